@@ -71,6 +71,7 @@
 #include "libavutil/bprint.h"
 #include "libavutil/dict.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 
 #include "libavformat/avformat.h"
@@ -113,6 +114,12 @@ int        nb_filtergraphs;
 Decoder     **decoders;
 int        nb_decoders;
 
+/* FrameData is attached to every packet and frame passing through the
+ * transcoding pipeline, so recycle it through a pool instead of going through
+ * the allocator for each of them. */
+static AVBufferPool *frame_data_pool;
+static AVOnce        frame_data_pool_init_once = AV_ONCE_INIT;
+
 #if HAVE_TERMIOS_H
 
 /* init terminal so that we can grab keys */
@@ -338,7 +345,10 @@ static void ffmpeg_cleanup(int ret)
 
     hw_device_free_all();
 
+    av_buffer_pool_uninit(&frame_data_pool);
+
     av_freep(&filter_nbthreads);
+    av_freep(&filter_thread_type);
 
     av_freep(&input_files);
     av_freep(&output_files);
@@ -398,6 +408,27 @@ static void frame_data_free(void *opaque, uint8_t *data)
     av_free(data);
 }
 
+static AVBufferRef *frame_data_alloc(size_t size)
+{
+    AVBufferRef *buf;
+    FrameData *fd;
+
+    fd = av_mallocz(size);
+    if (!fd)
+        return NULL;
+
+    buf = av_buffer_create((uint8_t *)fd, size, frame_data_free, NULL, 0);
+    if (!buf)
+        av_freep(&fd);
+
+    return buf;
+}
+
+static void frame_data_pool_init(void)
+{
+    frame_data_pool = av_buffer_pool_init(sizeof(FrameData), frame_data_alloc);
+}
+
 static int frame_data_ensure(AVBufferRef **dst, int writable)
 {
     AVBufferRef *src = *dst;
@@ -405,17 +436,19 @@ static int frame_data_ensure(AVBufferRef **dst, int writable)
     if (!src || (writable && !av_buffer_is_writable(src))) {
         FrameData *fd;
 
-        fd = av_mallocz(sizeof(*fd));
-        if (!fd)
+        ff_thread_once(&frame_data_pool_init_once, frame_data_pool_init);
+        if (!frame_data_pool)
             return AVERROR(ENOMEM);
 
-        *dst = av_buffer_create((uint8_t *)fd, sizeof(*fd),
-                                frame_data_free, NULL, 0);
+        *dst = av_buffer_pool_get(frame_data_pool);
         if (!*dst) {
             av_buffer_unref(&src);
-            av_freep(&fd);
             return AVERROR(ENOMEM);
         }
+        fd = (FrameData *)(*dst)->data;
+
+        // recycled entries may still hold their previous user's parameters
+        avcodec_parameters_free(&fd->par_enc);
 
         if (src) {
             const FrameData *fd_src = (const FrameData *)src->data;
@@ -439,6 +472,8 @@ static int frame_data_ensure(AVBufferRef **dst, int writable)
 
             av_buffer_unref(&src);
         } else {
+            memset(fd, 0, sizeof(*fd));
+
             fd->dec.frame_num = UINT64_MAX;
             fd->dec.pts       = AV_NOPTS_VALUE;
 
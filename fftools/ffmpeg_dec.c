@@ -102,6 +102,17 @@ typedef struct DecoderPriv {
         AVDictionary       *opts;
         const AVCodec      *codec;
     } standalone_init;
+
+    /* Decoders opened before the scheduler is started cannot know their share
+     * of the task thread budget yet. They are opened with a single thread and
+     * reopened with these parameters once the decoding task starts. */
+    struct {
+        AVDictionary       *opts;
+        const AVCodec      *codec;
+        AVCodecParameters  *par;
+        AVRational          time_base;
+        char               *hwaccel_device;
+    } deferred_open;
 } DecoderPriv;
 
 static DecoderPriv *dp_from_dec(Decoder *d)
@@ -132,6 +143,10 @@ void dec_free(Decoder **pdec)
 
     av_dict_free(&dp->standalone_init.opts);
 
+    av_dict_free(&dp->deferred_open.opts);
+    avcodec_parameters_free(&dp->deferred_open.par);
+    av_freep(&dp->deferred_open.hwaccel_device);
+
     for (int i = 0; i < FF_ARRAY_ELEMS(dp->sub_prev); i++)
         av_frame_free(&dp->sub_prev[i]);
     av_frame_free(&dp->sub_heartbeat);
@@ -829,6 +844,7 @@ static int packet_decode(DecoderPriv *dp, AVPacket *pkt, AVFrame *frame)
     }
 }
 
+static int dec_deferred_reopen(DecoderPriv *dp);
 static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
                     const DecoderOpts *o, AVFrame *param_out);
 
@@ -921,6 +937,12 @@ static int decoder_thread(void *arg)
 
     dec_thread_set_name(dp);
 
+    if (dp->deferred_open.codec) {
+        ret = dec_deferred_reopen(dp);
+        if (ret < 0)
+            goto finish;
+    }
+
     while (!input_status) {
         int flush_buffers, have_data;
 
@@ -1519,47 +1541,17 @@ static int hw_device_setup_for_decode(DecoderPriv *dp,
     return 0;
 }
 
-static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
-                    const DecoderOpts *o, AVFrame *param_out)
+static int dec_codec_open(DecoderPriv *dp, const AVCodec *codec,
+                          const AVCodecParameters *par, AVRational time_base,
+                          const char *hwaccel_device, AVDictionary **dec_opts)
 {
-    const AVCodec *codec = o->codec;
     int ret;
 
-    dp->flags      = o->flags;
-    dp->log_parent = o->log_parent;
-
-    dp->dec.type                = codec->type;
-    dp->framerate_in            = o->framerate;
-
-    dp->hwaccel_id              = o->hwaccel_id;
-    dp->hwaccel_device_type     = o->hwaccel_device_type;
-    dp->hwaccel_output_format   = o->hwaccel_output_format;
-
-    snprintf(dp->log_name, sizeof(dp->log_name), "dec:%s", codec->name);
-
-    dp->parent_name = av_strdup(o->name ? o->name : "");
-    if (!dp->parent_name)
-        return AVERROR(ENOMEM);
-
-    if (codec->type == AVMEDIA_TYPE_SUBTITLE &&
-        (dp->flags & DECODER_FLAG_FIX_SUB_DURATION)) {
-        for (int i = 0; i < FF_ARRAY_ELEMS(dp->sub_prev); i++) {
-            dp->sub_prev[i] = av_frame_alloc();
-            if (!dp->sub_prev[i])
-                return AVERROR(ENOMEM);
-        }
-        dp->sub_heartbeat = av_frame_alloc();
-        if (!dp->sub_heartbeat)
-            return AVERROR(ENOMEM);
-    }
-
-    dp->sar_override = o->par->sample_aspect_ratio;
-
     dp->dec_ctx = avcodec_alloc_context3(codec);
     if (!dp->dec_ctx)
         return AVERROR(ENOMEM);
 
-    ret = avcodec_parameters_to_context(dp->dec_ctx, o->par);
+    ret = avcodec_parameters_to_context(dp->dec_ctx, par);
     if (ret < 0) {
         av_log(dp, AV_LOG_ERROR, "Error initializing the decoder context.\n");
         return ret;
@@ -1568,12 +1560,9 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
     dp->dec_ctx->opaque                = dp;
     dp->dec_ctx->get_format            = get_format;
     dp->dec_ctx->get_buffer2           = get_buffer;
-    dp->dec_ctx->pkt_timebase          = o->time_base;
-
-    if (!av_dict_get(*dec_opts, "threads", NULL, 0))
-        av_dict_set(dec_opts, "threads", "auto", 0);
+    dp->dec_ctx->pkt_timebase          = time_base;
 
-    ret = hw_device_setup_for_decode(dp, codec, o->hwaccel_device);
+    ret = hw_device_setup_for_decode(dp, codec, hwaccel_device);
     if (ret < 0) {
         av_log(dp, AV_LOG_ERROR,
                "Hardware device setup failed for decoder: %s\n",
@@ -1592,7 +1581,7 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
         return ret;
 
     dp->dec_ctx->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
-    if (o->flags & DECODER_FLAG_BITEXACT)
+    if (dp->flags & DECODER_FLAG_BITEXACT)
         dp->dec_ctx->flags |= AV_CODEC_FLAG_BITEXACT;
 
     // we apply cropping outselves
@@ -1621,6 +1610,131 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
     dp->dec.subtitle_header      = dp->dec_ctx->subtitle_header;
     dp->dec.subtitle_header_size = dp->dec_ctx->subtitle_header_size;
 
+    return 0;
+}
+
+static int dec_defer_open(DecoderPriv *dp, const AVDictionary *dec_opts,
+                          const DecoderOpts *o)
+{
+    int ret;
+
+    ret = av_dict_copy(&dp->deferred_open.opts, dec_opts, 0);
+    if (ret < 0)
+        return ret;
+
+    dp->deferred_open.par = avcodec_parameters_alloc();
+    if (!dp->deferred_open.par)
+        return AVERROR(ENOMEM);
+
+    ret = avcodec_parameters_copy(dp->deferred_open.par, o->par);
+    if (ret < 0)
+        return ret;
+
+    if (o->hwaccel_device) {
+        dp->deferred_open.hwaccel_device = av_strdup(o->hwaccel_device);
+        if (!dp->deferred_open.hwaccel_device)
+            return AVERROR(ENOMEM);
+    }
+
+    dp->deferred_open.codec     = o->codec;
+    dp->deferred_open.time_base = o->time_base;
+
+    return 0;
+}
+
+/* reopen a decoder whose thread count was deferred, now that the scheduler
+ * has been started and the thread budget split is final */
+static int dec_deferred_reopen(DecoderPriv *dp)
+{
+    int nb_threads = sch_auto_threads(dp->sch);
+    int ret = 0;
+
+    if (nb_threads > 1) {
+        av_log(dp, AV_LOG_VERBOSE, "Reopening decoder with %d threads\n",
+               nb_threads);
+
+        avcodec_free_context(&dp->dec_ctx);
+
+        ret = av_dict_set_int(&dp->deferred_open.opts, "threads", nb_threads, 0);
+        if (ret >= 0)
+            ret = dec_codec_open(dp, dp->deferred_open.codec,
+                                 dp->deferred_open.par,
+                                 dp->deferred_open.time_base,
+                                 dp->deferred_open.hwaccel_device,
+                                 &dp->deferred_open.opts);
+    }
+
+    av_dict_free(&dp->deferred_open.opts);
+    avcodec_parameters_free(&dp->deferred_open.par);
+    av_freep(&dp->deferred_open.hwaccel_device);
+    dp->deferred_open.codec = NULL;
+
+    return ret;
+}
+
+static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
+                    const DecoderOpts *o, AVFrame *param_out)
+{
+    const AVCodec *codec = o->codec;
+    int ret;
+
+    dp->flags      = o->flags;
+    dp->log_parent = o->log_parent;
+
+    dp->dec.type                = codec->type;
+    dp->framerate_in            = o->framerate;
+
+    dp->hwaccel_id              = o->hwaccel_id;
+    dp->hwaccel_device_type     = o->hwaccel_device_type;
+    dp->hwaccel_output_format   = o->hwaccel_output_format;
+
+    snprintf(dp->log_name, sizeof(dp->log_name), "dec:%s", codec->name);
+
+    dp->parent_name = av_strdup(o->name ? o->name : "");
+    if (!dp->parent_name)
+        return AVERROR(ENOMEM);
+
+    if (codec->type == AVMEDIA_TYPE_SUBTITLE &&
+        (dp->flags & DECODER_FLAG_FIX_SUB_DURATION)) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(dp->sub_prev); i++) {
+            dp->sub_prev[i] = av_frame_alloc();
+            if (!dp->sub_prev[i])
+                return AVERROR(ENOMEM);
+        }
+        dp->sub_heartbeat = av_frame_alloc();
+        if (!dp->sub_heartbeat)
+            return AVERROR(ENOMEM);
+    }
+
+    dp->sar_override = o->par->sample_aspect_ratio;
+
+    if (!av_dict_get(*dec_opts, "threads", NULL, 0)) {
+        int nb_threads = sch_auto_threads(dp->sch);
+
+        if (nb_threads == AVERROR(EAGAIN)) {
+            // the budget is split once all the components are known, so
+            // open with a single thread for now and reopen when decoding
+            // starts if the codec can use more
+            if (codec->capabilities & (AV_CODEC_CAP_FRAME_THREADS |
+                                       AV_CODEC_CAP_SLICE_THREADS)) {
+                ret = dec_defer_open(dp, *dec_opts, o);
+                if (ret < 0)
+                    return ret;
+            }
+            nb_threads = 1;
+        }
+
+        if (nb_threads)
+            av_dict_set_int(dec_opts, "threads", nb_threads, 0);
+        else
+            av_dict_set(dec_opts, "threads", "auto", 0);
+    }
+
+    ret = dec_codec_open(dp, codec, o->par, o->time_base, o->hwaccel_device,
+                         dec_opts);
+    if (ret < 0)
+        return ret;
+
     if (param_out) {
         if (dp->dec_ctx->codec_type == AVMEDIA_TYPE_AUDIO) {
             param_out->format               = dp->dec_ctx->sample_fmt;
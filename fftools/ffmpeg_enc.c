@@ -327,6 +327,10 @@ int enc_open(void *opaque, const AVFrame *frame)
 
     enc_ctx->flags |= AV_CODEC_FLAG_FRAME_DURATION;
 
+    // automatic thread count, share the scheduler task budget if there is one
+    if (!enc_ctx->thread_count)
+        enc_ctx->thread_count = sch_auto_threads(ep->sch);
+
     ret = hw_device_setup_for_encode(e, enc_ctx, frame ? frame->hw_frames_ctx : NULL);
     if (ret < 0) {
         av_log(e, AV_LOG_ERROR,
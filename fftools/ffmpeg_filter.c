@@ -1904,6 +1904,12 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
     if (!fgt->graph)
         return AVERROR(ENOMEM);
 
+    if (filter_thread_type) {
+        ret = av_opt_set(fgt->graph, "thread_type", filter_thread_type, 0);
+        if (ret < 0)
+            goto fail;
+    }
+
     if (simple) {
         OutputFilterPriv *ofp = ofp_from_ofilter(fg->outputs[0]);
 
@@ -1915,6 +1921,8 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             ret = av_opt_set(fgt->graph, "threads", fgp->nb_threads, 0);
             if (ret < 0)
                 return ret;
+        } else {
+            fgt->graph->nb_threads = sch_auto_threads(fgp->sch);
         }
 
         if (av_dict_count(ofp->sws_opts)) {
@@ -1934,7 +1942,8 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             av_free(args);
         }
     } else {
-        fgt->graph->nb_threads = filter_complex_nbthreads;
+        fgt->graph->nb_threads = filter_complex_nbthreads ?
+                                 filter_complex_nbthreads : sch_auto_threads(fgp->sch);
     }
 
     hw_device = hw_device_for_filter();
@@ -2445,9 +2454,21 @@ static int fg_output_frame(OutputFilterPriv *ofp, FilterGraphThread *fgt,
                 break;
 
             frame_out = fgp->frame_enc;
-            ret = av_frame_ref(frame_out, frame_in);
-            if (ret < 0)
-                return ret;
+
+            // Without CFR duplication the frame is never output again, so
+            // hand it over to the encoder instead of keeping a reference.
+            // That saves reallocating its buffer refs and side data, and
+            // lets the buffer return to the filter's pool as soon as the
+            // encoder is done with it.
+            if (frame_in == frame && i == nb_frames - 1 &&
+                ofp->fps.vsync_method != VSYNC_CFR &&
+                ofp->fps.vsync_method != VSYNC_VSCFR)
+                av_frame_move_ref(frame_out, frame_in);
+            else {
+                ret = av_frame_ref(frame_out, frame_in);
+                if (ret < 0)
+                    return ret;
+            }
 
             frame_out->pts = ofp->next_pts;
 
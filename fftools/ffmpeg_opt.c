@@ -74,6 +74,7 @@ int print_stats       = -1;
 int stdin_interaction = 1;
 float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
+char *filter_thread_type;
 int filter_complex_nbthreads = 0;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
@@ -423,6 +424,13 @@ static int opt_filter_threads(void *optctx, const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_filter_thread_type(void *optctx, const char *opt, const char *arg)
+{
+    av_free(filter_thread_type);
+    filter_thread_type = av_strdup(arg);
+    return filter_thread_type ? 0 : AVERROR(ENOMEM);
+}
+
 static int opt_abort_on(void *optctx, const char *opt, const char *arg)
 {
     static const AVOption opts[] = {
@@ -624,6 +632,23 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(go->sch, arg);
 }
 
+static int opt_task_threads(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    double nb_threads;
+    int ret;
+
+    if (!strcmp(arg, "auto"))
+        nb_threads = 0;
+    else {
+        ret = parse_number(opt, arg, OPT_TYPE_INT, 0, INT_MAX, &nb_threads);
+        if (ret < 0)
+            return ret;
+    }
+
+    return sch_set_task_threads(go->sch, nb_threads);
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1720,9 +1745,16 @@ const OptionDef options[] = {
     { "filter_complex",         OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
+    { "task_threads",           OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_task_threads },
+        "limit the number of concurrently running transcoding tasks and "
+        "share it with codec and filter threads", "count" },
     { "filter_complex_threads", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_thread_type",     OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_filter_thread_type },
+        "allowed thread types for all filtergraphs", "flags" },
     { "lavfi",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
@@ -32,6 +32,7 @@
 #include "libavcodec/packet.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
@@ -69,6 +70,10 @@ typedef struct SchTask {
 
     pthread_t           thread;
     int                 thread_running;
+
+    // whether this task currently occupies one of Scheduler.task_slots;
+    // only accessed from the task's own thread
+    int                 slot_held;
 } SchTask;
 
 typedef struct SchDecOutput {
@@ -311,6 +316,19 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    /* Maximum number of tasks that may be running (i.e. not waiting inside
+     * the scheduler) at the same time, 0 means unlimited. Tasks release their
+     * slot whenever they enter a potentially blocking scheduler call, so the
+     * limit only applies to actual processing. */
+    int                 task_slots;
+    int                 task_slots_free;
+    pthread_mutex_t     task_slots_lock;
+    pthread_cond_t      task_slots_cond;
+
+    /* Per-component share of task_slots, determined in sch_start() once all
+     * the components are known. */
+    int                 auto_threads;
 };
 
 /**
@@ -372,7 +390,7 @@ static void waiter_uninit(SchWaiter *w)
 }
 
 static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
-                       enum QueueType type)
+                       enum QueueType type, unsigned flags)
 {
     ThreadQueue *tq;
     ObjPool *op;
@@ -399,7 +417,7 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
         return AVERROR(ENOMEM);
 
     tq = tq_alloc(nb_streams, queue_size, op,
-                  (type == QUEUE_PACKETS) ? pkt_move : frame_move);
+                  (type == QUEUE_PACKETS) ? pkt_move : frame_move, flags);
     if (!tq) {
         objpool_free(&op);
         return AVERROR(ENOMEM);
@@ -409,6 +427,39 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
     return 0;
 }
 
+static void task_slot_acquire(Scheduler *sch, SchTask *task)
+{
+    if (!sch->task_slots || task->slot_held)
+        return;
+
+    pthread_mutex_lock(&sch->task_slots_lock);
+
+    while (!sch->task_slots_free && !atomic_load(&sch->terminate))
+        pthread_cond_wait(&sch->task_slots_cond, &sch->task_slots_lock);
+
+    // on termination, tasks are let through unconditionally so that they
+    // can notice it and exit; the slot count may temporarily go negative
+    sch->task_slots_free--;
+    task->slot_held = 1;
+
+    pthread_mutex_unlock(&sch->task_slots_lock);
+}
+
+static void task_slot_release(Scheduler *sch, SchTask *task)
+{
+    if (!sch->task_slots || !task->slot_held)
+        return;
+
+    pthread_mutex_lock(&sch->task_slots_lock);
+
+    sch->task_slots_free++;
+    task->slot_held = 0;
+    if (sch->task_slots_free > 0)
+        pthread_cond_signal(&sch->task_slots_cond);
+
+    pthread_mutex_unlock(&sch->task_slots_lock);
+}
+
 static void *task_wrapper(void *arg);
 
 static int task_start(SchTask *task)
@@ -574,6 +625,9 @@ void sch_free(Scheduler **psch)
     pthread_mutex_destroy(&sch->mux_done_lock);
     pthread_cond_destroy(&sch->mux_done_cond);
 
+    pthread_mutex_destroy(&sch->task_slots_lock);
+    pthread_cond_destroy(&sch->task_slots_cond);
+
     av_freep(psch);
 }
 
@@ -610,12 +664,46 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
+    ret = pthread_mutex_init(&sch->task_slots_lock, NULL);
+    if (ret)
+        goto fail;
+
+    ret = pthread_cond_init(&sch->task_slots_cond, NULL);
+    if (ret)
+        goto fail;
+
     return sch;
 fail:
     sch_free(&sch);
     return NULL;
 }
 
+int sch_set_task_threads(Scheduler *sch, int nb_threads)
+{
+    if (sch->state != SCH_STATE_UNINIT || nb_threads < 0)
+        return AVERROR(EINVAL);
+
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+
+    sch->task_slots      = nb_threads;
+    sch->task_slots_free = nb_threads;
+
+    return 0;
+}
+
+int sch_auto_threads(const Scheduler *sch)
+{
+    if (!sch->task_slots)
+        return 0;
+
+    // the split is only meaningful once the graph is complete
+    if (sch->state == SCH_STATE_UNINIT)
+        return AVERROR(EAGAIN);
+
+    return sch->auto_threads;
+}
+
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
 {
     av_freep(&sch->sdp_filename);
@@ -769,10 +857,6 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx, int send_end_ts)
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS);
-    if (ret < 0)
-        return ret;
-
     if (send_end_ts) {
         ret = av_thread_message_queue_alloc(&dec->queue_end_ts, 1, sizeof(Timestamp));
         if (ret < 0)
@@ -813,10 +897,6 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
     if (!enc->send_pkt)
         return AVERROR(ENOMEM);
 
-    ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES);
-    if (ret < 0)
-        return ret;
-
     return idx;
 }
 
@@ -861,7 +941,7 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES, 0);
     if (ret < 0)
         return ret;
 
@@ -1545,7 +1625,44 @@ static int start_prepare(Scheduler *sch)
         }
 
         ret = queue_alloc(&mux->queue, mux->nb_streams, mux->queue_size,
-                          QUEUE_PACKETS);
+                          QUEUE_PACKETS, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    // Decoder and encoder input queues are allocated here rather than when
+    // the component is added, because whether they have a single producer
+    // is only known once everything is connected.
+    for (unsigned i = 0; i < sch->nb_dec; i++) {
+        SchDec *dec = &sch->dec[i];
+        unsigned flags = TQ_SINGLE_PRODUCER;
+
+        // subtitle heartbeats are sent from muxer threads,
+        // concurrently with the regular source
+        for (unsigned j = 0; j < sch->nb_mux && flags; j++) {
+            const SchMux *mux = &sch->mux[j];
+
+            for (unsigned k = 0; k < mux->nb_streams && flags; k++) {
+                const SchMuxStream *ms = &mux->streams[k];
+
+                for (unsigned l = 0; l < ms->nb_sub_heartbeat_dst; l++)
+                    if (ms->sub_heartbeat_dst[l] == i)
+                        flags = 0;
+            }
+        }
+
+        ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS, flags);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (unsigned i = 0; i < sch->nb_enc; i++) {
+        SchEnc *enc = &sch->enc[i];
+
+        // encoders in a sync queue may be sent frames by whichever thread
+        // currently holds the sync queue lock
+        ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES,
+                          enc->sq_idx[0] >= 0 ? 0 : TQ_SINGLE_PRODUCER);
         if (ret < 0)
             return ret;
     }
@@ -1607,6 +1724,11 @@ int sch_start(Scheduler *sch)
     av_assert0(sch->state == SCH_STATE_UNINIT);
     sch->state = SCH_STATE_STARTED;
 
+    if (sch->task_slots) {
+        unsigned nb_tasks = sch->nb_dec + sch->nb_enc + sch->nb_filters;
+        sch->auto_threads = FFMAX(1, sch->task_slots / FFMAX(nb_tasks, 1));
+    }
+
     for (unsigned i = 0; i < sch->nb_mux; i++) {
         SchMux *mux = &sch->mux[i];
 
@@ -2036,8 +2158,8 @@ static int demux_flush(Scheduler *sch, SchDemux *d, AVPacket *pkt)
     return 0;
 }
 
-int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
-                   unsigned flags)
+static int demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
+                      unsigned flags)
 {
     SchDemux *d;
     int terminate;
@@ -2058,6 +2180,22 @@ int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
     return demux_send_for_stream(sch, d, &d->streams[pkt->stream_index], pkt, flags);
 }
 
+int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
+                   unsigned flags)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(demux_idx < sch->nb_demux);
+    task = &sch->demux[demux_idx].task;
+
+    task_slot_release(sch, task);
+    ret = demux_send(sch, demux_idx, pkt, flags);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 static int demux_done(Scheduler *sch, unsigned demux_idx)
 {
     SchDemux *d = &sch->demux[demux_idx];
@@ -2080,7 +2218,7 @@ static int demux_done(Scheduler *sch, unsigned demux_idx)
     return ret;
 }
 
-int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
+static int mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
 {
     SchMux *mux;
     int ret, stream_idx;
@@ -2093,6 +2231,21 @@ int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
     return ret;
 }
 
+int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(mux_idx < sch->nb_mux);
+    task = &sch->mux[mux_idx].task;
+
+    task_slot_release(sch, task);
+    ret = mux_receive(sch, mux_idx, pkt);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 void sch_mux_receive_finish(Scheduler *sch, unsigned mux_idx, unsigned stream_idx)
 {
     SchMux *mux;
@@ -2131,7 +2284,9 @@ int sch_mux_sub_heartbeat(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
         if (ret < 0)
             return ret;
 
+        task_slot_release(sch, &mux->task);
         tq_send(dst->queue, 0, mux->sub_heartbeat_pkt);
+        task_slot_acquire(sch, &mux->task);
     }
 
     return 0;
@@ -2164,7 +2319,7 @@ static int mux_done(Scheduler *sch, unsigned mux_idx)
     return 0;
 }
 
-int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
+static int dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
 {
     SchDec *dec;
     int ret, dummy;
@@ -2193,6 +2348,21 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
     return ret;
 }
 
+int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(dec_idx < sch->nb_dec);
+    task = &sch->dec[dec_idx].task;
+
+    task_slot_release(sch, task);
+    ret = dec_receive(sch, dec_idx, pkt);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 static int send_to_filter(Scheduler *sch, SchFilterGraph *fg,
                           unsigned in_idx, AVFrame *frame)
 {
@@ -2240,8 +2410,8 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_dec_send(Scheduler *sch, unsigned dec_idx,
-                 unsigned out_idx, AVFrame *frame)
+static int dec_send(Scheduler *sch, unsigned dec_idx,
+                    unsigned out_idx, AVFrame *frame)
 {
     SchDec *dec;
     SchDecOutput *o;
@@ -2284,6 +2454,22 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
     return (nb_done == o->nb_dst) ? AVERROR_EOF : 0;
 }
 
+int sch_dec_send(Scheduler *sch, unsigned dec_idx,
+                 unsigned out_idx, AVFrame *frame)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(dec_idx < sch->nb_dec);
+    task = &sch->dec[dec_idx].task;
+
+    task_slot_release(sch, task);
+    ret = dec_send(sch, dec_idx, out_idx, frame);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 static int dec_done(Scheduler *sch, unsigned dec_idx)
 {
     SchDec *dec = &sch->dec[dec_idx];
@@ -2309,7 +2495,7 @@ static int dec_done(Scheduler *sch, unsigned dec_idx)
     return ret;
 }
 
-int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
+static int enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
 {
     SchEnc *enc;
     int ret, dummy;
@@ -2323,6 +2509,21 @@ int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
     return ret;
 }
 
+int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(enc_idx < sch->nb_enc);
+    task = &sch->enc[enc_idx].task;
+
+    task_slot_release(sch, task);
+    ret = enc_receive(sch, enc_idx, frame);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 static int enc_send_to_dst(Scheduler *sch, const SchedulerNode dst,
                            uint8_t *dst_finished, AVPacket *pkt)
 {
@@ -2353,7 +2554,7 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+static int enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
 {
     SchEnc *enc;
     int ret;
@@ -2386,6 +2587,21 @@ int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
     return 0;
 }
 
+int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(enc_idx < sch->nb_enc);
+    task = &sch->enc[enc_idx].task;
+
+    task_slot_release(sch, task);
+    ret = enc_send(sch, enc_idx, pkt);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 static int enc_done(Scheduler *sch, unsigned enc_idx)
 {
     SchEnc *enc = &sch->enc[enc_idx];
@@ -2402,8 +2618,8 @@ static int enc_done(Scheduler *sch, unsigned enc_idx)
     return ret;
 }
 
-int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
-                       unsigned *in_idx, AVFrame *frame)
+static int filter_receive(Scheduler *sch, unsigned fg_idx,
+                          unsigned *in_idx, AVFrame *frame)
 {
     SchFilterGraph *fg;
 
@@ -2446,6 +2662,22 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
     }
 }
 
+int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
+                       unsigned *in_idx, AVFrame *frame)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(fg_idx < sch->nb_filters);
+    task = &sch->filters[fg_idx].task;
+
+    task_slot_release(sch, task);
+    ret = filter_receive(sch, fg_idx, in_idx, frame);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 void sch_filter_receive_finish(Scheduler *sch, unsigned fg_idx, unsigned in_idx)
 {
     SchFilterGraph *fg;
@@ -2467,7 +2699,7 @@ void sch_filter_receive_finish(Scheduler *sch, unsigned fg_idx, unsigned in_idx)
     }
 }
 
-int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *frame)
+static int filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *frame)
 {
     SchFilterGraph *fg;
     SchedulerNode  dst;
@@ -2483,6 +2715,21 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
            send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
 }
 
+int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *frame)
+{
+    SchTask *task;
+    int ret;
+
+    av_assert0(fg_idx < sch->nb_filters);
+    task = &sch->filters[fg_idx].task;
+
+    task_slot_release(sch, task);
+    ret = filter_send(sch, fg_idx, out_idx, frame);
+    task_slot_acquire(sch, task);
+
+    return ret;
+}
+
 static int filter_done(Scheduler *sch, unsigned fg_idx)
 {
     SchFilterGraph *fg = &sch->filters[fg_idx];
@@ -2541,11 +2788,15 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    task_slot_acquire(sch, task);
+
     ret = task->func(task->func_arg);
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
                "Task finished with error code: %d (%s)\n", ret, av_err2str(ret));
 
+    task_slot_release(sch, task);
+
     err = task_cleanup(sch, task->node);
     ret = err_merge(ret, err);
 
@@ -2587,6 +2838,10 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts)
 
     atomic_store(&sch->terminate, 1);
 
+    pthread_mutex_lock(&sch->task_slots_lock);
+    pthread_cond_broadcast(&sch->task_slots_cond);
+    pthread_mutex_unlock(&sch->task_slots_lock);
+
     for (unsigned type = 0; type < 2; type++)
         for (unsigned i = 0; i < (type ? sch->nb_demux : sch->nb_filters); i++) {
             SchWaiter *w = type ? &sch->demux[i].waiter : &sch->filters[i].waiter;
@@ -149,6 +149,35 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts);
  */
 int sch_wait(Scheduler *sch, uint64_t timeout_us, int64_t *transcode_ts);
 
+/**
+ * Limit the number of tasks (demuxers, decoders, filtergraphs, encoders and
+ * muxers) that may be processing data at the same time. A task waiting inside
+ * the scheduler for input or for space in its output queues does not count
+ * towards this limit, so pipelines with many components do not oversubscribe
+ * the CPU.
+ *
+ * Must be called before sch_start().
+ *
+ * @param nb_threads maximum number of concurrently running tasks; 0 uses the
+ *                   number of logical CPUs
+ */
+int sch_set_task_threads(Scheduler *sch, int nb_threads);
+
+/**
+ * Get the thread count that decoders, encoders and filtergraphs with an
+ * automatic thread count should use so that they share the limit set by
+ * sch_set_task_threads() with the other components.
+ *
+ * The threads are divided between all the components added to the scheduler,
+ * so the share is only known once the scheduler has been started.
+ *
+ * @return the recommended thread count, 0 when no limit was set and the
+ *         component should determine its thread count on its own, or
+ *         AVERROR(EAGAIN) when a limit was set but sch_start() has not been
+ *         called yet
+ */
+int sch_auto_threads(const Scheduler *sch);
+
 /**
  * Add a demuxer to the scheduler.
  *
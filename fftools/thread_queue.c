@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -50,6 +51,22 @@ struct ThreadQueue {
 
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+
+    /* Lock-free ring used instead of fifo for TQ_SINGLE_PRODUCER queues.
+     * Every slot holds a preallocated object that the data is moved into and
+     * out of, so the object pool is never touched after allocation.
+     * ring_tail is only written by the producer, ring_head only by the
+     * consumer; both increase monotonically and are taken modulo ring_size.
+     * lock/cond are only used to sleep when the ring is full/empty, and the
+     * other side only takes the lock to wake up a thread that is actually
+     * sleeping. */
+    void          **ring;
+    size_t          ring_size;
+    atomic_size_t   ring_head;
+    atomic_size_t   ring_tail;
+    atomic_int      ring_finished;
+    atomic_int      ring_wait_send;
+    atomic_int      ring_wait_recv;
 };
 
 void tq_free(ThreadQueue **ptq)
@@ -66,6 +83,12 @@ void tq_free(ThreadQueue **ptq)
     }
     av_fifo_freep2(&tq->fifo);
 
+    if (tq->ring) {
+        for (size_t i = 0; i < tq->ring_size; i++)
+            objpool_release(tq->obj_pool, &tq->ring[i]);
+    }
+    av_freep(&tq->ring);
+
     objpool_free(&tq->obj_pool);
 
     av_freep(&tq->finished);
@@ -77,7 +100,8 @@ void tq_free(ThreadQueue **ptq)
 }
 
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src))
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      unsigned flags)
 {
     ThreadQueue *tq;
     int ret;
@@ -104,25 +128,149 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
         goto fail;
     tq->nb_streams = nb_streams;
 
+    tq->obj_pool = obj_pool;
+    tq->obj_move = obj_move;
+
+    if (flags & TQ_SINGLE_PRODUCER) {
+        av_assert0(nb_streams == 1);
+
+        tq->ring = av_calloc(queue_size, sizeof(*tq->ring));
+        if (!tq->ring)
+            goto fail;
+        tq->ring_size = queue_size;
+
+        for (size_t i = 0; i < queue_size; i++) {
+            ret = objpool_get(tq->obj_pool, &tq->ring[i]);
+            if (ret < 0)
+                goto fail;
+        }
+
+        atomic_init(&tq->ring_head,      0);
+        atomic_init(&tq->ring_tail,      0);
+        atomic_init(&tq->ring_finished,  0);
+        atomic_init(&tq->ring_wait_send, 0);
+        atomic_init(&tq->ring_wait_recv, 0);
+
+        return tq;
+    }
+
     tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
     if (!tq->fifo)
         goto fail;
 
-    tq->obj_pool = obj_pool;
-    tq->obj_move = obj_move;
-
     return tq;
 fail:
     tq_free(&tq);
     return NULL;
 }
 
+static void ring_wake(ThreadQueue *tq, atomic_int *waiting)
+{
+    if (!atomic_load(waiting))
+        return;
+
+    pthread_mutex_lock(&tq->lock);
+    pthread_cond_broadcast(&tq->cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+static int ring_send(ThreadQueue *tq, void *data)
+{
+    size_t tail = atomic_load_explicit(&tq->ring_tail, memory_order_relaxed);
+    int finished;
+
+    if (atomic_load(&tq->ring_finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    while (1) {
+        finished = atomic_load(&tq->ring_finished);
+        if ((finished & FINISHED_RECV) ||
+            tail - atomic_load_explicit(&tq->ring_head, memory_order_acquire) < tq->ring_size)
+            break;
+
+        pthread_mutex_lock(&tq->lock);
+        atomic_store(&tq->ring_wait_send, 1);
+        // re-check after announcing ourselves, the consumer only signals
+        // when it sees ring_wait_send set
+        if (!(atomic_load(&tq->ring_finished) & FINISHED_RECV) &&
+            tail - atomic_load(&tq->ring_head) >= tq->ring_size)
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        atomic_store(&tq->ring_wait_send, 0);
+        pthread_mutex_unlock(&tq->lock);
+    }
+
+    if (finished & FINISHED_RECV) {
+        atomic_fetch_or(&tq->ring_finished, FINISHED_SEND);
+        return AVERROR_EOF;
+    }
+
+    tq->obj_move(tq->ring[tail % tq->ring_size], data);
+    atomic_store(&tq->ring_tail, tail + 1);
+
+    ring_wake(tq, &tq->ring_wait_recv);
+
+    return 0;
+}
+
+static int ring_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    size_t head = atomic_load_explicit(&tq->ring_head, memory_order_relaxed);
+
+    while (1) {
+        int finished = atomic_load(&tq->ring_finished);
+
+        if (finished & FINISHED_RECV)
+            return AVERROR_EOF;
+
+        // the producer sets FINISHED_SEND after writing its last item,
+        // so the ring must be checked after loading the flags
+        if (atomic_load_explicit(&tq->ring_tail, memory_order_acquire) != head)
+            break;
+
+        if (finished & FINISHED_SEND) {
+            atomic_fetch_or(&tq->ring_finished, FINISHED_RECV);
+            ring_wake(tq, &tq->ring_wait_send);
+            *stream_idx = 0;
+            return AVERROR_EOF;
+        }
+
+        pthread_mutex_lock(&tq->lock);
+        atomic_store(&tq->ring_wait_recv, 1);
+        if (!atomic_load(&tq->ring_finished) &&
+            atomic_load(&tq->ring_tail) == head)
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        atomic_store(&tq->ring_wait_recv, 0);
+        pthread_mutex_unlock(&tq->lock);
+    }
+
+    tq->obj_move(data, tq->ring[head % tq->ring_size]);
+    atomic_store(&tq->ring_head, head + 1);
+    *stream_idx = 0;
+
+    ring_wake(tq, &tq->ring_wait_send);
+
+    return 0;
+}
+
+static void ring_finish(ThreadQueue *tq, int flag)
+{
+    atomic_fetch_or(&tq->ring_finished, flag);
+
+    pthread_mutex_lock(&tq->lock);
+    pthread_cond_broadcast(&tq->cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 {
     int *finished;
     int ret;
 
     av_assert0(stream_idx < tq->nb_streams);
+
+    if (tq->ring)
+        return ring_send(tq, data);
+
     finished = &tq->finished[stream_idx];
 
     pthread_mutex_lock(&tq->lock);
@@ -199,6 +347,9 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     *stream_idx = -1;
 
+    if (tq->ring)
+        return ring_receive(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -227,6 +378,11 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        ring_finish(tq, FINISHED_SEND);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as send-finished;
@@ -242,6 +398,11 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        ring_finish(tq, FINISHED_RECV);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as recv-finished;
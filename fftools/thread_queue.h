@@ -25,6 +25,16 @@
 
 typedef struct ThreadQueue ThreadQueue;
 
+enum ThreadQueueFlags {
+    /**
+     * Items are only ever sent by one thread at a time (and received by one
+     * thread at a time). Such queues are implemented as a lock-free ring,
+     * with the mutex only used for sleeping when the ring is full or empty.
+     * Only valid for queues with a single stream.
+     */
+    TQ_SINGLE_PRODUCER = (1 << 0),
+};
+
 /**
  * Allocate a queue for sending data between threads.
  *
@@ -35,9 +45,11 @@ typedef struct ThreadQueue ThreadQueue;
  * @param obj_pool object pool that will be used to allocate items stored in the
  *                 queue; the pool becomes owned by the queue
  * @param callback that moves the contents between two data pointers
+ * @param flags a combination of ThreadQueueFlags
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src));
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      unsigned flags);
 void         tq_free(ThreadQueue **tq);
 
 /**
@@ -826,6 +826,84 @@ static void copy_input_samples(AACEncContext *s, const AVFrame *frame)
     }
 }
 
+/**
+ * Reset the coding tools of a channel element and run the psychoacoustic
+ * analysis on it. This has to be done in bitstream order since the model
+ * keeps track of the bit reservoir.
+ */
+static void analyze_element(AVCodecContext *avctx, AACEncContext *s,
+                            int el, int start_ch, FFPsyWindowInfo *wi,
+                            int *target_bits)
+{
+    ChannelElement *cpe = &s->cpe[el];
+    int chans = s->chan_map[el + 1] == TYPE_CPE ? 2 : 1;
+    const float *coeffs[2];
+
+    cpe->common_window = 0;
+    memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
+    memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
+    for (int ch = 0; ch < chans; ch++) {
+        SingleChannelElement *sce = &cpe->ch[ch];
+        coeffs[ch] = sce->coeffs;
+        sce->ics.predictor_present = 0;
+        sce->ics.ltp.present = 0;
+        memset(sce->ics.ltp.used, 0, sizeof(sce->ics.ltp.used));
+        memset(sce->ics.prediction_used, 0, sizeof(sce->ics.prediction_used));
+        memset(&sce->tns, 0, sizeof(TemporalNoiseShaping));
+        for (int w = 0; w < 128; w++)
+            if (sce->band_type[w] > RESERVED_BT)
+                sce->band_type[w] = 0;
+    }
+    s->psy.bitres.alloc = -1;
+    s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
+    s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
+    if (s->psy.bitres.alloc > 0) {
+        /* Lambda unused here on purpose, we need to take psy's unscaled allocation */
+        *target_bits += s->psy.bitres.alloc
+            * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
+        s->psy.bitres.alloc /= chans;
+    }
+    for (int ch = 0; ch < chans; ch++)
+        s->ch_bitres_alloc[start_ch + ch] = s->psy.bitres.alloc;
+}
+
+static void search_channel_quantizers(AVCodecContext *avctx, AACEncContext *s,
+                                      SingleChannelElement *sce)
+{
+    if (s->options.pns && s->coder->mark_pns)
+        s->coder->mark_pns(s, avctx, sce);
+    s->coder->search_for_quantizers(avctx, s, sce, s->lambda);
+}
+
+/**
+ * Quantizer search of one channel on a thread, after all channel elements
+ * have been analyzed. The search only depends on the channel itself and on
+ * the allocation psy made for it, so each thread uses its own copy of the
+ * context for the scratch buffers and the band cost cache.
+ */
+static int search_quantizers_job(AVCodecContext *avctx, void *arg,
+                                 int jobnr, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    AACEncContext *t = &s->thread_ctx[threadnr];
+    int el, start_ch = 0;
+
+    for (el = 0; el < s->chan_map[0]; el++) {
+        int chans = s->chan_map[el + 1] == TYPE_CPE ? 2 : 1;
+        if (jobnr < start_ch + chans)
+            break;
+        start_ch += chans;
+    }
+
+    t->lambda              = s->lambda;
+    t->cur_type            = s->chan_map[el + 1];
+    t->cur_channel         = jobnr;
+    t->psy.bitres.alloc    = s->ch_bitres_alloc[jobnr];
+    search_channel_quantizers(avctx, t, &s->cpe[el].ch[jobnr - start_ch]);
+
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                             const AVFrame *frame, int *got_packet_ptr)
 {
@@ -839,6 +917,9 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
     int ms_mode = 0, is_mode = 0, tns_mode = 0, pred_mode = 0;
     int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    /* The coder may set the psy cutoff while encoding the first frame, which
+     * the analysis of the following channel elements takes into account. */
+    int threaded = s->thread_ctx && avctx->frame_num > 1;
 
     /* add current frame to queue */
     if (frame) {
@@ -959,47 +1040,31 @@ static int aac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
         if ((avctx->frame_num & 0xFF)==1 && !(avctx->flags & AV_CODEC_FLAG_BITEXACT))
             put_bitstream_info(s, LIBAVCODEC_IDENT);
-        start_ch = 0;
         target_bits = 0;
+        if (threaded) {
+            start_ch = 0;
+            for (i = 0; i < s->chan_map[0]; i++) {
+                analyze_element(avctx, s, i, start_ch, windows + start_ch, &target_bits);
+                start_ch += s->chan_map[i+1] == TYPE_CPE ? 2 : 1;
+            }
+            avctx->execute2(avctx, search_quantizers_job, NULL, NULL, s->channels);
+        }
+        start_ch = 0;
         memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < s->chan_map[0]; i++) {
             FFPsyWindowInfo* wi = windows + start_ch;
-            const float *coeffs[2];
             tag      = s->chan_map[i+1];
             chans    = tag == TYPE_CPE ? 2 : 1;
             cpe      = &s->cpe[i];
-            cpe->common_window = 0;
-            memset(cpe->is_mask, 0, sizeof(cpe->is_mask));
-            memset(cpe->ms_mask, 0, sizeof(cpe->ms_mask));
             put_bits(&s->pb, 3, tag);
             put_bits(&s->pb, 4, chan_el_counter[tag]++);
-            for (ch = 0; ch < chans; ch++) {
-                sce = &cpe->ch[ch];
-                coeffs[ch] = sce->coeffs;
-                sce->ics.predictor_present = 0;
-                sce->ics.ltp.present = 0;
-                memset(sce->ics.ltp.used, 0, sizeof(sce->ics.ltp.used));
-                memset(sce->ics.prediction_used, 0, sizeof(sce->ics.prediction_used));
-                memset(&sce->tns, 0, sizeof(TemporalNoiseShaping));
-                for (w = 0; w < 128; w++)
-                    if (sce->band_type[w] > RESERVED_BT)
-                        sce->band_type[w] = 0;
-            }
-            s->psy.bitres.alloc = -1;
-            s->psy.bitres.bits = s->last_frame_pb_count / s->channels;
-            s->psy.model->analyze(&s->psy, start_ch, coeffs, wi);
-            if (s->psy.bitres.alloc > 0) {
-                /* Lambda unused here on purpose, we need to take psy's unscaled allocation */
-                target_bits += s->psy.bitres.alloc
-                    * (s->lambda / (avctx->global_quality ? avctx->global_quality : 120));
-                s->psy.bitres.alloc /= chans;
-            }
             s->cur_type = tag;
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                if (s->options.pns && s->coder->mark_pns)
-                    s->coder->mark_pns(s, avctx, &cpe->ch[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
+            if (!threaded) {
+                analyze_element(avctx, s, i, start_ch, wi, &target_bits);
+                for (ch = 0; ch < chans; ch++) {
+                    s->cur_channel = start_ch + ch;
+                    search_channel_quantizers(avctx, s, &cpe->ch[ch]);
+                }
             }
             if (chans > 1
                 && wi[0].window_type[0] == wi[1].window_type[0]
@@ -1196,6 +1261,7 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     av_freep(&s->buffer.samples);
     av_freep(&s->cpe);
     av_freep(&s->fdsp);
+    av_freep(&s->thread_ctx);
     ff_af_queue_close(&s->afq);
     return 0;
 }
@@ -1384,6 +1450,16 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     ff_af_queue_init(avctx, &s->afq);
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE && avctx->thread_count > 1) {
+        s->thread_ctx = av_malloc_array(avctx->thread_count, sizeof(*s->thread_ctx));
+        if (!s->thread_ctx)
+            return AVERROR(ENOMEM);
+        for (i = 0; i < avctx->thread_count; i++) {
+            s->thread_ctx[i] = *s;
+            s->thread_ctx[i].thread_ctx = NULL;
+        }
+    }
+
     return 0;
 }
 
@@ -1422,7 +1498,7 @@ const FFCodec ff_aac_encoder = {
     .p.type         = AVMEDIA_TYPE_AUDIO,
     .p.id           = AV_CODEC_ID_AAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
-                      AV_CODEC_CAP_SMALL_LAST_FRAME,
+                      AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_SLICE_THREADS,
     .priv_data_size = sizeof(AACEncContext),
     .init           = aac_encode_init,
     FF_CODEC_ENCODE_CB(aac_encode_frame),
@@ -253,6 +253,9 @@ typedef struct AACEncContext {
     struct {
         float *samples;
     } buffer;
+
+    struct AACEncContext *thread_ctx;            ///< per-thread copies used by the quantizer search
+    int ch_bitres_alloc[16];                     ///< psy bit allocation of each channel of the frame
 } AACEncContext;
 
 void ff_quantize_band_cost_cache_init(struct AACEncContext *s);
@@ -1982,12 +1982,181 @@ static void ac3_output_frame(AC3EncodeContext *s, unsigned char *frame)
     output_frame_end(s, &pb);
 }
 
+/**
+ * Set the packet properties once a frame has been written to avpkt.
+ */
+static int output_packet(AVCodecContext *avctx, AVPacket *avpkt,
+                         const AVFrame *frame)
+{
+    if (frame->pts != AV_NOPTS_VALUE)
+        avpkt->pts = frame->pts - ff_samples_to_time_base(avctx, avctx->initial_padding);
+    avpkt->duration = frame->duration ? frame->duration :
+                      ff_samples_to_time_base(avctx, frame->nb_samples);
+
+    return ff_encode_reordered_opaque(avctx, avpkt, frame);
+}
+
+
+/**
+ * Analysis part of a threaded frame: everything up to the bit allocation
+ * search, which depends on the SNR offset of the previous frame.
+ */
+static int analyze_job(AVCodecContext *avctx, void *arg)
+{
+    AC3EncodeJob *job = arg;
+    AC3EncodeContext *s = job->avctx->priv_data;
+
+    s->encode_frame(s, job->frame->extended_data);
+
+    ac3_apply_rematrixing(s);
+
+    ac3_process_exponents(s);
+
+    count_frame_bits(s);
+
+    s->exponent_bits = count_exponent_bits(s);
+
+    bit_alloc_masking(s);
+
+    return 0;
+}
+
+
+static int output_job(AVCodecContext *avctx, void *arg)
+{
+    AC3EncodeJob *job = arg;
+    AC3EncodeContext *s = job->avctx->priv_data;
+
+    if (job->ret)
+        return 0;
+
+    ac3_group_exponents(s);
+
+    ac3_quantize_mantissas(s);
+
+    ac3_output_frame(s, job->buf);
+
+    return 0;
+}
+
+
+/**
+ * Encode all queued frames.
+ *
+ * The MDCT overlap, the frame size and the SNR offset search are carried from
+ * one frame to the next. The main context keeps them: the overlap and the
+ * frame size are known from the input before encoding, so the analysis of
+ * all frames is done in parallel, then the bit allocation is run in order,
+ * then the mantissas of all frames are quantized and written in parallel.
+ */
+static void encode_batch(AVCodecContext *avctx)
+{
+    AC3EncodeContext *s = avctx->priv_data;
+    int sample_size = SAMPLETYPE_SIZE(s);
+
+    for (int i = 0; i < s->nb_queued; i++) {
+        AC3EncodeJob *job = &s->jobs[i];
+        AC3EncodeContext *t = job->avctx->priv_data;
+        int tail;
+
+        av_frame_move_ref(job->frame, s->queue[i]);
+        tail = (job->frame->nb_samples - AC3_BLOCK_SIZE) * sample_size;
+
+        if (s->bit_alloc.sr_code == 1 || s->eac3)
+            ac3_adjust_frame_size(s);
+        t->frame_size = s->frame_size;
+
+        for (int ch = 0; ch < s->channels; ch++) {
+            memcpy(t->planar_samples[ch], s->planar_samples[ch],
+                   AC3_BLOCK_SIZE * sample_size);
+            memcpy(s->planar_samples[ch],
+                   job->frame->extended_data[s->channel_map[ch]] + tail,
+                   AC3_BLOCK_SIZE * sample_size);
+        }
+    }
+
+    avctx->execute(avctx, analyze_job, s->jobs, NULL, s->nb_queued,
+                   sizeof(*s->jobs));
+
+    for (int i = 0; i < s->nb_queued; i++) {
+        AC3EncodeContext *t = s->jobs[i].avctx->priv_data;
+
+        t->coarse_snr_offset = s->coarse_snr_offset;
+        memcpy(t->fine_snr_offset, s->fine_snr_offset, sizeof(s->fine_snr_offset));
+        s->jobs[i].ret = cbr_bit_allocation(t);
+        if (!s->jobs[i].ret) {
+            s->coarse_snr_offset = t->coarse_snr_offset;
+            memcpy(s->fine_snr_offset, t->fine_snr_offset, sizeof(s->fine_snr_offset));
+        }
+    }
+
+    avctx->execute(avctx, output_job, s->jobs, NULL, s->nb_queued,
+                   sizeof(*s->jobs));
+
+    s->nb_encoded = s->nb_queued;
+    s->nb_queued  = 0;
+    s->next_out   = 0;
+}
+
+
+static int encode_frame_threaded(AVCodecContext *avctx, AVPacket *avpkt,
+                                 const AVFrame *frame, int *got_packet_ptr)
+{
+    AC3EncodeContext *s = avctx->priv_data;
+    AC3EncodeJob *job;
+    AC3EncodeContext *t;
+    int ret;
+
+    if (frame) {
+        ret = av_frame_ref(s->queue[s->nb_queued], frame);
+        if (ret < 0)
+            return ret;
+        s->nb_queued++;
+    }
+
+    if (s->next_out == s->nb_encoded) {
+        if (s->nb_queued < s->nb_jobs && (frame || !s->nb_queued))
+            return 0;
+        encode_batch(avctx);
+    }
+
+    job = &s->jobs[s->next_out++];
+    t   = job->avctx->priv_data;
+    if (job->ret) {
+        av_log(avctx, AV_LOG_ERROR, "Bit allocation failed. Try increasing the bitrate.\n");
+        ret = job->ret;
+        goto end;
+    }
+
+    ret = ff_get_encode_buffer(avctx, avpkt, t->frame_size, 0);
+    if (ret < 0)
+        goto end;
+    memcpy(avpkt->data, job->buf, t->frame_size);
+
+    ret = output_packet(avctx, avpkt, job->frame);
+    if (ret < 0)
+        goto end;
+
+    *got_packet_ptr = 1;
+end:
+    av_frame_unref(job->frame);
+    return ret;
+}
+
+
 int ff_ac3_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                         const AVFrame *frame, int *got_packet_ptr)
 {
     AC3EncodeContext *const s = avctx->priv_data;
     int ret;
 
+    if (s->nb_jobs)
+        return encode_frame_threaded(avctx, avpkt, frame, got_packet_ptr);
+
+    /* no delay without threads */
+    if (!frame)
+        return 0;
+
     if (s->options.allow_per_frame_metadata) {
         ret = ac3_validate_metadata(s);
         if (ret)
@@ -2018,8 +2187,9 @@ int ff_ac3_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
         return ret;
     ac3_output_frame(s, avpkt->data);
 
-    if (frame->pts != AV_NOPTS_VALUE)
-        avpkt->pts = frame->pts - ff_samples_to_time_base(avctx, avctx->initial_padding);
+    ret = output_packet(avctx, avpkt, frame);
+    if (ret < 0)
+        return ret;
 
     *got_packet_ptr = 1;
     return 0;
@@ -2174,6 +2344,16 @@ av_cold int ff_ac3_encode_close(AVCodecContext *avctx)
     av_freep(&s->cpl_coord_buffer);
     av_freep(&s->fdsp);
 
+    for (int i = 0; i < s->nb_jobs; i++) {
+        avcodec_free_context(&s->jobs[i].avctx);
+        av_frame_free(&s->jobs[i].frame);
+        av_freep(&s->jobs[i].buf);
+        av_frame_free(&s->queue[i]);
+    }
+    av_freep(&s->jobs);
+    av_freep(&s->queue);
+    s->nb_jobs = 0;
+
     av_tx_uninit(&s->tx);
 
     return 0;
@@ -2473,6 +2653,54 @@ static av_cold int allocate_buffers(AC3EncodeContext *s)
 }
 
 
+/*
+ * Open one encoder instance per thread for encode_batch().
+ */
+static av_cold int init_jobs(AVCodecContext *avctx)
+{
+    AC3EncodeContext *s = avctx->priv_data;
+    int nb_jobs = avctx->thread_count;
+
+    if (nb_jobs <= 1 || s->options.allow_per_frame_metadata)
+        return 0;
+
+    s->jobs  = av_calloc(nb_jobs, sizeof(*s->jobs));
+    s->queue = av_calloc(nb_jobs, sizeof(*s->queue));
+    if (!s->jobs || !s->queue)
+        return AVERROR(ENOMEM);
+    s->nb_jobs = nb_jobs;
+
+    for (int i = 0; i < nb_jobs; i++) {
+        AC3EncodeJob *job = &s->jobs[i];
+        AVCodecContext *job_avctx;
+        int ret;
+
+        job->frame  = av_frame_alloc();
+        job->buf    = av_malloc(s->frame_size_min + 2);
+        s->queue[i] = av_frame_alloc();
+        job->avctx  = job_avctx = avcodec_alloc_context3(avctx->codec);
+        if (!job->frame || !job->buf || !s->queue[i] || !job_avctx)
+            return AVERROR(ENOMEM);
+
+        ret = av_opt_copy(job_avctx, avctx);
+        if (ret < 0)
+            return ret;
+        ret = av_opt_copy(job_avctx->priv_data, avctx->priv_data);
+        if (ret < 0)
+            return ret;
+        job_avctx->sample_fmt   = avctx->sample_fmt;
+        job_avctx->time_base    = avctx->time_base;
+        job_avctx->thread_count = 1;
+
+        ret = avcodec_open2(job_avctx, avctx->codec, NULL);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+
 av_cold int ff_ac3_encode_init(AVCodecContext *avctx)
 {
     static AVOnce init_static_once = AV_ONCE_INIT;
@@ -2522,5 +2750,8 @@ av_cold int ff_ac3_encode_init(AVCodecContext *avctx)
 
     ff_thread_once(&init_static_once, exponent_init);
 
+    if (avctx->active_thread_type & FF_THREAD_SLICE)
+        return init_jobs(avctx);
+
     return 0;
 }
@@ -152,6 +152,16 @@ typedef struct AC3Block {
 
 struct PutBitContext;
 
+/**
+ * A frame encoded by a worker thread, see encode_batch() in ac3enc.c.
+ */
+typedef struct AC3EncodeJob {
+    AVCodecContext *avctx;                  ///< encoder instance owning the job state
+    AVFrame *frame;
+    uint8_t *buf;                           ///< coded frame
+    int ret;                                ///< error code of the bit allocation
+} AC3EncodeJob;
+
 /**
  * AC-3 encoder private context.
  */
@@ -245,6 +255,13 @@ typedef struct AC3EncodeContext {
     int16_t *qmant_buffer;
     uint8_t *cpl_coord_buffer;
 
+    AC3EncodeJob *jobs;                     ///< one job per thread, NULL when single-threaded
+    AVFrame **queue;                        ///< frames waiting for the next batch
+    int nb_jobs;
+    int nb_queued;
+    int nb_encoded;                         ///< number of frames of the last batch
+    int next_out;                           ///< next job of the last batch to output
+
     uint8_t exp_strategy[AC3_MAX_CHANNELS][AC3_MAX_BLOCKS]; ///< exponent strategies
     uint8_t frame_exp_strategy[AC3_MAX_CHANNELS];           ///< frame exp strategy index
     int use_frame_exp_strategy;                             ///< indicates use of frame exp strategy
@@ -102,6 +102,10 @@ static int amf_save_hdr_metadata(AVCodecContext *avctx, const AVFrame *frame, AM
 
 #define PTS_PROP L"PtsProp"
 
+// QueryOutput() timeout while blocked on the encoder, it returns as soon as
+// output is available so this only bounds how long a stalled encoder is waited for
+#define QUERY_WAIT_TIMEOUT_MS 100
+
 const enum AVPixelFormat ff_amf_pix_fmts[] = {
     AV_PIX_FMT_NV12,
     AV_PIX_FMT_YUV420P,
@@ -641,13 +645,31 @@ static void amf_release_buffer_with_frame_ref(AMFBuffer *frame_ref_storage_buffe
     frame_ref_storage_buffer->pVtbl->Release(frame_ref_storage_buffer);
 }
 
+static void amf_set_query_timeout(AVCodecContext *avctx, int timeout)
+{
+    AmfContext *ctx = avctx->priv_data;
+    AMF_RESULT res;
+
+    if (!ctx->query_timeout_supported || ctx->query_timeout == timeout)
+        return;
+    AMF_ASSIGN_PROPERTY_INT64(res, ctx->encoder, ctx->query_timeout_prop, timeout);
+    if (res != AMF_OK) {
+        // fall back to polling, the current timeout is unknown
+        av_log(avctx, AV_LOG_WARNING, "Setting the QueryOutput() timeout to %d ms "
+               "failed with error %d, falling back to polling\n", timeout, res);
+        ctx->query_timeout_supported = 0;
+        return;
+    }
+    ctx->query_timeout = timeout;
+}
+
 int ff_amf_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
 {
     AmfContext *ctx = avctx->priv_data;
     AMFSurface *surface;
     AMF_RESULT  res;
     int         ret;
-    AMF_RESULT  res_query;
+    AMF_RESULT  res_query = AMF_OK;
     AMFData    *data = NULL;
     AVFrame    *frame = ctx->delayed_frame;
     int         block_and_wait;
@@ -844,6 +866,13 @@ int ff_amf_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
         block_and_wait = 0;
         // poll data
         if (!avpkt->data && !avpkt->buf && (ctx->use_b_frame ? (ctx->submitted_frame >= 2) : true) ) {
+            // Only let QueryOutput() wait for the encoder when nothing else
+            // can be done until it produces output, otherwise return at once
+            // so that the caller can submit more input.
+            int must_wait = ctx->delayed_surface || ctx->delayed_drain || ctx->eof ||
+                            ctx->hwsurfaces_in_queue >= ctx->hwsurfaces_in_queue_max;
+            amf_set_query_timeout(avctx, must_wait ? QUERY_WAIT_TIMEOUT_MS : 0);
+
             res_query = ctx->encoder->pVtbl->QueryOutput(ctx->encoder, &data);
             if (data) {
                 // copy data to packet
@@ -914,8 +943,10 @@ int ff_amf_receive_packet(AVCodecContext *avctx, AVPacket *avpkt)
                 block_and_wait = 1;
 
                 // Only sleep if the driver doesn't support waiting in QueryOutput()
-                // or if we already have output data so we will skip calling it.
-                if (!ctx->query_timeout_supported || avpkt->data || avpkt->buf) {
+                // or if QueryOutput() was skipped, otherwise it blocks until
+                // the encoder produces something.
+                if (!ctx->query_timeout_supported || avpkt->data || avpkt->buf ||
+                    (ctx->use_b_frame && ctx->submitted_frame < 2)) {
                     av_usleep(1000);
                 }
             }
@@ -69,6 +69,8 @@ typedef struct AmfContext {
     int                 hwsurfaces_in_queue;
     int                 hwsurfaces_in_queue_max;
     int                 query_timeout_supported;
+    int                 query_timeout;      ///< current QueryOutput() timeout in ms
+    const wchar_t      *query_timeout_prop; ///< codec-specific name of the timeout property
 
     // helpers to handle async calls
     int                 delayed_drain;
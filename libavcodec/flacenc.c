@@ -103,6 +103,18 @@ typedef struct FlacFrame {
     int verbatim_only;
 } FlacFrame;
 
+struct FlacEncodeContext;
+
+/**
+ * A frame encoded by a worker thread, see encode_batch().
+ */
+typedef struct FlacEncodeJob {
+    struct FlacEncodeContext *s;    ///< private copy of the encoder state
+    AVFrame *frame;
+    uint8_t *buf;
+    int      size;                  ///< size of the coded frame or error code
+} FlacEncodeJob;
+
 typedef struct FlacEncodeContext {
     AVClass *class;
     PutBitContext pb;
@@ -129,6 +141,13 @@ typedef struct FlacEncodeContext {
 
     int flushed;
     int64_t next_pts;
+
+    FlacEncodeJob *jobs;
+    AVFrame **queue;                ///< input frames waiting for the next batch
+    int nb_jobs;
+    int nb_queued;
+    int nb_encoded;                 ///< number of frames of the last batch
+    int next_out;                   ///< next frame of the last batch to output
 } FlacEncodeContext;
 
 
@@ -267,6 +286,55 @@ static av_cold void dprint_compression_options(FlacEncodeContext *s)
 }
 
 
+/**
+ * Frames are independent except for the frame number in the header and the
+ * stream statistics in STREAMINFO, so with several threads the input frames
+ * are gathered in batches of one frame per thread, each frame is encoded
+ * with its own copy of the encoder state and the packets are output in order.
+ */
+static av_cold int init_jobs(AVCodecContext *avctx)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int nb_jobs = avctx->thread_count;
+
+    if (nb_jobs <= 1)
+        return 0;
+
+    s->jobs  = av_calloc(nb_jobs, sizeof(*s->jobs));
+    s->queue = av_calloc(nb_jobs, sizeof(*s->queue));
+    if (!s->jobs || !s->queue)
+        return AVERROR(ENOMEM);
+    s->nb_jobs = nb_jobs;
+
+    for (int i = 0; i < nb_jobs; i++) {
+        FlacEncodeJob *job = &s->jobs[i];
+        int ret;
+
+        job->s     = av_mallocz(sizeof(*job->s));
+        job->frame = av_frame_alloc();
+        job->buf   = av_malloc(s->max_framesize);
+        s->queue[i] = av_frame_alloc();
+        if (!job->s || !job->frame || !job->buf || !s->queue[i])
+            return AVERROR(ENOMEM);
+
+        *job->s = *s;
+        job->s->md5ctx          = NULL;
+        job->s->md5_buffer      = NULL;
+        job->s->md5_buffer_size = 0;
+        job->s->jobs            = NULL;
+        job->s->queue           = NULL;
+        job->s->nb_jobs         = 0;
+        memset(&job->s->lpc_ctx, 0, sizeof(job->s->lpc_ctx));
+        ret = ff_lpc_init(&job->s->lpc_ctx, avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+
 static av_cold int flac_encode_init(AVCodecContext *avctx)
 {
     int freq = avctx->sample_rate;
@@ -472,6 +540,9 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
 
     dprint_compression_options(s);
 
+    if (ret >= 0 && avctx->active_thread_type & FF_THREAD_SLICE)
+        ret = init_jobs(avctx);
+
     return ret;
 }
 
@@ -1561,9 +1632,9 @@ static void write_frame_footer(FlacEncodeContext *s)
 }
 
 
-static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
+static int write_frame(FlacEncodeContext *s, uint8_t *buf, int size)
 {
-    init_put_bits(&s->pb, avpkt->data, avpkt->size);
+    init_put_bits(&s->pb, buf, size);
     write_frame_header(s);
     write_subframes(s);
     write_frame_footer(s);
@@ -1571,10 +1642,11 @@ static int write_frame(FlacEncodeContext *s, AVPacket *avpkt)
 }
 
 
-static int update_md5_sum(FlacEncodeContext *s, const void *samples)
+static int update_md5_sum(FlacEncodeContext *s, const void *samples,
+                          int nb_samples)
 {
     const uint8_t *buf;
-    int buf_size = s->frame.blocksize * s->channels *
+    int buf_size = nb_samples * s->channels *
                    ((s->avctx->bits_per_raw_sample + 7) / 8);
 
     if (s->avctx->bits_per_raw_sample > 16 || HAVE_BIGENDIAN) {
@@ -1595,7 +1667,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+        for (i = 0; i < nb_samples * s->channels; i++) {
             int32_t v = samples0[i] >> 8;
             AV_WL24(tmp + 3*i, v);
         }
@@ -1606,7 +1678,7 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
         const int32_t *samples0 = samples;
         uint8_t *tmp            = s->md5_buffer;
 
-        for (i = 0; i < s->frame.blocksize * s->channels; i++)
+        for (i = 0; i < nb_samples * s->channels; i++)
             AV_WL32(tmp + 4*i, samples0[i]);
         buf = s->md5_buffer;
     }
@@ -1616,6 +1688,154 @@ static int update_md5_sum(FlacEncodeContext *s, const void *samples)
 }
 
 
+/**
+ * Encode the samples of frame into s->frame.
+ *
+ * @return size of the coded frame in bytes or a negative error code
+ */
+static int compress_frame(FlacEncodeContext *s, const AVFrame *frame)
+{
+    int frame_bytes;
+
+    init_frame(s, frame->nb_samples);
+
+    copy_samples(s, frame->data[0]);
+
+    channel_decorrelation(s);
+
+    remove_wasted_bits(s);
+
+    frame_bytes = encode_frame(s);
+
+    /* Fall back on verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
+        s->frame.verbatim_only = 1;
+        frame_bytes = encode_frame(s);
+        if (frame_bytes < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "Bad frame count\n");
+            return frame_bytes;
+        }
+    }
+
+    return frame_bytes;
+}
+
+
+/**
+ * Update the stream statistics and set the packet properties once a frame
+ * has been written to avpkt.
+ */
+static int output_frame(AVCodecContext *avctx, AVPacket *avpkt,
+                        const AVFrame *frame, int out_bytes)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    int ret;
+
+    s->sample_count += frame->nb_samples;
+    if ((ret = update_md5_sum(s, frame->data[0], frame->nb_samples)) < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+        return ret;
+    }
+    if (out_bytes > s->max_encoded_framesize)
+        s->max_encoded_framesize = out_bytes;
+    if (out_bytes < s->min_framesize)
+        s->min_framesize = out_bytes;
+
+    s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
+
+    avpkt->pts      = frame->pts;
+    avpkt->duration = ff_samples_to_time_base(avctx, frame->nb_samples);
+
+    return ff_encode_reordered_opaque(avctx, avpkt, frame);
+}
+
+
+static int encode_job(AVCodecContext *avctx, void *arg)
+{
+    FlacEncodeJob *job = arg;
+    FlacEncodeContext *s = job->s;
+    int frame_bytes;
+
+    s->max_framesize = flac_get_max_frame_size(job->frame->nb_samples,
+                                               s->channels,
+                                               avctx->bits_per_raw_sample);
+
+    frame_bytes = compress_frame(s, job->frame);
+    if (frame_bytes < 0) {
+        job->size = frame_bytes;
+        return 0;
+    }
+
+    job->size = write_frame(s, job->buf, frame_bytes);
+    return 0;
+}
+
+
+/**
+ * Encode all queued frames in parallel.
+ */
+static void encode_batch(AVCodecContext *avctx)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+
+    for (int i = 0; i < s->nb_queued; i++) {
+        FlacEncodeJob *job = &s->jobs[i];
+
+        av_frame_move_ref(job->frame, s->queue[i]);
+        job->s->frame_count = s->frame_count++;
+    }
+
+    avctx->execute(avctx, encode_job, s->jobs, NULL, s->nb_queued,
+                   sizeof(*s->jobs));
+
+    s->nb_encoded = s->nb_queued;
+    s->nb_queued  = 0;
+    s->next_out   = 0;
+}
+
+
+static int flac_encode_frame_threaded(AVCodecContext *avctx, AVPacket *avpkt,
+                                      const AVFrame *frame, int *got_packet_ptr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacEncodeJob *job;
+    int ret;
+
+    if (frame) {
+        ret = av_frame_ref(s->queue[s->nb_queued], frame);
+        if (ret < 0)
+            return ret;
+        s->nb_queued++;
+    }
+
+    if (s->next_out == s->nb_encoded) {
+        if (s->nb_queued < s->nb_jobs && (frame || !s->nb_queued))
+            return 0;
+        encode_batch(avctx);
+    }
+
+    job = &s->jobs[s->next_out++];
+    if (job->size < 0) {
+        ret = job->size;
+        goto end;
+    }
+
+    if ((ret = ff_get_encode_buffer(avctx, avpkt, job->size, 0)) < 0)
+        goto end;
+    memcpy(avpkt->data, job->buf, job->size);
+
+    ret = output_frame(avctx, avpkt, job->frame, job->size);
+    if (ret < 0)
+        goto end;
+
+    *got_packet_ptr = 1;
+end:
+    av_frame_unref(job->frame);
+    return ret;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                              const AVFrame *frame, int *got_packet_ptr)
 {
@@ -1624,6 +1844,9 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
 
     s = avctx->priv_data;
 
+    if (s->nb_jobs && (frame || s->nb_queued || s->next_out < s->nb_encoded))
+        return flac_encode_frame_threaded(avctx, avpkt, frame, got_packet_ptr);
+
     /* when the last block is reached, update the header in extradata */
     if (!frame) {
         s->max_framesize = s->max_encoded_framesize;
@@ -1653,44 +1876,18 @@ static int flac_encode_frame(AVCodecContext *avctx, AVPacket *avpkt,
                                                    avctx->bits_per_raw_sample);
     }
 
-    init_frame(s, frame->nb_samples);
-
-    copy_samples(s, frame->data[0]);
-
-    channel_decorrelation(s);
-
-    remove_wasted_bits(s);
-
-    frame_bytes = encode_frame(s);
-
-    /* Fall back on verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes < 0 || frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
-        if (frame_bytes < 0) {
-            av_log(avctx, AV_LOG_ERROR, "Bad frame count\n");
-            return frame_bytes;
-        }
-    }
+    frame_bytes = compress_frame(s, frame);
+    if (frame_bytes < 0)
+        return frame_bytes;
 
     if ((ret = ff_get_encode_buffer(avctx, avpkt, frame_bytes, 0)) < 0)
         return ret;
 
-    out_bytes = write_frame(s, avpkt);
+    out_bytes = write_frame(s, avpkt->data, avpkt->size);
 
     s->frame_count++;
-    s->sample_count += frame->nb_samples;
-    if ((ret = update_md5_sum(s, frame->data[0])) < 0) {
-        av_log(avctx, AV_LOG_ERROR, "Error updating MD5 checksum\n");
+    if ((ret = output_frame(avctx, avpkt, frame, out_bytes)) < 0)
         return ret;
-    }
-    if (out_bytes > s->max_encoded_framesize)
-        s->max_encoded_framesize = out_bytes;
-    if (out_bytes < s->min_framesize)
-        s->min_framesize = out_bytes;
-
-    s->next_pts = frame->pts + ff_samples_to_time_base(avctx, frame->nb_samples);
 
     av_shrink_packet(avpkt, out_bytes);
 
@@ -1703,6 +1900,19 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     FlacEncodeContext *s = avctx->priv_data;
 
+    for (int i = 0; i < s->nb_jobs; i++) {
+        FlacEncodeJob *job = &s->jobs[i];
+
+        if (job->s)
+            ff_lpc_end(&job->s->lpc_ctx);
+        av_freep(&job->s);
+        av_frame_free(&job->frame);
+        av_freep(&job->buf);
+        av_frame_free(&s->queue[i]);
+    }
+    av_freep(&s->jobs);
+    av_freep(&s->queue);
+
     av_freep(&s->md5ctx);
     av_freep(&s->md5_buffer);
     ff_lpc_end(&s->lpc_ctx);
@@ -1755,6 +1965,7 @@ const FFCodec ff_flac_encoder = {
     .p.id           = AV_CODEC_ID_FLAC,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY |
                       AV_CODEC_CAP_SMALL_LAST_FRAME |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(FlacEncodeContext),
     .init           = flac_encode_init,
@@ -1764,5 +1975,5 @@ const FFCodec ff_flac_encoder = {
                                                      AV_SAMPLE_FMT_S32,
                                                      AV_SAMPLE_FMT_NONE },
     .p.priv_class   = &flac_encoder_class,
-    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_EOF_FLUSH,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP,
 };
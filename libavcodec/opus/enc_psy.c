@@ -383,6 +383,63 @@ static int bands_dist(OpusPsyContext *s, CeltFrame *f, float *total_dist)
     return 0;
 }
 
+/* Only the parameters are copied, the bands are read-only during the trials
+ * and have been copied by run_trials() */
+static void trial_frame_init(CeltFrame *t, const CeltFrame *f, struct CeltPVQ *pvq)
+{
+    memcpy(t, f, offsetof(CeltFrame, block));
+    memcpy(&t->pvq, &f->pvq, sizeof(*f) - offsetof(CeltFrame, pvq));
+    t->pvq = pvq;
+}
+
+static int trial_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    OpusPsyContext *s = arg;
+    CeltFrame *t = &s->trial_frames[threadnr];
+
+    trial_frame_init(t, s->trial_src, s->trial_pvq[threadnr]);
+    if (s->trial_intensity)
+        t->intensity_stereo = t->end_band - jobnr;
+    else
+        t->dual_stereo = jobnr;
+
+    bands_dist(s, t, &s->trial_dist[jobnr]);
+
+    return 0;
+}
+
+/* With a single thread the trials run in order on f itself, each one seeing
+ * the state left behind by the previous one, as the serial search always did.
+ * With more threads every trial starts from the state of f instead, so they
+ * can run in parallel and the result does not depend on the thread count. */
+static void run_trials(OpusPsyContext *s, CeltFrame *f, int intensity,
+                       int nb_trials)
+{
+    if (s->nb_trial_frames < 2) {
+        for (int i = 0; i < nb_trials; i++) {
+            if (intensity)
+                f->intensity_stereo = f->end_band - i;
+            else
+                f->dual_stereo = i;
+            bands_dist(s, f, &s->trial_dist[i]);
+        }
+        return;
+    }
+
+    for (int i = 0; i < s->nb_trial_frames; i++) {
+        for (int ch = 0; ch < f->channels; ch++) {
+            CeltBlock *dst = &s->trial_frames[i].block[ch];
+            const CeltBlock *src = &f->block[ch];
+            memcpy(dst->lin_energy, src->lin_energy, sizeof(src->lin_energy));
+            memcpy(dst->coeffs, src->coeffs, sizeof(src->coeffs));
+        }
+    }
+
+    s->trial_src       = f;
+    s->trial_intensity = intensity;
+    s->avctx->execute2(s->avctx, trial_job, s, NULL, nb_trials);
+}
+
 static void celt_search_for_dual_stereo(OpusPsyContext *s, CeltFrame *f)
 {
     float td1, td2;
@@ -391,9 +448,9 @@ static void celt_search_for_dual_stereo(OpusPsyContext *s, CeltFrame *f)
     if (s->avctx->ch_layout.nb_channels < 2)
         return;
 
-    bands_dist(s, f, &td1);
-    f->dual_stereo = 1;
-    bands_dist(s, f, &td2);
+    run_trials(s, f, 0, 2);
+    td1 = s->trial_dist[0];
+    td2 = s->trial_dist[1];
 
     f->dual_stereo = td2 < td1;
     s->dual_stereo_used += td2 < td1;
@@ -409,9 +466,10 @@ static void celt_search_for_intensity(OpusPsyContext *s, CeltFrame *f)
     if (s->avctx->ch_layout.nb_channels < 2)
         return;
 
+    run_trials(s, f, 1, f->end_band - end_band + 1);
+
     for (i = f->end_band; i >= end_band; i--) {
-        f->intensity_stereo = i;
-        bands_dist(s, f, &dist);
+        dist = s->trial_dist[f->end_band - i];
         if (best_dist > dist) {
             best_dist = dist;
             best_band = i;
@@ -533,6 +591,21 @@ av_cold int ff_opus_psy_init(OpusPsyContext *s, AVCodecContext *avctx,
         goto fail;
     }
 
+    s->nb_trial_frames = avctx->active_thread_type & FF_THREAD_SLICE ?
+                         avctx->thread_count : 1;
+    if (s->nb_trial_frames > 1) {
+        s->trial_frames = av_calloc(s->nb_trial_frames, sizeof(*s->trial_frames));
+        s->trial_pvq    = av_calloc(s->nb_trial_frames, sizeof(*s->trial_pvq));
+        if (!s->trial_frames || !s->trial_pvq) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (i = 0; i < s->nb_trial_frames; i++) {
+            if ((ret = ff_celt_pvq_init(&s->trial_pvq[i], 1)) < 0)
+                goto fail;
+        }
+    }
+
     s->dsp = avpriv_float_dsp_alloc(avctx->flags & AV_CODEC_FLAG_BITEXACT);
     if (!s->dsp) {
         ret = AVERROR(ENOMEM);
@@ -584,6 +657,13 @@ fail:
     for (i = 0; i < s->max_steps; i++)
         av_freep(&s->steps[i]);
 
+    if (s->trial_pvq) {
+        for (i = 0; i < s->nb_trial_frames; i++)
+            ff_celt_pvq_uninit(&s->trial_pvq[i]);
+    }
+    av_freep(&s->trial_pvq);
+    av_freep(&s->trial_frames);
+
     return ret;
 }
 
@@ -607,6 +687,13 @@ av_cold int ff_opus_psy_end(OpusPsyContext *s)
     for (i = 0; i < s->max_steps; i++)
         av_freep(&s->steps[i]);
 
+    if (s->trial_pvq) {
+        for (i = 0; i < s->nb_trial_frames; i++)
+            ff_celt_pvq_uninit(&s->trial_pvq[i]);
+    }
+    av_freep(&s->trial_pvq);
+    av_freep(&s->trial_frames);
+
     av_log(s->avctx, AV_LOG_INFO, "Average Intensity Stereo band: %0.1f\n", s->avg_is_band);
     av_log(s->avctx, AV_LOG_INFO, "Dual Stereo used: %0.2f%%\n", ((float)s->dual_stereo_used/s->total_packets_out)*100.0f);
 
@@ -82,6 +82,14 @@ typedef struct OpusPsyContext {
     float lambda;
     int *inflection_points;
     int inflection_points_count;
+
+    /* Bit allocation trials, one frame and PVQ context per thread */
+    CeltFrame *trial_frames;
+    struct CeltPVQ **trial_pvq;
+    int nb_trial_frames;
+    const CeltFrame *trial_src;
+    int trial_intensity;                /* Trials search for the intensity band */
+    float trial_dist[CELT_MAX_BANDS + 1];
 } OpusPsyContext;
 
 int  ff_opus_psy_process           (OpusPsyContext *s, OpusPacketInfo *p);
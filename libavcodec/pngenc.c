@@ -42,6 +42,10 @@
 
 #define IOBUF_SIZE 4096
 
+/* amount of filtered image data compressed by one slice job */
+#define SLICE_SIZE (256 << 10)
+#define DICT_SIZE  (32 << 10)
+
 typedef struct APNGFctlChunk {
     uint32_t sequence_number;
     uint32_t width, height;
@@ -50,6 +54,17 @@ typedef struct APNGFctlChunk {
     uint8_t dispose_op, blend_op;
 } APNGFctlChunk;
 
+/**
+ * A horizontal band of the image, compressed independently of the others,
+ * see encode_frame_slices().
+ */
+typedef struct PNGEncSlice {
+    uint8_t *buf;
+    int      size;               ///< size of the compressed data or error code
+    uint32_t adler;              ///< Adler-32 of the filtered rows
+    int      input_size;
+} PNGEncSlice;
+
 typedef struct PNGEncContext {
     AVClass *class;
     LLVidEncDSPContext llvidencdsp;
@@ -82,6 +97,21 @@ typedef struct PNGEncContext {
     APNGFctlChunk last_frame_fctl;
     uint8_t *last_frame_packet;
     size_t last_frame_packet_size;
+
+    // slice threading
+    int compression_level;
+    FFZStream *slice_zstreams;   ///< one raw deflate stream per thread
+    PNGEncSlice *slices;
+    unsigned int slices_size;
+    uint8_t *slice_buf;          ///< compressed data of all slices
+    unsigned int slice_buf_size;
+    uint8_t *thread_buf;         ///< dictionary and row buffers of all threads
+    unsigned int thread_buf_size;
+    const AVFrame *slice_frame;
+    int slice_rows;
+    int slice_stride;            ///< size of the compressed data of a slice
+    int thread_stride;
+    int dict_rows;
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -296,6 +326,150 @@ static int png_write_row(AVCodecContext *avctx, const uint8_t *data, int size)
     return 0;
 }
 
+static int deflate_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s = avctx->priv_data;
+    PNGEncSlice *slice = &s->slices[jobnr];
+    z_stream *const zstream = &s->slice_zstreams[threadnr].zstream;
+    const AVFrame *p = s->slice_frame;
+    int row_size = (p->width * s->bits_per_pixel + 7) >> 3;
+    int bpp      = s->bits_per_pixel >> 3;
+    int y_start  = jobnr * s->slice_rows;
+    int y_end    = FFMIN(y_start + s->slice_rows, p->height);
+    int last     = y_end == p->height;
+    uint8_t *dict     = s->thread_buf + threadnr * s->thread_stride;
+    uint8_t *crow_buf = dict + FFALIGN(s->dict_rows * (row_size + 1), 64) + 15;
+    const uint8_t *top = NULL;
+    int y = FFMAX(y_start - s->dict_rows, 0);
+    int dict_size = 0, ret;
+
+    deflateReset(zstream);
+    slice->adler      = adler32(0, Z_NULL, 0);
+    slice->input_size = (y_end - y_start) * (row_size + 1);
+    slice->buf        = s->slice_buf + jobnr * s->slice_stride;
+
+    /* the previous rows are filtered again to prime the window, so that
+     * the compression ratio does not suffer from the split */
+    if (y > 0)
+        top = p->data[0] + (y - 1) * p->linesize[0];
+    for (; y < y_end; y++) {
+        const uint8_t *ptr = p->data[0] + y * p->linesize[0];
+        uint8_t *crow = png_choose_filter(s, crow_buf, ptr, top,
+                                          row_size, bpp);
+        top = ptr;
+
+        if (y < y_start) {
+            memcpy(dict + dict_size, crow, row_size + 1);
+            dict_size += row_size + 1;
+            continue;
+        }
+        if (y == y_start) {
+            if (dict_size > DICT_SIZE) {
+                dict      += dict_size - DICT_SIZE;
+                dict_size  = DICT_SIZE;
+            }
+            if (dict_size)
+                deflateSetDictionary(zstream, dict, dict_size);
+            zstream->next_out  = slice->buf;
+            zstream->avail_out = s->slice_stride;
+        }
+
+        slice->adler = adler32(slice->adler, crow, row_size + 1);
+        zstream->next_in  = crow;
+        zstream->avail_in = row_size + 1;
+        ret = deflate(zstream, Z_NO_FLUSH);
+        if (ret != Z_OK || zstream->avail_in) {
+            slice->size = AVERROR_EXTERNAL;
+            return 0;
+        }
+    }
+
+    /* all but the last slice end on a byte boundary and without the final
+     * block flag, so that the compressed slices can be concatenated */
+    ret = deflate(zstream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret != (last ? Z_STREAM_END : Z_OK) || !zstream->avail_out) {
+        slice->size = AVERROR_EXTERNAL;
+        return 0;
+    }
+    slice->size = s->slice_stride - zstream->avail_out;
+    return 0;
+}
+
+static void png_write_zdata(AVCodecContext *avctx, const uint8_t *data, int size,
+                            int *buf_len)
+{
+    PNGEncContext *s = avctx->priv_data;
+
+    while (size > 0) {
+        int len = FFMIN(size, IOBUF_SIZE - *buf_len);
+
+        memcpy(s->buf + *buf_len, data, len);
+        *buf_len += len;
+        data     += len;
+        size     -= len;
+        if (*buf_len == IOBUF_SIZE) {
+            if (s->bytestream_end - s->bytestream > IOBUF_SIZE + 100)
+                png_write_image_data(avctx, s->buf, IOBUF_SIZE);
+            *buf_len = 0;
+        }
+    }
+}
+
+/**
+ * Compress the image in independent bands of about SLICE_SIZE bytes of
+ * filtered data, in parallel. Each band is a raw deflate stream primed with
+ * the end of the previous band, the bands are joined into a single zlib
+ * stream by adding the header and the combined checksum.
+ */
+static int encode_frame_slices(AVCodecContext *avctx, const AVFrame *pict,
+                               int nb_slices)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
+    int level    = s->compression_level == Z_DEFAULT_COMPRESSION ? 6 :
+                   s->compression_level;
+    uint32_t adler = adler32(0, Z_NULL, 0);
+    uint8_t hdr[2], trailer[4];
+    int header, buf_len = 0;
+
+    s->thread_stride = FFALIGN(s->dict_rows * (row_size + 1), 64) +
+                       FFALIGN((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED), 64);
+
+    av_fast_malloc(&s->slice_buf, &s->slice_buf_size, nb_slices * s->slice_stride);
+    av_fast_malloc(&s->thread_buf, &s->thread_buf_size,
+                   (size_t)avctx->thread_count * s->thread_stride);
+    av_fast_malloc(&s->slices, &s->slices_size, nb_slices * sizeof(*s->slices));
+    if (!s->slice_buf || !s->thread_buf || !s->slices)
+        return AVERROR(ENOMEM);
+
+    s->slice_frame = pict;
+    avctx->execute2(avctx, deflate_slice, NULL, NULL, nb_slices);
+    s->slice_frame = NULL;
+
+    /* zlib header, with the compression level hint deflate() would write */
+    header  = (Z_DEFLATED + ((MAX_WBITS - 8) << 4)) << 8;
+    header |= (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+    header += 31 - header % 31;
+    AV_WB16(hdr, header);
+    png_write_zdata(avctx, hdr, 2, &buf_len);
+
+    for (int i = 0; i < nb_slices; i++) {
+        const PNGEncSlice *slice = &s->slices[i];
+
+        if (slice->size < 0)
+            return slice->size;
+        png_write_zdata(avctx, slice->buf, slice->size, &buf_len);
+        adler = adler32_combine(adler, slice->adler, slice->input_size);
+    }
+
+    AV_WB32(trailer, adler);
+    png_write_zdata(avctx, trailer, 4, &buf_len);
+    if (buf_len > 0 && s->bytestream_end - s->bytestream > buf_len + 100)
+        png_write_image_data(avctx, s->buf, buf_len);
+
+    return 0;
+}
+
 #define PNG_LRINT(d, divisor) lrint((d) * (divisor))
 #define PNG_Q2D(q, divisor) PNG_LRINT(av_q2d(q), (divisor))
 #define AV_WB32_PNG_D(buf, q) AV_WB32(buf, PNG_Q2D(q, 100000))
@@ -520,6 +694,23 @@ static int encode_frame(AVCodecContext *avctx, const AVFrame *pict)
 
     row_size = (pict->width * s->bits_per_pixel + 7) >> 3;
 
+    if (s->slice_zstreams && !s->is_progressive) {
+        uint64_t slice_stride;
+        int nb_slices;
+
+        s->slice_rows = FFMAX(SLICE_SIZE / (row_size + 1), 1);
+        s->dict_rows  = (DICT_SIZE + row_size) / (row_size + 1);
+        nb_slices     = (pict->height + s->slice_rows - 1) / s->slice_rows;
+        slice_stride  = deflateBound(&s->slice_zstreams[0].zstream,
+                                     (uint64_t)s->slice_rows * (row_size + 1)) + 16;
+        /* the compressed slices must fit in one buffer of at most INT_MAX
+         * bytes, larger images are encoded as a single stream */
+        if (nb_slices > 1 && nb_slices * slice_stride <= INT_MAX) {
+            s->slice_stride = slice_stride;
+            return encode_frame_slices(avctx, pict, nb_slices);
+        }
+    }
+
     crow_base = av_malloc((row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
     if (!crow_base) {
         ret = AVERROR(ENOMEM);
@@ -1184,6 +1375,20 @@ static av_cold int png_enc_init(AVCodecContext *avctx)
     compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT
                       ? Z_DEFAULT_COMPRESSION
                       : av_clip(avctx->compression_level, 0, 9);
+    s->compression_level = compression_level;
+
+    if (avctx->active_thread_type & FF_THREAD_SLICE) {
+        s->slice_zstreams = av_calloc(avctx->thread_count, sizeof(*s->slice_zstreams));
+        if (!s->slice_zstreams)
+            return AVERROR(ENOMEM);
+        for (int i = 0; i < avctx->thread_count; i++) {
+            int ret = ff_deflate_init2(&s->slice_zstreams[i], compression_level,
+                                       -MAX_WBITS, avctx);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
     return ff_deflate_init(&s->zstream, compression_level, avctx);
 }
 
@@ -1192,6 +1397,14 @@ static av_cold int png_enc_close(AVCodecContext *avctx)
     PNGEncContext *s = avctx->priv_data;
 
     ff_deflate_end(&s->zstream);
+    if (s->slice_zstreams) {
+        for (int i = 0; i < avctx->thread_count; i++)
+            ff_deflate_end(&s->slice_zstreams[i]);
+        av_freep(&s->slice_zstreams);
+    }
+    av_freep(&s->slices);
+    av_freep(&s->slice_buf);
+    av_freep(&s->thread_buf);
     av_frame_free(&s->last_frame);
     av_frame_free(&s->prev_frame);
     av_freep(&s->last_frame_packet);
@@ -1228,6 +1441,7 @@ const FFCodec ff_png_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_PNG,
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_FRAME_THREADS |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE,
     .priv_data_size = sizeof(PNGEncContext),
     .init           = png_enc_init,
@@ -1242,7 +1456,7 @@ const FFCodec ff_png_encoder = {
         AV_PIX_FMT_MONOBLACK, AV_PIX_FMT_NONE
     },
     .p.priv_class   = &pngenc_class,
-    .caps_internal  = FF_CODEC_CAP_ICC_PROFILES,
+    .caps_internal  = FF_CODEC_CAP_INIT_CLEANUP | FF_CODEC_CAP_ICC_PROFILES,
 };
 
 const FFCodec ff_apng_encoder = {
@@ -68,6 +68,10 @@ typedef struct SnowEncContext {
     unsigned me_cache_generation;
 
     uint64_t encoding_error[SNOW_MAX_PLANES];
+
+    SnowContext *slice_ctx;     ///< per thread copies of com for the OBMC prediction
+    uint8_t **slice_scratch;    ///< per thread scratchbuf of the copies in slice_ctx
+    int nb_slice_ctx;
 } SnowEncContext;
 
 static void init_ref(MotionEstContext *c, const uint8_t *const src[3],
@@ -298,6 +302,14 @@ static av_cold int encode_init(AVCodecContext *avctx)
         }
     }
 
+    if ((avctx->active_thread_type & FF_THREAD_SLICE) && avctx->thread_count > 1) {
+        enc->slice_ctx     = av_calloc(avctx->thread_count, sizeof(*enc->slice_ctx));
+        enc->slice_scratch = av_calloc(avctx->thread_count, sizeof(*enc->slice_scratch));
+        if (!enc->slice_ctx || !enc->slice_scratch)
+            return AVERROR(ENOMEM);
+        enc->nb_slice_ctx = avctx->thread_count;
+    }
+
     return 0;
 }
 
@@ -1752,6 +1764,48 @@ static void calculate_visual_weight(SnowContext *s, Plane *p){
     }
 }
 
+typedef struct PredictPlaneArg {
+    IDWTELEM *buf;
+    int plane_index;
+    int add;
+} PredictPlaneArg;
+
+static int predict_slice_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    SnowEncContext *const enc = avctx->priv_data;
+    const PredictPlaneArg *const a = arg;
+
+    predict_slice(&enc->slice_ctx[threadnr], a->buf, a->plane_index, a->add, jobnr);
+    return 0;
+}
+
+/**
+ * predict_plane() with the rows of blocks distributed over the slice threads.
+ * Each row writes a disjoint range of lines, the threads only need their own
+ * scratch buffer.
+ */
+static void predict_plane_threaded(SnowEncContext *enc, IDWTELEM *buf,
+                                   int plane_index, int add)
+{
+    SnowContext *const s = &enc->com;
+    PredictPlaneArg arg = { buf, plane_index, add };
+
+    if (!enc->nb_slice_ctx) {
+        if (add)
+            predict_plane(s, buf, plane_index, 1);
+        else
+            predict_plane(s, buf, plane_index, 0);
+        return;
+    }
+
+    for (int i = 0; i < enc->nb_slice_ctx; i++) {
+        enc->slice_ctx[i]            = *s;
+        enc->slice_ctx[i].scratchbuf = enc->slice_scratch[i];
+    }
+    s->avctx->execute2(s->avctx, predict_slice_job, &arg, NULL,
+                       (s->b_height << s->block_max_depth) + 1);
+}
+
 static int encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                         const AVFrame *pict, int *got_packet)
 {
@@ -1904,6 +1958,14 @@ redo_frame:
 
     ff_snow_common_init_after_header(avctx);
 
+    for (i = 0; i < enc->nb_slice_ctx; i++) {
+        if (!enc->slice_scratch[i]) {
+            enc->slice_scratch[i] = av_mallocz(FFMAX(s->mconly_picture->linesize[0], 2*width+256) * 7 * MB_SIZE);
+            if (!enc->slice_scratch[i])
+                return AVERROR(ENOMEM);
+        }
+    }
+
     if(s->last_spatial_decomposition_count != s->spatial_decomposition_count){
         for(plane_index=0; plane_index < s->nb_planes; plane_index++){
             calculate_visual_weight(s, &s->plane[plane_index]);
@@ -1930,7 +1992,7 @@ redo_frame:
                         s->spatial_idwt_buffer[y*w + x]= pict->data[plane_index][y*pict->linesize[plane_index] + x]<<FRAC_BITS;
                     }
                 }
-            predict_plane(s, s->spatial_idwt_buffer, plane_index, 0);
+            predict_plane_threaded(enc, s->spatial_idwt_buffer, plane_index, 0);
 
             if(   plane_index==0
                && pic->pict_type == AV_PICTURE_TYPE_P
@@ -2005,7 +2067,7 @@ redo_frame:
                     }
                 }
             }
-            predict_plane(s, s->spatial_idwt_buffer, plane_index, 1);
+            predict_plane_threaded(enc, s->spatial_idwt_buffer, plane_index, 1);
         }else{
             //ME/MC only
             if(pic->pict_type == AV_PICTURE_TYPE_I){
@@ -2017,7 +2079,7 @@ redo_frame:
                 }
             }else{
                 memset(s->spatial_idwt_buffer, 0, sizeof(IDWTELEM)*w*h);
-                predict_plane(s, s->spatial_idwt_buffer, plane_index, 1);
+                predict_plane_threaded(enc, s->spatial_idwt_buffer, plane_index, 1);
             }
         }
         if(s->avctx->flags&AV_CODEC_FLAG_PSNR){
@@ -2093,6 +2155,11 @@ static av_cold int encode_end(AVCodecContext *avctx)
     av_freep(&enc->m.me.map);
     av_freep(&enc->m.sc.obmc_scratchpad);
 
+    for (int i = 0; i < enc->nb_slice_ctx; i++)
+        av_freep(&enc->slice_scratch[i]);
+    av_freep(&enc->slice_scratch);
+    av_freep(&enc->slice_ctx);
+
     av_freep(&avctx->stats_out);
 
     return 0;
@@ -2135,6 +2202,7 @@ const FFCodec ff_snow_encoder = {
     .p.type         = AVMEDIA_TYPE_VIDEO,
     .p.id           = AV_CODEC_ID_SNOW,
     .p.capabilities = AV_CODEC_CAP_DR1 |
+                      AV_CODEC_CAP_SLICE_THREADS |
                       AV_CODEC_CAP_ENCODER_REORDERED_OPAQUE |
                       AV_CODEC_CAP_ENCODER_RECON_FRAME,
     .priv_data_size = sizeof(SnowEncContext),
@@ -71,7 +71,7 @@ void ff_inflate_end(FFZStream *z)
 #endif
 
 #if CONFIG_DEFLATE_WRAPPER
-int ff_deflate_init(FFZStream *z, int level, void *logctx)
+int ff_deflate_init2(FFZStream *z, int level, int window_bits, void *logctx)
 {
     z_stream *const zstream = &z->zstream;
     int zret;
@@ -81,7 +81,8 @@ int ff_deflate_init(FFZStream *z, int level, void *logctx)
     zstream->zfree  = free_wrapper;
     zstream->opaque = Z_NULL;
 
-    zret = deflateInit(zstream, level);
+    zret = deflateInit2(zstream, level, Z_DEFLATED, window_bits, 8,
+                        Z_DEFAULT_STRATEGY);
     if (zret == Z_OK) {
         z->inited = 1;
     } else {
@@ -92,6 +93,11 @@ int ff_deflate_init(FFZStream *z, int level, void *logctx)
     return 0;
 }
 
+int ff_deflate_init(FFZStream *z, int level, void *logctx)
+{
+    return ff_deflate_init2(z, level, MAX_WBITS, logctx);
+}
+
 void ff_deflate_end(FFZStream *z)
 {
     if (z->inited) {
@@ -239,7 +239,13 @@ static void update_link_current_pts(FilterLinkInternal *li, int64_t pts)
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
     FFFilterContext *ctxi = fffilterctx(filter);
-    ctxi->ready = FFMAX(ctxi->ready, priority);
+    unsigned ready = atomic_load_explicit(&ctxi->ready, memory_order_relaxed);
+
+    while (ready < priority &&
+           !atomic_compare_exchange_weak_explicit(&ctxi->ready, &ready, priority,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
 }
 
 /**
@@ -485,7 +491,7 @@ int ff_request_frame(AVFilterLink *link)
     if (li->status_in) {
         if (ff_framequeue_queued_frames(&li->fifo)) {
             av_assert1(!li->frame_wanted_out);
-            av_assert1(ctxi_dst->ready >= 300);
+            av_assert1(atomic_load_explicit(&ctxi_dst->ready, memory_order_relaxed) >= 300);
             return 0;
         } else {
             /* Acknowledge status change. Filters using ff_request_frame() will
@@ -1427,7 +1433,7 @@ int ff_filter_activate(AVFilterContext *filter)
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(filter->filter->flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  filter->filter->activate));
-    ctxi->ready = 0;
+    atomic_store_explicit(&ctxi->ready, 0, memory_order_relaxed);
     ret = filter->filter->activate ? filter->filter->activate(filter) :
           filter_activate_default(filter);
     if (ret == FFERROR_NOT_READY)
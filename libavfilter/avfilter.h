@@ -452,6 +452,12 @@ unsigned avfilter_filter_pad_count(const AVFilter *filter, int is_output);
  * Process multiple parts of the frame concurrently.
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
+/**
+ * Activate independent filters of the graph concurrently, using up to
+ * AVFilterGraph.nb_threads threads. Only meaningful in
+ * AVFilterGraph.thread_type.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
 
 /** An instance of a filter */
 struct AVFilterContext {
@@ -790,7 +796,9 @@ typedef struct AVFilterGraph {
      * of AVFILTER_THREAD_* flags.
      *
      * May be set by the caller at any point, the setting will apply to all
-     * filters initialized after that. The default is allowing everything.
+     * filters initialized after that. AVFILTER_THREAD_GRAPH must be set
+     * before adding any filters to the filtergraph. The default is
+     * AVFILTER_THREAD_SLICE.
      *
      * When a filter in this graph is initialized, this field is combined using
      * bit AND with AVFilterContext.thread_type to get the final mask used for
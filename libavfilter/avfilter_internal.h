@@ -25,6 +25,7 @@
 #ifndef AVFILTER_AVFILTER_INTERNAL_H
 #define AVFILTER_AVFILTER_INTERNAL_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 
 #include "avfilter.h"
@@ -79,6 +80,12 @@ typedef struct FilterLinkInternal {
      */
     int age_index;
 
+    /**
+     * Value of FFFilterGraph.batch_id for the last activation batch that
+     * this link was reserved for, see ff_filter_graph_run_once().
+     */
+    unsigned batch_id;
+
     /** stage of the initialization of the link properties (dimensions, etc) */
     enum {
         AVLINK_UNINIT = 0,      ///< not started
@@ -107,8 +114,11 @@ typedef struct FFFilterContext {
      * Ready status of the filter.
      * A non-0 value means that the filter needs activating;
      * a higher value suggests a more urgent activation.
+     *
+     * Atomic because with AVFILTER_THREAD_GRAPH several neighbours of
+     * a filter may be marking it ready at the same time.
      */
-    unsigned ready;
+    atomic_uint ready;
 
     ///< parsed expression
     struct AVExpr *enable;
@@ -145,6 +155,13 @@ typedef struct FFFilterGraph {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Filters selected for concurrent activation by ff_filter_graph_run_once()
+     * with AVFILTER_THREAD_GRAPH.
+     */
+    AVFilterContext **batch;
+    unsigned          batch_id;
 } FFFilterGraph;
 
 static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
@@ -192,6 +209,15 @@ int ff_graph_thread_init(FFFilterGraph *graph);
 
 void ff_graph_thread_free(FFFilterGraph *graph);
 
+/**
+ * Activate the given filters concurrently and wait for all of them to finish.
+ * The filters must not share any state, see ff_filter_graph_run_once().
+ *
+ * @return 0 or the first error returned by any of the activations
+ */
+int ff_graph_run_batch(FFFilterGraph *graph, AVFilterContext **filters,
+                       int nb_filters);
+
 /**
  * Negotiate the media format, dimensions, etc of all inputs to a filter.
  *
@@ -49,6 +49,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, .unit = "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, F|V|A, .unit = "threads"},
         {"auto", "autodetect a suitable number of threads to use", 0, AV_OPT_TYPE_CONST, {.i64 = 0 }, .flags = F|V|A, .unit = "threads"},
@@ -78,6 +79,12 @@ int ff_graph_thread_init(FFFilterGraph *graph)
     graph->p.nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_run_batch(FFFilterGraph *graph, AVFilterContext **filters,
+                       int nb_filters)
+{
+    return AVERROR_BUG;
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -1469,21 +1476,110 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+static unsigned filter_ready(AVFilterContext *filter)
+{
+    return atomic_load_explicit(&fffilterctx(filter)->ready, memory_order_relaxed);
+}
+
+/**
+ * Check whether a filter can be activated concurrently with others.
+ * Sinks update the graph-wide sink heap and some filters reach into
+ * other filters of the graph, those always run alone.
+ */
+static int filter_batchable(const AVFilterContext *filter)
+{
+    return filter->nb_outputs &&
+           !(filter->filter->flags_internal & FF_FILTER_FLAG_GRAPH_SERIAL);
+}
+
+/**
+ * Try to reserve all the links whose state may be modified by activating
+ * filter: its own inputs and outputs, and the outputs of the filters it
+ * feeds (through filter_unblock()).
+ *
+ * @return 1 if the filter was added to the current batch, 0 if it conflicts
+ *         with a filter already in it
+ */
+static int batch_reserve(FFFilterGraph *graphi, AVFilterContext *filter)
+{
+    const unsigned id = graphi->batch_id;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (unsigned i = 0; i < filter->nb_inputs; i++) {
+            FilterLinkInternal *li = ff_link_internal(filter->inputs[i]);
+            if (!pass && li->batch_id == id)
+                return 0;
+            li->batch_id = id;
+        }
+        for (unsigned i = 0; i < filter->nb_outputs; i++) {
+            AVFilterContext *dst = filter->outputs[i]->dst;
+            FilterLinkInternal *li = ff_link_internal(filter->outputs[i]);
+
+            if (!pass && li->batch_id == id)
+                return 0;
+            li->batch_id = id;
+
+            for (unsigned j = 0; j < dst->nb_outputs; j++) {
+                FilterLinkInternal *lj = ff_link_internal(dst->outputs[j]);
+                if (!pass && lj->batch_id == id)
+                    return 0;
+                lj->batch_id = id;
+            }
+        }
+    }
+    return 1;
+}
+
+static int graph_run_batch(AVFilterGraph *graph, AVFilterContext *first)
+{
+    FFFilterGraph *graphi = fffiltergraph(graph);
+    int nb_batch = 0;
+
+    if (!filter_batchable(first))
+        return ff_filter_activate(first);
+
+    /* Zero is the initial batch_id of every link, never use it. */
+    if (!++graphi->batch_id)
+        graphi->batch_id++;
+
+    batch_reserve(graphi, first);
+    graphi->batch[nb_batch++] = first;
+
+    for (unsigned i = 0; i < graph->nb_filters && nb_batch < graph->nb_threads; i++) {
+        AVFilterContext *filter = graph->filters[i];
+
+        if (filter == first || !filter_ready(filter) || !filter_batchable(filter))
+            continue;
+        if (batch_reserve(graphi, filter))
+            graphi->batch[nb_batch++] = filter;
+    }
+
+    if (nb_batch == 1)
+        return ff_filter_activate(first);
+    return ff_graph_run_batch(graphi, graphi->batch, nb_batch);
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
-    FFFilterContext *ctxi;
+    AVFilterContext *filter;
+    unsigned ready;
     unsigned i;
 
     av_assert0(graph->nb_filters);
-    ctxi = fffilterctx(graph->filters[0]);
+    filter = graph->filters[0];
+    ready  = filter_ready(filter);
     for (i = 1; i < graph->nb_filters; i++) {
-        FFFilterContext *ctxi_other = fffilterctx(graph->filters[i]);
+        unsigned ready_other = filter_ready(graph->filters[i]);
 
-        if (ctxi_other->ready > ctxi->ready)
-            ctxi = ctxi_other;
+        if (ready_other > ready) {
+            filter = graph->filters[i];
+            ready  = ready_other;
+        }
     }
 
-    if (!ctxi->ready)
+    if (!ready)
         return AVERROR(EAGAIN);
-    return ff_filter_activate(&ctxi->p);
+    if (fffiltergraph(graph)->batch && graph->thread_type & AVFILTER_THREAD_GRAPH)
+        return graph_run_batch(graph, filter);
+    return ff_filter_activate(filter);
 }
@@ -586,6 +586,7 @@ const AVFilter ff_vf_graphmonitor = {
     .init          = init,
     .uninit        = uninit,
     .activate      = activate,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_SERIAL,
     FILTER_INPUTS(ff_video_default_filterpad),
     FILTER_OUTPUTS(graphmonitor_outputs),
     FILTER_QUERY_FUNC2(query_formats),
@@ -604,6 +605,7 @@ const AVFilter ff_avf_agraphmonitor = {
     .init          = init,
     .uninit        = uninit,
     .activate      = activate,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_SERIAL,
     FILTER_INPUTS(ff_audio_default_filterpad),
     FILTER_OUTPUTS(graphmonitor_outputs),
     FILTER_QUERY_FUNC2(query_formats),
@@ -609,6 +609,7 @@ const AVFilter ff_vf_sendcmd = {
     .uninit      = uninit,
     .priv_size   = sizeof(SendCmdContext),
     .flags       = AVFILTER_FLAG_METADATA_ONLY,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_SERIAL,
     FILTER_INPUTS(sendcmd_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     .priv_class  = &sendcmd_class,
@@ -634,6 +635,7 @@ const AVFilter ff_af_asendcmd = {
     .uninit      = uninit,
     .priv_size   = sizeof(SendCmdContext),
     .flags       = AVFILTER_FLAG_METADATA_ONLY,
+    .flags_internal = FF_FILTER_FLAG_GRAPH_SERIAL,
     FILTER_INPUTS(asendcmd_inputs),
     FILTER_OUTPUTS(ff_audio_default_filterpad),
 };
@@ -205,6 +205,13 @@ static inline FilterLink* ff_filter_link(AVFilterLink *link)
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter accesses other filters or links of its graph (e.g. to send them
+ * commands or to inspect them), so it must never be activated concurrently
+ * with any other filter when AVFILTER_THREAD_GRAPH is in use.
+ */
+#define FF_FILTER_FLAG_GRAPH_SERIAL  (1 << 1)
+
 /**
  * Find the index of a link.
  *
@@ -0,0 +1,343 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Frame threading for video filters
+ */
+
+#include <stdatomic.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/executor.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "framethread.h"
+#include "video.h"
+
+typedef struct FrameThreadJob {
+    AVTask   task;
+    uint64_t seq;
+
+    AVFrame *in[FF_FILTER_FRAME_THREAD_MAX_HISTORY + 1];
+    AVFrame *out;
+
+    /* protected by FFFrameThread.lock */
+    int ret;
+    int done;
+} FrameThreadJob;
+
+struct FFFrameThread {
+    AVFilterContext             *ctx;
+    ff_filter_frame_thread_func *func;
+
+    AVExecutor *executor;
+    int         nb_threads;
+    atomic_int  nb_threads_started;
+
+    /* ring of jobs in input order, only touched by the filter's activate */
+    FrameThreadJob *jobs;
+    int             nb_jobs;
+    int             first;
+    int             nb_queued;
+    uint64_t        seq;
+
+    AVFrame *history[FF_FILTER_FRAME_THREAD_MAX_HISTORY];
+    int      nb_history;
+
+    int     eof;
+    int64_t eof_pts;
+
+    AVMutex lock;
+    AVCond  cond;
+};
+
+static int job_ready(const AVTask *t, void *user_data)
+{
+    return 1;
+}
+
+static int job_priority_higher(const AVTask *a, const AVTask *b)
+{
+    return ((const FrameThreadJob *)a)->seq < ((const FrameThreadJob *)b)->seq;
+}
+
+static int job_run(AVTask *t, void *local_context, void *user_data)
+{
+    FrameThreadJob *job = (FrameThreadJob *)t;
+    FFFrameThread *ft   = user_data;
+    int *threadnr       = local_context;
+    int ret;
+
+    /* local contexts start zeroed, number the threads on first use */
+    if (!*threadnr)
+        *threadnr = atomic_fetch_add_explicit(&ft->nb_threads_started, 1,
+                                              memory_order_relaxed) + 1;
+    av_assert1(*threadnr <= ft->nb_threads);
+
+    ret = ft->func(ft->ctx, job->out, job->in, *threadnr - 1);
+
+    for (int i = 0; i <= ft->nb_history; i++)
+        av_frame_free(&job->in[i]);
+
+    /* must happen before signalling, ctx may be freed right after that */
+    ff_filter_set_ready(ft->ctx, 100);
+
+    ff_mutex_lock(&ft->lock);
+    job->ret  = ret;
+    job->done = 1;
+    ff_cond_broadcast(&ft->cond);
+    ff_mutex_unlock(&ft->lock);
+    return 0;
+}
+
+int ff_filter_frame_thread_init(FFFrameThread **pft, AVFilterContext *ctx,
+                                ff_filter_frame_thread_func *func,
+                                int nb_history, int max_threads)
+{
+    AVTaskCallbacks cb = {
+        .local_context_size = sizeof(int),
+        .priority_higher    = job_priority_higher,
+        .ready              = job_ready,
+        .run                = job_run,
+    };
+    FFFrameThread *ft;
+    int ret;
+
+    av_assert0(nb_history >= 0 && nb_history <= FF_FILTER_FRAME_THREAD_MAX_HISTORY);
+
+    ft = av_mallocz(sizeof(*ft));
+    if (!ft)
+        return AVERROR(ENOMEM);
+
+    ft->ctx        = ctx;
+    ft->func       = func;
+    ft->nb_history = nb_history;
+    ft->nb_threads = FFMAX(ff_filter_get_nb_threads(ctx), 1);
+    if (max_threads > 0)
+        ft->nb_threads = FFMIN(ft->nb_threads, max_threads);
+    atomic_init(&ft->nb_threads_started, 0);
+
+    /* one more job than threads, so that the workers are kept busy while
+     * the oldest frame is being sent downstream */
+    ft->nb_jobs = ft->nb_threads > 1 ? ft->nb_threads + 1 : 1;
+    ft->jobs    = av_calloc(ft->nb_jobs, sizeof(*ft->jobs));
+    if (!ft->jobs) {
+        av_free(ft);
+        return AVERROR(ENOMEM);
+    }
+
+    ret = ff_mutex_init(&ft->lock, NULL);
+    if (ret) {
+        av_free(ft->jobs);
+        av_free(ft);
+        return AVERROR(ret);
+    }
+    ret = ff_cond_init(&ft->cond, NULL);
+    if (ret) {
+        ff_mutex_destroy(&ft->lock);
+        av_free(ft->jobs);
+        av_free(ft);
+        return AVERROR(ret);
+    }
+
+    cb.user_data = ft;
+    ft->executor = av_executor_alloc(&cb, ft->nb_threads > 1 ? ft->nb_threads : 0);
+    if (!ft->executor) {
+        ff_filter_frame_thread_uninit(&ft);
+        return AVERROR(ENOMEM);
+    }
+
+    *pft = ft;
+    return 0;
+}
+
+int ff_filter_frame_thread_nb_threads(const FFFrameThread *ft)
+{
+    return ft->nb_threads;
+}
+
+static int submit_frame(FFFrameThread *ft, AVFrame *in)
+{
+    AVFilterContext *ctx = ft->ctx;
+    AVFilterLink *outlink = ctx->outputs[0];
+    FrameThreadJob *job = &ft->jobs[(ft->first + ft->nb_queued) % ft->nb_jobs];
+    AVFrame *out = NULL;
+    int ret = 0;
+
+    av_assert1(ft->nb_queued < ft->nb_jobs);
+
+    memset(job, 0, sizeof(*job));
+    job->seq = ft->seq++;
+
+    if (!ctx->is_disabled) {
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        ret = av_frame_copy_props(out, in);
+        if (ret < 0)
+            goto fail;
+
+        for (int i = 0; i < ft->nb_history; i++) {
+            if (!ft->history[i])
+                continue;
+            job->in[i + 1] = av_frame_clone(ft->history[i]);
+            if (!job->in[i + 1]) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
+    }
+
+    if (ft->nb_history) {
+        AVFrame *ref = av_frame_clone(in);
+        if (!ref) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        av_frame_free(&ft->history[ft->nb_history - 1]);
+        memmove(ft->history + 1, ft->history,
+                (ft->nb_history - 1) * sizeof(*ft->history));
+        ft->history[0] = ref;
+    }
+
+    ft->nb_queued++;
+
+    if (ctx->is_disabled) {
+        job->out  = in;
+        job->done = 1;
+        return 0;
+    }
+
+    job->in[0] = in;
+    job->out   = out;
+    av_executor_execute(ft->executor, &job->task);
+    return 0;
+
+fail:
+    for (int i = 1; i <= ft->nb_history; i++)
+        av_frame_free(&job->in[i]);
+    av_frame_free(&out);
+    av_frame_free(&in);
+    return ret;
+}
+
+int ff_filter_frame_thread_activate(FFFrameThread *ft)
+{
+    AVFilterContext *ctx = ft->ctx;
+    AVFilterLink *inlink  = ctx->inputs[0];
+    AVFilterLink *outlink = ctx->outputs[0];
+    AVFrame *frame;
+    int64_t pts;
+    int ret, status;
+
+    FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
+
+    /* Output the oldest frame once it is done. Block for it only when no
+     * more work can be queued, otherwise keep feeding the workers. */
+    if (ft->nb_queued) {
+        FrameThreadJob *job = &ft->jobs[ft->first];
+        int done;
+
+        ff_mutex_lock(&ft->lock);
+        if (ft->nb_queued == ft->nb_jobs || ft->eof) {
+            while (!job->done)
+                ff_cond_wait(&ft->cond, &ft->lock);
+        }
+        done = job->done;
+        ret  = job->ret;
+        ff_mutex_unlock(&ft->lock);
+
+        if (done) {
+            frame      = job->out;
+            job->out   = NULL;
+            ft->first  = (ft->first + 1) % ft->nb_jobs;
+            ft->nb_queued--;
+
+            ff_filter_set_ready(ctx, 100);
+            if (ret < 0) {
+                av_frame_free(&frame);
+                return ret;
+            }
+            return ff_filter_frame(outlink, frame);
+        }
+    }
+
+    if (!ft->eof) {
+        ret = ff_inlink_consume_frame(inlink, &frame);
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            ret = submit_frame(ft, frame);
+            if (ret < 0)
+                return ret;
+            ff_filter_set_ready(ctx, 100);
+            return 0;
+        }
+
+        if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+            ft->eof     = status;
+            ft->eof_pts = pts;
+        }
+    }
+
+    if (ft->eof) {
+        if (ft->nb_queued) {
+            ff_filter_set_ready(ctx, 100);
+            return 0;
+        }
+        ff_outlink_set_status(outlink, ft->eof, ft->eof_pts);
+        return 0;
+    }
+
+    FF_FILTER_FORWARD_WANTED(outlink, inlink);
+
+    return FFERROR_NOT_READY;
+}
+
+void ff_filter_frame_thread_uninit(FFFrameThread **pft)
+{
+    FFFrameThread *ft = *pft;
+
+    if (!ft)
+        return;
+
+    ff_mutex_lock(&ft->lock);
+    for (int i = 0; i < ft->nb_queued; i++) {
+        FrameThreadJob *job = &ft->jobs[(ft->first + i) % ft->nb_jobs];
+        while (!job->done)
+            ff_cond_wait(&ft->cond, &ft->lock);
+        av_frame_free(&job->out);
+    }
+    ff_mutex_unlock(&ft->lock);
+
+    av_executor_free(&ft->executor);
+
+    for (int i = 0; i < ft->nb_history; i++)
+        av_frame_free(&ft->history[i]);
+
+    ff_cond_destroy(&ft->cond);
+    ff_mutex_destroy(&ft->lock);
+    av_freep(&ft->jobs);
+    av_freep(pft);
+}
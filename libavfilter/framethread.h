@@ -0,0 +1,94 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FRAMETHREAD_H
+#define AVFILTER_FRAMETHREAD_H
+
+#include "libavutil/frame.h"
+
+#include "avfilter.h"
+
+/**
+ * @file
+ * Frame threading for single-input, single-output video filters.
+ *
+ * Filters that cannot split a frame into slices, but whose output only
+ * depends on the current input frame and a bounded number of previous input
+ * frames, may process several frames concurrently. The filter provides a
+ * function that filters one frame and uses ff_filter_frame_thread_activate()
+ * as its activate callback. Frames are output in input order.
+ */
+
+/**
+ * Maximum number of previous input frames that can be passed to the
+ * filtering function.
+ */
+#define FF_FILTER_FRAME_THREAD_MAX_HISTORY 8
+
+typedef struct FFFrameThread FFFrameThread;
+
+/**
+ * Filter one frame. Called concurrently for different frames, so it must
+ * not modify any filter state except per-thread data indexed by threadnr.
+ *
+ * @param ctx      the filter
+ * @param out      output frame, allocated on the output link with the
+ *                 properties of in[0] already copied
+ * @param in       in[0] is the frame to filter, in[i] the i-th previous input
+ *                 frame for 1 <= i <= nb_history, or NULL at the start of the
+ *                 stream
+ * @param threadnr index of the calling thread, between 0 and the value
+ *                 returned by ff_filter_frame_thread_nb_threads() - 1
+ * @return 0 or a negative AVERROR code
+ */
+typedef int (ff_filter_frame_thread_func)(AVFilterContext *ctx, AVFrame *out,
+                                          AVFrame *const *in, int threadnr);
+
+/**
+ * Allocate a frame threading context for ctx. The number of threads is
+ * taken from ff_filter_get_nb_threads().
+ *
+ * @param nb_history  number of previous input frames func needs access to,
+ *                    at most FF_FILTER_FRAME_THREAD_MAX_HISTORY
+ * @param max_threads upper bound for the number of threads, e.g. to limit
+ *                    the memory used by per-thread data; 0 for no limit
+ */
+int ff_filter_frame_thread_init(FFFrameThread **pft, AVFilterContext *ctx,
+                                ff_filter_frame_thread_func *func,
+                                int nb_history, int max_threads);
+
+/**
+ * @return the number of threads that may call the filtering function
+ *         concurrently, i.e. the number of per-thread data instances
+ *         the filter must provide
+ */
+int ff_filter_frame_thread_nb_threads(const FFFrameThread *ft);
+
+/**
+ * Activate the filter, to be called from the activate callback.
+ * If the filter has AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL set, disabled
+ * frames are passed through unchanged.
+ */
+int ff_filter_frame_thread_activate(FFFrameThread *ft);
+
+/**
+ * Wait for all pending frames and free the context.
+ */
+void ff_filter_frame_thread_uninit(FFFrameThread **pft);
+
+#endif /* AVFILTER_FRAMETHREAD_H */
@@ -22,14 +22,26 @@
  */
 
 #include <stddef.h>
+#include <string.h>
 
+#include "libavutil/avassert.h"
 #include "libavutil/error.h"
+#include "libavutil/executor.h"
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "avfilter.h"
 #include "avfilter_internal.h"
+#include "filters.h"
+
+typedef struct GraphTask {
+    AVTask task;
+    struct ThreadContext *c;
+    AVFilterContext *filter;
+    int ret;
+} GraphTask;
 
 typedef struct ThreadContext {
     AVFilterGraph *graph;
@@ -40,6 +52,17 @@ typedef struct ThreadContext {
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+
+    /* serializes slice threading requests from concurrently running filters */
+    AVMutex execute_lock;
+
+    /* graph threading, only used with AVFILTER_THREAD_GRAPH */
+    AVExecutor *executor;
+    GraphTask  *tasks;
+    int      nb_tasks;
+    int      nb_pending;
+    AVMutex  batch_lock;
+    AVCond   batch_cond;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
@@ -62,15 +85,120 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+
+    ff_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    ff_mutex_unlock(&c->execute_lock);
+    return 0;
+}
+
+static int graph_task_ready(const AVTask *t, void *user_data)
+{
+    return 1;
+}
+
+static int graph_task_priority_higher(const AVTask *a, const AVTask *b)
+{
+    return 0;
+}
+
+static int graph_task_run(AVTask *t, void *local_context, void *user_data)
+{
+    GraphTask *task = (GraphTask *)t;
+    ThreadContext *c = task->c;
+
+    task->ret = ff_filter_activate(task->filter);
+
+    ff_mutex_lock(&c->batch_lock);
+    if (!--c->nb_pending)
+        ff_cond_signal(&c->batch_cond);
+    ff_mutex_unlock(&c->batch_lock);
     return 0;
 }
 
+static int graph_thread_init(ThreadContext *c, int nb_threads)
+{
+    const AVTaskCallbacks cb = {
+        .user_data          = c,
+        .local_context_size = 0,
+        .priority_higher    = graph_task_priority_higher,
+        .ready              = graph_task_ready,
+        .run                = graph_task_run,
+    };
+    int ret;
+
+    ret = ff_mutex_init(&c->batch_lock, NULL);
+    if (ret)
+        return AVERROR(ret);
+    ret = ff_cond_init(&c->batch_cond, NULL);
+    if (ret) {
+        ff_mutex_destroy(&c->batch_lock);
+        return AVERROR(ret);
+    }
+
+    /* the calling thread runs one filter of every batch itself */
+    c->executor = av_executor_alloc(&cb, nb_threads - 1);
+    if (!c->executor) {
+        ff_cond_destroy(&c->batch_cond);
+        ff_mutex_destroy(&c->batch_lock);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static void graph_thread_uninit(ThreadContext *c)
+{
+    if (!c->executor)
+        return;
+    av_executor_free(&c->executor);
+    av_freep(&c->tasks);
+    ff_cond_destroy(&c->batch_cond);
+    ff_mutex_destroy(&c->batch_lock);
+}
+
+int ff_graph_run_batch(FFFilterGraph *graphi, AVFilterContext **filters,
+                       int nb_filters)
+{
+    ThreadContext *c = graphi->thread;
+    int ret;
+
+    av_assert1(c && c->executor && nb_filters > 0);
+
+    if (nb_filters > c->nb_tasks) {
+        GraphTask *tasks = av_realloc_array(c->tasks, nb_filters, sizeof(*tasks));
+        if (!tasks)
+            return AVERROR(ENOMEM);
+        c->tasks    = tasks;
+        c->nb_tasks = nb_filters;
+    }
+
+    c->nb_pending = nb_filters - 1;
+    for (int i = 1; i < nb_filters; i++) {
+        GraphTask *task = &c->tasks[i];
+
+        memset(task, 0, sizeof(*task));
+        task->c      = c;
+        task->filter = filters[i];
+        av_executor_execute(c->executor, &task->task);
+    }
+
+    ret = ff_filter_activate(filters[0]);
+
+    ff_mutex_lock(&c->batch_lock);
+    while (c->nb_pending)
+        ff_cond_wait(&c->batch_cond, &c->batch_lock);
+    ff_mutex_unlock(&c->batch_lock);
+
+    for (int i = 1; i < nb_filters && ret >= 0; i++)
+        ret = c->tasks[i].ret;
+    return ret;
+}
+
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
     nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
@@ -82,6 +210,7 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
 int ff_graph_thread_init(FFFilterGraph *graphi)
 {
     AVFilterGraph *graph = &graphi->p;
+    ThreadContext *c;
     int ret;
 
     if (graph->nb_threads == 1) {
@@ -89,7 +218,7 @@ int ff_graph_thread_init(FFFilterGraph *graphi)
         return 0;
     }
 
-    graphi->thread = av_mallocz(sizeof(ThreadContext));
+    c = graphi->thread = av_mallocz(sizeof(ThreadContext));
     if (!graphi->thread)
         return AVERROR(ENOMEM);
 
@@ -102,6 +231,26 @@ int ff_graph_thread_init(FFFilterGraph *graphi)
     }
     graph->nb_threads = ret;
 
+    ret = ff_mutex_init(&c->execute_lock, NULL);
+    if (ret) {
+        slice_thread_uninit(c);
+        av_freep(&graphi->thread);
+        return AVERROR(ret);
+    }
+
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH) {
+        graphi->batch = av_calloc(graph->nb_threads, sizeof(*graphi->batch));
+        ret = graphi->batch ? graph_thread_init(c, graph->nb_threads) :
+                              AVERROR(ENOMEM);
+        if (ret < 0) {
+            av_freep(&graphi->batch);
+            ff_mutex_destroy(&c->execute_lock);
+            slice_thread_uninit(c);
+            av_freep(&graphi->thread);
+            return ret;
+        }
+    }
+
     graphi->thread_execute = thread_execute;
 
     return 0;
@@ -109,7 +258,13 @@ int ff_graph_thread_init(FFFilterGraph *graphi)
 
 void ff_graph_thread_free(FFFilterGraph *graph)
 {
-    if (graph->thread)
-        slice_thread_uninit(graph->thread);
+    ThreadContext *c = graph->thread;
+
+    if (c) {
+        graph_thread_uninit(c);
+        ff_mutex_destroy(&c->execute_lock);
+        slice_thread_uninit(c);
+    }
     av_freep(&graph->thread);
+    av_freep(&graph->batch);
 }
@@ -40,17 +40,33 @@
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
 #include "filters.h"
+#include "framethread.h"
 #include "video.h"
 
+/* Upper bound for the wavelet planes of all threads together. A single
+ * thread may use more, so that large frames are still filtered. */
+#define MAX_SCRATCH_SIZE (512 << 20)
+
+typedef struct OWDenoiseThreadData {
+    /* plane[i][0] all point to the same low band buffer, the transform
+     * steps can work in place on it; plane[0][1] and plane[0][2] are the
+     * temporary buffers and plane[0][3] is unused */
+    float *plane[16+1][4];
+} OWDenoiseThreadData;
+
 typedef struct OWDenoiseContext {
     const AVClass *class;
     double luma_strength;
     double chroma_strength;
     int depth;
-    float *plane[16+1][4];
+    int alloc_depth;
     int linesize;
     int hsub, vsub;
     int pixel_depth;
+
+    FFFrameThread *ft;
+    OWDenoiseThreadData *td;
+    int nb_td;
 } OWDenoiseContext;
 
 #define OFFSET(x) offsetof(OWDenoiseContext, x)
@@ -187,7 +203,7 @@ static void compose2D2(float *dst, float *src[4], float *temp[2],
     compose2D(dst,     temp[0], temp[1], 1, linesize, step, w, h);
 }
 
-static void filter(OWDenoiseContext *s,
+static void filter(OWDenoiseContext *s, float *plane[16+1][4],
                    uint8_t       *dst, int dst_linesize,
                    const uint8_t *src, int src_linesize,
                    int width, int height, double strength)
@@ -200,39 +216,39 @@ static void filter(OWDenoiseContext *s,
     if (s->pixel_depth <= 8) {
         for (y = 0; y < height; y++)
             for(x = 0; x < width; x++)
-                s->plane[0][0][y*s->linesize + x] = src[y*src_linesize + x];
+                plane[0][0][y*s->linesize + x] = src[y*src_linesize + x];
     } else {
         const uint16_t *src16 = (const uint16_t *)src;
 
         src_linesize /= 2;
         for (y = 0; y < height; y++)
             for(x = 0; x < width; x++)
-                s->plane[0][0][y*s->linesize + x] = src16[y*src_linesize + x];
+                plane[0][0][y*s->linesize + x] = src16[y*src_linesize + x];
     }
 
     for (i = 0; i < depth; i++)
-        decompose2D2(s->plane[i + 1], s->plane[i][0], s->plane[0] + 1, s->linesize, 1<<i, width, height);
+        decompose2D2(plane[i + 1], plane[i][0], plane[0] + 1, s->linesize, 1<<i, width, height);
 
     for (i = 0; i < depth; i++) {
         for (j = 1; j < 4; j++) {
             for (y = 0; y < height; y++) {
                 for (x = 0; x < width; x++) {
-                    double v = s->plane[i + 1][j][y*s->linesize + x];
+                    double v = plane[i + 1][j][y*s->linesize + x];
                     if      (v >  strength) v -= strength;
                     else if (v < -strength) v += strength;
                     else                    v  = 0;
-                    s->plane[i + 1][j][x + y*s->linesize] = v;
+                    plane[i + 1][j][x + y*s->linesize] = v;
                 }
             }
         }
     }
     for (i = depth-1; i >= 0; i--)
-        compose2D2(s->plane[i][0], s->plane[i + 1], s->plane[0] + 1, s->linesize, 1<<i, width, height);
+        compose2D2(plane[i][0], plane[i + 1], plane[0] + 1, s->linesize, 1<<i, width, height);
 
     if (s->pixel_depth <= 8) {
         for (y = 0; y < height; y++) {
             for (x = 0; x < width; x++) {
-                i = s->plane[0][0][y*s->linesize + x] + dither[x&7][y&7]*(1.0/64) + 1.0/128; // yes the rounding is insane but optimal :)
+                i = plane[0][0][y*s->linesize + x] + dither[x&7][y&7]*(1.0/64) + 1.0/128; // yes the rounding is insane but optimal :)
                 if ((unsigned)i > 255U) i = ~(i >> 31);
                 dst[y*dst_linesize + x] = i;
             }
@@ -243,60 +259,51 @@ static void filter(OWDenoiseContext *s,
         dst_linesize /= 2;
         for (y = 0; y < height; y++) {
             for (x = 0; x < width; x++) {
-                i = s->plane[0][0][y*s->linesize + x];
+                i = plane[0][0][y*s->linesize + x];
                 dst16[y*dst_linesize + x] = i;
             }
         }
     }
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *in)
+static int filter_frame(AVFilterContext *ctx, AVFrame *out,
+                        AVFrame *const *inp, int threadnr)
 {
-    AVFilterContext *ctx = inlink->dst;
     OWDenoiseContext *s = ctx->priv;
-    AVFilterLink *outlink = ctx->outputs[0];
-    AVFrame *out;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const AVFrame *in = inp[0];
+    float *(*plane)[4] = s->td[threadnr].plane;
     const int cw = AV_CEIL_RSHIFT(inlink->w, s->hsub);
     const int ch = AV_CEIL_RSHIFT(inlink->h, s->vsub);
 
-    if (av_frame_is_writable(in)) {
-        out = in;
-
-        if (s->luma_strength > 0)
-            filter(s, out->data[0], out->linesize[0], in->data[0], in->linesize[0], inlink->w, inlink->h, s->luma_strength);
-        if (s->chroma_strength > 0) {
-            filter(s, out->data[1], out->linesize[1], in->data[1], in->linesize[1], cw,        ch,        s->chroma_strength);
-            filter(s, out->data[2], out->linesize[2], in->data[2], in->linesize[2], cw,        ch,        s->chroma_strength);
-        }
+    if (s->luma_strength > 0) {
+        filter(s, plane, out->data[0], out->linesize[0], in->data[0], in->linesize[0], inlink->w, inlink->h, s->luma_strength);
     } else {
-        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-        if (!out) {
-            av_frame_free(&in);
-            return AVERROR(ENOMEM);
-        }
-        av_frame_copy_props(out, in);
+        av_image_copy_plane(out->data[0], out->linesize[0], in ->data[0], in ->linesize[0],
+                            inlink->w * ((s->pixel_depth + 7) / 8), inlink->h);
+    }
+    if (s->chroma_strength > 0) {
+        filter(s, plane, out->data[1], out->linesize[1], in->data[1], in->linesize[1], cw, ch, s->chroma_strength);
+        filter(s, plane, out->data[2], out->linesize[2], in->data[2], in->linesize[2], cw, ch, s->chroma_strength);
+    } else {
+        av_image_copy_plane(out->data[1], out->linesize[1], in ->data[1], in ->linesize[1],
+                            cw * ((s->pixel_depth + 7) / 8), ch);
+        av_image_copy_plane(out->data[2], out->linesize[2], in ->data[2], in ->linesize[2],
+                            cw * ((s->pixel_depth + 7) / 8), ch);
+    }
 
-        if (s->luma_strength > 0) {
-            filter(s, out->data[0], out->linesize[0], in->data[0], in->linesize[0], inlink->w, inlink->h, s->luma_strength);
-        } else {
-            av_image_copy_plane(out->data[0], out->linesize[0], in ->data[0], in ->linesize[0], inlink->w, inlink->h);
-        }
-        if (s->chroma_strength > 0) {
-            filter(s, out->data[1], out->linesize[1], in->data[1], in->linesize[1], cw, ch, s->chroma_strength);
-            filter(s, out->data[2], out->linesize[2], in->data[2], in->linesize[2], cw, ch, s->chroma_strength);
-        } else {
-            av_image_copy_plane(out->data[1], out->linesize[1], in ->data[1], in ->linesize[1], inlink->w, inlink->h);
-            av_image_copy_plane(out->data[2], out->linesize[2], in ->data[2], in ->linesize[2], inlink->w, inlink->h);
-        }
+    if (in->data[3])
+        av_image_copy_plane(out->data[3], out->linesize[3],
+                            in ->data[3], in ->linesize[3],
+                            inlink->w * ((s->pixel_depth + 7) / 8), inlink->h);
 
-        if (in->data[3])
-            av_image_copy_plane(out->data[3], out->linesize[3],
-                                in ->data[3], in ->linesize[3],
-                                inlink->w, inlink->h);
-        av_frame_free(&in);
-    }
+    return 0;
+}
 
-    return ff_filter_frame(outlink, out);
+static int activate(AVFilterContext *ctx)
+{
+    OWDenoiseContext *s = ctx->priv;
+    return ff_filter_frame_thread_activate(s->ft);
 }
 
 static const enum AVPixelFormat pix_fmts[] = {
@@ -315,43 +322,86 @@ static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_NONE
 };
 
+static void free_thread_data(OWDenoiseContext *s)
+{
+    for (int n = 0; n < s->nb_td; n++) {
+        for (int j = 0; j < 3; j++)
+            av_freep(&s->td[n].plane[0][j]);
+        for (int i = 1; i <= s->alloc_depth; i++)
+            for (int j = 1; j < 4; j++)
+                av_freep(&s->td[n].plane[i][j]);
+    }
+    av_freep(&s->td);
+    s->nb_td = 0;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
-    int i, j;
-    OWDenoiseContext *s = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    OWDenoiseContext *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     const int h = FFALIGN(inlink->h, 16);
+    size_t plane_size, thread_size;
+    int ret, depth = s->depth;
 
     s->hsub = desc->log2_chroma_w;
     s->vsub = desc->log2_chroma_h;
     s->pixel_depth = desc->comp[0].depth;
 
+    ff_filter_frame_thread_uninit(&s->ft);
+    free_thread_data(s);
+
+    // the chroma planes never use more levels than the luma plane
+    while (1<<depth > inlink->w || 1<<depth > inlink->h)
+        depth--;
+    s->alloc_depth = depth;
+
     s->linesize = FFALIGN(inlink->w, 16);
-    for (j = 0; j < 4; j++) {
-        for (i = 0; i <= s->depth; i++) {
-            s->plane[i][j] = av_malloc_array(s->linesize, h * sizeof(s->plane[0][0][0]));
-            if (!s->plane[i][j])
+    plane_size  = (size_t)s->linesize * h * sizeof(s->td[0].plane[0][0][0]);
+    thread_size = plane_size * (3 + 3 * depth);
+
+    ret = ff_filter_frame_thread_init(&s->ft, ctx, filter_frame, 0,
+                                      FFMAX(MAX_SCRATCH_SIZE / thread_size, 1));
+    if (ret < 0)
+        return ret;
+
+    s->td = av_calloc(ff_filter_frame_thread_nb_threads(s->ft), sizeof(*s->td));
+    if (!s->td)
+        return AVERROR(ENOMEM);
+    s->nb_td = ff_filter_frame_thread_nb_threads(s->ft);
+
+    for (int n = 0; n < s->nb_td; n++) {
+        float *(*plane)[4] = s->td[n].plane;
+
+        for (int j = 0; j < 3; j++) {
+            plane[0][j] = av_malloc(plane_size);
+            if (!plane[0][j])
                 return AVERROR(ENOMEM);
         }
+        for (int i = 1; i <= depth; i++) {
+            plane[i][0] = plane[0][0];
+            for (int j = 1; j < 4; j++) {
+                plane[i][j] = av_malloc(plane_size);
+                if (!plane[i][j])
+                    return AVERROR(ENOMEM);
+            }
+        }
     }
     return 0;
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
 {
-    int i, j;
     OWDenoiseContext *s = ctx->priv;
 
-    for (j = 0; j < 4; j++)
-        for (i = 0; i <= s->depth; i++)
-            av_freep(&s->plane[i][j]);
+    ff_filter_frame_thread_uninit(&s->ft);
+    free_thread_data(s);
 }
 
 static const AVFilterPad owdenoise_inputs[] = {
     {
         .name         = "default",
         .type         = AVMEDIA_TYPE_VIDEO,
-        .filter_frame = filter_frame,
         .config_props = config_input,
     },
 };
@@ -361,9 +411,10 @@ const AVFilter ff_vf_owdenoise = {
     .description   = NULL_IF_CONFIG_SMALL("Denoise using wavelets."),
     .priv_size     = sizeof(OWDenoiseContext),
     .uninit        = uninit,
+    .activate      = activate,
     FILTER_INPUTS(owdenoise_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
     .priv_class    = &owdenoise_class,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
 };
@@ -33,6 +33,7 @@
 #include "framesync.h"
 #include "scale_eval.h"
 #include "video.h"
+#include "libavutil/avstring.h"
 #include "libavutil/eval.h"
 #include "libavutil/imgutils_internal.h"
 #include "libavutil/internal.h"
@@ -1405,3 +1406,388 @@ const AVFilter ff_vf_scale2ref = {
     FILTER_QUERY_FUNC2(query_formats),
     .process_command = process_command,
 };
+
+typedef struct ScaleMultiContext {
+    const AVClass *class;
+    // context used for forwarding options to sws
+    struct SwsContext *sws_opts;
+    struct SwsContext **sws;    ///< scaler of each output, in processing order
+    AVFrame **frames;           ///< output frames, in processing order
+
+    char *sizes_str;
+    char *flags_str;
+    int pyramid;
+
+    int nb_outputs;
+    int *w, *h;
+    int *order;                 ///< output indices sorted by decreasing size
+    int *parent;                ///< output used as source, -1 for the input
+
+    int in_w, in_h;             ///< input size the scalers are set up for
+} ScaleMultiContext;
+
+static int scale_multi_config_output(AVFilterLink *outlink);
+
+static av_cold int scale_multi_preinit(AVFilterContext *ctx)
+{
+    ScaleMultiContext *s = ctx->priv;
+
+    s->sws_opts = sws_alloc_context();
+    if (!s->sws_opts)
+        return AVERROR(ENOMEM);
+
+    // set threads=0, so we can later check whether the user modified it
+    return av_opt_set_int(s->sws_opts, "threads", 0, 0);
+}
+
+static av_cold int scale_multi_init(AVFilterContext *ctx)
+{
+    ScaleMultiContext *s = ctx->priv;
+    char *sizes, *token, *saveptr = NULL;
+    int ret;
+
+    if (!s->sizes_str || !*s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified.\n");
+        return AVERROR(EINVAL);
+    }
+
+    if (s->flags_str && *s->flags_str) {
+        ret = av_opt_set(s->sws_opts, "sws_flags", s->flags_str, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    sizes = av_strdup(s->sizes_str);
+    if (!sizes)
+        return AVERROR(ENOMEM);
+
+    for (token = av_strtok(sizes, "|", &saveptr); token;
+         token = av_strtok(NULL, "|", &saveptr)) {
+        AVFilterPad pad = { 0 };
+        int w, h;
+
+        ret = av_parse_video_size(&w, &h, token);
+        if (ret < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'.\n", token);
+            goto end;
+        }
+
+        if ((ret = av_reallocp_array(&s->w, s->nb_outputs + 1, sizeof(*s->w))) < 0 ||
+            (ret = av_reallocp_array(&s->h, s->nb_outputs + 1, sizeof(*s->h))) < 0)
+            goto end;
+        s->w[s->nb_outputs] = w;
+        s->h[s->nb_outputs] = h;
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = scale_multi_config_output;
+        pad.name         = av_asprintf("output%d", s->nb_outputs);
+        if (!pad.name) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = ff_append_outpad_free_name(ctx, &pad)) < 0)
+            goto end;
+
+        s->nb_outputs++;
+    }
+
+    s->sws    = av_calloc(s->nb_outputs, sizeof(*s->sws));
+    s->frames = av_calloc(s->nb_outputs, sizeof(*s->frames));
+    s->order  = av_calloc(s->nb_outputs, sizeof(*s->order));
+    s->parent = av_calloc(s->nb_outputs, sizeof(*s->parent));
+    if (!s->sws || !s->frames || !s->order || !s->parent) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    /* largest first, so that every output comes after its parent */
+    for (int i = 0; i < s->nb_outputs; i++) {
+        int j = i;
+        while (j > 0 && (int64_t)s->w[s->order[j - 1]] * s->h[s->order[j - 1]] <
+                        (int64_t)s->w[i] * s->h[i]) {
+            s->order[j] = s->order[j - 1];
+            j--;
+        }
+        s->order[j] = i;
+    }
+
+    /* Scale an output from the smallest larger output that is at least twice
+     * its size in both directions, e.g. 360p from 720p, as the filter then
+     * still covers enough input lines for a reasonable result. */
+    for (int i = 0; i < s->nb_outputs; i++) {
+        const int o = s->order[i];
+
+        s->parent[i] = -1;
+        for (int j = i - 1; s->pyramid && j >= 0; j--) {
+            const int p = s->order[j];
+            if (s->w[p] >= 2 * s->w[o] && s->h[p] >= 2 * s->h[o]) {
+                s->parent[i] = j;
+                break;
+            }
+        }
+    }
+
+    ret = 0;
+end:
+    av_free(sizes);
+    return ret;
+}
+
+static av_cold void scale_multi_uninit(AVFilterContext *ctx)
+{
+    ScaleMultiContext *s = ctx->priv;
+
+    for (int i = 0; i < s->nb_outputs; i++) {
+        if (s->sws)
+            sws_free_context(&s->sws[i]);
+        if (s->frames)
+            av_frame_free(&s->frames[i]);
+    }
+    av_freep(&s->sws);
+    av_freep(&s->frames);
+    av_freep(&s->order);
+    av_freep(&s->parent);
+    av_freep(&s->w);
+    av_freep(&s->h);
+    sws_freeContext(s->sws_opts);
+    s->sws_opts = NULL;
+}
+
+static int scale_multi_query_formats(const AVFilterContext *ctx,
+                                     AVFilterFormatsConfig **cfg_in,
+                                     AVFilterFormatsConfig **cfg_out)
+{
+    AVFilterFormats *formats = NULL;
+    const AVPixFmtDescriptor *desc = NULL;
+    int ret;
+
+    /* the input is only resized, all links share the same format */
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        enum AVPixelFormat pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if (sws_isSupportedInput(pix_fmt) && sws_isSupportedOutput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+
+    return ff_set_common_formats2(ctx, cfg_in, cfg_out, formats);
+}
+
+static int scale_multi_init_sws(AVFilterContext *ctx, int in_w, int in_h)
+{
+    ScaleMultiContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const int full_range = inlink->color_range == AVCOL_RANGE_JPEG;
+    int64_t threads;
+    int ret;
+
+    ret = av_opt_get_int(s->sws_opts, "threads", 0, &threads);
+    if (ret < 0)
+        return ret;
+    /* threaded scalers are run one after the other, on the whole input;
+     * only single threaded ones are fed with bands of the input */
+    if (!threads)
+        threads = 1;
+
+    for (int i = 0; i < s->nb_outputs; i++) {
+        const int o = s->order[i];
+        const int p = s->parent[i] < 0 ? -1 : s->order[s->parent[i]];
+        struct SwsContext *sws;
+
+        sws_free_context(&s->sws[i]);
+        sws = s->sws[i] = sws_alloc_context();
+        if (!sws)
+            return AVERROR(ENOMEM);
+
+        ret = av_opt_copy(sws, s->sws_opts);
+        if (ret < 0)
+            return ret;
+
+        av_opt_set_int(sws, "srcw", p < 0 ? in_w : s->w[p], 0);
+        av_opt_set_int(sws, "srch", p < 0 ? in_h : s->h[p], 0);
+        av_opt_set_int(sws, "src_format", inlink->format, 0);
+        av_opt_set_int(sws, "dstw", s->w[o], 0);
+        av_opt_set_int(sws, "dsth", s->h[o], 0);
+        av_opt_set_int(sws, "dst_format", inlink->format, 0);
+        av_opt_set_int(sws, "src_range", full_range, 0);
+        av_opt_set_int(sws, "dst_range", full_range, 0);
+        av_opt_set_int(sws, "threads", threads, 0);
+
+        if ((ret = sws_init_context(sws, NULL, NULL)) < 0)
+            return ret;
+    }
+
+    s->in_w = in_w;
+    s->in_h = in_h;
+    return 0;
+}
+
+static int scale_multi_config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    ScaleMultiContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    const int idx = FF_OUTLINK_IDX(outlink);
+
+    outlink->w = s->w[idx];
+    outlink->h = s->h[idx];
+
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    if (idx == 0)
+        return scale_multi_init_sws(ctx, inlink->w, inlink->h);
+    return 0;
+}
+
+static int scale_multi_filter_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    ScaleMultiContext *s = ctx->priv;
+    int ret;
+
+    if (in->format != ctx->inputs[0]->format) {
+        av_log(ctx, AV_LOG_ERROR, "Changing the pixel format is not supported.\n");
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+
+    if (in->width != s->in_w || in->height != s->in_h) {
+        ret = scale_multi_init_sws(ctx, in->width, in->height);
+        if (ret < 0)
+            goto end;
+    }
+
+    for (int i = 0; i < s->nb_outputs; i++) {
+        AVFilterLink *outlink = ctx->outputs[s->order[i]];
+
+        s->frames[i] = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!s->frames[i]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = av_frame_copy_props(s->frames[i], in);
+        if (ret < 0)
+            goto end;
+        s->frames[i]->sample_aspect_ratio = outlink->sample_aspect_ratio;
+    }
+
+    ret = sws_scale_frames(s->sws, s->frames, s->nb_outputs, in);
+    if (ret < 0)
+        goto end;
+
+    for (int i = 0; i < s->nb_outputs; i++) {
+        AVFilterLink *outlink = ctx->outputs[s->order[i]];
+        AVFrame *out = s->frames[i];
+
+        s->frames[i] = NULL;
+        if (ff_outlink_get_status(outlink)) {
+            av_frame_free(&out);
+            continue;
+        }
+        ret = ff_filter_frame(outlink, out);
+        if (ret < 0)
+            goto end;
+    }
+
+end:
+    for (int i = 0; i < s->nb_outputs; i++)
+        av_frame_free(&s->frames[i]);
+    av_frame_free(&in);
+    return ret;
+}
+
+static int scale_multi_activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame *in;
+    int status, ret, nb_eofs = 0;
+    int64_t pts;
+
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        nb_eofs += ff_outlink_get_status(ctx->outputs[i]) == AVERROR_EOF;
+
+    if (nb_eofs == ctx->nb_outputs) {
+        ff_inlink_set_status(inlink, AVERROR_EOF);
+        return 0;
+    }
+
+    ret = ff_inlink_consume_frame(inlink, &in);
+    if (ret < 0)
+        return ret;
+    if (ret > 0)
+        return scale_multi_filter_frame(ctx, in);
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        for (int i = 0; i < ctx->nb_outputs; i++) {
+            if (ff_outlink_get_status(ctx->outputs[i]))
+                continue;
+            ff_outlink_set_status(ctx->outputs[i], status, pts);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        if (ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+
+        if (ff_outlink_frame_wanted(ctx->outputs[i])) {
+            ff_inlink_request_frame(inlink);
+            return 0;
+        }
+    }
+
+    return FFERROR_NOT_READY;
+}
+
+static const AVClass *scale_multi_child_class_iterate(void **iter)
+{
+    const AVClass *c = *iter ? NULL : sws_get_class();
+    *iter = (void*)(uintptr_t)c;
+    return c;
+}
+
+static void *scale_multi_child_next(void *obj, void *prev)
+{
+    ScaleMultiContext *s = obj;
+    if (!prev)
+        return s->sws_opts;
+    return NULL;
+}
+
+#undef OFFSET
+#define OFFSET(x) offsetof(ScaleMultiContext, x)
+
+static const AVOption scale_multi_options[] = {
+    { "sizes",   "'|'-separated list of output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL }, .flags = FLAGS },
+    { "flags",   "Flags to pass to libswscale",      OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "" },   .flags = FLAGS },
+    { "pyramid", "scale small outputs from larger outputs", OFFSET(pyramid), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, FLAGS },
+    { NULL }
+};
+
+static const AVClass scale_multi_class = {
+    .class_name          = "scale_multi",
+    .item_name           = av_default_item_name,
+    .option              = scale_multi_options,
+    .version             = LIBAVUTIL_VERSION_INT,
+    .category            = AV_CLASS_CATEGORY_FILTER,
+    .child_class_iterate = scale_multi_child_class_iterate,
+    .child_next          = scale_multi_child_next,
+};
+
+const AVFilter ff_vf_scale_multi = {
+    .name            = "scale_multi",
+    .description     = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes in one pass."),
+    .preinit         = scale_multi_preinit,
+    .init            = scale_multi_init,
+    .uninit          = scale_multi_uninit,
+    .priv_size       = sizeof(ScaleMultiContext),
+    .priv_class      = &scale_multi_class,
+    FILTER_INPUTS(ff_video_default_filterpad),
+    .outputs         = NULL,
+    FILTER_QUERY_FUNC2(scale_multi_query_formats),
+    .activate        = scale_multi_activate,
+    .flags           = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
@@ -35,6 +35,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "url.h"
+#include <stdatomic.h>
 #include <stdint.h>
 
 #if HAVE_UNISTD_H
@@ -44,6 +45,7 @@
 #define BUFFER_CAPACITY         (4 * 1024 * 1024)
 #define READ_BACK_CAPACITY      (4 * 1024 * 1024)
 #define SHORT_SEEK_THRESHOLD    (256 * 1024)
+#define READ_CHUNK_SIZE         (64 * 1024)
 
 typedef struct RingBuffer
 {
@@ -78,6 +80,13 @@ typedef struct AsyncContext {
 
     int             abort_request;
     AVIOInterruptCB interrupt_callback;
+
+    /* set while a seek is pending, interrupts the current inner read */
+    atomic_int      cancel_read;
+
+    /* options */
+    int             buffer_size;
+    int             read_back_size;
 } AsyncContext;
 
 static int ring_init(RingBuffer *ring, unsigned int capacity, int read_back_capacity)
@@ -181,6 +190,14 @@ static int async_check_interrupt(void *arg)
     return c->abort_request;
 }
 
+static int async_inner_check_interrupt(void *arg)
+{
+    URLContext   *h = arg;
+    AsyncContext *c = h->priv_data;
+
+    return atomic_load(&c->cancel_read) || async_check_interrupt(arg);
+}
+
 static void *async_buffer_task(void *arg)
 {
     URLContext   *h    = arg;
@@ -204,6 +221,9 @@ static void *async_buffer_task(void *arg)
         }
 
         if (c->seek_request) {
+            /* the seek itself must not be interrupted, e.g. when the inner
+             * protocol has to reconnect to perform it */
+            atomic_store(&c->cancel_read, 0);
             seek_ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
             if (seek_ret >= 0) {
                 c->io_eof_reached = 0;
@@ -215,7 +235,6 @@ static void *async_buffer_task(void *arg)
             c->seek_ret       = seek_ret;
             c->seek_request   = 0;
 
-
             pthread_cond_signal(&c->cond_wakeup_main);
             pthread_mutex_unlock(&c->mutex);
             continue;
@@ -230,11 +249,14 @@ static void *async_buffer_task(void *arg)
         }
         pthread_mutex_unlock(&c->mutex);
 
-        to_copy = FFMIN(4096, fifo_space);
+        to_copy = FFMIN(READ_CHUNK_SIZE, fifo_space);
         ret = ring_write(ring, h, to_copy);
 
         pthread_mutex_lock(&c->mutex);
-        if (ret <= 0) {
+        if (ret < 0 && c->seek_request && !c->abort_request) {
+            /* read interrupted by a seek, whatever it returned is discarded
+             * together with the rest of the buffer once the seek succeeds */
+        } else if (ret <= 0) {
             c->io_eof_reached = 1;
             if (c->inner_io_error < 0)
                 c->io_error = c->inner_io_error;
@@ -251,11 +273,13 @@ static int async_open(URLContext *h, const char *arg, int flags, AVDictionary **
 {
     AsyncContext *c = h->priv_data;
     int              ret;
-    AVIOInterruptCB  interrupt_callback = {.callback = async_check_interrupt, .opaque = h};
+    AVIOInterruptCB  interrupt_callback = {.callback = async_inner_check_interrupt, .opaque = h};
 
     av_strstart(arg, "async:", &arg);
 
-    ret = ring_init(&c->ring, BUFFER_CAPACITY, READ_BACK_CAPACITY);
+    atomic_init(&c->cancel_read, 0);
+
+    ret = ring_init(&c->ring, c->buffer_size, c->read_back_size);
     if (ret < 0)
         goto fifo_fail;
 
@@ -451,6 +475,8 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
     c->seek_whence    = SEEK_SET;
     c->seek_completed = 0;
     c->seek_ret       = 0;
+    /* the data being prefetched is useless now, do not wait for it */
+    atomic_store(&c->cancel_read, 1);
 
     while (1) {
         if (async_check_interrupt(h)) {
@@ -476,6 +502,8 @@ static int64_t async_seek(URLContext *h, int64_t pos, int whence)
 #define D AV_OPT_FLAG_DECODING_PARAM
 
 static const AVOption options[] = {
+    { "async_buffer_size",    "Size of the read-ahead buffer", OFFSET(buffer_size),    AV_OPT_TYPE_INT, { .i64 = BUFFER_CAPACITY },    4096, INT_MAX / 2, D },
+    { "async_read_back_size", "Size of the buffer kept for short backward seeks", OFFSET(read_back_size), AV_OPT_TYPE_INT, { .i64 = READ_BACK_CAPACITY }, 0, INT_MAX / 2, D },
     {NULL},
 };
 
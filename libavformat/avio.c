@@ -25,6 +25,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/avassert.h"
+#include "config_components.h"
 #include "avio_internal.h"
 #include "os_support.h"
 #include "internal.h"
@@ -61,6 +62,7 @@ static const AVOption options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"rw_timeout", "Timeout for IO operations (in microseconds)", offsetof(URLContext, rw_timeout), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_DECODING_PARAM },
+    {"readahead_size", "Size of the buffer filled in a background thread, 0 to disable read-ahead", offsetof(URLContext, readahead_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX / 2, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -473,11 +475,33 @@ int ffio_open_whitelist(AVIOContext **s, const char *filename, int flags,
                         const char *whitelist, const char *blacklist)
 {
     URLContext *h;
+    char *async_url = NULL;
     int err;
 
     *s = NULL;
 
+    /* Read-ahead is implemented by wrapping the URL in the async protocol,
+     * which fills its buffer from a background thread. */
+    if (CONFIG_ASYNC_PROTOCOL && !(flags & AVIO_FLAG_WRITE) && options &&
+        !av_strstart(filename, "async:", NULL) &&
+        (!whitelist || av_match_list("async", whitelist, ',') > 0) &&
+        (!blacklist || av_match_list("async", blacklist, ',') <= 0)) {
+        const AVDictionaryEntry *e = av_dict_get(*options, "readahead_size", NULL, 0);
+
+        if (e && strtol(e->value, NULL, 0) > 0) {
+            err = av_dict_set(options, "async_buffer_size", e->value,
+                              AV_DICT_DONT_OVERWRITE);
+            if (err < 0)
+                return err;
+            async_url = av_asprintf("async:%s", filename);
+            if (!async_url)
+                return AVERROR(ENOMEM);
+            filename = async_url;
+        }
+    }
+
     err = ffurl_open_whitelist(&h, filename, flags, int_cb, options, whitelist, blacklist, NULL);
+    av_free(async_url);
     if (err < 0)
         return err;
     err = ffio_fdopen(s, h);
@@ -844,6 +868,13 @@ int ffurl_get_short_seek(void *urlcontext)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_get_mapped_buffer(URLContext *h, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_get_mapped_buffer)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_mapped_buffer(h, buf);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
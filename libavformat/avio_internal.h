@@ -21,6 +21,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -119,6 +120,20 @@ void ffio_init_write_context(FFIOContext *s, uint8_t *buffer, int buffer_size);
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes from AVIOContext without copying them, if the underlying
+ * protocol maps the resource in memory.
+ *
+ * The returned buffer is read-only. It is followed by at least
+ * AV_INPUT_BUFFER_PADDING_SIZE readable bytes, which hold the following
+ * data of the resource, or zeros past its end.
+ *
+ * @param buf set to a new reference to the data on success
+ * @return size on success, AVERROR(ENOSYS) if the data cannot be referenced,
+ *         in which case nothing is read, or another negative AVERROR code
+ */
+int ffio_read_ref(AVIOContext *s, int size, AVBufferRef **buf);
+
 void ffio_fill(AVIOContext *s, int b, int64_t count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
@@ -31,6 +31,7 @@
 #include "avio.h"
 #include "avio_internal.h"
 #include "internal.h"
+#include "url.h"
 #include <stdarg.h>
 
 #define IO_BUFFER_SIZE 32768
@@ -659,6 +660,47 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
     return size1 - size;
 }
 
+int ffio_read_ref(AVIOContext *s, int size, AVBufferRef **pbuf)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    URLContext *h = ffio_geturlcontext(s);
+    int64_t pos = avio_tell(s);
+    AVBufferRef *buf;
+    int ret;
+
+    if (!h || s->write_flag || s->update_checksum || size <= 0 || pos < 0)
+        return AVERROR(ENOSYS);
+
+    ret = ffurl_get_mapped_buffer(h, &buf);
+    if (ret < 0)
+        return ret;
+    if (pos + size > buf->size) {
+        av_buffer_unref(&buf);
+        return AVERROR(ENOSYS);
+    }
+
+    if (size <= s->buf_end - s->buf_ptr) {
+        s->buf_ptr += size;
+    } else {
+        /* Seeking a mapped resource is cheap, do not read the data into the
+         * buffer like avio_skip() would do for short distances. */
+        int64_t res = s->seek(s->opaque, pos + size, SEEK_SET);
+        if (res < 0) {
+            av_buffer_unref(&buf);
+            return res;
+        }
+        s->buf_end = s->buf_ptr = s->buf_ptr_max = s->buffer;
+        s->pos         = pos + size;
+        s->eof_reached = 0;
+    }
+    ctx->bytes_read += size;
+
+    buf->data += pos;
+    buf->size  = size;
+    *pbuf = buf;
+    return size;
+}
+
 int ffio_read_size(AVIOContext *s, unsigned char *buf, int size)
 {
     int ret = avio_read(s, buf, size);
@@ -19,6 +19,8 @@
  * License along with FFmpeg; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+#include "config_components.h"
+
 #include <libxml/parser.h>
 #include <time.h>
 #include "libavutil/bprint.h"
@@ -30,9 +32,12 @@
 #include "avio_internal.h"
 #include "dash.h"
 #include "demux.h"
+#include "http.h"
 #include "url.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+/* idle persistent connections kept for the segments and manifests */
+#define HTTP_POOL_SIZE 8
 
 struct fragment {
     int64_t url_offset;
@@ -154,6 +159,8 @@ typedef struct DASHContext {
     AVDictionary *avio_opts;
     int max_url_size;
     char *cenc_decryption_key;
+    int http_persistent;
+    FFHTTPPool *http_pool;
 
     /* Flags for init section*/
     int is_init_section_common_video;
@@ -446,7 +453,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     av_freep(pb);
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
-    ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
+    if (c->http_pool)
+        ret = ff_http_pool_open(c->http_pool, s, pb, url, &tmp);
+    else
+        ret = avio_open2(pb, url, AVIO_FLAG_READ, c->interrupt_callback, &tmp);
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         char *new_cookies = NULL;
@@ -1225,7 +1235,10 @@ static int parse_manifest(AVFormatContext *s, const char *url, AVIOContext *in)
         close_in = 1;
 
         av_dict_copy(&opts, c->avio_opts, 0);
-        ret = avio_open2(&in, url, AVIO_FLAG_READ, c->interrupt_callback, &opts);
+        if (c->http_pool)
+            ret = ff_http_pool_open(c->http_pool, s, &in, url, &opts);
+        else
+            ret = avio_open2(&in, url, AVIO_FLAG_READ, c->interrupt_callback, &opts);
         av_dict_free(&opts);
         if (ret < 0)
             return ret;
@@ -1368,7 +1381,10 @@ cleanup:
 
     av_bprint_finalize(&buf, NULL);
     if (close_in) {
-        avio_close(in);
+        if (c->http_pool)
+            ff_http_pool_release(c->http_pool, s, &in);
+        else
+            avio_close(in);
     }
     return ret;
 }
@@ -1748,7 +1764,7 @@ static int update_init_section(struct representation *pls)
 
     ret = read_from_url(pls, pls->init_section, pls->init_sec_buf,
                         pls->init_sec_buf_size);
-    ff_format_io_close(pls->parent, &pls->input);
+    ff_http_pool_release(c->http_pool, pls->parent, &pls->input);
 
     if (ret < 0)
         return ret;
@@ -2026,6 +2042,11 @@ static int dash_read_header(AVFormatContext *s)
     if ((ret = ffio_copy_url_options(s->pb, &c->avio_opts)) < 0)
         return ret;
 
+#if CONFIG_HTTP_PROTOCOL
+    if (c->http_persistent && !(c->http_pool = ff_http_pool_alloc(HTTP_POOL_SIZE)))
+        return AVERROR(ENOMEM);
+#endif
+
     if ((ret = parse_manifest(s, s->url, s->pb)) < 0)
         return ret;
 
@@ -2209,7 +2230,7 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             cur->is_restart_needed = 0;
-            ff_format_io_close(cur->parent, &cur->input);
+            ff_http_pool_release(c->http_pool, cur->parent, &cur->input);
             ret = reopen_demux_for_component(s, cur);
         }
     }
@@ -2224,6 +2245,7 @@ static int dash_close(AVFormatContext *s)
     free_subtitle_list(c);
     av_dict_free(&c->avio_opts);
     av_freep(&c->base_url);
+    ff_http_pool_free(&c->http_pool, s);
     return 0;
 }
 
@@ -2346,6 +2368,7 @@ static const AVOption dash_options[] = {
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
     { "cenc_decryption_key", "Media decryption key (hex)", OFFSET(cenc_decryption_key), AV_OPT_TYPE_STRING, {.str = NULL}, INT_MIN, INT_MAX, .flags = FLAGS },
+    { "http_persistent", "Use persistent HTTP connections", OFFSET(http_persistent), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS },
     {NULL}
 };
 
@@ -330,6 +330,13 @@ int ff_generate_avci_extradata(AVStream *st);
  */
 int ff_get_extradata(void *logctx, AVCodecParameters *par, AVIOContext *pb, int size);
 
+/**
+ * Like av_get_packet(), but reference the data instead of copying it when
+ * the underlying protocol maps the resource in memory, see ffio_read_ref().
+ * The packet data must then not be modified in place.
+ */
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size);
+
 /**
  * Find stream index based on format-specific stream ID
  * @return stream index, or < 0 on error
@@ -335,6 +335,32 @@ int ff_generate_avci_extradata(AVStream *st)
     return 0;
 }
 
+int ff_get_packet_ref(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(s);
+    AVBufferRef *buf;
+    int ret;
+
+    ret = ffio_read_ref(s, size, &buf);
+    if (ret == AVERROR(ENOSYS))
+        return av_get_packet(s, pkt, size);
+    if (ret < 0)
+        return ret;
+
+#if FF_API_INIT_PACKET
+FF_DISABLE_DEPRECATION_WARNINGS
+    av_init_packet(pkt);
+FF_ENABLE_DEPRECATION_WARNINGS
+#else
+    av_packet_unref(pkt);
+#endif
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = size;
+    pkt->pos  = pos;
+    return size;
+}
+
 int ff_get_extradata(void *logctx, AVCodecParameters *par, AVIOContext *pb, int size)
 {
     int ret = ff_alloc_extradata(par, size);
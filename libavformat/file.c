@@ -19,13 +19,18 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* for O_DIRECT */
+#define _GNU_SOURCE
+
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/file_open.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavcodec/defs.h"
 #include "avio.h"
 #if HAVE_DIRENT_H
 #include <dirent.h>
@@ -38,9 +43,15 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
+#if HAVE_LINUX_IO_URING_H
+#include "file_uring.h"
+#endif
 
 /* Some systems may not have S_ISFIFO */
 #ifndef S_ISFIFO
@@ -96,6 +107,16 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int io_uring;
+    int io_uring_depth;
+    int io_uring_block_size;
+    int direct;
+    int mmap;
+#if HAVE_LINUX_IO_URING_H
+    FFFileUring *uring;
+#endif
+    AVBufferRef *map;
+    int64_t map_pos;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -106,6 +127,11 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring", "use io_uring for reading or writing", offsetof(FileContext, io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_depth", "number of io_uring requests in flight", offsetof(FileContext, io_uring_depth), AV_OPT_TYPE_INT, { .i64 = 8 }, 1, 256, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_block_size", "size of each io_uring request", offsetof(FileContext, io_uring_block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 64 << 20, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "direct", "bypass the page cache (O_DIRECT), requires io_uring", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "map the file in memory when reading, allows demuxers to avoid copying packet data", offsetof(FileContext, mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -136,11 +162,43 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+/* The size of the file is only checked when the mapping is created and when
+ * a read reaches the end of the mapping, so that the last read does not raise
+ * SIGBUS and data appended since then is not missed. If the size changed, the
+ * mapping is dropped and reading continues with plain I/O. Packets already
+ * referencing the mapping must not be accessed anymore if the file shrank. */
+static int file_check_map(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    struct stat st;
+
+    if (!fstat(c->fd, &st) && st.st_size == c->map->size)
+        return 0;
+
+    av_log(h, AV_LOG_WARNING, "File size changed, unmapping it\n");
+    av_buffer_unref(&c->map);
+    if (lseek(c->fd, c->map_pos, SEEK_SET) < 0)
+        return AVERROR(errno);
+    return AVERROR(ENOSYS);
+}
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->map && (c->map_pos + size < c->map->size || file_check_map(h) >= 0)) {
+        if (c->map_pos >= c->map->size)
+            return AVERROR_EOF;
+        size = FFMIN(size, c->map->size - c->map_pos);
+        memcpy(buf, c->map->data + c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring)
+        return ff_file_uring_read(c->uring, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -154,6 +212,10 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring)
+        return ff_file_uring_write(c->uring, buf, size);
+#endif
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -221,8 +283,14 @@ static int fd_dup(URLContext *h, int oldfd)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
-    return (ret == -1) ? AVERROR(errno) : 0;
+    int ret, err = 0;
+    /* the mapping stays valid while packets reference it */
+    av_buffer_unref(&c->map);
+#if HAVE_LINUX_IO_URING_H
+    err = ff_file_uring_close(&c->uring);
+#endif
+    ret = close(c->fd);
+    return (ret == -1) ? AVERROR(errno) : err;
 }
 
 /* XXX: use llseek */
@@ -231,6 +299,25 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+    if (c->map) {
+        if (whence == AVSEEK_SIZE)
+            return c->map->size;
+        if (whence == SEEK_CUR)
+            pos += c->map_pos;
+        else if (whence == SEEK_END)
+            pos += c->map->size;
+        else if (whence != SEEK_SET)
+            return AVERROR(EINVAL);
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->map_pos = pos;
+    }
+
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring)
+        return ff_file_uring_seek(c->uring, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -280,6 +367,103 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
     return 0;
 }
 
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)opaque);
+}
+#endif
+
+static int file_open_mmap(URLContext *h)
+{
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+    FileContext *c = h->priv_data;
+    struct stat st;
+    size_t map_size;
+    void *base, *map;
+
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        st.st_size > SIZE_MAX - AV_INPUT_BUFFER_PADDING_SIZE || c->follow)
+        return AVERROR(ENOSYS);
+
+    /* Reserve zeroed memory for the padding after the end of the file and map
+     * the file over the start of it. The partial page at the end of the file
+     * is zero-filled by the system, so the data of the last packets is
+     * followed by zeros like in a regular packet buffer. */
+    map_size = st.st_size + AV_INPUT_BUFFER_PADDING_SIZE;
+    base = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+        return AVERROR(errno);
+    map = mmap(base, st.st_size, PROT_READ, MAP_SHARED | MAP_FIXED, c->fd, 0);
+    if (map == MAP_FAILED) {
+        int err = AVERROR(errno);
+        munmap(base, map_size);
+        return err;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    c->map = av_buffer_create(map, st.st_size, file_unmap,
+                              (void *)map_size, AV_BUFFER_FLAG_READONLY);
+    if (!c->map) {
+        munmap(map, map_size);
+        return AVERROR(ENOMEM);
+    }
+    c->map_pos = lseek(c->fd, 0, SEEK_CUR);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+static int file_get_mapped_buffer(URLContext *h, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+
+    if (!c->map)
+        return AVERROR(ENOSYS);
+    *buf = av_buffer_ref(c->map);
+    return *buf ? 0 : AVERROR(ENOMEM);
+}
+
+static int file_open_uring(URLContext *h, int flags)
+{
+    FileContext *c = h->priv_data;
+    int ret = AVERROR(ENOSYS);
+
+#if HAVE_LINUX_IO_URING_H
+    struct stat st;
+
+    /* Reading and writing through the same context, following a growing file
+     * and pipes are left to plain I/O. */
+    if (!fstat(c->fd, &st) && S_ISREG(st.st_mode) && !c->follow &&
+        (flags & AVIO_FLAG_READ_WRITE) != AVIO_FLAG_READ_WRITE) {
+        ret = ff_file_uring_init(&c->uring, h, c->fd, flags & AVIO_FLAG_WRITE,
+                                 c->io_uring_depth, c->io_uring_block_size,
+                                 c->direct, lseek(c->fd, 0, SEEK_CUR));
+        if (ret >= 0) {
+            /* requests are at least one block, do not make them smaller */
+            if (flags & AVIO_FLAG_WRITE)
+                h->min_packet_size = h->max_packet_size =
+                    FFMAX(h->max_packet_size, c->io_uring_block_size);
+            return 0;
+        }
+    }
+#endif
+
+    av_log(h, AV_LOG_WARNING, "Cannot use io_uring (%s), using plain I/O\n",
+           av_err2str(ret));
+#ifdef O_DIRECT
+    if (c->direct) {
+        int fl = fcntl(c->fd, F_GETFL);
+        if (fl != -1 && fl & O_DIRECT && fcntl(c->fd, F_SETFL, fl & ~O_DIRECT) == -1)
+            return AVERROR(errno);
+    }
+#endif
+    return 0;
+}
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -302,6 +486,10 @@ static int file_open(URLContext *h, const char *filename, int flags)
     }
 #ifdef O_BINARY
     access |= O_BINARY;
+#endif
+#if HAVE_LINUX_IO_URING_H && defined(O_DIRECT)
+    if (c->direct && c->io_uring)
+        access |= O_DIRECT;
 #endif
     fd = avpriv_open(filename, access, 0666);
     if (fd == -1)
@@ -318,6 +506,22 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+    if (c->mmap && !(flags & AVIO_FLAG_WRITE)) {
+        int ret = file_open_mmap(h);
+        if (ret >= 0)
+            return 0;
+        av_log(h, AV_LOG_WARNING, "Cannot map the file (%s), using plain I/O\n",
+               av_err2str(ret));
+    }
+
+    if (c->io_uring) {
+        int ret = file_open_uring(h, flags);
+        if (ret < 0) {
+            close(fd);
+            return ret;
+        }
+    }
+
     return 0;
 }
 
@@ -413,6 +617,7 @@ const URLProtocol ff_file_protocol = {
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
+    .url_get_mapped_buffer = file_get_mapped_buffer,
     .url_check           = file_check,
     .url_delete          = file_delete,
     .url_move            = file_move,
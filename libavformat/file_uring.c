@@ -0,0 +1,623 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+
+#include "avio.h"
+#include "file_uring.h"
+
+enum BufferState {
+    BUF_IDLE,
+    BUF_FILLING,    ///< write buffer being filled, not submitted yet
+    BUF_PENDING,    ///< request in flight
+    BUF_DONE,
+};
+
+typedef struct Buffer {
+    uint8_t *data;
+    int64_t  offset;
+    int      len;   ///< size of the request
+    int      res;   ///< result of the request once done
+    enum BufferState state;
+} Buffer;
+
+struct FFFileUring {
+    void *logctx;
+    int   fd;
+    int   write;
+    int   direct;
+    int   fixed;
+
+    int          ring_fd;
+    void        *sq_ptr, *cq_ptr;
+    size_t       sq_size, cq_size;
+    struct io_uring_sqe *sqes;
+    size_t       sqes_size;
+    atomic_uint *sq_tail;
+    atomic_uint *cq_head, *cq_tail;
+    unsigned     sq_mask, cq_mask;
+    unsigned    *sq_array;
+    struct io_uring_cqe *cqes;
+    unsigned     to_submit;
+
+    uint8_t *mem;
+    size_t   mem_size;
+    Buffer  *bufs;
+    int      nb_bufs;
+    int      block_size;
+
+    /* bufs[first] to bufs[first + nb_used - 1] (modulo nb_bufs) cover
+     * consecutive file ranges, in submission order */
+    int first;
+    int nb_used;
+
+    int64_t pos;            ///< logical file position
+
+    /* reading */
+    int64_t next_offset;    ///< offset of the next read request
+    int     fresh;          ///< no data returned since the last reset
+    int     eof;
+
+    /* writing */
+    int cur;                ///< buffer being filled or -1
+    int error;
+};
+
+static int uring_enter(FFFileUring *u, unsigned min_complete)
+{
+    while (1) {
+        int ret = syscall(__NR_io_uring_enter, u->ring_fd, u->to_submit,
+                          min_complete,
+                          min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (ret >= 0) {
+            u->to_submit -= FFMIN(ret, u->to_submit);
+            return 0;
+        }
+        if (errno != EINTR && errno != EAGAIN)
+            return AVERROR(errno);
+    }
+}
+
+static void uring_reap(FFFileUring *u)
+{
+    unsigned head = atomic_load_explicit(u->cq_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(u->cq_tail, memory_order_acquire);
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+        Buffer *b = &u->bufs[cqe->user_data];
+
+        b->res   = cqe->res;
+        b->state = BUF_DONE;
+    }
+    atomic_store_explicit(u->cq_head, head, memory_order_release);
+}
+
+static void queue_request(FFFileUring *u, int i)
+{
+    Buffer *b = &u->bufs[i];
+    unsigned tail = atomic_load_explicit(u->sq_tail, memory_order_relaxed);
+    unsigned idx  = tail & u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (u->fixed) {
+        sqe->opcode    = u->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = i;
+    } else {
+        sqe->opcode    = u->write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd        = u->fd;
+    sqe->addr      = (uintptr_t)b->data;
+    sqe->len       = b->len;
+    sqe->off       = b->offset;
+    sqe->user_data = i;
+
+    u->sq_array[idx] = idx;
+    atomic_store_explicit(u->sq_tail, tail + 1, memory_order_release);
+    u->to_submit++;
+    b->state = BUF_PENDING;
+}
+
+static int wait_buffer(FFFileUring *u, int i)
+{
+    int ret;
+
+    while (u->bufs[i].state == BUF_PENDING) {
+        uring_reap(u);
+        if (u->bufs[i].state != BUF_PENDING)
+            break;
+        ret = uring_enter(u, 1);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int wait_all(FFFileUring *u)
+{
+    int ret = 0;
+
+    for (int i = 0; i < u->nb_bufs; i++) {
+        int err = wait_buffer(u, i);
+        if (err < 0 && !ret)
+            ret = err;
+    }
+    return ret;
+}
+
+static void release_first(FFFileUring *u)
+{
+    u->bufs[u->first].state = BUF_IDLE;
+    u->first = (u->first + 1) % u->nb_bufs;
+    u->nb_used--;
+}
+
+/* reading */
+
+static int read_reset(FFFileUring *u, int64_t pos)
+{
+    int ret = wait_all(u);
+
+    for (int i = 0; i < u->nb_bufs; i++)
+        u->bufs[i].state = BUF_IDLE;
+    u->first       = 0;
+    u->nb_used     = 0;
+    u->pos         = pos;
+    u->next_offset = u->direct ? pos & ~(int64_t)(FF_FILE_URING_DIRECT_ALIGN - 1) : pos;
+    u->fresh       = 1;
+    return ret;
+}
+
+static int read_fill(FFFileUring *u)
+{
+    while (u->nb_used < u->nb_bufs) {
+        int i = (u->first + u->nb_used) % u->nb_bufs;
+        Buffer *b = &u->bufs[i];
+
+        b->offset = u->next_offset;
+        b->len    = u->block_size;
+        queue_request(u, i);
+        u->nb_used++;
+        u->next_offset += u->block_size;
+    }
+    return u->to_submit ? uring_enter(u, 0) : 0;
+}
+
+int ff_file_uring_read(FFFileUring *u, uint8_t *buf, int size)
+{
+    int ret;
+
+    if (u->eof)
+        return AVERROR_EOF;
+
+    while (1) {
+        Buffer *b;
+        int64_t skip;
+        int avail;
+
+        ret = read_fill(u);
+        if (ret < 0)
+            return ret;
+
+        b   = &u->bufs[u->first];
+        ret = wait_buffer(u, u->first);
+        if (ret < 0)
+            return ret;
+
+        if (b->res < 0) {
+            ret = AVERROR(-b->res);
+            read_reset(u, u->pos);
+            return ret;
+        }
+
+        skip  = u->pos - b->offset;
+        avail = b->res - skip;
+        if (avail > 0) {
+            size = FFMIN(size, avail);
+            memcpy(buf, b->data + skip, size);
+            u->pos  += size;
+            u->fresh = 0;
+            if (size == avail && b->res == b->len)
+                release_first(u);
+            return size;
+        }
+
+        if (b->res == b->len) {
+            release_first(u);
+            u->fresh = 0;
+            continue;
+        }
+
+        /* A short read without data after pos, requested right at pos,
+         * means end of file. Otherwise the requests queued after it are not
+         * contiguous, restart from pos. */
+        if (u->fresh) {
+            u->eof = 1;
+            return AVERROR_EOF;
+        }
+        ret = read_reset(u, u->pos);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+/* writing */
+
+static int write_sync(FFFileUring *u, const uint8_t *data, int len, int64_t offset)
+{
+    int flags = 0, ret = 0;
+
+    /* unaligned requests are not possible with O_DIRECT */
+    if (u->direct) {
+        flags = fcntl(u->fd, F_GETFL);
+        if (flags == -1 || fcntl(u->fd, F_SETFL, flags & ~O_DIRECT) == -1)
+            return AVERROR(errno);
+    }
+
+    while (len > 0) {
+        ssize_t n = pwrite(u->fd, data, len, offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            ret = AVERROR(errno);
+            break;
+        }
+        data   += n;
+        len    -= n;
+        offset += n;
+    }
+
+    if (u->direct && fcntl(u->fd, F_SETFL, flags) == -1 && !ret)
+        ret = AVERROR(errno);
+    return ret;
+}
+
+static int write_complete_first(FFFileUring *u)
+{
+    Buffer *b = &u->bufs[u->first];
+    int ret = wait_buffer(u, u->first);
+
+    if (ret >= 0 && b->res < 0)
+        ret = AVERROR(-b->res);
+    else if (ret >= 0 && b->res < b->len)
+        ret = write_sync(u, b->data + b->res, b->len - b->res, b->offset + b->res);
+    release_first(u);
+
+    if (ret < 0 && !u->error)
+        u->error = ret;
+    return ret;
+}
+
+static int write_submit(FFFileUring *u)
+{
+    int i = u->cur;
+    Buffer *b = &u->bufs[i];
+    int ret = 0;
+
+    u->cur = -1;
+
+    if (u->direct && ((b->offset | b->len) & (FF_FILE_URING_DIRECT_ALIGN - 1))) {
+        /* the buffer is the last one in use */
+        ret = write_sync(u, b->data, b->len, b->offset);
+        b->state = BUF_IDLE;
+        u->nb_used--;
+        if (ret < 0 && !u->error)
+            u->error = ret;
+        return ret;
+    }
+
+    queue_request(u, i);
+    return uring_enter(u, 0);
+}
+
+static int write_flush(FFFileUring *u)
+{
+    int ret = 0;
+
+    if (u->cur >= 0) {
+        if (u->bufs[u->cur].len) {
+            ret = write_submit(u);
+        } else {
+            u->bufs[u->cur].state = BUF_IDLE;
+            u->cur = -1;
+            u->nb_used--;
+        }
+    }
+    while (u->nb_used) {
+        int err = write_complete_first(u);
+        if (err < 0 && !ret)
+            ret = err;
+    }
+
+    if (!ret)
+        ret = u->error;
+    u->error = 0;
+    return ret;
+}
+
+int ff_file_uring_write(FFFileUring *u, const uint8_t *buf, int size)
+{
+    int written = 0, ret;
+
+    if (u->error) {
+        ret = u->error;
+        u->error = 0;
+        return ret;
+    }
+
+    while (size > 0) {
+        Buffer *b;
+        int len;
+
+        if (u->cur < 0) {
+            if (u->nb_used == u->nb_bufs) {
+                ret = write_complete_first(u);
+                if (ret < 0) {
+                    u->error = 0;
+                    return ret;
+                }
+            }
+            u->cur = (u->first + u->nb_used++) % u->nb_bufs;
+            b = &u->bufs[u->cur];
+            b->state  = BUF_FILLING;
+            b->offset = u->pos;
+            b->len    = 0;
+        }
+
+        b   = &u->bufs[u->cur];
+        len = FFMIN(size, u->block_size - b->len);
+        memcpy(b->data + b->len, buf, len);
+        b->len  += len;
+        u->pos  += len;
+        buf     += len;
+        size    -= len;
+        written += len;
+
+        if (b->len == u->block_size) {
+            ret = write_submit(u);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return written;
+}
+
+int64_t ff_file_uring_seek(FFFileUring *u, int64_t pos, int whence)
+{
+    int64_t target;
+    int ret;
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        struct stat st;
+
+        if (u->write) {
+            ret = write_flush(u);
+            if (ret < 0)
+                return ret;
+        }
+        if (fstat(u->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return st.st_size;
+        target = st.st_size + pos;
+    } else if (whence == SEEK_CUR) {
+        target = u->pos + pos;
+    } else if (whence == SEEK_SET) {
+        target = pos;
+    } else {
+        return AVERROR(EINVAL);
+    }
+    if (target < 0)
+        return AVERROR(EINVAL);
+
+    if (u->write) {
+        if (target != u->pos) {
+            ret = write_flush(u);
+            if (ret < 0)
+                return ret;
+            u->pos = target;
+        }
+        return target;
+    }
+
+    u->eof = 0;
+
+    /* keep the buffers read ahead after the target */
+    if (u->nb_used && target >= u->bufs[u->first].offset && target < u->next_offset) {
+        while (target >= u->bufs[u->first].offset + u->bufs[u->first].len) {
+            ret = wait_buffer(u, u->first);
+            if (ret < 0)
+                return ret;
+            release_first(u);
+        }
+        u->pos   = target;
+        u->fresh = 0;
+        return target;
+    }
+
+    ret = read_reset(u, target);
+    return ret < 0 ? ret : target;
+}
+
+static int setup_ring(FFFileUring *u, unsigned entries)
+{
+    struct io_uring_params p = { 0 };
+    uint8_t *sq, *cq;
+
+    u->ring_fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (u->ring_fd < 0)
+        return AVERROR(errno);
+
+    u->sq_size   = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size   = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        u->sq_size = u->cq_size = FFMAX(u->sq_size, u->cq_size);
+
+    u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    if (u->sq_ptr == MAP_FAILED) {
+        u->sq_ptr = NULL;
+        return AVERROR(errno);
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ptr = u->sq_ptr;
+    } else {
+        u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+        if (u->cq_ptr == MAP_FAILED) {
+            u->cq_ptr = NULL;
+            return AVERROR(errno);
+        }
+    }
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) {
+        u->sqes = NULL;
+        return AVERROR(errno);
+    }
+
+    sq = u->sq_ptr;
+    cq = u->cq_ptr;
+    u->sq_tail  = (atomic_uint *)(sq + p.sq_off.tail);
+    u->sq_mask  = *(unsigned *)(sq + p.sq_off.ring_mask);
+    u->sq_array =  (unsigned *)(sq + p.sq_off.array);
+    u->cq_head  = (atomic_uint *)(cq + p.cq_off.head);
+    u->cq_tail  = (atomic_uint *)(cq + p.cq_off.tail);
+    u->cq_mask  = *(unsigned *)(cq + p.cq_off.ring_mask);
+    u->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+static void uring_free(FFFileUring *u)
+{
+    if (u->sqes)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ptr && u->cq_ptr != u->sq_ptr)
+        munmap(u->cq_ptr, u->cq_size);
+    if (u->sq_ptr)
+        munmap(u->sq_ptr, u->sq_size);
+    /* also unregisters the buffers */
+    if (u->ring_fd >= 0)
+        close(u->ring_fd);
+    if (u->mem)
+        munmap(u->mem, u->mem_size);
+    av_freep(&u->bufs);
+    av_free(u);
+}
+
+int ff_file_uring_init(FFFileUring **pu, void *logctx, int fd, int write,
+                       int depth, int block_size, int direct, int64_t pos)
+{
+    FFFileUring *u;
+    struct iovec *iov;
+    int ret;
+
+    u = av_mallocz(sizeof(*u));
+    if (!u)
+        return AVERROR(ENOMEM);
+    u->logctx     = logctx;
+    u->fd         = fd;
+    u->write      = write;
+    u->direct     = direct;
+    u->ring_fd    = -1;
+    u->cur        = -1;
+    u->nb_bufs    = depth;
+    u->block_size = FFALIGN(block_size, FF_FILE_URING_DIRECT_ALIGN);
+
+    ret = setup_ring(u, depth);
+    if (ret < 0)
+        goto fail;
+
+    u->bufs = av_calloc(depth, sizeof(*u->bufs));
+    if (!u->bufs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    /* page aligned, as required by O_DIRECT */
+    u->mem_size = (size_t)depth * u->block_size;
+    u->mem = mmap(NULL, u->mem_size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (u->mem == MAP_FAILED) {
+        u->mem = NULL;
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    iov = av_calloc(depth, sizeof(*iov));
+    if (!iov) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < depth; i++) {
+        u->bufs[i].data = u->mem + (size_t)i * u->block_size;
+        iov[i].iov_base = u->bufs[i].data;
+        iov[i].iov_len  = u->block_size;
+    }
+    /* registering may fail because of RLIMIT_MEMLOCK on older kernels */
+    u->fixed = syscall(__NR_io_uring_register, u->ring_fd,
+                       IORING_REGISTER_BUFFERS, iov, depth) >= 0;
+    if (!u->fixed)
+        av_log(logctx, AV_LOG_DEBUG, "Could not register io_uring buffers: %s\n",
+               av_err2str(AVERROR(errno)));
+    av_free(iov);
+
+    if (write)
+        u->pos = pos;
+    else
+        read_reset(u, pos);
+
+    *pu = u;
+    return 0;
+fail:
+    uring_free(u);
+    return ret;
+}
+
+int ff_file_uring_close(FFFileUring **pu)
+{
+    FFFileUring *u = *pu;
+    int ret;
+
+    if (!u)
+        return 0;
+
+    ret = u->write ? write_flush(u) : wait_all(u);
+    uring_free(u);
+    *pu = NULL;
+    return ret;
+}
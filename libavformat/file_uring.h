@@ -0,0 +1,74 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_FILE_URING_H
+#define AVFORMAT_FILE_URING_H
+
+#include <stdint.h>
+
+/**
+ * @file
+ * io_uring backend for the file protocol.
+ *
+ * Sequential reads are served from a ring of buffers that are read ahead
+ * with several requests in flight, sequential writes are gathered into
+ * buffers which are written in the background. The buffers are registered
+ * with the kernel when possible. The context is either used for reading or
+ * for writing, not both.
+ */
+
+/** Alignment of offsets and sizes required by O_DIRECT. */
+#define FF_FILE_URING_DIRECT_ALIGN 4096
+
+typedef struct FFFileUring FFFileUring;
+
+/**
+ * Set up an io_uring instance for fd.
+ *
+ * @param logctx     context used for logging
+ * @param write      nonzero for writing, zero for reading
+ * @param depth      number of buffers, i.e. maximum number of requests
+ *                   in flight
+ * @param block_size size of each buffer, rounded up to
+ *                   FF_FILE_URING_DIRECT_ALIGN
+ * @param direct     nonzero if fd was opened with O_DIRECT
+ * @param pos        current file offset
+ * @return 0 on success, a negative AVERROR code if io_uring is not usable,
+ *         in which case the caller should fall back to plain I/O
+ */
+int ff_file_uring_init(FFFileUring **pu, void *logctx, int fd, int write,
+                       int depth, int block_size, int direct, int64_t pos);
+
+int ff_file_uring_read(FFFileUring *u, uint8_t *buf, int size);
+
+int ff_file_uring_write(FFFileUring *u, const uint8_t *buf, int size);
+
+/**
+ * Same semantics as lseek(), whence may also be AVSEEK_SIZE. Pending writes
+ * are completed first.
+ */
+int64_t ff_file_uring_seek(FFFileUring *u, int64_t pos, int whence);
+
+/**
+ * Complete pending writes and free the context.
+ *
+ * @return 0 or the first write error that has not been reported yet
+ */
+int ff_file_uring_close(FFFileUring **pu);
+
+#endif /* AVFORMAT_FILE_URING_H */
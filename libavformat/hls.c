@@ -29,6 +29,8 @@
 
 #include "config_components.h"
 
+#include <stdatomic.h>
+
 #include "libavformat/http.h"
 #include "libavutil/aes.h"
 #include "libavutil/avstring.h"
@@ -38,6 +40,8 @@
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/fifo.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "demux.h"
@@ -49,8 +53,11 @@
 #include "hls_sample_encryption.h"
 
 #define INITIAL_BUFFER_SIZE 32768
+#define PREFETCH_READ_SIZE 65536
 
 #define MAX_FIELD_LEN 64
+/* idle persistent connections kept for the segments, keys and playlists */
+#define HTTP_POOL_SIZE 8
 #define MAX_CHARACTERISTICS_LEN 512
 
 #define MPEG_TIME_BASE 90000
@@ -87,6 +94,7 @@ struct segment {
 };
 
 struct rendition;
+struct prefetch;
 
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
@@ -104,9 +112,15 @@ struct playlist {
     FFIOContext pb;
     uint8_t* read_buffer;
     AVIOContext *input;
-    int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    /* background download the current segment is read from, instead of input */
+    struct prefetch *input_prefetch;
+    /* background downloads of the next segments, by sequence number */
+    struct prefetch **prefetch;
+    int n_prefetch;
+    /* segment whose background download failed, requested directly instead */
+    int64_t prefetch_skip_seq_no;
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -228,10 +242,522 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     int seg_max_retry;
-    AVIOContext *playlist_pb;
+    FFHTTPPool *http_pool;
     HLSCryptoContext  crypto_ctx;
+
+    int prefetch_segments;
+    int64_t prefetch_max_size;
+    struct prefetch_worker *prefetch_workers;
+    int n_prefetch_workers;
+    AVMutex prefetch_mutex;
+    AVCond prefetch_cond;
+    atomic_int prefetch_abort;
+    /* all the background downloads, in the order they were requested */
+    struct prefetch **prefetch_jobs;
+    int n_prefetch_jobs;
+    /* bytes downloaded and not read yet */
+    int64_t prefetch_buffered;
 } HLSContext;
 
+enum PrefetchState {
+    PREFETCH_QUEUED,
+    PREFETCH_ACTIVE,
+    PREFETCH_DONE,
+};
+
+/* background download of a segment or a playlist */
+struct prefetch {
+    char *url;
+    AVDictionary *opts;
+    int64_t seq_no;
+    int64_t url_offset;
+    /* url after redirections, set once the download has started */
+    char *location;
+    /* cookies of the connection after the response, to be used by the next
+     * requests; taken by the reader */
+    char *cookies;
+    AVFifo *fifo;
+    enum PrefetchState state;
+    int ret;
+    /* the reader is waiting for it, started first and regardless of
+     * prefetch_max_size */
+    int urgent;
+    /* not wanted anymore, freed by the thread downloading it */
+    int released;
+    struct prefetch_worker *owner;
+};
+
+#if HAVE_THREADS
+struct prefetch_worker {
+    HLSContext *c;
+    URLContext *conn;
+    AVIOInterruptCB int_cb;
+    /* set when the download in progress is released */
+    atomic_int cancel;
+    pthread_t thread;
+};
+
+static int prefetch_interrupt(void *opaque)
+{
+    struct prefetch_worker *w = opaque;
+
+    return atomic_load(&w->c->prefetch_abort) || atomic_load(&w->cancel) ||
+           ff_check_interrupt(w->c->interrupt_callback);
+}
+
+/* called with the mutex held */
+static void prefetch_free(HLSContext *c, struct prefetch *job)
+{
+    for (int i = 0; i < c->n_prefetch_jobs; i++) {
+        if (c->prefetch_jobs[i] == job) {
+            memmove(&c->prefetch_jobs[i], &c->prefetch_jobs[i + 1],
+                    (c->n_prefetch_jobs - i - 1) * sizeof(*c->prefetch_jobs));
+            c->n_prefetch_jobs--;
+            break;
+        }
+    }
+    c->prefetch_buffered -= av_fifo_can_read(job->fifo);
+    av_fifo_freep2(&job->fifo);
+    av_dict_free(&job->opts);
+    av_freep(&job->url);
+    av_freep(&job->location);
+    av_freep(&job->cookies);
+    av_free(job);
+}
+
+/* called with the mutex held */
+static struct prefetch *prefetch_next(HLSContext *c)
+{
+    struct prefetch *job = NULL;
+
+    for (int i = 0; i < c->n_prefetch_jobs; i++) {
+        struct prefetch *cur = c->prefetch_jobs[i];
+        if (cur->state != PREFETCH_QUEUED)
+            continue;
+        if (cur->urgent)
+            return cur;
+        if (!job)
+            job = cur;
+    }
+    /* the downloads ahead of the reader wait for the buffered data to be
+     * read; the ones in progress are completed */
+    if (c->prefetch_buffered >= c->prefetch_max_size)
+        return NULL;
+    return job;
+}
+
+#if CONFIG_HTTP_PROTOCOL
+static int is_same_host(const char *url1, const char *url2)
+{
+    char proto1[10], host1[1024], proto2[10], host2[1024];
+    int port1, port2;
+
+    av_url_split(proto1, sizeof(proto1), NULL, 0, host1, sizeof(host1), &port1,
+                 NULL, 0, url1);
+    av_url_split(proto2, sizeof(proto2), NULL, 0, host2, sizeof(host2), &port2,
+                 NULL, 0, url2);
+    return !strcmp(proto1, proto2) && !strcmp(host1, host2) && port1 == port2;
+}
+#endif
+
+static int prefetch_open(struct prefetch_worker *w, struct prefetch *job)
+{
+    AVFormatContext *s = w->c->ctx;
+    AVDictionary *opts = NULL;
+    int ret;
+
+#if CONFIG_HTTP_PROTOCOL
+    /* keep using the connection of the previous download, which is
+     * connected to the host of its final location after redirects */
+    if (w->conn) {
+        uint8_t *location = NULL;
+        int same_host = av_opt_get(w->conn, "location", AV_OPT_SEARCH_CHILDREN,
+                                   &location) >= 0 && location &&
+                        is_same_host(location, job->url);
+
+        av_free(location);
+        if (same_host) {
+            if ((ret = av_dict_copy(&opts, job->opts, 0)) >= 0)
+                ret = ff_http_do_new_request2(w->conn, job->url, &opts);
+            av_dict_free(&opts);
+            if (ret >= 0 || ret == AVERROR_EXIT)
+                return ret;
+        }
+    }
+#endif
+    ffurl_closep(&w->conn);
+
+    if ((ret = av_dict_copy(&opts, job->opts, 0)) >= 0)
+        ret = ff_http_pool_open_url(w->c->http_pool, &w->conn, job->url,
+                                    &w->int_cb, &opts, s->protocol_whitelist,
+                                    s->protocol_blacklist);
+    av_dict_free(&opts);
+    return ret;
+}
+
+static int prefetch_download(struct prefetch_worker *w, struct prefetch *job,
+                             uint8_t *buf)
+{
+    HLSContext *c = w->c;
+    char *location = NULL, *cookies = NULL;
+    int ret;
+
+    /* the end of the data is only the end of the segment once it was opened */
+    if ((ret = prefetch_open(w, job)) < 0)
+        return ret == AVERROR_EOF ? AVERROR(EIO) : ret;
+    av_opt_get(w->conn, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&location);
+    // update cookies on http response with setcookies.
+    av_opt_get(w->conn, "cookies", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&cookies);
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    job->location = location;
+    job->cookies  = cookies;
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    for (;;) {
+        int len = ffurl_read(w->conn, buf, PREFETCH_READ_SIZE);
+        if (!len || len == AVERROR_EOF) {
+            ret = 0;
+            break;
+        } else if (len < 0) {
+            ret = len;
+            break;
+        }
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        if (job->released)
+            ret = AVERROR_EXIT;
+        else if ((ret = av_fifo_write(job->fifo, buf, len)) >= 0)
+            c->prefetch_buffered += len;
+        ff_cond_broadcast(&c->prefetch_cond);
+        ff_mutex_unlock(&c->prefetch_mutex);
+        if (ret < 0)
+            break;
+    }
+
+    /* the rest of the response is still pending */
+    if (ret < 0)
+        ffurl_closep(&w->conn);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    struct prefetch_worker *w = arg;
+    HLSContext *c = w->c;
+    uint8_t *buf = av_malloc(PREFETCH_READ_SIZE);
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    while (!atomic_load(&c->prefetch_abort)) {
+        struct prefetch *job = prefetch_next(c);
+        int ret;
+
+        if (!job) {
+            ff_cond_wait(&c->prefetch_cond, &c->prefetch_mutex);
+            continue;
+        }
+        job->state = PREFETCH_ACTIVE;
+        job->owner = w;
+        atomic_store(&w->cancel, 0);
+        ff_mutex_unlock(&c->prefetch_mutex);
+
+        ret = buf ? prefetch_download(w, job, buf) : AVERROR(ENOMEM);
+        if (ret < 0 && ret != AVERROR_EXIT)
+            av_log(c->ctx, AV_LOG_WARNING, "Prefetching '%s' failed: %s\n",
+                   job->url, av_err2str(ret));
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        job->state = PREFETCH_DONE;
+        job->ret   = ret;
+        if (job->released)
+            prefetch_free(c, job);
+        ff_cond_broadcast(&c->prefetch_cond);
+    }
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    ffurl_closep(&w->conn);
+    av_free(buf);
+    return NULL;
+}
+
+static void prefetch_release(HLSContext *c, struct prefetch **pjob)
+{
+    struct prefetch *job = *pjob;
+
+    if (!job)
+        return;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    if (job->state == PREFETCH_ACTIVE) {
+        job->released = 1;
+        atomic_store(&job->owner->cancel, 1);
+    } else {
+        prefetch_free(c, job);
+    }
+    ff_cond_broadcast(&c->prefetch_cond);
+    ff_mutex_unlock(&c->prefetch_mutex);
+    *pjob = NULL;
+}
+
+static struct prefetch *prefetch_request(HLSContext *c, const char *url,
+                                         int64_t offset, int64_t size,
+                                         int urgent)
+{
+    struct prefetch *job = av_mallocz(sizeof(*job));
+    int ret;
+
+    if (!job)
+        return NULL;
+    job->url    = av_strdup(url);
+    job->fifo   = av_fifo_alloc2(PREFETCH_READ_SIZE, 1, AV_FIFO_FLAG_AUTO_GROW);
+    job->urgent = urgent;
+    ret = av_dict_copy(&job->opts, c->avio_opts, 0);
+    if (ret >= 0 && c->http_persistent)
+        ret = av_dict_set(&job->opts, "multiple_requests", "1", 0);
+    /* a reused connection keeps the range of its previous request otherwise */
+    if (ret >= 0)
+        ret = av_dict_set_int(&job->opts, "offset", size >= 0 ? offset : 0, 0);
+    if (ret >= 0)
+        ret = av_dict_set_int(&job->opts, "end_offset", size >= 0 ? offset + size : 0, 0);
+    if (ret < 0 || !job->url || !job->fifo) {
+        av_fifo_freep2(&job->fifo);
+        av_dict_free(&job->opts);
+        av_freep(&job->url);
+        av_free(job);
+        return NULL;
+    }
+    av_fifo_auto_grow_limit(job->fifo, SIZE_MAX);
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    ret = av_dynarray_add_nofree(&c->prefetch_jobs, &c->n_prefetch_jobs, job);
+    if (ret >= 0)
+        ff_cond_broadcast(&c->prefetch_cond);
+    else
+        prefetch_free(c, job);
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    return ret < 0 ? NULL : job;
+}
+
+/* called with the mutex held, by the reader once the download has started */
+static void prefetch_update_cookies(HLSContext *c, struct prefetch *job)
+{
+    if (job->cookies && !(c->ctx->flags & AVFMT_FLAG_CUSTOM_IO))
+        av_dict_set(&c->avio_opts, "cookies", job->cookies, AV_DICT_DONT_STRDUP_VAL);
+    else
+        av_free(job->cookies);
+    job->cookies = NULL;
+}
+
+/* called with the mutex held, after size bytes were read from a fifo */
+static void prefetch_drained(HLSContext *c, int64_t size)
+{
+    /* wake up the downloads waiting for memory */
+    if (c->prefetch_buffered >= c->prefetch_max_size &&
+        c->prefetch_buffered - size < c->prefetch_max_size)
+        ff_cond_broadcast(&c->prefetch_cond);
+    c->prefetch_buffered -= size;
+}
+
+static int prefetch_read(HLSContext *c, struct prefetch *job,
+                         uint8_t *buf, int buf_size)
+{
+    int ret;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    if (!job->urgent) {
+        job->urgent = 1;
+        ff_cond_broadcast(&c->prefetch_cond);
+    }
+    while (!av_fifo_can_read(job->fifo) && job->state != PREFETCH_DONE)
+        ff_cond_wait(&c->prefetch_cond, &c->prefetch_mutex);
+    prefetch_update_cookies(c, job);
+
+    ret = FFMIN(av_fifo_can_read(job->fifo), buf_size);
+    if (ret > 0) {
+        av_fifo_read(job->fifo, buf, ret);
+        prefetch_drained(c, ret);
+    } else if (!av_fifo_can_read(job->fifo)) {
+        ret = job->ret < 0 ? job->ret : AVERROR_EOF;
+    }
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    return ret;
+}
+
+static void prefetch_drop_playlist(HLSContext *c, struct playlist *pls)
+{
+    prefetch_release(c, &pls->input_prefetch);
+    for (int i = 0; i < pls->n_prefetch; i++)
+        prefetch_release(c, &pls->prefetch[i]);
+    av_freep(&pls->prefetch);
+    pls->n_prefetch = 0;
+}
+
+/*
+ * Request the segments of the prefetch window of the playlist and take the
+ * download of the current one, if any.
+ * Return 1 if the current segment is to be read from pls->input_prefetch.
+ */
+static int prefetch_open_segment(HLSContext *c, struct playlist *pls,
+                                 struct segment *seg)
+{
+    int64_t seq_no, last_seq_no;
+    int i, j;
+
+    if (!c->n_prefetch_workers)
+        return 0;
+
+    /* drop the downloads the reader went past */
+    for (i = j = 0; i < pls->n_prefetch; i++) {
+        if (pls->prefetch[i]->seq_no < pls->cur_seq_no)
+            prefetch_release(c, &pls->prefetch[i]);
+        else
+            pls->prefetch[j++] = pls->prefetch[i];
+    }
+    pls->n_prefetch = j;
+
+    /* the playlist was updated, and does not match the downloads anymore */
+    if (pls->n_prefetch && pls->prefetch[0]->seq_no == pls->cur_seq_no &&
+        (strcmp(pls->prefetch[0]->url, seg->url) ||
+         pls->prefetch[0]->url_offset != seg->url_offset))
+        prefetch_drop_playlist(c, pls);
+
+    seq_no = pls->n_prefetch ? pls->prefetch[pls->n_prefetch - 1]->seq_no + 1 :
+                               pls->cur_seq_no;
+    last_seq_no = FFMIN(pls->cur_seq_no + c->prefetch_segments,
+                        pls->start_seq_no + pls->n_segments - 1);
+    for (; seq_no <= last_seq_no; seq_no++) {
+        struct segment *s = pls->segments[seq_no - pls->start_seq_no];
+        struct prefetch *job;
+
+        /* open_input() loads the keys of encrypted segments */
+        if (s->key_type != KEY_NONE || !av_strstart(s->url, "http", NULL) ||
+            seq_no == pls->prefetch_skip_seq_no)
+            continue;
+
+        av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch of url '%s', offset %"PRId64", playlist %d\n",
+               s->url, s->url_offset, pls->index);
+        job = prefetch_request(c, s->url, s->url_offset, s->size,
+                               seq_no == pls->cur_seq_no);
+        if (!job)
+            break;
+        job->seq_no     = seq_no;
+        job->url_offset = s->url_offset;
+        if (av_dynarray_add_nofree(&pls->prefetch, &pls->n_prefetch, job) < 0) {
+            prefetch_release(c, &job);
+            break;
+        }
+    }
+
+    if (!pls->n_prefetch || pls->prefetch[0]->seq_no != pls->cur_seq_no)
+        return 0;
+
+    pls->input_prefetch = pls->prefetch[0];
+    memmove(&pls->prefetch[0], &pls->prefetch[1],
+            (pls->n_prefetch - 1) * sizeof(*pls->prefetch));
+    pls->n_prefetch--;
+    return 1;
+}
+
+static int prefetch_init(HLSContext *c)
+{
+    int ret;
+
+    if (!c->prefetch_segments)
+        return 0;
+
+    c->prefetch_workers = av_calloc(c->prefetch_segments, sizeof(*c->prefetch_workers));
+    if (!c->prefetch_workers)
+        return AVERROR(ENOMEM);
+    if ((ret = ff_mutex_init(&c->prefetch_mutex, NULL))) {
+        av_freep(&c->prefetch_workers);
+        return AVERROR(ret);
+    }
+    if ((ret = ff_cond_init(&c->prefetch_cond, NULL))) {
+        ff_mutex_destroy(&c->prefetch_mutex);
+        av_freep(&c->prefetch_workers);
+        return AVERROR(ret);
+    }
+    atomic_init(&c->prefetch_abort, 0);
+
+    for (int i = 0; i < c->prefetch_segments; i++) {
+        struct prefetch_worker *w = &c->prefetch_workers[i];
+        w->c      = c;
+        w->int_cb = (AVIOInterruptCB){ prefetch_interrupt, w };
+        atomic_init(&w->cancel, 0);
+        if ((ret = pthread_create(&w->thread, NULL, prefetch_thread, w))) {
+            ret = AVERROR(ret);
+            break;
+        }
+        c->n_prefetch_workers++;
+    }
+    if (!c->n_prefetch_workers) {
+        ff_cond_destroy(&c->prefetch_cond);
+        ff_mutex_destroy(&c->prefetch_mutex);
+        av_freep(&c->prefetch_workers);
+        return ret;
+    }
+
+    av_log(c->ctx, AV_LOG_VERBOSE, "Prefetching %d segments with %d threads\n",
+           c->prefetch_segments, c->n_prefetch_workers);
+    return 0;
+}
+
+static void prefetch_uninit(HLSContext *c)
+{
+    if (!c->prefetch_workers)
+        return;
+
+    ff_mutex_lock(&c->prefetch_mutex);
+    atomic_store(&c->prefetch_abort, 1);
+    ff_cond_broadcast(&c->prefetch_cond);
+    ff_mutex_unlock(&c->prefetch_mutex);
+
+    for (int i = 0; i < c->n_prefetch_workers; i++)
+        pthread_join(c->prefetch_workers[i].thread, NULL);
+
+    while (c->n_prefetch_jobs)
+        prefetch_free(c, c->prefetch_jobs[0]);
+    av_freep(&c->prefetch_jobs);
+    ff_cond_destroy(&c->prefetch_cond);
+    ff_mutex_destroy(&c->prefetch_mutex);
+    av_freep(&c->prefetch_workers);
+    c->n_prefetch_workers = 0;
+}
+#else
+static void prefetch_release(HLSContext *c, struct prefetch **pjob)
+{
+}
+
+static int prefetch_read(HLSContext *c, struct prefetch *job,
+                         uint8_t *buf, int buf_size)
+{
+    return AVERROR(ENOSYS);
+}
+
+static void prefetch_drop_playlist(HLSContext *c, struct playlist *pls)
+{
+}
+
+static int prefetch_open_segment(HLSContext *c, struct playlist *pls,
+                                 struct segment *seg)
+{
+    return 0;
+}
+
+static int prefetch_init(HLSContext *c)
+{
+    if (c->prefetch_segments)
+        av_log(c->ctx, AV_LOG_WARNING, "Prefetching requires threads, disabled\n");
+    return 0;
+}
+
+static void prefetch_uninit(HLSContext *c)
+{
+}
+#endif
+
 static void free_segment_dynarray(struct segment **segments, int n_segments)
 {
     int i;
@@ -277,9 +803,9 @@ static void free_playlist_list(HLSContext *c)
         av_packet_free(&pls->pkt);
         av_freep(&pls->pb.pub.buffer);
         ff_format_io_close(c->ctx, &pls->input);
-        pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
+        prefetch_drop_playlist(c, pls);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -329,6 +855,7 @@ static struct playlist *new_playlist(HLSContext *c, const char *url,
         return NULL;
     }
     pls->seek_timestamp = AV_NOPTS_VALUE;
+    pls->prefetch_skip_seq_no = -1;
 
     pls->is_id3_timestamped = -1;
     pls->id3_mpegts_timestamp = AV_NOPTS_VALUE;
@@ -626,24 +1153,6 @@ static int ensure_playlist(HLSContext *c, struct playlist **pls, const char *url
     return 0;
 }
 
-static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
-                              const char *url, AVDictionary **options)
-{
-#if !CONFIG_HTTP_PROTOCOL
-    return AVERROR_PROTOCOL_NOT_FOUND;
-#else
-    int ret;
-    URLContext *uc = ffio_geturlcontext(*pb);
-    av_assert0(uc);
-    (*pb)->eof_reached = 0;
-    ret = ff_http_do_new_request2(uc, url, options);
-    if (ret < 0) {
-        ff_format_io_close(s, pb);
-    }
-    return ret;
-#endif
-}
-
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
 {
@@ -695,23 +1204,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
 
-    if (is_http && c->http_persistent && *pb) {
-        ret = open_url_keepalive(c->ctx, pb, url, &tmp);
-        if (ret == AVERROR_EXIT) {
-            av_dict_free(&tmp);
-            return ret;
-        } else if (ret < 0) {
-            if (ret != AVERROR_EOF)
-                av_log(s, AV_LOG_WARNING,
-                    "keepalive request failed for '%s' with error: '%s' when opening url, retrying with new connection\n",
-                    url, av_err2str(ret));
-            av_dict_copy(&tmp, *opts, 0);
-            av_dict_copy(&tmp, opts2, 0);
-            ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
-        }
-    } else {
+    if (c->http_pool)
+        ret = ff_http_pool_open(c->http_pool, s, pb, url, &tmp);
+    else
         ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
-    }
     if (ret >= 0) {
         // update cookies on http response with setcookies.
         char *new_cookies = NULL;
@@ -742,48 +1238,30 @@ static int parse_playlist(HLSContext *c, const char *url,
     char key[MAX_URL_SIZE] = "";
     char line[MAX_URL_SIZE];
     const char *ptr;
-    int close_in = 0;
+    int release_in = 0;
     int64_t seg_offset = 0;
     int64_t seg_size = -1;
     uint8_t *new_url = NULL;
     struct variant_info variant_info;
     char tmp_str[MAX_URL_SIZE];
     struct segment *cur_init_section = NULL;
-    int is_http = av_strstart(url, "http", NULL);
     struct segment **prev_segments = NULL;
     int prev_n_segments = 0;
     int64_t prev_start_seq_no = -1;
 
-    if (is_http && !in && c->http_persistent && c->playlist_pb) {
-        in = c->playlist_pb;
-        ret = open_url_keepalive(c->ctx, &c->playlist_pb, url, NULL);
-        if (ret == AVERROR_EXIT) {
-            return ret;
-        } else if (ret < 0) {
-            if (ret != AVERROR_EOF)
-                av_log(c->ctx, AV_LOG_WARNING,
-                    "keepalive request failed for '%s' with error: '%s' when parsing playlist\n",
-                    url, av_err2str(ret));
-            in = NULL;
-        }
-    }
-
     if (!in) {
         AVDictionary *opts = NULL;
         av_dict_copy(&opts, c->avio_opts, 0);
 
-        if (c->http_persistent)
-            av_dict_set(&opts, "multiple_requests", "1", 0);
-
-        ret = c->ctx->io_open(c->ctx, &in, url, AVIO_FLAG_READ, &opts);
+        if (c->http_pool)
+            ret = ff_http_pool_open(c->http_pool, c->ctx, &in, url, &opts);
+        else
+            ret = c->ctx->io_open(c->ctx, &in, url, AVIO_FLAG_READ, &opts);
         av_dict_free(&opts);
         if (ret < 0)
             return ret;
 
-        if (is_http && c->http_persistent)
-            c->playlist_pb = in;
-        else
-            close_in = 1;
+        release_in = 1;
     }
 
     if (av_opt_get(in, "location", AV_OPT_SEARCH_CHILDREN, &new_url) >= 0)
@@ -1037,8 +1515,8 @@ static int parse_playlist(HLSContext *c, const char *url,
 
 fail:
     av_free(new_url);
-    if (close_in)
-        ff_format_io_close(c->ctx, &in);
+    if (release_in)
+        ff_http_pool_release(c->http_pool, c->ctx, &in);
     c->ctx->ctx_flags = c->ctx->ctx_flags & ~(unsigned)AVFMTCTX_UNSEEKABLE;
     if (!c->n_variants || !c->variants[0]->n_playlists ||
         !(c->variants[0]->playlists[0]->finished ||
@@ -1072,7 +1550,11 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->input_prefetch)
+        ret = prefetch_read(pls->parent->priv_data, pls->input_prefetch,
+                            buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1308,7 +1790,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
                     av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
                            seg->key);
                 }
-                ff_format_io_close(pls->parent, &pb);
+                ff_http_pool_release(c->http_pool, pls->parent, &pb);
             } else {
                 av_log(pls->parent, AV_LOG_ERROR, "Unable to open key file %s\n",
                        seg->key);
@@ -1404,7 +1886,7 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
 
     ret = read_from_url(pls, seg->init_section, pls->init_sec_buf,
                         pls->init_sec_buf_size);
-    ff_format_io_close(pls->parent, &pls->input);
+    ff_http_pool_release(c->http_pool, pls->parent, &pls->input);
 
     if (ret < 0)
         return ret;
@@ -1487,7 +1969,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if (!v->input && !v->input_prefetch) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1550,7 +2032,6 @@ reload:
             goto reload;
         }
 
-        v->input_read_done = 0;
         seg = current_segment(v);
 
         /* load/update Media Initialization Section, if any */
@@ -1558,7 +2039,10 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (prefetch_open_segment(c, v, seg)) {
+            v->cur_seg_offset = 0;
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1587,7 +2071,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1597,7 +2081,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !v->input_next_requested && !c->n_prefetch_workers &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1630,12 +2114,15 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
-        seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
-        v->input_read_done = 1;
-    } else {
-        ff_format_io_close(v->parent, &v->input);
+    if (v->input_prefetch && ret < 0 && ret != AVERROR_EOF &&
+        ret != AVERROR_EXIT && !v->cur_seg_offset) {
+        /* request the segment again, without prefetching it */
+        prefetch_release(c, &v->input_prefetch);
+        v->prefetch_skip_seq_no = v->cur_seq_no;
+        goto restart;
     }
+    ff_http_pool_release(c->http_pool, v->parent, &v->input);
+    prefetch_release(c, &v->input_prefetch);
     v->cur_seq_no++;
 
     c->cur_seq_no = v->cur_seq_no;
@@ -1910,11 +2397,55 @@ static void update_noheader_flag(AVFormatContext *s)
         s->ctx_flags &= ~AVFMTCTX_NOHEADER;
 }
 
+/* Parse a media playlist, from its background download if it was requested. */
+static int load_playlist(HLSContext *c, struct playlist *pls)
+{
+#if HAVE_THREADS
+    struct prefetch *job = pls->input_prefetch;
+
+    if (job) {
+        FFIOContext pb;
+        uint8_t *data = NULL;
+        size_t size;
+        int ret;
+
+        ff_mutex_lock(&c->prefetch_mutex);
+        while (job->state != PREFETCH_DONE)
+            ff_cond_wait(&c->prefetch_cond, &c->prefetch_mutex);
+        prefetch_update_cookies(c, job);
+        size = av_fifo_can_read(job->fifo);
+        ret  = job->ret;
+        if (ret >= 0 && size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+            ret = AVERROR_INVALIDDATA;
+        if (ret >= 0 && !(data = av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE)))
+            ret = AVERROR(ENOMEM);
+        if (ret >= 0) {
+            av_fifo_read(job->fifo, data, size);
+            prefetch_drained(c, size);
+        }
+        ff_mutex_unlock(&c->prefetch_mutex);
+
+        if (ret >= 0) {
+            ffio_init_read_context(&pb, data, size);
+            ret = parse_playlist(c, job->location ? job->location : pls->url,
+                                 pls, &pb.pub);
+        }
+        av_free(data);
+        prefetch_release(c, &pls->input_prefetch);
+        /* on failure, request it again */
+        if (ret >= 0 || ret == AVERROR_EXIT)
+            return ret;
+    }
+#endif
+    return parse_playlist(c, pls->url, pls, NULL);
+}
+
 static int hls_close(AVFormatContext *s)
 {
     HLSContext *c = s->priv_data;
 
     free_playlist_list(c);
+    prefetch_uninit(c);
     free_variant_list(c);
     free_rendition_list(c);
 
@@ -1922,7 +2453,7 @@ static int hls_close(AVFormatContext *s)
         av_free(c->crypto_ctx.aes_ctx);
 
     av_dict_free(&c->avio_opts);
-    ff_format_io_close(c->ctx, &c->playlist_pb);
+    ff_http_pool_free(&c->http_pool, c->ctx);
 
     return 0;
 }
@@ -1948,6 +2479,14 @@ static int hls_read_header(AVFormatContext *s)
        the range header */
     av_dict_set_int(&c->avio_opts, "seekable", c->http_seekable, 0);
 
+#if CONFIG_HTTP_PROTOCOL
+    if (c->http_persistent && !(c->http_pool = ff_http_pool_alloc(HTTP_POOL_SIZE)))
+        return AVERROR(ENOMEM);
+#endif
+
+    if ((ret = prefetch_init(c)) < 0)
+        return ret;
+
     if ((ret = parse_playlist(c, s->url, NULL, s->pb)) < 0)
         return ret;
 
@@ -1958,10 +2497,18 @@ static int hls_read_header(AVFormatContext *s)
     /* If the playlist only contained playlists (Master Playlist),
      * parse each individual playlist. */
     if (c->n_playlists > 1 || c->playlists[0]->n_segments == 0) {
+#if HAVE_THREADS
+        /* download all the playlists at once, they are parsed in order */
+        for (i = 0; c->n_prefetch_workers && i < c->n_playlists; i++) {
+            struct playlist *pls = c->playlists[i];
+            if (av_strstart(pls->url, "http", NULL))
+                pls->input_prefetch = prefetch_request(c, pls->url, 0, -1, 1);
+        }
+#endif
         for (i = 0; i < c->n_playlists; i++) {
             struct playlist *pls = c->playlists[i];
             pls->m3u8_hold_counters = 0;
-            if ((ret = parse_playlist(c, pls->url, pls, NULL)) < 0) {
+            if ((ret = load_playlist(c, pls)) < 0) {
                 av_log(s, AV_LOG_WARNING, "parse_playlist error %s [%s]\n", av_err2str(ret), pls->url);
                 pls->broken = 1;
                 if (c->n_playlists > 1)
@@ -2081,10 +2628,10 @@ static int hls_read_header(AVFormatContext *s)
             /* Reset reading */
             ff_format_io_close(pls->parent, &pls->input);
             pls->input = NULL;
-            pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next = NULL;
             pls->input_next_requested = 0;
+            prefetch_drop_playlist(c, pls);
             pls->cur_seg_offset = 0;
             pls->cur_init_section = NULL;
             /* Reset EOF flag */
@@ -2239,9 +2786,9 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
             ff_format_io_close(pls->parent, &pls->input);
-            pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
+            prefetch_drop_playlist(c, pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2495,9 +3042,9 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         struct playlist *pls = c->playlists[i];
         AVIOContext *const pb = &pls->pb.pub;
         ff_format_io_close(pls->parent, &pls->input);
-        pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
+        prefetch_drop_playlist(c, pls);
         av_packet_unref(pls->pkt);
         pb->eof_reached = 0;
         /* Clear any buffered data */
@@ -2590,6 +3137,10 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_segments", "Number of segments downloaded ahead in background threads, 0 = disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 32, FLAGS},
+    {"prefetch_max_size", "Maximum amount of prefetched data in bytes, before starting new downloads",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -36,9 +36,12 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 
 #include "avformat.h"
+#include "avio_internal.h"
 #include "http.h"
+#include "http_parallel.h"
 #include "httpauth.h"
 #include "internal.h"
 #include "network.h"
@@ -143,6 +146,10 @@ typedef struct HTTPContext {
     unsigned int retry_after;
     int reconnect_max_retries;
     int reconnect_delay_total_max;
+    int parallel_connections;
+    int parallel_min_chunk;
+    int parallel_max_chunk;
+    FFHTTPParallel *parallel;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -188,6 +195,9 @@ static const AVOption options[] = {
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "short_seek_size", "Threshold to favor readahead over seek.", OFFSET(short_seek_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "parallel_connections", "download seekable resources with byte range requests on several connections", OFFSET(parallel_connections), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, D },
+    { "parallel_min_chunk_size", "minimum size of the ranges requested in parallel", OFFSET(parallel_min_chunk), AV_OPT_TYPE_INT, { .i64 = 256 * 1024 }, 4096, INT_MAX / 2, D },
+    { "parallel_max_chunk_size", "maximum size of the ranges requested in parallel", OFFSET(parallel_max_chunk), AV_OPT_TYPE_INT, { .i64 = 8 * 1024 * 1024 }, 4096, INT_MAX / 2, D },
     { NULL }
 };
 
@@ -504,6 +514,12 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
         return AVERROR(EINVAL);
     }
 
+#if HAVE_THREADS
+    /* the previous resource may have been read on parallel connections,
+     * the new one is requested on s->hd */
+    ff_http_parallel_free(&s->parallel);
+#endif
+
     if (!s->end_chunked_post) {
         ret = http_shutdown(h, h->flags);
         if (ret < 0)
@@ -537,6 +553,372 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **opts)
     return ret;
 }
 
+struct FFHTTPPool {
+    AVMutex mutex;
+    /* idle connections, the least recently used first */
+    AVIOContext **idle;
+    char        **idle_origin;
+    int           nb_idle;
+    int           max_idle;
+    /* hex encoded TLS sessions, by origin */
+    AVDictionary *sessions;
+};
+
+static int pool_origin(char *buf, int size, const char *url)
+{
+    char proto[10], host[1024];
+    int port;
+
+    av_url_split(proto, sizeof(proto), NULL, 0, host, sizeof(host), &port,
+                 NULL, 0, url);
+    if (strcmp(proto, "http") && strcmp(proto, "https"))
+        return AVERROR(EINVAL);
+    if (port < 0)
+        port = strcmp(proto, "https") ? 80 : 443;
+    snprintf(buf, size, "%s://%s:%d", proto, host, port);
+    return 0;
+}
+
+static HTTPContext *pool_url_http_context(URLContext *uc)
+{
+    if (!uc || !uc->prot ||
+        (strcmp(uc->prot->name, "http") && strcmp(uc->prot->name, "https")))
+        return NULL;
+    return uc->priv_data;
+}
+
+static HTTPContext *pool_http_context(AVIOContext *pb)
+{
+    return pool_url_http_context(ffio_geturlcontext(pb));
+}
+
+/* called with the mutex held */
+static void pool_store_session(FFHTTPPool *pool, const char *origin,
+                               HTTPContext *s)
+{
+    uint8_t *data = NULL;
+
+    if (!s->hd || strcmp(s->hd->prot->name, "tls"))
+        return;
+    if (av_opt_get(s->hd, "tls_session", AV_OPT_SEARCH_CHILDREN, &data) >= 0 &&
+        data && *data)
+        av_dict_set(&pool->sessions, origin, data, AV_DICT_DONT_STRDUP_VAL);
+    else
+        av_free(data);
+}
+
+FFHTTPPool *ff_http_pool_alloc(int max_idle)
+{
+    FFHTTPPool *pool = av_mallocz(sizeof(*pool));
+
+    if (!pool)
+        return NULL;
+    pool->idle        = av_calloc(max_idle, sizeof(*pool->idle));
+    pool->idle_origin = av_calloc(max_idle, sizeof(*pool->idle_origin));
+    if (!pool->idle || !pool->idle_origin || ff_mutex_init(&pool->mutex, NULL)) {
+        av_freep(&pool->idle);
+        av_freep(&pool->idle_origin);
+        av_freep(&pool);
+        return NULL;
+    }
+    pool->max_idle = max_idle;
+    return pool;
+}
+
+void ff_http_pool_free(FFHTTPPool **ppool, AVFormatContext *s)
+{
+    FFHTTPPool *pool = *ppool;
+
+    if (!pool)
+        return;
+    for (int i = 0; i < pool->nb_idle; i++) {
+        ff_format_io_close(s, &pool->idle[i]);
+        av_freep(&pool->idle_origin[i]);
+    }
+    av_freep(&pool->idle);
+    av_freep(&pool->idle_origin);
+    av_dict_free(&pool->sessions);
+    ff_mutex_destroy(&pool->mutex);
+    av_freep(ppool);
+}
+
+int ff_http_pool_open(FFHTTPPool *pool, AVFormatContext *s, AVIOContext **pb,
+                      const char *url, AVDictionary **options)
+{
+    AVIOContext *idle = NULL;
+    AVDictionaryEntry *session;
+    char origin[MAX_URL_SIZE];
+    HTTPContext *hs;
+    int ret;
+
+    if (pool_origin(origin, sizeof(origin), url) < 0)
+        return s->io_open(s, pb, url, AVIO_FLAG_READ, options);
+
+    ff_mutex_lock(&pool->mutex);
+    for (int i = pool->nb_idle - 1; i >= 0; i--) {
+        if (!strcmp(pool->idle_origin[i], origin)) {
+            idle = pool->idle[i];
+            av_freep(&pool->idle_origin[i]);
+            memmove(&pool->idle[i], &pool->idle[i + 1],
+                    (pool->nb_idle - i - 1) * sizeof(*pool->idle));
+            memmove(&pool->idle_origin[i], &pool->idle_origin[i + 1],
+                    (pool->nb_idle - i - 1) * sizeof(*pool->idle_origin));
+            pool->nb_idle--;
+            break;
+        }
+    }
+    ff_mutex_unlock(&pool->mutex);
+
+    if (idle) {
+        /* the connection keeps the range of its last request otherwise */
+        av_dict_set(options, "offset", "0", AV_DICT_DONT_OVERWRITE);
+        av_dict_set(options, "end_offset", "0", AV_DICT_DONT_OVERWRITE);
+        ret = ff_http_do_new_request2(ffio_geturlcontext(idle), url, options);
+        if (ret >= 0) {
+            /* drop what is left of the previous response */
+            idle->buf_ptr     = idle->buf_end = idle->buffer;
+            idle->pos         = pool_http_context(idle)->off;
+            idle->eof_reached = 0;
+            idle->error       = 0;
+            *pb = idle;
+            return 0;
+        }
+        ff_format_io_close(s, &idle);
+        if (ret == AVERROR_EXIT)
+            return ret;
+        if (ret != AVERROR_EOF)
+            av_log(s, AV_LOG_VERBOSE, "Reusing the connection to %s failed: %s\n",
+                   origin, av_err2str(ret));
+    }
+
+    ff_mutex_lock(&pool->mutex);
+    session = av_dict_get(pool->sessions, origin, NULL, 0);
+    ret = session ? av_dict_set(options, "tls_session", session->value, 0) : 0;
+    ff_mutex_unlock(&pool->mutex);
+    if (ret < 0 ||
+        (ret = av_dict_set(options, "multiple_requests", "1", 0)) < 0)
+        return ret;
+
+    ret = s->io_open(s, pb, url, AVIO_FLAG_READ, options);
+    if (ret >= 0 && (hs = pool_http_context(*pb))) {
+        ff_mutex_lock(&pool->mutex);
+        pool_store_session(pool, origin, hs);
+        ff_mutex_unlock(&pool->mutex);
+    }
+    return ret;
+}
+
+int ff_http_pool_open_url(FFHTTPPool *pool, URLContext **puc, const char *url,
+                          const AVIOInterruptCB *int_cb, AVDictionary **options,
+                          const char *whitelist, const char *blacklist)
+{
+    AVDictionaryEntry *session;
+    char origin[MAX_URL_SIZE];
+    HTTPContext *hs;
+    int ret;
+
+    if (pool && pool_origin(origin, sizeof(origin), url) < 0)
+        pool = NULL;
+
+    if (pool) {
+        ff_mutex_lock(&pool->mutex);
+        session = av_dict_get(pool->sessions, origin, NULL, 0);
+        ret = session ? av_dict_set(options, "tls_session", session->value, 0) : 0;
+        ff_mutex_unlock(&pool->mutex);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = ffurl_open_whitelist(puc, url, AVIO_FLAG_READ, int_cb, options,
+                               whitelist, blacklist, NULL);
+    if (ret >= 0 && pool && (hs = pool_url_http_context(*puc))) {
+        ff_mutex_lock(&pool->mutex);
+        pool_store_session(pool, origin, hs);
+        ff_mutex_unlock(&pool->mutex);
+    }
+    return ret;
+}
+
+void ff_http_pool_release(FFHTTPPool *pool, AVFormatContext *s, AVIOContext **pb)
+{
+    AVIOContext *evicted = NULL;
+    HTTPContext *hs;
+    char origin[MAX_URL_SIZE], *key;
+    uint64_t end;
+
+    if (!*pb)
+        return;
+    if (!pool || !(hs = pool_http_context(*pb)) ||
+        pool_origin(origin, sizeof(origin), hs->location) < 0) {
+        ff_format_io_close(s, pb);
+        return;
+    }
+
+    ff_mutex_lock(&pool->mutex);
+    pool_store_session(pool, origin, hs);
+    ff_mutex_unlock(&pool->mutex);
+
+    /* only a connection whose response has been read completely can carry
+     * the next request */
+    end = hs->end_off ? hs->end_off : hs->filesize;
+    if (!hs->hd || hs->willclose || !hs->multiple_requests ||
+        (hs->chunksize != UINT64_MAX ? !hs->chunkend :
+                                       end == UINT64_MAX || hs->off < end) ||
+        !(key = av_strdup(origin))) {
+        ff_format_io_close(s, pb);
+        return;
+    }
+
+    ff_mutex_lock(&pool->mutex);
+    if (pool->nb_idle == pool->max_idle) {
+        evicted = pool->idle[0];
+        av_free(pool->idle_origin[0]);
+        memmove(&pool->idle[0], &pool->idle[1],
+                (pool->nb_idle - 1) * sizeof(*pool->idle));
+        memmove(&pool->idle_origin[0], &pool->idle_origin[1],
+                (pool->nb_idle - 1) * sizeof(*pool->idle_origin));
+        pool->nb_idle--;
+    }
+    pool->idle[pool->nb_idle]        = *pb;
+    pool->idle_origin[pool->nb_idle] = key;
+    pool->nb_idle++;
+    ff_mutex_unlock(&pool->mutex);
+
+    *pb = NULL;
+    ff_format_io_close(s, &evicted);
+}
+
+#if HAVE_THREADS
+/**
+ * Check that the response to a range request is the uncompressed range,
+ * ret is the result of the request. http_connect() already fails with
+ * AVERROR(EPERM) if the response does not start at the requested offset.
+ */
+static int http_parallel_check_range(URLContext *conn, uint64_t start, int ret)
+{
+    HTTPContext *c = conn->priv_data;
+
+    if (ret < 0 && ret != AVERROR(EPERM))
+        return ret;
+    if (c->http_code != 206 || c->off != start
+#if CONFIG_ZLIB
+        || c->compressed
+#endif
+        ) {
+        av_log(conn, AV_LOG_ERROR, "The server did not return the range "
+               "starting at %"PRIu64" (HTTP code %d)\n", start, c->http_code);
+        return AVERROR(ENOSYS);
+    }
+    return ret;
+}
+
+static int http_parallel_request(URLContext *h, URLContext **conn,
+                                 const AVIOInterruptCB *int_cb,
+                                 uint64_t start, uint64_t end)
+{
+    HTTPContext *s = h->priv_data, *c;
+    AVDictionary *options = NULL;
+    int ret;
+
+    /* send the request on the persistent connection of the last one */
+    if (*conn) {
+        c = (*conn)->priv_data;
+        if (c->hd && !c->willclose) {
+            c->off      = start;
+            c->end_off  = end;
+            c->chunkend = 0;
+            ret = http_open_cnx(*conn, &options);
+            av_dict_free(&options);
+            ret = http_parallel_check_range(*conn, start, ret);
+            if (ret >= 0 || ret == AVERROR(ENOSYS))
+                return ret;
+        }
+        ffurl_closep(conn);
+    }
+
+    ret = ffurl_alloc(conn, s->location, AVIO_FLAG_READ, int_cb);
+    if (ret < 0)
+        return ret;
+    c = (*conn)->priv_data;
+    if ((ret = av_opt_copy(c, s)) < 0)
+        goto fail;
+    av_freep(&c->location);
+    c->off                  = start;
+    c->end_off              = end;
+    c->seekable             = 1;
+    c->multiple_requests    = 1;
+    c->parallel_connections = 0;
+    ff_http_init_auth_state(*conn, h);
+    (*conn)->rw_timeout     = h->rw_timeout;
+
+    /* the lower protocol options, including the protocol whitelist */
+    if ((ret = av_dict_copy(&options, s->chained_options, 0)) < 0 ||
+        (ret = av_opt_set_dict(*conn, &options)) < 0)
+        goto fail;
+    ret = ffurl_connect(*conn, &options);
+    ret = http_parallel_check_range(*conn, start, ret);
+
+fail:
+    av_dict_free(&options);
+    if (ret < 0)
+        ffurl_closep(conn);
+    return ret;
+}
+
+static int http_parallel_start(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t size = s->filesize;
+    int ret;
+
+    if (s->end_off && s->end_off < size)
+        size = s->end_off;
+
+    /* the chunks are requested from the final location with the same
+     * protocol, with the same options as the initial request */
+    if (h->is_streamed || s->filesize == UINT64_MAX || s->post_data ||
+        (s->method && av_strcasecmp(s->method, "GET")) ||
+#if CONFIG_ZLIB
+        s->compressed ||
+#endif
+        s->icy_metaint ||
+        !av_strstart(s->location, h->prot->name, NULL) ||
+        s->location[strlen(h->prot->name)] != ':') {
+        av_log(h, AV_LOG_VERBOSE, "Not using parallel connections for this resource\n");
+        return 0;
+    }
+    if (size <= s->off + s->parallel_min_chunk)
+        return 0;
+
+    ret = ff_http_parallel_init(&s->parallel, h, http_parallel_request,
+                                s->parallel_connections, s->parallel_min_chunk,
+                                s->parallel_max_chunk, s->off, size);
+    if (ret < 0)
+        return ret;
+
+    /* the data is now only read from the parallel connections */
+    ffurl_closep(&s->hd);
+    return 0;
+}
+
+/* Continue on a single connection from the current position, once the server
+ * did not honour a range request of the parallel connections. */
+static int http_parallel_stop(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionary *options = NULL;
+    int ret;
+
+    av_log(h, AV_LOG_WARNING, "Reading on a single connection from %"PRIu64"\n",
+           s->off);
+    ff_http_parallel_free(&s->parallel);
+    s->buf_ptr = s->buf_end = s->buffer;
+    ret = http_open_cnx(h, &options);
+    av_dict_free(&options);
+    return ret;
+}
+#endif
+
 int ff_http_averror(int status_code, int default_averror)
 {
     switch (status_code) {
@@ -750,6 +1132,10 @@ static int http_open(URLContext *h, const char *uri, int flags,
         return http_listen(h, uri, flags, options);
     }
     ret = http_open_cnx(h, options);
+#if HAVE_THREADS
+    if (ret >= 0 && s->parallel_connections > 1 && !(flags & AVIO_FLAG_WRITE))
+        ret = http_parallel_start(h);
+#endif
 bail_out:
     if (ret < 0) {
         av_dict_free(&s->chained_options);
@@ -1865,6 +2251,19 @@ static int http_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
 
+#if HAVE_THREADS
+    if (s->parallel) {
+        int ret = ff_http_parallel_read(s->parallel, buf, size);
+        if (ret != AVERROR(ENOSYS)) {
+            if (ret > 0)
+                s->off += ret;
+            return ret;
+        }
+        if ((ret = http_parallel_stop(h)) < 0)
+            return ret;
+    }
+#endif
+
     if (s->icy_metaint > 0) {
         size = store_icy(h, size);
         if (size < 0)
@@ -1942,6 +2341,9 @@ static int http_close(URLContext *h)
     inflateEnd(&s->inflate_stream);
     av_freep(&s->inflate_buffer);
 #endif /* CONFIG_ZLIB */
+#if HAVE_THREADS
+    ff_http_parallel_free(&s->parallel);
+#endif
 
     if (s->hd && !s->end_chunked_post)
         /* Close the write direction by sending the end of chunked encoding. */
@@ -1988,6 +2390,11 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     if (s->off && h->is_streamed)
         return AVERROR(ENOSYS);
 
+#if HAVE_THREADS
+    if (s->parallel)
+        return ff_http_parallel_seek(s->parallel, s->off);
+#endif
+
     /* do not try to make a new connection if seeking past the end of the file */
     if (s->end_off || s->filesize != UINT64_MAX) {
         uint64_t end_pos = s->end_off ? s->end_off : s->filesize;
@@ -22,6 +22,10 @@
 #ifndef AVFORMAT_HTTP_H
 #define AVFORMAT_HTTP_H
 
+#include "config_components.h"
+
+#include "avformat.h"
+#include "internal.h"
 #include "url.h"
 
 #define HTTP_HEADERS_SIZE 4096
@@ -62,4 +66,95 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **optio
 
 int ff_http_averror(int status_code, int default_averror);
 
+typedef struct FFHTTPPool FFHTTPPool;
+
+#if CONFIG_HTTP_PROTOCOL
+/**
+ * Allocate a pool of persistent HTTP connections, used by demuxers which
+ * fetch many resources from the same hosts.
+ *
+ * Idle connections are kept per host (scheme, host and port) and reused for
+ * the next request to the same host. The TLS session of the last HTTPS
+ * connection to a host is resumed when a new connection to it is needed.
+ * The pool may be used from several threads.
+ *
+ * @param max_idle maximum number of idle connections, the least recently
+ *                 used ones are closed first
+ */
+FFHTTPPool *ff_http_pool_alloc(int max_idle);
+
+/**
+ * Close the idle connections and free the pool.
+ *
+ * @param s context the connections were opened with
+ */
+void ff_http_pool_free(FFHTTPPool **pool, AVFormatContext *s);
+
+/**
+ * Open url for reading, on an idle connection of the pool if there is one
+ * to the same host, or with s->io_open() otherwise. Other URLs than http
+ * and https ones are opened with s->io_open().
+ *
+ * @param options options for the request, see ff_http_do_new_request2()
+ */
+int ff_http_pool_open(FFHTTPPool *pool, AVFormatContext *s, AVIOContext **pb,
+                      const char *url, AVDictionary **options);
+
+/**
+ * Give a connection back to the pool once the response has been read. The
+ * connection is closed if the response has not been read completely or the
+ * connection cannot be reused. *pb is set to NULL.
+ *
+ * @param pool pool or NULL, in which case the connection is closed
+ */
+void ff_http_pool_release(FFHTTPPool *pool, AVFormatContext *s, AVIOContext **pb);
+
+/**
+ * Open url for reading on a new connection with ffurl_open_whitelist(),
+ * resuming the TLS session of the pool for its host, for the callers which
+ * need their own interrupt callback. The TLS session of the connection is
+ * stored back into the pool.
+ *
+ * @param pool pool or NULL, in which case url is only opened
+ */
+int ff_http_pool_open_url(FFHTTPPool *pool, URLContext **puc, const char *url,
+                          const AVIOInterruptCB *int_cb, AVDictionary **options,
+                          const char *whitelist, const char *blacklist);
+#else
+/* without the http protocol no pool is allocated, and the connections are
+ * opened and closed with the callbacks of the format context */
+static inline FFHTTPPool *ff_http_pool_alloc(int max_idle)
+{
+    return NULL;
+}
+
+static inline void ff_http_pool_free(FFHTTPPool **pool, AVFormatContext *s)
+{
+}
+
+static inline int ff_http_pool_open(FFHTTPPool *pool, AVFormatContext *s,
+                                    AVIOContext **pb, const char *url,
+                                    AVDictionary **options)
+{
+    return s->io_open(s, pb, url, AVIO_FLAG_READ, options);
+}
+
+static inline void ff_http_pool_release(FFHTTPPool *pool, AVFormatContext *s,
+                                        AVIOContext **pb)
+{
+    ff_format_io_close(s, pb);
+}
+
+static inline int ff_http_pool_open_url(FFHTTPPool *pool, URLContext **puc,
+                                        const char *url,
+                                        const AVIOInterruptCB *int_cb,
+                                        AVDictionary **options,
+                                        const char *whitelist,
+                                        const char *blacklist)
+{
+    return ffurl_open_whitelist(puc, url, AVIO_FLAG_READ, int_cb, options,
+                                whitelist, blacklist, NULL);
+}
+#endif
+
 #endif /* AVFORMAT_HTTP_H */
@@ -0,0 +1,421 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "avio.h"
+#include "http_parallel.h"
+#include "url.h"
+
+/* size of the reads from the connections, so that the reader can
+ * consume a chunk while it is being downloaded */
+#define READ_SIZE   (64 * 1024)
+#define MAX_RETRIES 3
+/* a chunk taking longer than this stalls the reader for too long */
+#define MAX_CHUNK_TIME 2000000
+
+enum ChunkState {
+    CHUNK_FREE,
+    CHUNK_QUEUED,   ///< waiting for a thread, new or to be retried
+    CHUNK_ACTIVE,   ///< being downloaded
+    CHUNK_DONE,
+    CHUNK_FAILED,
+};
+
+typedef struct Chunk {
+    uint8_t     *data;
+    unsigned int alloc;
+    uint64_t     start, end;
+    uint64_t     filled;    ///< number of bytes received
+    int          retries;
+    int          err;
+    /* not wanted anymore by the reader, freed by the thread which
+     * downloads it */
+    int          dropped;
+    int          owner;
+    enum ChunkState state;
+} Chunk;
+
+typedef struct Worker {
+    FFHTTPParallel *p;
+    URLContext     *conn;
+    AVIOInterruptCB int_cb;
+    /* set when the chunk being downloaded is dropped */
+    atomic_int      cancel;
+    pthread_t       thread;
+} Worker;
+
+struct FFHTTPParallel {
+    URLContext           *h;
+    FFHTTPParallelRequest request;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_reader;
+    pthread_cond_t  cond_worker;
+    atomic_int      abort;
+
+    Worker *workers;
+    int     nb_workers;
+    /* the chunks not free cover [pos, next) */
+    Chunk  *chunks;
+    int     nb_chunks;
+
+    uint64_t pos;
+    uint64_t next;
+    uint64_t size;
+    int      chunk_size, min_chunk, max_chunk;
+};
+
+static int worker_interrupt(void *opaque)
+{
+    Worker *w = opaque;
+
+    return atomic_load(&w->p->abort) || atomic_load(&w->cancel) ||
+           ff_check_interrupt(&w->p->h->interrupt_callback);
+}
+
+/* called with the mutex held */
+static Chunk *next_chunk(FFHTTPParallel *p)
+{
+    Chunk *c = NULL, *free_chunk = NULL;
+
+    for (int i = 0; i < p->nb_chunks; i++) {
+        Chunk *cur = &p->chunks[i];
+        if (cur->state == CHUNK_QUEUED && (!c || cur->start < c->start))
+            c = cur;
+        else if (cur->state == CHUNK_FREE && !free_chunk)
+            free_chunk = cur;
+    }
+    if (c || !free_chunk || p->next >= p->size)
+        return c;
+
+    c          = free_chunk;
+    c->start   = p->next;
+    c->end     = FFMIN(p->next + p->chunk_size, p->size);
+    c->filled  = 0;
+    c->retries = 0;
+    c->dropped = 0;
+    p->next    = c->end;
+    return c;
+}
+
+/* called with the mutex held */
+static void adapt_chunk_size(FFHTTPParallel *p, uint64_t bytes,
+                             int64_t latency, int64_t transfer)
+{
+    int size = p->chunk_size;
+
+    /* only the chunks of the current size tell something about it */
+    if (bytes < size / 2)
+        return;
+
+    /* the request round trip is a large part of the time spent on the
+     * chunk, larger chunks keep the connections busy for longer */
+    if (transfer < 4 * latency && size < p->max_chunk)
+        size = FFMIN((int64_t)size * 2, p->max_chunk);
+    else if (transfer > MAX_CHUNK_TIME && size > p->min_chunk)
+        size = FFMAX(size / 2, p->min_chunk);
+
+    if (size != p->chunk_size) {
+        av_log(p->h, AV_LOG_DEBUG, "Chunk size %d -> %d, latency %"PRId64" us, "
+               "transfer %"PRId64" us\n", p->chunk_size, size, latency, transfer);
+        p->chunk_size = size;
+    }
+}
+
+static void *worker_thread(void *arg)
+{
+    Worker *w = arg;
+    FFHTTPParallel *p = w->p;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!atomic_load(&p->abort)) {
+        Chunk *c = next_chunk(p);
+        uint64_t off, first;
+        int64_t t0, t1;
+        int ret = 0;
+
+        if (!c) {
+            pthread_cond_wait(&p->cond_worker, &p->mutex);
+            continue;
+        }
+        c->state = CHUNK_ACTIVE;
+        c->owner = w - p->workers;
+        atomic_store(&w->cancel, 0);
+        off = first = c->start + c->filled;
+        pthread_mutex_unlock(&p->mutex);
+
+        /* the reader does not touch the data of a chunk before some of it
+         * is received */
+        if (!c->filled) {
+            av_fast_malloc(&c->data, &c->alloc, c->end - c->start);
+            if (!c->data)
+                ret = AVERROR(ENOMEM);
+        }
+
+        t0 = av_gettime_relative();
+        if (ret >= 0)
+            ret = p->request(p->h, &w->conn, &w->int_cb, off, c->end);
+        t1 = av_gettime_relative();
+
+        while (ret >= 0 && off < c->end) {
+            int len = ffurl_read(w->conn, c->data + (off - c->start),
+                                 FFMIN(c->end - off, READ_SIZE));
+            if (len <= 0) {
+                ret = len ? len : AVERROR_EOF;
+                break;
+            }
+            off += len;
+
+            pthread_mutex_lock(&p->mutex);
+            c->filled += len;
+            pthread_cond_signal(&p->cond_reader);
+            pthread_mutex_unlock(&p->mutex);
+        }
+
+        /* the rest of the response is still pending */
+        if (off < c->end)
+            ffurl_closep(&w->conn);
+
+        pthread_mutex_lock(&p->mutex);
+        if (c->dropped) {
+            c->state   = CHUNK_FREE;
+            c->dropped = 0;
+            pthread_cond_broadcast(&p->cond_worker);
+        } else if (ret < 0 && off < c->end) {
+            if (ret != AVERROR_EXIT && ret != AVERROR(ENOMEM) &&
+                ret != AVERROR(ENOSYS) && c->retries++ < MAX_RETRIES) {
+                av_log(p->h, AV_LOG_WARNING, "Retrying range %"PRIu64"-%"PRIu64
+                       ": %s\n", off, c->end - 1, av_err2str(ret));
+                c->state = CHUNK_QUEUED;
+            } else {
+                c->state = CHUNK_FAILED;
+                c->err   = ret;
+            }
+        } else {
+            c->state = CHUNK_DONE;
+            adapt_chunk_size(p, off - first, t1 - t0, av_gettime_relative() - t1);
+        }
+        pthread_cond_signal(&p->cond_reader);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    ffurl_closep(&w->conn);
+    return NULL;
+}
+
+/* called with the mutex held */
+static void drop_chunk(FFHTTPParallel *p, Chunk *c)
+{
+    if (c->state == CHUNK_ACTIVE) {
+        c->dropped = 1;
+        if (c->start + c->filled < c->end)
+            atomic_store(&p->workers[c->owner].cancel, 1);
+    } else {
+        c->state = CHUNK_FREE;
+    }
+}
+
+static Chunk *find_chunk(FFHTTPParallel *p, uint64_t pos)
+{
+    for (int i = 0; i < p->nb_chunks; i++) {
+        Chunk *c = &p->chunks[i];
+        if (c->state != CHUNK_FREE && !c->dropped &&
+            c->start <= pos && pos < c->end)
+            return c;
+    }
+    return NULL;
+}
+
+int ff_http_parallel_read(FFHTTPParallel *p, uint8_t *buf, int size)
+{
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    for (;;) {
+        Chunk *c;
+        uint64_t avail;
+
+        if (p->pos >= p->size) {
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        c = find_chunk(p, p->pos);
+        if (!c) {
+            /* the chunk at the read position is not scheduled yet */
+            pthread_cond_signal(&p->cond_worker);
+            pthread_cond_wait(&p->cond_reader, &p->mutex);
+            continue;
+        }
+
+        avail = c->start + c->filled - p->pos;
+        if (avail) {
+            ret = FFMIN(avail, size);
+            memcpy(buf, c->data + (p->pos - c->start), ret);
+            p->pos += ret;
+            if (p->pos == c->end) {
+                drop_chunk(p, c);
+                pthread_cond_signal(&p->cond_worker);
+            }
+            break;
+        }
+
+        if (c->state == CHUNK_FAILED) {
+            /* try again on the next call */
+            ret        = c->err;
+            c->state   = CHUNK_QUEUED;
+            c->retries = 0;
+            pthread_cond_signal(&p->cond_worker);
+            break;
+        }
+
+        pthread_cond_wait(&p->cond_reader, &p->mutex);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+int64_t ff_http_parallel_seek(FFHTTPParallel *p, uint64_t pos)
+{
+    Chunk *cur;
+
+    pthread_mutex_lock(&p->mutex);
+    cur = find_chunk(p, pos);
+    for (int i = 0; i < p->nb_chunks; i++) {
+        Chunk *c = &p->chunks[i];
+        if (c->state != CHUNK_FREE && !c->dropped &&
+            (!cur || c->end <= pos))
+            drop_chunk(p, c);
+    }
+    if (!cur)
+        p->next = pos;
+    p->pos = pos;
+    pthread_cond_broadcast(&p->cond_worker);
+    pthread_mutex_unlock(&p->mutex);
+
+    return pos;
+}
+
+int ff_http_parallel_init(FFHTTPParallel **pp, URLContext *h,
+                          FFHTTPParallelRequest request, int nb_conns,
+                          int min_chunk, int max_chunk,
+                          uint64_t pos, uint64_t size)
+{
+    FFHTTPParallel *p;
+    int ret;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    p->h          = h;
+    p->request    = request;
+    p->pos        = pos;
+    p->next       = pos;
+    p->size       = size;
+    p->min_chunk  = min_chunk;
+    p->max_chunk  = FFMAX(max_chunk, min_chunk);
+    p->chunk_size = min_chunk;
+    atomic_init(&p->abort, 0);
+
+    /* one chunk being downloaded and one waiting per connection */
+    p->nb_chunks = 2 * nb_conns;
+    p->chunks    = av_calloc(p->nb_chunks, sizeof(*p->chunks));
+    p->workers   = av_calloc(nb_conns, sizeof(*p->workers));
+    if (!p->chunks || !p->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    if ((ret = pthread_mutex_init(&p->mutex, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&p->cond_reader, NULL))) {
+        pthread_mutex_destroy(&p->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&p->cond_worker, NULL))) {
+        pthread_cond_destroy(&p->cond_reader);
+        pthread_mutex_destroy(&p->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    for (int i = 0; i < nb_conns; i++) {
+        Worker *w = &p->workers[i];
+        w->p      = p;
+        w->int_cb = (AVIOInterruptCB){ worker_interrupt, w };
+        atomic_init(&w->cancel, 0);
+        if ((ret = pthread_create(&w->thread, NULL, worker_thread, w))) {
+            ret = AVERROR(ret);
+            break;
+        }
+        p->nb_workers++;
+    }
+    *pp = p;
+    if (!p->nb_workers) {
+        ff_http_parallel_free(pp);
+        return ret;
+    }
+
+    av_log(h, AV_LOG_VERBOSE, "Downloading with %d connections\n", p->nb_workers);
+    return 0;
+
+fail:
+    av_freep(&p->chunks);
+    av_freep(&p->workers);
+    av_freep(&p);
+    return ret;
+}
+
+void ff_http_parallel_free(FFHTTPParallel **pp)
+{
+    FFHTTPParallel *p = *pp;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    atomic_store(&p->abort, 1);
+    pthread_cond_broadcast(&p->cond_worker);
+    pthread_mutex_unlock(&p->mutex);
+
+    for (int i = 0; i < p->nb_workers; i++)
+        pthread_join(p->workers[i].thread, NULL);
+
+    for (int i = 0; i < p->nb_chunks; i++)
+        av_freep(&p->chunks[i].data);
+    pthread_cond_destroy(&p->cond_worker);
+    pthread_cond_destroy(&p->cond_reader);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&p->chunks);
+    av_freep(&p->workers);
+    av_freep(pp);
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HTTP_PARALLEL_H
+#define AVFORMAT_HTTP_PARALLEL_H
+
+#include <stdint.h>
+
+#include "url.h"
+
+/**
+ * @file
+ * Parallel range downloader for the HTTP protocol.
+ *
+ * The resource is split into chunks which are requested with byte ranges
+ * by several threads, each using its own persistent connection. The chunks
+ * are buffered until the reader consumes them in order, so that the data is
+ * returned as one ordered byte stream. The chunk size is adapted to the
+ * observed request latency and transfer time.
+ */
+
+typedef struct FFHTTPParallel FFHTTPParallel;
+
+/**
+ * Callback issuing the request for the byte range [start, end) of the
+ * resource.
+ *
+ * @param h     URL context passed to ff_http_parallel_init()
+ * @param conn  connection owned by the calling thread; if *conn is NULL or
+ *              cannot be reused, a new connection must be opened with
+ *              int_cb as interrupt callback and returned in *conn
+ * @return 0 once the response headers for the range have been read, so
+ *         that the data can be read from *conn, AVERROR(ENOSYS) if the
+ *         response is not the requested range, another negative AVERROR
+ *         code on failure
+ */
+typedef int (*FFHTTPParallelRequest)(URLContext *h, URLContext **conn,
+                                     const AVIOInterruptCB *int_cb,
+                                     uint64_t start, uint64_t end);
+
+/**
+ * Start the download threads.
+ *
+ * @param h          URL context of the resource, used for logging, as
+ *                   interrupt callback and passed to request
+ * @param nb_conns   number of connections, i.e. requests in flight
+ * @param min_chunk  minimum chunk size in bytes
+ * @param max_chunk  maximum chunk size in bytes
+ * @param pos        current read position
+ * @param size       size of the resource
+ */
+int ff_http_parallel_init(FFHTTPParallel **pp, URLContext *h,
+                          FFHTTPParallelRequest request, int nb_conns,
+                          int min_chunk, int max_chunk,
+                          uint64_t pos, uint64_t size);
+
+int ff_http_parallel_read(FFHTTPParallel *p, uint8_t *buf, int size);
+
+/**
+ * Move the read position. Chunks before the new position are dropped, the
+ * chunks after it are kept if they are in the current window.
+ */
+int64_t ff_http_parallel_seek(FFHTTPParallel *p, uint64_t pos);
+
+void ff_http_parallel_free(FFHTTPParallel **pp);
+
+#endif /* AVFORMAT_HTTP_PARALLEL_H */
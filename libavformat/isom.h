@@ -273,6 +273,15 @@ typedef struct MOVStreamContext {
     } cenc;
 
     struct IAMFDemuxContext *iamf;
+
+    /* sample index cache */
+    int64_t trak_pos;
+    struct MOVIndexCacheTrack *index_cache; ///< cached index matching this trak
+    int index_cache_invalid;
+    MOVAtom stsz_atom, stco_atom;
+    int64_t stsz_pos, stco_pos;
+    uint32_t stsz_crc, stco_crc;
+    int stsz_skipped, stco_skipped;         ///< table was not read, the cached index is used
 } MOVStreamContext;
 
 typedef struct HEIFItem {
@@ -367,6 +376,8 @@ typedef struct MOVContext {
     int thmb_item_id;
     int64_t idat_offset;
     int interleaved_read;
+    char *index_cache_path;
+    struct MOVIndexCache *index_cache;
 } MOVContext;
 
 int ff_mp4_read_descr_len(AVIOContext *pb);
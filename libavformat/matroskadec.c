@@ -1085,10 +1085,27 @@ static int ebml_read_ascii(AVIOContext *pb, int size,
  * 0 is success, < 0 or NEEDS_CHECKING is failure.
  */
 static int ebml_read_binary(AVIOContext *pb, int length,
-                            int64_t pos, EbmlBin *bin)
+                            int64_t pos, EbmlBin *bin, int ref)
 {
     int ret;
 
+    /* block data is not modified, reference it when possible */
+    if (ref) {
+        AVBufferRef *buf;
+
+        ret = ffio_read_ref(pb, length, &buf);
+        if (ret >= 0) {
+            av_buffer_unref(&bin->buf);
+            bin->buf  = buf;
+            bin->data = buf->data;
+            bin->size = length;
+            bin->pos  = pos;
+            return 0;
+        } else if (ret != AVERROR(ENOSYS)) {
+            return ret;
+        }
+    }
+
     ret = av_buffer_realloc(&bin->buf, length + AV_INPUT_BUFFER_PADDING_SIZE);
     if (ret < 0)
         return ret;
@@ -1486,7 +1503,8 @@ static int ebml_parse(MatroskaDemuxContext *matroska,
         res = ebml_read_ascii(pb, length, syntax->def.s, data);
         break;
     case EBML_BIN:
-        res = ebml_read_binary(pb, length, pos_alt, data);
+        res = ebml_read_binary(pb, length, pos_alt, data,
+                               id == MATROSKA_ID_SIMPLEBLOCK || id == MATROSKA_ID_BLOCK);
         break;
     case EBML_LEVEL1:
     case EBML_NEST:
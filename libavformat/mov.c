@@ -32,6 +32,7 @@
 #include "libavutil/attributes.h"
 #include "libavutil/bprint.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/crc.h"
 #include "libavutil/dict_internal.h"
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
@@ -68,6 +69,7 @@
 #include "libavcodec/get_bits.h"
 #include "id3v1.h"
 #include "mov_chan.h"
+#include "mov_index_cache.h"
 #include "replaygain.h"
 
 #if CONFIG_ZLIB
@@ -2551,6 +2553,7 @@ static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     AVStream *st;
     MOVStreamContext *sc;
     unsigned int i, entries;
+    int64_t pos;
 
     if (c->trak_index < 0) {
         av_log(c->fc, AV_LOG_WARNING, "STCO outside TRAK\n");
@@ -2560,6 +2563,7 @@ static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return 0;
     st = c->fc->streams[c->fc->nb_streams-1];
     sc = st->priv_data;
+    pos = avio_tell(pb);
 
     avio_r8(pb); /* version */
     avio_rb24(pb); /* flags */
@@ -2575,11 +2579,30 @@ static int mov_read_stco(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (!entries)
         return 0;
 
-    if (sc->chunk_offsets) {
+    if (sc->chunk_offsets || sc->stco_skipped) {
         av_log(c->fc, AV_LOG_WARNING, "Ignoring duplicated STCO atom\n");
         return 0;
     }
 
+    if (c->index_cache && !sc->stco_atom.type) {
+        const MOVIndexCacheTrack *t = sc->index_cache;
+
+        sc->stco_atom = atom;
+        sc->stco_pos  = pos;
+        /* an unchanged file has the same tables at the same place */
+        if (t && c->index_cache->unchanged && t->stco_pos == pos)
+            sc->stco_crc = t->stco_crc;
+        else if (ff_mov_index_cache_atom_crc(pb, atom.size - 8, &sc->stco_crc) < 0)
+            sc->index_cache_invalid = 1;
+        if (t && !sc->index_cache_invalid && t->stco_pos == pos &&
+            t->stco_crc == sc->stco_crc && t->chunk_count == entries) {
+            /* the offsets are only needed to build the index */
+            sc->chunk_count  = entries;
+            sc->stco_skipped = 1;
+            return 0;
+        }
+    }
+
     av_free(sc->chunk_offsets);
     sc->chunk_count = 0;
     sc->chunk_offsets = av_malloc_array(entries, sizeof(*sc->chunk_offsets));
@@ -3428,6 +3451,7 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     unsigned int i, entries, sample_size, field_size, num_bytes;
     GetBitContext gb;
     unsigned char* buf;
+    int64_t pos;
     int ret;
 
     if (c->trak_index < 0) {
@@ -3439,6 +3463,7 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return 0;
     st = c->fc->streams[c->fc->nb_streams-1];
     sc = st->priv_data;
+    pos = avio_tell(pb);
 
     avio_r8(pb); /* version */
     avio_rb24(pb); /* flags */
@@ -3471,8 +3496,32 @@ static int mov_read_stsz(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         return 0;
     if (entries >= (INT_MAX - 4 - 8 * AV_INPUT_BUFFER_PADDING_SIZE) / field_size)
         return AVERROR_INVALIDDATA;
-    if (sc->sample_sizes)
+
+    if (c->index_cache && !sc->stsz_atom.type) {
+        const MOVIndexCacheTrack *t = sc->index_cache;
+
+        sc->stsz_atom = atom;
+        sc->stsz_pos  = pos;
+        if (t && c->index_cache->unchanged && t->stsz_pos == pos)
+            sc->stsz_crc = t->stsz_crc;
+        else if (ff_mov_index_cache_atom_crc(pb, atom.size - (avio_tell(pb) - pos),
+                                             &sc->stsz_crc) < 0)
+            sc->index_cache_invalid = 1;
+        if (t && !sc->index_cache_invalid && t->stsz_pos == pos &&
+            t->stsz_crc == sc->stsz_crc && t->sample_count == entries) {
+            /* the sizes are only needed to build the index */
+            sc->data_size   += t->data_size;
+            sc->stsz_skipped = 1;
+            return 0;
+        }
+    } else if (sc->stsz_atom.type && sc->stsz_pos != pos) {
+        /* the cached index is built from a single table */
+        sc->index_cache_invalid = 1;
+    }
+
+    if (sc->sample_sizes || sc->stsz_skipped)
         av_log(c->fc, AV_LOG_WARNING, "Duplicated STSZ atom\n");
+    sc->stsz_skipped = 0;
     av_free(sc->sample_sizes);
     sc->sample_count = 0;
     sc->sample_sizes = av_malloc_array(entries, sizeof(*sc->sample_sizes));
@@ -4579,6 +4628,151 @@ static int build_open_gop_key_points(AVStream *st)
     return 0;
 }
 
+/**
+ * Read the stsz and stco atoms of a track that were skipped because the
+ * cached index was expected to be used.
+ */
+static int mov_index_cache_reload(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    const MOVIndexCacheTrack *t = sc->index_cache;
+    AVIOContext *pb = mov->fc->pb;
+    int trak_index = mov->trak_index;
+    int64_t pos;
+    int ret = 0;
+
+    sc->index_cache = NULL;
+    if (!sc->stsz_skipped && !sc->stco_skipped)
+        return 0;
+
+    pos = avio_tell(pb);
+    mov->trak_index = st->index;
+    if (sc->stsz_skipped) {
+        sc->stsz_skipped = 0;
+        sc->data_size   -= t->data_size;
+        ret = avio_seek(pb, sc->stsz_pos, SEEK_SET) < 0 ? AVERROR(EIO) :
+              mov_read_stsz(mov, pb, sc->stsz_atom);
+    }
+    if (ret >= 0 && sc->stco_skipped) {
+        sc->stco_skipped = 0;
+        ret = avio_seek(pb, sc->stco_pos, SEEK_SET) < 0 ? AVERROR(EIO) :
+              mov_read_stco(mov, pb, sc->stco_atom);
+    }
+    mov->trak_index = trak_index;
+
+    if (avio_seek(pb, pos, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    if (ret < 0)
+        av_log(mov->fc, AV_LOG_ERROR, "stream %d, error reading sample tables\n",
+               st->index);
+    return ret;
+}
+
+/* Checksum of everything besides stsz and stco the index is built from. */
+static uint32_t mov_index_cache_tables_crc(AVStream *st, int64_t current_dts)
+{
+    const MOVStreamContext *sc = st->priv_data;
+    const AVCRC *table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    uint8_t buf[36];
+    uint32_t crc;
+
+    AV_WL32(buf,      st->codecpar->codec_type);
+    AV_WL32(buf +  4, sc->sample_size);
+    AV_WL32(buf +  8, sc->stsz_sample_size);
+    AV_WL32(buf + 12, sc->sample_count);
+    AV_WL32(buf + 16, sc->chunk_count);
+    AV_WL32(buf + 20, sc->keyframe_absent);
+    AV_WL32(buf + 24, sc->pseudo_stream_id);
+    AV_WL64(buf + 28, current_dts);
+    crc = av_crc(table, UINT32_MAX, buf, sizeof(buf));
+
+#define CRC_TABLE(data, count)                                                   \
+    do {                                                                         \
+        AV_WL32(buf, count);                                                     \
+        crc = av_crc(table, crc, buf, 4);                                        \
+        if (data)                                                                \
+            crc = av_crc(table, crc, (const uint8_t *)data, count * sizeof(*data)); \
+    } while (0)
+    CRC_TABLE(sc->stsc_data, sc->stsc_count);
+    CRC_TABLE(sc->stts_data, sc->stts_count);
+    CRC_TABLE(sc->keyframes, sc->keyframe_count);
+    CRC_TABLE(sc->stps_data, sc->stps_count);
+    CRC_TABLE(sc->rap_group, sc->rap_group_count);
+#undef CRC_TABLE
+
+    return crc;
+}
+
+/**
+ * Fill the index from the cache if it matches the sample tables, otherwise
+ * make sure that all tables needed to build it have been read.
+ *
+ * @return 1 if the index was restored, 0 if it has to be built,
+ *         a negative error code on failure
+ */
+static int mov_index_cache_restore(MOVContext *mov, AVStream *st, int64_t current_dts,
+                                   uint32_t *tables_crc, uint64_t *stream_size)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    MOVIndexCacheTrack *t = sc->index_cache;
+
+    if (!mov->index_cache || sc->index_cache_invalid)
+        return mov_index_cache_reload(mov, st);
+
+    *tables_crc = mov_index_cache_tables_crc(st, current_dts);
+    if (!t || t->tables_crc != *tables_crc ||
+        t->stsz_pos     != sc->stsz_pos     || t->stsz_crc    != sc->stsz_crc ||
+        t->stco_pos     != sc->stco_pos     || t->stco_crc    != sc->stco_crc ||
+        t->sample_count != sc->sample_count || t->chunk_count != sc->chunk_count ||
+        t->nb_entries   >  sc->sample_count ||
+        ff_mov_index_cache_decode(t, sti->index_entries) < 0)
+        return mov_index_cache_reload(mov, st);
+
+    sti->nb_index_entries = t->nb_entries;
+    sc->stsz_sample_size  = t->stsz_sample_size;
+    *stream_size          = t->stream_size;
+    t->used               = 1;
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (int i = 0; i < FFMIN(sti->nb_index_entries, 99); i++)
+            ff_rfps_add_frame(mov->fc, st, sti->index_entries[i].timestamp);
+
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d, %d index entries restored from cache\n",
+           st->index, sti->nb_index_entries);
+    return 1;
+}
+
+static void mov_index_cache_store(MOVContext *mov, AVStream *st,
+                                  uint32_t tables_crc, uint64_t stream_size)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    MOVIndexCacheTrack t = {
+        .trak_pos         = sc->trak_pos,
+        .stsz_pos         = sc->stsz_pos,
+        .stco_pos         = sc->stco_pos,
+        .stsz_crc         = sc->stsz_crc,
+        .stco_crc         = sc->stco_crc,
+        .sample_count     = sc->sample_count,
+        .chunk_count      = sc->chunk_count,
+        .stsz_sample_size = sc->stsz_sample_size,
+        .data_size        = sc->data_size,
+        .tables_crc       = tables_crc,
+        .stream_size      = stream_size,
+        .nb_entries       = sti->nb_index_entries,
+    };
+    int ret;
+
+    if (!mov->index_cache || sc->index_cache_invalid)
+        return;
+
+    ret = ff_mov_index_cache_add(mov->index_cache, &t, sti->index_entries);
+    if (ret < 0)
+        av_log(mov->fc, AV_LOG_WARNING, "stream %d, could not add index to cache: %s\n",
+               st->index, av_err2str(ret));
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -4657,6 +4851,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         unsigned int rap_group_sample = 0;
         int rap_group_present = sc->rap_group_count && sc->rap_group;
         int key_off = (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+        uint32_t tables_crc = 0;
+        int restored;
 
         current_dts -= sc->dts_shift;
 
@@ -4697,7 +4893,11 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
             av_free(ctts_data_old);
         }
 
-        for (i = 0; i < sc->chunk_count; i++) {
+        restored = mov_index_cache_restore(mov, st, current_dts, &tables_crc, &stream_size);
+        if (restored < 0)
+            return;
+
+        for (i = 0; !restored && i < sc->chunk_count; i++) {
             int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
             current_offset = sc->chunk_offsets[i];
             while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
@@ -4787,6 +4987,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                 }
             }
         }
+        if (!restored)
+            mov_index_cache_store(mov, st, tables_crc, stream_size);
         if (st->duration > 0)
             st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
     } else {
@@ -4794,6 +4996,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
         if (!sc->chunk_count)
             return;
+        if (mov_index_cache_reload(mov, st) < 0)
+            return;
 
         // compute total chunk count
         for (i = 0; i < sc->stsc_count; i++) {
@@ -5083,6 +5287,9 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc->tref_flags = 0;
     sc->tref_id = -1;
     sc->refcount = 1;
+    sc->trak_pos = avio_tell(pb);
+    if (c->index_cache)
+        sc->index_cache = ff_mov_index_cache_find(c->index_cache, sc->trak_pos);
 
     if ((ret = mov_read_default(c, pb, atom)) < 0)
         return ret;
@@ -5219,6 +5426,7 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     av_freep(&sc->rap_group);
     av_freep(&sc->sync_group);
     av_freep(&sc->sgpd_sync);
+    sc->index_cache = NULL;
 
     return 0;
 }
@@ -9811,6 +10019,10 @@ static int mov_read_close(AVFormatContext *s)
     }
     av_freep(&mov->heif_grid);
 
+    if (mov->index_cache)
+        ff_mov_index_cache_free(mov->index_cache);
+    av_freep(&mov->index_cache);
+
     return 0;
 }
 
@@ -10375,6 +10587,62 @@ static int mov_parse_lcevc_streams(AVFormatContext *s)
     return 0;
 }
 
+static int mov_read_index_cache(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+        av_log(s, AV_LOG_WARNING, "Index cache needs seekable input, ignoring it\n");
+        return 0;
+    }
+
+    mov->index_cache = av_mallocz(sizeof(*mov->index_cache));
+    if (!mov->index_cache)
+        return AVERROR(ENOMEM);
+    mov->index_cache->file_size  = avio_size(s->pb);
+    mov->index_cache->file_mtime = ff_mov_index_cache_file_mtime(s);
+
+    /* the cache is created after the first open */
+    if (s->io_open(s, &pb, mov->index_cache_path, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+
+    ret = ff_mov_index_cache_read(mov->index_cache, pb, s);
+    ff_format_io_close(s, &pb);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "Ignoring invalid index cache %s\n",
+               mov->index_cache_path);
+        ff_mov_index_cache_free(mov->index_cache);
+    }
+
+    return 0;
+}
+
+static void mov_write_index_cache(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if (!mov->index_cache)
+        return;
+
+    if (mov->index_cache->updated) {
+        ret = s->io_open(s, &pb, mov->index_cache_path, AVIO_FLAG_WRITE, NULL);
+        if (ret >= 0) {
+            ret = ff_mov_index_cache_write(mov->index_cache, pb);
+            ff_format_io_close(s, &pb);
+        }
+        if (ret < 0)
+            av_log(s, AV_LOG_WARNING, "Could not write index cache %s: %s\n",
+                   mov->index_cache_path, av_err2str(ret));
+    }
+
+    ff_mov_index_cache_free(mov->index_cache);
+    av_freep(&mov->index_cache);
+}
+
 static int mov_read_header(AVFormatContext *s)
 {
     MOVContext *mov = s->priv_data;
@@ -10394,6 +10662,13 @@ static int mov_read_header(AVFormatContext *s)
     mov->thmb_item_id = -1;
     mov->primary_item_id = -1;
     mov->cur_item_id = -1;
+
+    if (mov->index_cache_path) {
+        err = mov_read_index_cache(s);
+        if (err < 0)
+            return err;
+    }
+
     /* .mov and .mp4 aren't streamable anyway (only progressive download if moov is before mdat) */
     if (pb->seekable & AVIO_SEEKABLE_NORMAL)
         atom.size = avio_size(pb);
@@ -10416,6 +10691,9 @@ static int mov_read_header(AVFormatContext *s)
     }
     av_log(mov->fc, AV_LOG_TRACE, "on_parse_exit_offset=%"PRId64"\n", avio_tell(pb));
 
+    /* all sample tables have been read */
+    mov_write_index_cache(s);
+
     if (mov->found_iloc && mov->found_iinf) {
         err = mov_parse_heif_items(s);
         if (err < 0)
@@ -10874,8 +11152,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
                 return FFERROR_REDO;
         }
 #endif
-        else
+        else if (mov->aax_mode || mov->decryption_key)
+            /* decrypted in place */
             ret = av_get_packet(sc->pb, pkt, sample->size);
+        else
+            ret = ff_get_packet_ref(sc->pb, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
@@ -11186,6 +11467,7 @@ static const AVOption mov_options[] = {
         {.i64 = 0}, 0, 1, FLAGS },
     { "max_stts_delta", "treat offsets above this value as invalid", OFFSET(max_stts_delta), AV_OPT_TYPE_INT, {.i64 = UINT_MAX-48000*10 }, 0, UINT_MAX, .flags = AV_OPT_FLAG_DECODING_PARAM },
     { "interleaved_read", "Interleave packets from multiple tracks at demuxer level", OFFSET(interleaved_read), AV_OPT_TYPE_BOOL, {.i64 = 1 }, 0, 1, .flags = AV_OPT_FLAG_DECODING_PARAM },
+    { "index_cache", "File to cache the sample index in", OFFSET(index_cache_path), AV_OPT_TYPE_STRING, .flags = AV_OPT_FLAG_DECODING_PARAM },
 
     { NULL },
 };
@@ -0,0 +1,394 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Persistent cache of the sample index of mov/mp4 tracks
+ */
+
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#include <string.h>
+#include <sys/stat.h>
+
+#include "config.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavcodec/bytestream.h"
+
+#include "avio_internal.h"
+#include "mov_index_cache.h"
+#include "os_support.h"
+
+#define CACHE_MAGIC    "FFMOVIDX"
+#define CACHE_VERSION  3
+#define MAX_TRACKS     4096
+#define CRC_BLOCK_SIZE 16384
+
+enum {
+    ARRAY_SIZE,     ///< sample size
+    ARRAY_POS,      ///< position relative to the end of the previous sample
+    ARRAY_TS,       ///< timestamp relative to the previous sample
+    ARRAY_FLAGS,    ///< flags and min_distance relative to the expected value
+};
+
+static inline uint64_t zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static int varint_len(uint64_t v)
+{
+    int len = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        len++;
+    }
+    return len;
+}
+
+static void put_varint(PutByteContext *pb, uint64_t v)
+{
+    while (v >= 0x80) {
+        bytestream2_put_byteu(pb, (v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    bytestream2_put_byteu(pb, v);
+}
+
+static int get_varint(GetByteContext *gb, uint64_t *v)
+{
+    uint64_t val = 0;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        int b;
+        if (bytestream2_get_bytes_left(gb) < 1)
+            return AVERROR_INVALIDDATA;
+        b    = bytestream2_get_byteu(gb);
+        val |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = val;
+            return 0;
+        }
+    }
+    return AVERROR_INVALIDDATA;
+}
+
+/* Compute the values stored in the arrays for one entry. */
+static void entry_values(uint64_t v[MOV_INDEX_CACHE_NB_ARRAYS],
+                         const AVIndexEntry *e, const AVIndexEntry *prev)
+{
+    int64_t  next_pos = prev ? prev->pos + prev->size : 0;
+    int64_t  last_ts  = prev ? prev->timestamp        : 0;
+    int expected_dist = (e->flags & AVINDEX_KEYFRAME) ? 0 :
+                        prev ? prev->min_distance + 1 : 0;
+
+    v[ARRAY_SIZE]  = e->size;
+    v[ARRAY_POS]   = zigzag(e->pos - next_pos);
+    v[ARRAY_TS]    = zigzag(e->timestamp - (uint64_t)last_ts);
+    v[ARRAY_FLAGS] = zigzag(e->min_distance - (int64_t)expected_dist) << 2 |
+                     (e->flags & 3);
+}
+
+int ff_mov_index_cache_add(MOVIndexCache *c, const MOVIndexCacheTrack *t,
+                           const AVIndexEntry *entries)
+{
+    MOVIndexCacheTrack *dst = ff_mov_index_cache_find(c, t->trak_pos);
+    uint64_t sizes[MOV_INDEX_CACHE_NB_ARRAYS] = { 0 };
+    uint64_t total = 0;
+    PutByteContext pb;
+    uint8_t *data;
+
+    for (uint32_t i = 0; i < t->nb_entries; i++) {
+        uint64_t v[MOV_INDEX_CACHE_NB_ARRAYS];
+        entry_values(v, &entries[i], i ? &entries[i - 1] : NULL);
+        for (int j = 0; j < MOV_INDEX_CACHE_NB_ARRAYS; j++)
+            sizes[j] += varint_len(v[j]);
+    }
+    for (int j = 0; j < MOV_INDEX_CACHE_NB_ARRAYS; j++)
+        total += sizes[j];
+    if (total > INT_MAX)
+        return AVERROR(ERANGE);
+
+    data = av_malloc(total + 1);
+    if (!data)
+        return AVERROR(ENOMEM);
+
+    if (!dst) {
+        if (c->nb_tracks >= MAX_TRACKS) {
+            av_free(data);
+            return AVERROR(ERANGE);
+        }
+        dst = av_realloc_array(c->tracks, c->nb_tracks + 1, sizeof(*c->tracks));
+        if (!dst) {
+            av_free(data);
+            return AVERROR(ENOMEM);
+        }
+        c->tracks = dst;
+        dst = &c->tracks[c->nb_tracks++];
+    } else {
+        av_free(dst->data);
+    }
+
+    *dst      = *t;
+    dst->data = data;
+    dst->used = 1;
+
+    for (int j = 0; j < MOV_INDEX_CACHE_NB_ARRAYS; j++) {
+        dst->array_size[j] = sizes[j];
+        bytestream2_init_writer(&pb, data, sizes[j]);
+        for (uint32_t i = 0; i < t->nb_entries; i++) {
+            uint64_t v[MOV_INDEX_CACHE_NB_ARRAYS];
+            entry_values(v, &entries[i], i ? &entries[i - 1] : NULL);
+            put_varint(&pb, v[j]);
+        }
+        data += sizes[j];
+    }
+
+    c->updated = 1;
+    return 0;
+}
+
+int ff_mov_index_cache_decode(const MOVIndexCacheTrack *t, AVIndexEntry *entries)
+{
+    GetByteContext gb[MOV_INDEX_CACHE_NB_ARRAYS];
+    const uint8_t *data = t->data;
+
+    for (int j = 0; j < MOV_INDEX_CACHE_NB_ARRAYS; j++) {
+        bytestream2_init(&gb[j], data, t->array_size[j]);
+        data += t->array_size[j];
+    }
+
+    for (uint32_t i = 0; i < t->nb_entries; i++) {
+        const AVIndexEntry *prev = i ? &entries[i - 1] : NULL;
+        AVIndexEntry *e = &entries[i];
+        uint64_t v[MOV_INDEX_CACHE_NB_ARRAYS];
+        int64_t dist;
+
+        for (int j = 0; j < MOV_INDEX_CACHE_NB_ARRAYS; j++)
+            if (get_varint(&gb[j], &v[j]) < 0)
+                return AVERROR_INVALIDDATA;
+
+        if (v[ARRAY_SIZE] > 0x3FFFFFFF)
+            return AVERROR_INVALIDDATA;
+        e->size      = v[ARRAY_SIZE];
+        e->pos       = (prev ? prev->pos + (uint64_t)prev->size : 0) +
+                       (uint64_t)unzigzag(v[ARRAY_POS]);
+        e->timestamp = (prev ? prev->timestamp : 0) +
+                       (uint64_t)unzigzag(v[ARRAY_TS]);
+        e->flags     = v[ARRAY_FLAGS] & 3;
+
+        dist = (e->flags & AVINDEX_KEYFRAME) ? 0 :
+               prev ? prev->min_distance + 1 : 0;
+        dist += unzigzag(v[ARRAY_FLAGS] >> 2);
+        if (dist < 0 || dist > 0x3FFFFFFF)
+            return AVERROR_INVALIDDATA;
+        e->min_distance = dist;
+    }
+
+    return 0;
+}
+
+MOVIndexCacheTrack *ff_mov_index_cache_find(MOVIndexCache *c, int64_t trak_pos)
+{
+    for (int i = 0; i < c->nb_tracks; i++)
+        if (c->tracks[i].trak_pos == trak_pos)
+            return &c->tracks[i];
+    return NULL;
+}
+
+int ff_mov_index_cache_atom_crc(AVIOContext *pb, int64_t size, uint32_t *crc)
+{
+    const AVCRC *table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    uint8_t buf[CRC_BLOCK_SIZE];
+    int64_t pos = avio_tell(pb);
+    uint32_t c = UINT32_MAX;
+    int ret = 0;
+
+    *crc = 0;
+    if (size <= 0)
+        return 0;
+
+    while (size > 0) {
+        int len = FFMIN(size, CRC_BLOCK_SIZE);
+
+        ret = ffio_read_size(pb, buf, len);
+        if (ret < 0)
+            goto end;
+        c     = av_crc(table, c, buf, len);
+        size -= len;
+    }
+    *crc = c;
+
+end:
+    if (avio_seek(pb, pos, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    return ret < 0 ? ret : 0;
+}
+
+int ff_mov_index_cache_read(MOVIndexCache *c, AVIOContext *pb, void *logctx)
+{
+    uint8_t magic[8];
+    unsigned version, nb_tracks;
+    int ret;
+
+    ret = ffio_read_size(pb, magic, sizeof(magic));
+    if (ret < 0)
+        return ret;
+    version = avio_rl32(pb);
+    if (memcmp(magic, CACHE_MAGIC, sizeof(magic)) || version != CACHE_VERSION) {
+        av_log(logctx, AV_LOG_WARNING, "Ignoring index cache with unsupported format\n");
+        return 0;
+    }
+
+    if (avio_rl64(pb) != c->file_size) {
+        av_log(logctx, AV_LOG_VERBOSE, "Index cache is for a different file\n");
+        return 0;
+    }
+    c->unchanged = avio_rl64(pb) == c->file_mtime && c->file_mtime >= 0;
+    if (c->unchanged)
+        av_log(logctx, AV_LOG_DEBUG, "File unchanged since the index cache was written\n");
+
+    nb_tracks = avio_rl32(pb);
+    if (nb_tracks > MAX_TRACKS)
+        return AVERROR_INVALIDDATA;
+
+    for (unsigned i = 0; i < nb_tracks; i++) {
+        MOVIndexCacheTrack t = { 0 }, *tracks;
+        uint64_t total = 0;
+
+        t.trak_pos         = avio_rl64(pb);
+        t.stsz_pos         = avio_rl64(pb);
+        t.stco_pos         = avio_rl64(pb);
+        t.stsz_crc         = avio_rl32(pb);
+        t.stco_crc         = avio_rl32(pb);
+        t.sample_count     = avio_rl32(pb);
+        t.chunk_count      = avio_rl32(pb);
+        t.stsz_sample_size = avio_rl32(pb);
+        t.data_size        = avio_rl64(pb);
+        t.tables_crc       = avio_rl32(pb);
+        t.stream_size      = avio_rl64(pb);
+        t.nb_entries       = avio_rl32(pb);
+        for (int j = 0; j < MOV_INDEX_CACHE_NB_ARRAYS; j++) {
+            t.array_size[j] = avio_rl32(pb);
+            total += t.array_size[j];
+        }
+        if (pb->eof_reached)
+            return AVERROR_INVALIDDATA;
+        if (total > INT_MAX || t.nb_entries > t.sample_count)
+            return AVERROR_INVALIDDATA;
+
+        t.data = av_malloc(total + 1);
+        if (!t.data)
+            return AVERROR(ENOMEM);
+        ret = ffio_read_size(pb, t.data, total);
+        if (ret < 0) {
+            av_free(t.data);
+            return ret;
+        }
+
+        tracks = av_realloc_array(c->tracks, c->nb_tracks + 1, sizeof(*c->tracks));
+        if (!tracks) {
+            av_free(t.data);
+            return AVERROR(ENOMEM);
+        }
+        c->tracks = tracks;
+        c->tracks[c->nb_tracks++] = t;
+    }
+
+    return 0;
+}
+
+int ff_mov_index_cache_write(const MOVIndexCache *c, AVIOContext *pb)
+{
+    unsigned nb_tracks = 0;
+
+    for (int i = 0; i < c->nb_tracks; i++)
+        nb_tracks += c->tracks[i].used;
+
+    avio_write(pb, CACHE_MAGIC, 8);
+    avio_wl32(pb, CACHE_VERSION);
+    avio_wl64(pb, c->file_size);
+    avio_wl64(pb, c->file_mtime);
+    avio_wl32(pb, nb_tracks);
+
+    for (int i = 0; i < c->nb_tracks; i++) {
+        const MOVIndexCacheTrack *t = &c->tracks[i];
+        uint64_t total = 0;
+
+        if (!t->used)
+            continue;
+
+        avio_wl64(pb, t->trak_pos);
+        avio_wl64(pb, t->stsz_pos);
+        avio_wl64(pb, t->stco_pos);
+        avio_wl32(pb, t->stsz_crc);
+        avio_wl32(pb, t->stco_crc);
+        avio_wl32(pb, t->sample_count);
+        avio_wl32(pb, t->chunk_count);
+        avio_wl32(pb, t->stsz_sample_size);
+        avio_wl64(pb, t->data_size);
+        avio_wl32(pb, t->tables_crc);
+        avio_wl64(pb, t->stream_size);
+        avio_wl32(pb, t->nb_entries);
+        for (int j = 0; j < MOV_INDEX_CACHE_NB_ARRAYS; j++) {
+            avio_wl32(pb, t->array_size[j]);
+            total += t->array_size[j];
+        }
+        avio_write(pb, t->data, total);
+    }
+
+    avio_flush(pb);
+    return pb->error;
+}
+
+int64_t ff_mov_index_cache_file_mtime(AVFormatContext *s)
+{
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+    const char *proto = avio_find_protocol_name(s->url);
+    const char *path  = s->url;
+    struct stat st;
+
+    if ((s->flags & AVFMT_FLAG_CUSTOM_IO) || !proto || strcmp(proto, "file"))
+        return -1;
+    av_strstart(path, "file:", &path);
+    if (stat(path, &st) < 0)
+        return -1;
+    return st.st_mtime * INT64_C(1000000000) + st.st_mtim.tv_nsec;
+#else
+    return -1;
+#endif
+}
+
+void ff_mov_index_cache_free(MOVIndexCache *c)
+{
+    for (int i = 0; i < c->nb_tracks; i++)
+        av_freep(&c->tracks[i].data);
+    av_freep(&c->tracks);
+    c->nb_tracks = 0;
+}
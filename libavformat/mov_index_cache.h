@@ -0,0 +1,114 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_MOV_INDEX_CACHE_H
+#define AVFORMAT_MOV_INDEX_CACHE_H
+
+#include <stdint.h>
+
+#include "avformat.h"
+
+/**
+ * @file
+ * Persistent cache of the sample index of mov/mp4 tracks.
+ *
+ * The index entries of a track are stored as four separate variable length
+ * coded arrays (sizes, position deltas, timestamp deltas, flags and
+ * distances), which takes a few bytes per sample. Each track also records
+ * where its stsz and stco atoms are and a checksum of their payload, so that
+ * the demuxer can skip parsing these tables when the cached index will be
+ * used. If the modification time of the file is the one recorded in the
+ * cache, these tables are not read at all.
+ */
+
+#define MOV_INDEX_CACHE_NB_ARRAYS 4
+
+typedef struct MOVIndexCacheTrack {
+    int64_t  trak_pos;         ///< offset of the trak atom payload, used as key
+    int64_t  stsz_pos;         ///< offset of the stsz/stz2 atom payload
+    int64_t  stco_pos;         ///< offset of the stco/co64 atom payload
+    uint32_t stsz_crc;         ///< checksum of the stsz payload
+    uint32_t stco_crc;         ///< checksum of the stco payload
+    uint32_t sample_count;
+    uint32_t chunk_count;
+    uint32_t stsz_sample_size; ///< stsz sample size after building the index
+    int64_t  data_size;        ///< sum of the sizes in stsz
+    uint32_t tables_crc;       ///< checksum of all other inputs of the index
+    uint64_t stream_size;      ///< sum of the sizes of all samples in the index
+    uint32_t nb_entries;
+
+    uint8_t *data;
+    uint32_t array_size[MOV_INDEX_CACHE_NB_ARRAYS];
+
+    int used;                  ///< write this track back
+} MOVIndexCacheTrack;
+
+typedef struct MOVIndexCache {
+    int64_t file_size;
+    int64_t file_mtime;        ///< modification time in nanoseconds, or -1
+    int unchanged;             ///< the cache was written for the same file_mtime
+    MOVIndexCacheTrack *tracks;
+    int nb_tracks;
+    int updated;               ///< tracks were added or replaced
+} MOVIndexCache;
+
+/**
+ * Read a cache file. c->file_size and c->file_mtime must be set for the media
+ * file, tracks from a cache that was written for a file with a different size
+ * are discarded.
+ */
+int ff_mov_index_cache_read(MOVIndexCache *c, AVIOContext *pb, void *logctx);
+
+/**
+ * Write the tracks that were used or added.
+ */
+int ff_mov_index_cache_write(const MOVIndexCache *c, AVIOContext *pb);
+
+MOVIndexCacheTrack *ff_mov_index_cache_find(MOVIndexCache *c, int64_t trak_pos);
+
+/**
+ * Encode entries and add them to the cache, replacing any track with the
+ * same trak_pos.
+ *
+ * @param t track description, data and array_size are ignored
+ */
+int ff_mov_index_cache_add(MOVIndexCache *c, const MOVIndexCacheTrack *t,
+                           const AVIndexEntry *entries);
+
+/**
+ * Decode the t->nb_entries index entries of a track.
+ */
+int ff_mov_index_cache_decode(const MOVIndexCacheTrack *t, AVIndexEntry *entries);
+
+/**
+ * Compute the checksum of the next size bytes of pb, the position of pb is
+ * restored afterwards.
+ */
+int ff_mov_index_cache_atom_crc(AVIOContext *pb, int64_t size, uint32_t *crc);
+
+/**
+ * Get the modification time of the input of s, in nanoseconds.
+ *
+ * @return the modification time, or -1 if the input is not a local file or
+ *         the time is not known with a sub-second precision
+ */
+int64_t ff_mov_index_cache_file_mtime(AVFormatContext *s);
+
+void ff_mov_index_cache_free(MOVIndexCache *c);
+
+#endif /* AVFORMAT_MOV_INDEX_CACHE_H */
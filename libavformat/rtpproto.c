@@ -61,6 +61,10 @@ typedef struct RTPContext {
     char *fec_options_str;
     int64_t rw_timeout;
     char *localaddr;
+    int64_t bitrate;
+    int64_t burst_bits;
+    int pcr_pacing;
+    int pacing_spin;
 } RTPContext;
 
 #define OFFSET(x) offsetof(RTPContext, x)
@@ -81,6 +85,10 @@ static const AVOption options[] = {
     { "block",              "Block list",                                                       OFFSET(block),           AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "fec",                "FEC",                                                              OFFSET(fec_options_str), AV_OPT_TYPE_STRING, { .str = NULL },               .flags = E },
     { "localaddr",          "Local address",                                                    OFFSET(localaddr),       AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "bitrate",            "Bits to send per second",                                          OFFSET(bitrate),         AV_OPT_TYPE_INT64,  { .i64 =  0 },     0, INT64_MAX, .flags = E },
+    { "burst_bits",         "Max length of bursts in bits (when using bitrate)",                OFFSET(burst_bits),      AV_OPT_TYPE_INT64,  { .i64 =  0 },     0, INT64_MAX, .flags = E },
+    { "pcr_pacing",         "Send MPEG-TS packets at the time given by their PCR",              OFFSET(pcr_pacing),      AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = E },
+    { "pacing_spin",        "Busy-wait this long in microseconds before a paced packet",        OFFSET(pacing_spin),     AV_OPT_TYPE_INT,    { .i64 =  0 },     0, 1000000, .flags = E },
     { NULL }
 };
 
@@ -177,7 +185,8 @@ static void build_udp_url(RTPContext *s,
                           const char *localaddr,
                           int port, int local_port,
                           const char *include_sources,
-                          const char *exclude_sources)
+                          const char *exclude_sources,
+                          int paced)
 {
     ff_url_join(buf, buf_size, "udp", NULL, hostname, port, NULL);
     if (local_port >= 0)
@@ -192,7 +201,18 @@ static void build_udp_url(RTPContext *s,
         url_add_option(buf, buf_size, "connect=1");
     if (s->dscp >= 0)
         url_add_option(buf, buf_size, "dscp=%d", s->dscp);
-    url_add_option(buf, buf_size, "fifo_size=0");
+    if (paced && (s->bitrate || s->pcr_pacing)) {
+        /* keep the default fifo_size, the udp send thread does the pacing */
+        if (s->bitrate)
+            url_add_option(buf, buf_size, "bitrate=%"PRId64, s->bitrate);
+        if (s->burst_bits)
+            url_add_option(buf, buf_size, "burst_bits=%"PRId64, s->burst_bits);
+        if (s->pcr_pacing)
+            url_add_option(buf, buf_size, "pcr_pacing=1");
+        if (s->pacing_spin)
+            url_add_option(buf, buf_size, "pacing_spin=%d", s->pacing_spin);
+    } else
+        url_add_option(buf, buf_size, "fifo_size=0");
     if (include_sources && include_sources[0])
         url_add_option(buf, buf_size, "sources=%s", include_sources);
     if (exclude_sources && exclude_sources[0])
@@ -213,6 +233,10 @@ static void build_udp_url(RTPContext *s,
  *         'block=ip[,ip]'    : list disallowed source IP addresses
  *         'write_to_source=0/1' : send packets to the source address of the latest received packet
  *         'dscp=n'           : set DSCP value to n (QoS)
+ *         'bitrate=n'        : pace the sent RTP packets to n bits per second
+ *         'burst_bits=n'     : allow bursts of up to n bits when pacing
+ *         'pcr_pacing=0/1'   : pace MPEG-TS payloads according to their PCR
+ *         'pacing_spin=n'    : busy-wait the last n microseconds before a paced packet
  * deprecated option:
  *         'localport=n'      : set the local port to n
  *
@@ -274,6 +298,18 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "timeout", p)) {
             s->rw_timeout = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
+            s->bitrate = strtoll(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
+            s->burst_bits = strtoll(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "pcr_pacing", p)) {
+            s->pcr_pacing = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "pacing_spin", p)) {
+            s->pacing_spin = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "sources", p)) {
             av_strlcpy(include_sources, buf, sizeof(include_sources));
             ff_ip_parse_sources(h, buf, &s->filters);
@@ -325,7 +361,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
     for (i = 0; i < max_retry_count; i++) {
         build_udp_url(s, buf, sizeof(buf),
                       hostname, s->localaddr, rtp_port, s->local_rtpport,
-                      sources, block);
+                      sources, block, 1);
         if (ffurl_open_whitelist(&s->rtp_hd, buf, flags, &h->interrupt_callback,
                                  NULL, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
             goto fail;
@@ -339,7 +375,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
             s->local_rtcpport = s->local_rtpport + 1;
             build_udp_url(s, buf, sizeof(buf),
                           hostname, s->localaddr, s->rtcp_port, s->local_rtcpport,
-                          sources, block);
+                          sources, block, 0);
             if (ffurl_open_whitelist(&s->rtcp_hd, buf, rtcpflags,
                                      &h->interrupt_callback, NULL,
                                      h->protocol_whitelist, h->protocol_blacklist, h) < 0) {
@@ -350,7 +386,7 @@ static int rtp_open(URLContext *h, const char *uri, int flags)
         }
         build_udp_url(s, buf, sizeof(buf),
                       hostname, s->localaddr, s->rtcp_port, s->local_rtcpport,
-                      sources, block);
+                      sources, block, 0);
         if (ffurl_open_whitelist(&s->rtcp_hd, buf, rtcpflags, &h->interrupt_callback,
                                  NULL, h->protocol_whitelist, h->protocol_blacklist, h) < 0)
             goto fail;
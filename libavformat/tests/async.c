@@ -0,0 +1,176 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/file_open.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavformat/avio.h"
+#include "libavformat/url.h"
+
+/* The stream is read through the crypto protocol, which reads from its inner
+ * protocol when seeking to a position that is not block aligned. Such a seek
+ * fails if the inner protocol is interrupted, which makes it possible to
+ * check that seeking outside of the async buffer is not aborted. */
+
+#define STREAM_SIZE (1 << 20)
+#define BUFFER_SIZE 65536
+#define KEY         "00112233445566778899aabbccddeeff"
+#define IV          "0f0e0d0c0b0a09080706050403020100"
+
+static uint8_t pattern(int64_t pos)
+{
+    return pos ^ (pos >> 8) ^ (pos >> 16);
+}
+
+static int write_stream(const char *url)
+{
+    URLContext   *h    = NULL;
+    AVDictionary *opts = NULL;
+    uint8_t buf[4096];
+    int ret;
+
+    av_dict_set(&opts, "encryption_key", KEY, 0);
+    av_dict_set(&opts, "encryption_iv",  IV,  0);
+    ret = ffurl_open_whitelist(&h, url, AVIO_FLAG_WRITE, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    for (int64_t pos = 0; pos < STREAM_SIZE; pos += sizeof(buf)) {
+        for (int i = 0; i < sizeof(buf); i++)
+            buf[i] = pattern(pos + i);
+        ret = ffurl_write(h, buf, sizeof(buf));
+        if (ret < 0)
+            break;
+    }
+
+    ffurl_closep(&h);
+    return ret < 0 ? ret : 0;
+}
+
+static int check_read(URLContext *h, int64_t pos, int size)
+{
+    uint8_t buf[4096];
+    int ret, len = 0;
+
+    while (len < size) {
+        ret = ffurl_read(h, buf, FFMIN(size - len, sizeof(buf)));
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            printf("read error at %"PRId64": %s\n", pos + len, av_err2str(ret));
+            return ret;
+        }
+        for (int i = 0; i < ret; i++) {
+            if (buf[i] != pattern(pos + len + i)) {
+                printf("mismatch at %"PRId64"\n", pos + len + i);
+                return AVERROR_INVALIDDATA;
+            }
+        }
+        len += ret;
+    }
+
+    printf("read %d bytes at %"PRId64"\n", len, pos);
+    return 0;
+}
+
+static int check_seek(URLContext *h, int64_t pos, int size)
+{
+    int64_t ret = ffurl_seek(h, pos, SEEK_SET);
+
+    printf("seek to %"PRId64": ", pos);
+    if (ret != pos) {
+        printf("failed: %"PRId64"\n", ret);
+        return ret < 0 ? ret : AVERROR_BUG;
+    }
+    return check_read(h, pos, size);
+}
+
+int main(void)
+{
+    static const struct {
+        int64_t pos;
+        int     size;
+    } seeks[] = {
+        { 700001,            10000 }, // forwards, past the buffered data
+        {  12345,            10000 }, // backwards, before the read-back data
+        {  20000,             5000 }, // forwards, inside the buffered data
+        { STREAM_SIZE - 1000, 2000 }, // up to EOF
+        {  40003,             4096 }, // backwards again, after EOF was reached
+    };
+    URLContext   *h    = NULL;
+    AVDictionary *opts = NULL;
+    char *path = NULL, *url = NULL;
+    int fd, ret;
+
+    fd = avpriv_tempfile("async-test", &path, 0, NULL);
+    if (fd < 0)
+        return 1;
+    close(fd);
+
+    url = av_asprintf("crypto:file:%s", path);
+    if (!url) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = write_stream(url);
+    if (ret < 0) {
+        printf("writing the test stream failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    av_freep(&url);
+    url = av_asprintf("async:crypto:file:%s", path);
+    if (!url) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    av_dict_set(&opts, "decryption_key",       KEY, 0);
+    av_dict_set(&opts, "decryption_iv",        IV,  0);
+    av_dict_set_int(&opts, "async_buffer_size",    BUFFER_SIZE, 0);
+    av_dict_set_int(&opts, "async_read_back_size", 4096,        0);
+    ret = ffurl_open_whitelist(&h, url, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    if (ret < 0) {
+        printf("open failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+    printf("size: %"PRId64"\n", ffurl_size(h));
+
+    ret = check_read(h, 0, 4096);
+    for (int i = 0; ret >= 0 && i < FF_ARRAY_ELEMS(seeks); i++)
+        ret = check_seek(h, seeks[i].pos, seeks[i].size);
+
+end:
+    ffurl_closep(&h);
+    av_dict_free(&opts);
+    unlink(path);
+    av_free(path);
+    av_free(url);
+    return ret < 0;
+}
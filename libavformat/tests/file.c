@@ -0,0 +1,209 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/file_open.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavformat/avio.h"
+#include "libavformat/url.h"
+
+/* Reads a file through the file protocol with mmap enabled, while the file
+ * is truncated or extended between reads. */
+
+#define FILE_SIZE 100000
+
+static uint8_t pattern(int64_t pos)
+{
+    return pos ^ (pos >> 8) ^ (pos >> 16);
+}
+
+static int write_file(const char *path, int64_t start, int64_t end)
+{
+    uint8_t buf[4096];
+    FILE *f = fopen(path, start ? "ab" : "wb");
+
+    if (!f)
+        return AVERROR(errno);
+    for (int64_t pos = start; pos < end; pos += sizeof(buf)) {
+        int size = FFMIN(end - pos, sizeof(buf));
+        for (int i = 0; i < size; i++)
+            buf[i] = pattern(pos + i);
+        if (fwrite(buf, 1, size, f) != size)
+            break;
+    }
+    return fclose(f) ? AVERROR(errno) : 0;
+}
+
+static int check_data(const uint8_t *data, int64_t pos, int size)
+{
+    for (int i = 0; i < size; i++) {
+        if (data[i] != pattern(pos + i)) {
+            printf("mismatch at %"PRId64"\n", pos + i);
+            return AVERROR_INVALIDDATA;
+        }
+    }
+    return 0;
+}
+
+/* Reads up to size bytes at pos, in reads of at most chunk bytes */
+static int check_read(URLContext *h, int64_t pos, int size, int chunk)
+{
+    static uint8_t buf[FILE_SIZE];
+    int ret, len = 0;
+
+    while (len < size) {
+        ret = ffurl_read(h, buf, FFMIN(size - len, chunk));
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            printf("read error at %"PRId64": %s\n", pos + len, av_err2str(ret));
+            return ret;
+        }
+        if (check_data(buf, pos + len, ret) < 0)
+            return AVERROR_INVALIDDATA;
+        len += ret;
+    }
+
+    printf("read %d bytes at %"PRId64"\n", len, pos);
+    return 0;
+}
+
+static int open_mapped(URLContext **h, const char *url)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    av_dict_set(&opts, "mmap", "1", 0);
+    ret = ffurl_open_whitelist(h, url, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0)
+        printf("open failed: %s\n", av_err2str(ret));
+    else
+        printf("size: %"PRId64"\n", ffurl_size(*h));
+    return ret;
+}
+
+static int test_truncate(const char *path, const char *url)
+{
+    URLContext *h = NULL;
+    AVBufferRef *map = NULL;
+    int ret;
+
+    printf("truncation:\n");
+    if ((ret = write_file(path, 0, FILE_SIZE)) < 0 ||
+        (ret = open_mapped(&h, url)) < 0)
+        goto end;
+
+    ret = ffurl_get_mapped_buffer(h, &map);
+    if (ret < 0) {
+        printf("no mapping: %s\n", av_err2str(ret));
+        goto end;
+    }
+    printf("mapped %zu bytes\n", map->size);
+
+    ret = check_read(h, 0, 60000, 4096);
+    if (ret < 0)
+        goto end;
+
+    if (truncate(path, 80000) < 0) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    printf("truncated to 80000 bytes\n");
+
+    /* This read reaches the end of the mapping, so the size is checked before
+     * accessing the part of the mapping past the new end of the file. */
+    ret = check_read(h, 60000, FILE_SIZE - 60000, FILE_SIZE);
+    if (ret < 0)
+        goto end;
+
+    /* The start of the file is still there, the mapping must still be usable */
+    ret = check_data(map->data, 0, 60000);
+    if (ret >= 0)
+        printf("mapped data still valid\n");
+
+end:
+    av_buffer_unref(&map);
+    ffurl_closep(&h);
+    return ret;
+}
+
+static int test_append(const char *path, const char *url)
+{
+    URLContext *h = NULL;
+    int ret;
+
+    printf("append:\n");
+    if ((ret = write_file(path, 0, 80000)) < 0 ||
+        (ret = open_mapped(&h, url)) < 0)
+        goto end;
+
+    ret = check_read(h, 0, 60000, 4096);
+    if (ret < 0)
+        goto end;
+
+    if ((ret = write_file(path, 80000, FILE_SIZE)) < 0)
+        goto end;
+    printf("appended up to %d bytes\n", FILE_SIZE);
+
+    /* The appended data is read once the end of the mapping is reached */
+    ret = check_read(h, 60000, FILE_SIZE, 4096);
+
+end:
+    ffurl_closep(&h);
+    return ret;
+}
+
+int main(void)
+{
+    char *path = NULL, *url = NULL;
+    int fd, ret;
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    fd = avpriv_tempfile("file-test", &path, 0, NULL);
+    if (fd < 0)
+        return 1;
+    close(fd);
+
+    url = av_asprintf("file:%s", path);
+    if (!url) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = test_truncate(path, url);
+    if (ret >= 0)
+        ret = test_append(path, url);
+
+end:
+    unlink(path);
+    av_free(path);
+    av_free(url);
+    return ret < 0;
+}
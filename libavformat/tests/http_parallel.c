@@ -0,0 +1,310 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavformat/network.h"
+#include "libavformat/url.h"
+
+/* Reads a resource with parallel range requests from a local HTTP server,
+ * which either honours the ranges or always sends the whole resource. */
+
+#define FILE_SIZE   1000000
+#define MAX_CLIENTS 32
+
+typedef struct Server {
+    int fd;
+    int port;
+    int ignore_range;
+    atomic_int range_requests;
+    atomic_int stop;
+    pthread_t thread;
+    pthread_t clients[MAX_CLIENTS];
+    int nb_clients;
+} Server;
+
+typedef struct Client {
+    Server *srv;
+    int fd;
+} Client;
+
+static uint8_t pattern(int64_t pos)
+{
+    return pos ^ (pos >> 8) ^ (pos >> 16);
+}
+
+static int send_all(int fd, const uint8_t *buf, int size)
+{
+    while (size > 0) {
+        int ret = send(fd, buf, size, 0);
+        if (ret <= 0)
+            return -1;
+        buf  += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static int handle_request(Server *srv, int fd, const char *req)
+{
+    uint8_t buf[65536];
+    char *hdr = (char *)buf;
+    const char *range = av_stristr(req, "\nRange: bytes=");
+    int64_t start = 0, end = FILE_SIZE - 1;
+    int len;
+
+    if (range) {
+        char *ptr;
+        start = strtoll(range + 14, &ptr, 10);
+        if (*ptr == '-' && ptr[1] >= '0' && ptr[1] <= '9')
+            end = FFMIN(strtoll(ptr + 1, NULL, 10), FILE_SIZE - 1);
+        if (start)
+            atomic_fetch_add(&srv->range_requests, 1);
+    }
+    if (!range || srv->ignore_range || start >= FILE_SIZE) {
+        start = 0;
+        end   = FILE_SIZE - 1;
+        len = snprintf(hdr, sizeof(buf), "HTTP/1.1 200 OK\r\n");
+    } else {
+        len = snprintf(hdr, sizeof(buf), "HTTP/1.1 206 Partial Content\r\n"
+                       "Content-Range: bytes %"PRId64"-%"PRId64"/%d\r\n",
+                       start, end, FILE_SIZE);
+    }
+    len += snprintf(hdr + len, sizeof(buf) - len,
+                    "Accept-Ranges: bytes\r\nContent-Length: %"PRId64"\r\n\r\n",
+                    end - start + 1);
+    if (send_all(fd, buf, len) < 0)
+        return -1;
+
+    for (int64_t pos = start; pos <= end; pos += sizeof(buf)) {
+        int size = FFMIN(end + 1 - pos, sizeof(buf));
+        for (int i = 0; i < size; i++)
+            buf[i] = pattern(pos + i);
+        if (send_all(fd, buf, size) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void *client_thread(void *arg)
+{
+    Client *c = arg;
+    char req[4096];
+    int len = 0;
+
+    /* the requests are not pipelined, one is read at a time */
+    for (;;) {
+        int ret = recv(c->fd, req + len, sizeof(req) - 1 - len, 0);
+        if (ret <= 0)
+            break;
+        len += ret;
+        req[len] = 0;
+        if (!strstr(req, "\r\n\r\n")) {
+            if (len == sizeof(req) - 1)
+                break;
+            continue;
+        }
+        if (handle_request(c->srv, c->fd, req) < 0)
+            break;
+        len = 0;
+    }
+    closesocket(c->fd);
+    av_free(c);
+    return NULL;
+}
+
+static void *server_thread(void *arg)
+{
+    Server *srv = arg;
+
+    while (srv->nb_clients < MAX_CLIENTS) {
+        Client *c;
+        int fd = accept(srv->fd, NULL, NULL);
+
+        if (fd < 0 || atomic_load(&srv->stop)) {
+            if (fd >= 0)
+                closesocket(fd);
+            break;
+        }
+        if (!(c = av_mallocz(sizeof(*c)))) {
+            closesocket(fd);
+            break;
+        }
+        c->srv = srv;
+        c->fd  = fd;
+        if (pthread_create(&srv->clients[srv->nb_clients], NULL, client_thread, c)) {
+            closesocket(fd);
+            av_free(c);
+            break;
+        }
+        srv->nb_clients++;
+    }
+    return NULL;
+}
+
+static int server_start(Server *srv, int ignore_range)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addrlen = sizeof(addr);
+
+    memset(srv, 0, sizeof(*srv));
+    srv->ignore_range = ignore_range;
+    atomic_init(&srv->range_requests, 0);
+    atomic_init(&srv->stop, 0);
+
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    srv->fd = ff_socket(AF_INET, SOCK_STREAM, 0, NULL);
+    if (srv->fd < 0)
+        return AVERROR(errno);
+    if (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(srv->fd, MAX_CLIENTS) ||
+        getsockname(srv->fd, (struct sockaddr *)&addr, &addrlen) ||
+        pthread_create(&srv->thread, NULL, server_thread, srv)) {
+        closesocket(srv->fd);
+        return AVERROR(EIO);
+    }
+    srv->port = ntohs(addr.sin_port);
+    return 0;
+}
+
+static void server_stop(Server *srv)
+{
+    struct sockaddr_in addr = { 0 };
+    int fd;
+
+    /* wake up the accept() call with a last connection */
+    atomic_store(&srv->stop, 1);
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(srv->port);
+    fd = ff_socket(AF_INET, SOCK_STREAM, 0, NULL);
+    if (fd >= 0) {
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+        closesocket(fd);
+    }
+    pthread_join(srv->thread, NULL);
+    for (int i = 0; i < srv->nb_clients; i++)
+        pthread_join(srv->clients[i], NULL);
+    closesocket(srv->fd);
+}
+
+/* Reads until the end of the resource from pos and checks the data. */
+static int check_read(URLContext *h, int64_t pos)
+{
+    static uint8_t buf[32768];
+    int64_t len = 0;
+
+    for (;;) {
+        int ret = ffurl_read(h, buf, sizeof(buf));
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0) {
+            printf("read error at %"PRId64": %s\n", pos + len, av_err2str(ret));
+            return ret;
+        }
+        for (int i = 0; i < ret; i++) {
+            if (buf[i] != pattern(pos + len + i)) {
+                printf("mismatch at %"PRId64"\n", pos + len + i);
+                return AVERROR_INVALIDDATA;
+            }
+        }
+        len += ret;
+    }
+
+    printf("read %"PRId64" bytes at %"PRId64"\n", len, pos);
+    return 0;
+}
+
+static int test(int ignore_range)
+{
+    AVDictionary *opts = NULL;
+    URLContext *h = NULL;
+    char url[64];
+    Server srv;
+    int64_t pos;
+    int ret;
+
+    printf("%s:\n", ignore_range ? "server ignoring ranges" : "server with ranges");
+    if ((ret = server_start(&srv, ignore_range)) < 0)
+        return ret;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/file", srv.port);
+    av_dict_set(&opts, "parallel_connections", "4", 0);
+    av_dict_set(&opts, "parallel_min_chunk_size", "16384", 0);
+    av_dict_set(&opts, "parallel_max_chunk_size", "65536", 0);
+    ret = ffurl_open_whitelist(&h, url, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        printf("open failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    /* without ranges, the data is read from the start on a single connection
+     * after the first range request of the parallel connections failed */
+    if ((ret = check_read(h, 0)) < 0 || ignore_range)
+        goto end;
+
+    pos = ffurl_seek(h, FILE_SIZE / 3, SEEK_SET);
+    if (pos < 0) {
+        ret = pos;
+        printf("seek failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+    ret = check_read(h, pos);
+
+end:
+    ffurl_closep(&h);
+    server_stop(&srv);
+    if (ret >= 0 && !ignore_range)
+        printf("range requests: %s\n",
+               atomic_load(&srv.range_requests) > 1 ? "several" : "at most one");
+    return ret;
+}
+
+int main(void)
+{
+    int ret;
+
+    av_log_set_level(AV_LOG_FATAL);
+#ifdef SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    if (!ff_network_init())
+        return 1;
+
+    ret = test(0);
+    if (ret >= 0)
+        ret = test(1);
+
+    ff_network_close();
+    return ret < 0;
+}
@@ -0,0 +1,387 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavformat/avformat.h"
+#include "libavformat/network.h"
+
+/* Reads an HLS or a DASH stream from a local HTTP server and counts the
+ * connections used for the playlists or the manifest and the segments. */
+
+#define NB_SEGMENTS  5
+#define NB_PACKETS   10
+#define MAX_CLIENTS  32
+
+typedef struct Server {
+    int fd;
+    int port;
+    atomic_int connections;
+    atomic_int requests;
+    atomic_int stop;
+    pthread_t thread;
+    pthread_t clients[MAX_CLIENTS];
+    int nb_clients;
+} Server;
+
+typedef struct Client {
+    Server *srv;
+    int fd;
+} Client;
+
+static char    *master, *playlist, *manifest;
+static uint8_t *segments[NB_SEGMENTS];
+static int      segment_sizes[NB_SEGMENTS];
+
+/* Mux a segment of MPEG-TS with a KLV data stream */
+static int make_segment(int n)
+{
+    const AVOutputFormat *ofmt = av_guess_format("mpegts", NULL, NULL);
+    AVFormatContext *oc = NULL;
+    AVPacket *pkt = NULL;
+    uint8_t data[64];
+    AVStream *st;
+    int ret;
+
+    if ((ret = avformat_alloc_output_context2(&oc, ofmt, NULL, NULL)) < 0)
+        return ret;
+    if (!(st = avformat_new_stream(oc, NULL)) || !(pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    st->codecpar->codec_type = AVMEDIA_TYPE_DATA;
+    st->codecpar->codec_id   = AV_CODEC_ID_SMPTE_KLV;
+    st->time_base            = (AVRational){ 1, 90000 };
+    oc->flags               |= AVFMT_FLAG_BITEXACT;
+
+    if ((ret = avio_open_dyn_buf(&oc->pb)) < 0 ||
+        (ret = avformat_write_header(oc, NULL)) < 0)
+        goto end;
+
+    for (int i = 0; i < NB_PACKETS; i++) {
+        memset(data, n * NB_PACKETS + i, sizeof(data));
+        if ((ret = av_new_packet(pkt, sizeof(data))) < 0)
+            goto end;
+        memcpy(pkt->data, data, sizeof(data));
+        pkt->pts = pkt->dts = (n * NB_PACKETS + i) * 9000LL;
+        pkt->flags |= AV_PKT_FLAG_KEY;
+        if ((ret = av_interleaved_write_frame(oc, pkt)) < 0)
+            goto end;
+    }
+    ret = av_write_trailer(oc);
+
+end:
+    if (oc && oc->pb) {
+        int size = avio_close_dyn_buf(oc->pb, &segments[n]);
+        if (ret >= 0)
+            segment_sizes[n] = size;
+    }
+    avformat_free_context(oc);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+static int make_resources(void)
+{
+    AVBPrint pl, mpd;
+    int ret = 0;
+
+    for (int i = 0; i < NB_SEGMENTS && ret >= 0; i++)
+        ret = make_segment(i);
+    if (ret < 0)
+        return ret;
+
+    master = av_strdup("#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH=100000\nmedia.m3u8\n");
+    if (!master)
+        return AVERROR(ENOMEM);
+
+    av_bprint_init(&pl, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&pl, "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:1\n"
+               "#EXT-X-MEDIA-SEQUENCE:0\n#EXT-X-PLAYLIST-TYPE:VOD\n");
+    for (int i = 0; i < NB_SEGMENTS; i++)
+        av_bprintf(&pl, "#EXTINF:1.0,\nseg%d.ts\n", i);
+    av_bprintf(&pl, "#EXT-X-ENDLIST\n");
+
+    av_bprint_init(&mpd, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&mpd, "<?xml version=\"1.0\"?>\n"
+               "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"static\" "
+               "mediaPresentationDuration=\"PT%dS\" minBufferTime=\"PT1S\" "
+               "profiles=\"urn:mpeg:dash:profile:full:2011\">\n"
+               "<Period start=\"PT0S\">\n"
+               "<AdaptationSet contentType=\"video\" mimeType=\"video/mp2t\">\n"
+               "<Representation id=\"0\" bandwidth=\"100000\">\n"
+               "<SegmentList timescale=\"1\" duration=\"1\">\n", NB_SEGMENTS);
+    for (int i = 0; i < NB_SEGMENTS; i++)
+        av_bprintf(&mpd, "<SegmentURL media=\"seg%d.ts\"/>\n", i);
+    av_bprintf(&mpd, "</SegmentList>\n</Representation>\n</AdaptationSet>\n"
+               "</Period>\n</MPD>\n");
+
+    ret = av_bprint_finalize(&pl, &playlist);
+    if (ret >= 0)
+        ret = av_bprint_finalize(&mpd, &manifest);
+    else
+        av_bprint_finalize(&mpd, NULL);
+    return ret;
+}
+
+static void free_resources(void)
+{
+    av_freep(&master);
+    av_freep(&playlist);
+    av_freep(&manifest);
+    for (int i = 0; i < NB_SEGMENTS; i++)
+        av_freep(&segments[i]);
+}
+
+static int send_all(int fd, const uint8_t *buf, int size)
+{
+    while (size > 0) {
+        int ret = send(fd, buf, size, 0);
+        if (ret <= 0)
+            return -1;
+        buf  += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static int handle_request(Server *srv, int fd, const char *req)
+{
+    const uint8_t *data = NULL;
+    char hdr[256], path[64];
+    int size = 0, seg, len;
+
+    atomic_fetch_add(&srv->requests, 1);
+    if (sscanf(req, "GET /%63s ", path) != 1)
+        return -1;
+    if (!strcmp(path, "index.m3u8")) {
+        data = (const uint8_t *)master;
+        size = strlen(master);
+    } else if (!strcmp(path, "media.m3u8")) {
+        data = (const uint8_t *)playlist;
+        size = strlen(playlist);
+    } else if (!strcmp(path, "index.mpd")) {
+        data = (const uint8_t *)manifest;
+        size = strlen(manifest);
+    } else if (sscanf(path, "seg%d.ts", &seg) == 1 && seg >= 0 && seg < NB_SEGMENTS) {
+        data = segments[seg];
+        size = segment_sizes[seg];
+    }
+
+    if (!data)
+        len = snprintf(hdr, sizeof(hdr), "HTTP/1.1 404 Not Found\r\n"
+                       "Content-Length: 0\r\n\r\n");
+    else
+        len = snprintf(hdr, sizeof(hdr), "HTTP/1.1 200 OK\r\n"
+                       "Content-Length: %d\r\n\r\n", size);
+    if (send_all(fd, (const uint8_t *)hdr, len) < 0)
+        return -1;
+    return send_all(fd, data, size);
+}
+
+static void *client_thread(void *arg)
+{
+    Client *c = arg;
+    char req[4096];
+    int len = 0;
+
+    /* the requests are not pipelined, one is read at a time */
+    for (;;) {
+        int ret = recv(c->fd, req + len, sizeof(req) - 1 - len, 0);
+        if (ret <= 0)
+            break;
+        len += ret;
+        req[len] = 0;
+        if (!strstr(req, "\r\n\r\n")) {
+            if (len == sizeof(req) - 1)
+                break;
+            continue;
+        }
+        if (handle_request(c->srv, c->fd, req) < 0)
+            break;
+        len = 0;
+    }
+    closesocket(c->fd);
+    av_free(c);
+    return NULL;
+}
+
+static void *server_thread(void *arg)
+{
+    Server *srv = arg;
+
+    while (srv->nb_clients < MAX_CLIENTS) {
+        Client *c;
+        int fd = accept(srv->fd, NULL, NULL);
+
+        if (fd < 0 || atomic_load(&srv->stop)) {
+            if (fd >= 0)
+                closesocket(fd);
+            break;
+        }
+        if (!(c = av_mallocz(sizeof(*c)))) {
+            closesocket(fd);
+            break;
+        }
+        c->srv = srv;
+        c->fd  = fd;
+        if (pthread_create(&srv->clients[srv->nb_clients], NULL, client_thread, c)) {
+            closesocket(fd);
+            av_free(c);
+            break;
+        }
+        atomic_fetch_add(&srv->connections, 1);
+        srv->nb_clients++;
+    }
+    return NULL;
+}
+
+static int server_start(Server *srv)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addrlen = sizeof(addr);
+
+    memset(srv, 0, sizeof(*srv));
+    atomic_init(&srv->connections, 0);
+    atomic_init(&srv->requests, 0);
+    atomic_init(&srv->stop, 0);
+
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    srv->fd = ff_socket(AF_INET, SOCK_STREAM, 0, NULL);
+    if (srv->fd < 0)
+        return AVERROR(errno);
+    if (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(srv->fd, MAX_CLIENTS) ||
+        getsockname(srv->fd, (struct sockaddr *)&addr, &addrlen) ||
+        pthread_create(&srv->thread, NULL, server_thread, srv)) {
+        closesocket(srv->fd);
+        return AVERROR(EIO);
+    }
+    srv->port = ntohs(addr.sin_port);
+    return 0;
+}
+
+static void server_stop(Server *srv)
+{
+    struct sockaddr_in addr = { 0 };
+    int fd;
+
+    /* wake up the accept() call with a last connection */
+    atomic_store(&srv->stop, 1);
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(srv->port);
+    fd = ff_socket(AF_INET, SOCK_STREAM, 0, NULL);
+    if (fd >= 0) {
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+        closesocket(fd);
+    }
+    pthread_join(srv->thread, NULL);
+    for (int i = 0; i < srv->nb_clients; i++)
+        pthread_join(srv->clients[i], NULL);
+    closesocket(srv->fd);
+}
+
+static int test(const char *name, const char *file, const char *persistent)
+{
+    AVFormatContext *ic = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket *pkt = NULL;
+    char url[64];
+    Server srv;
+    int nb_packets = 0, ret;
+
+    printf("%s, http_persistent=%s: ", name, persistent);
+    if ((ret = server_start(&srv)) < 0)
+        return ret;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/%s", srv.port, file);
+    av_dict_set(&opts, "http_persistent", persistent, 0);
+    ret = avformat_open_input(&ic, url, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        printf("open failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+    if (!(pkt = av_packet_alloc())) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        nb_packets++;
+        av_packet_unref(pkt);
+    }
+    if (ret != AVERROR_EOF) {
+        printf("read failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+    ret = 0;
+
+end:
+    av_packet_free(&pkt);
+    avformat_close_input(&ic);
+    server_stop(&srv);
+    if (ret >= 0)
+        printf("%d packets, %d requests over %d connections\n", nb_packets,
+               atomic_load(&srv.requests), atomic_load(&srv.connections));
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *file;
+    int ret;
+
+    if (argc < 2 || (strcmp(argv[1], "hls") && strcmp(argv[1], "dash"))) {
+        fprintf(stderr, "Usage: %s hls|dash\n", argv[0]);
+        return 1;
+    }
+    file = !strcmp(argv[1], "hls") ? "index.m3u8" : "index.mpd";
+
+    av_log_set_level(AV_LOG_FATAL);
+#ifdef SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    if (!ff_network_init())
+        return 1;
+
+    /* The master playlist or the manifest is read from the connection opened
+     * by avformat_open_input(). HLS reuses the connection of the media
+     * playlist for the segments, and requests the next segment on a second
+     * connection while reading the current one (http_multiple). */
+    ret = make_resources();
+    if (ret >= 0)
+        ret = test(argv[1], file, "1");
+    if (ret >= 0)
+        ret = test(argv[1], file, "0");
+
+    free_resources();
+    ff_network_close();
+    return ret < 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/time.h"
+#include "libavformat/network.h"
+#include "libavformat/url.h"
+
+/* Sends datagrams over the loopback interface through the circular buffer
+ * threads of the udp protocol and checks that they arrive unchanged and in
+ * order, with and without batching and segmentation offloads, and that the
+ * paced output is not sent faster than requested. */
+
+#define NB_PACKETS 500
+#define PKT_SIZE   1316
+#define TS_SIZE    188
+
+/* Paced tests: 500 datagrams at 20 Mbit/s, or with a PCR every 10 datagrams
+ * advancing by 5 ms, take about 250 ms. */
+#define PCR_INTERVAL   10
+#define PCR_STEP       (5 * 27000)
+#define MIN_DURATION   200000
+
+/* Runs of full sized datagrams, broken by a shorter one every 50 datagrams */
+static int packet_size(int n, int ts)
+{
+    return n % 50 == 49 && !ts ? TS_SIZE * (1 + n / 50 % 6) : PKT_SIZE;
+}
+
+/* MPEG-TS packets on one PID, with a PCR in the first packet of every
+ * PCR_INTERVAL datagrams */
+static void fill_ts_packet(uint8_t *buf, int n)
+{
+    for (int k = 0; k < PKT_SIZE / TS_SIZE; k++) {
+        uint8_t *pkt = buf + k * TS_SIZE;
+        int cc = (n * (PKT_SIZE / TS_SIZE) + k) & 15, hdr = 4;
+
+        pkt[0] = 0x47;
+        pkt[1] = 0x01;
+        pkt[2] = 0x00;
+        pkt[3] = 0x10 | cc;
+        if (!k && n % PCR_INTERVAL == 0) {
+            int64_t base = n / PCR_INTERVAL * PCR_STEP / 300;
+
+            pkt[3] |= 0x20;
+            pkt[4]  = 7;
+            pkt[5]  = 0x10;
+            AV_WB32(pkt + 6, base >> 1);
+            pkt[10] = (base & 1) << 7 | 0x7e;
+            pkt[11] = 0;
+            hdr     = 12;
+        }
+        for (int i = hdr; i < TS_SIZE; i++)
+            pkt[i] = n + i;
+    }
+}
+
+static void fill_packet(uint8_t *buf, int n, int ts)
+{
+    int size = packet_size(n, ts);
+
+    if (ts) {
+        fill_ts_packet(buf, n);
+        return;
+    }
+    AV_WB32(buf, n);
+    for (int i = 4; i < size; i++)
+        buf[i] = n + i;
+}
+
+static int open_url(URLContext **h, const char *url, int flags)
+{
+    int ret = ffurl_open_whitelist(h, url, flags, NULL, NULL,
+                                   NULL, NULL, NULL);
+    if (ret < 0)
+        printf("opening %s failed: %s\n", url, av_err2str(ret));
+    return ret;
+}
+
+static int receive(URLContext *h, int ts)
+{
+    uint8_t buf[PKT_SIZE], ref[PKT_SIZE];
+
+    for (int n = 0; n < NB_PACKETS; n++) {
+        int ret = ffurl_read(h, buf, sizeof(buf));
+        if (ret < 0) {
+            printf("datagram %d: %s\n", n, av_err2str(ret));
+            return ret;
+        }
+        fill_packet(ref, n, ts);
+        if (ret != packet_size(n, ts) || memcmp(buf, ref, ret)) {
+            printf("datagram %d: wrong size or data\n", n);
+            return AVERROR_INVALIDDATA;
+        }
+    }
+    printf("%d datagrams received in order", NB_PACKETS);
+    return 0;
+}
+
+/**
+ * Send NB_PACKETS datagrams with the given options of the sender and the
+ * receiver and check them.
+ *
+ * @param duration set to the time it took to send them
+ */
+static int test(const char *rx_opts, const char *tx_opts, int ts, int64_t *duration)
+{
+    URLContext *rx = NULL, *tx = NULL;
+    uint8_t buf[PKT_SIZE];
+    char url[256];
+    int64_t start;
+    int ret;
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:0?fifo_size=8192&timeout=2000000"
+             "&buffer_size=1048576&%s", rx_opts);
+    if ((ret = open_url(&rx, url, AVIO_FLAG_READ)) < 0)
+        goto end;
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d?pkt_size=%d&fifo_size=8192&%s",
+             ff_udp_get_local_port(rx), PKT_SIZE, tx_opts);
+    if ((ret = open_url(&tx, url, AVIO_FLAG_WRITE)) < 0)
+        goto end;
+
+    start = av_gettime_relative();
+    for (int n = 0; n < NB_PACKETS; n++) {
+        fill_packet(buf, n, ts);
+        ret = ffurl_write(tx, buf, packet_size(n, ts));
+        if (ret < 0) {
+            printf("writing datagram %d failed: %s\n", n, av_err2str(ret));
+            goto end;
+        }
+    }
+    /* waits until the send thread has sent everything */
+    ffurl_closep(&tx);
+    *duration = av_gettime_relative() - start;
+
+    ret = receive(rx, ts);
+
+end:
+    ffurl_closep(&tx);
+    ffurl_closep(&rx);
+    return ret;
+}
+
+static int test_batch(int batch_size, int gso, int gro)
+{
+    char rx_opts[64], tx_opts[128];
+    int64_t duration;
+    int ret;
+
+    printf("batch_size=%d gso=%d gro=%d: ", batch_size, gso, gro);
+    snprintf(rx_opts, sizeof(rx_opts), "batch_size=%d&gro=%d", batch_size, gro);
+    /* At this rate, the send thread regularly finds several datagrams due */
+    snprintf(tx_opts, sizeof(tx_opts), "bitrate=1000000000&batch_size=%d&gso=%d",
+             batch_size, gso);
+    ret = test(rx_opts, tx_opts, 0, &duration);
+    printf("\n");
+    return ret;
+}
+
+static int test_pacing(const char *tx_opts, int ts)
+{
+    int64_t duration;
+    int ret;
+
+    printf("%s: ", tx_opts);
+    ret = test("", tx_opts, ts, &duration);
+    if (ret >= 0) {
+        /* only the lower bound holds on a loaded machine */
+        printf(", sent in %s %d ms", duration >= MIN_DURATION ? "at least" : "less than",
+               MIN_DURATION / 1000);
+        if (duration < MIN_DURATION)
+            ret = AVERROR(EINVAL);
+    }
+    printf("\n");
+    return ret;
+}
+
+int main(void)
+{
+    static const int configs[][3] = {
+        { 1, 0, 0 }, { 8, 0, 0 }, { 32, 0, 0 }, { 32, 1, 0 }, { 32, 0, 1 }, { 32, 1, 1 },
+    };
+    static const char *const pacing[] = {
+        "bitrate=20000000", "bitrate=20000000&pacing_spin=500",
+        "pcr_pacing=1", "pcr_pacing=1&pacing_spin=500", "pcr_pacing=1&batch_size=1",
+    };
+    int ret = 0;
+
+    av_log_set_level(AV_LOG_ERROR);
+    if (!ff_network_init())
+        return 1;
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(configs) && ret >= 0; i++)
+        ret = test_batch(configs[i][0], configs[i][1], configs[i][2]);
+    for (int i = 0; i < FF_ARRAY_ELEMS(pacing) && ret >= 0; i++)
+        ret = test_pacing(pacing[i], !strncmp(pacing[i], "pcr", 3));
+
+    ff_network_close();
+    return ret < 0;
+}
@@ -64,6 +64,17 @@ static int set_options(TLSShared *c, const char *uri)
     return 0;
 }
 
+int ff_tls_set_session_data(TLSShared *c, const uint8_t *data, int size)
+{
+    uint8_t *buf = av_memdup(data, size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    av_free(c->session_data);
+    c->session_data      = buf;
+    c->session_data_size = size;
+    return 0;
+}
+
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options)
 {
     int port;
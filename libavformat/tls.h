@@ -39,6 +39,10 @@ typedef struct TLSShared {
     char underlying_host[200];
     int numerichost;
 
+    /* serialized client session, resumed if set before the handshake */
+    uint8_t *session_data;
+    int session_data_size;
+
     URLContext *tcp;
 } TLSShared;
 
@@ -51,10 +55,16 @@ typedef struct TLSShared {
     {"key_file",   "Private key file",                    offsetof(pstruct, options_field . key_file),  AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
     {"listen",     "Listen for incoming connections",     offsetof(pstruct, options_field . listen),    AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, .flags = TLS_OPTFL }, \
     {"verifyhost", "Verify against a specific hostname",  offsetof(pstruct, options_field . host),      AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
-    {"http_proxy", "Set proxy to tunnel through",         offsetof(pstruct, options_field . http_proxy), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }
+    {"http_proxy", "Set proxy to tunnel through",         offsetof(pstruct, options_field . http_proxy), AV_OPT_TYPE_STRING, .flags = TLS_OPTFL }, \
+    {"tls_session", "Session to resume, exports the session of the connection", offsetof(pstruct, options_field . session_data), AV_OPT_TYPE_BINARY, .flags = TLS_OPTFL | AV_OPT_FLAG_EXPORT }
 
 int ff_tls_open_underlying(TLSShared *c, URLContext *parent, const char *uri, AVDictionary **options);
 
+/**
+ * Replace the exported session data with a copy of data.
+ */
+int ff_tls_set_session_data(TLSShared *c, const uint8_t *data, int size);
+
 void ff_gnutls_init(void);
 void ff_gnutls_deinit(void);
 
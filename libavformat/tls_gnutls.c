@@ -48,6 +48,7 @@ typedef struct TLSContext {
     gnutls_certificate_credentials_t cred;
     int need_shutdown;
     int io_err;
+    int session_stored;
 } TLSContext;
 
 static AVMutex gnutls_mutex = AV_MUTEX_INITIALIZER;
@@ -147,6 +148,27 @@ static ssize_t gnutls_url_push(gnutls_transport_ptr_t transport,
     return -1;
 }
 
+static void store_session(TLSContext *p)
+{
+    gnutls_datum_t data;
+
+    if (!gnutls_session_get_data2(p->session, &data)) {
+        ff_tls_set_session_data(&p->tls_shared, data.data, data.size);
+        gnutls_free(data.data);
+    }
+}
+
+/* With TLS 1.3 the session ticket is sent after the handshake. */
+static int session_ticket_pending(TLSContext *p)
+{
+#if GNUTLS_VERSION_NUMBER >= 0x030603
+    return gnutls_protocol_get_version(p->session) == GNUTLS_TLS1_3 &&
+           !(gnutls_session_get_flags(p->session) & GNUTLS_SFLAGS_SESSION_TICKET);
+#else
+    return 0;
+#endif
+}
+
 static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **options)
 {
     TLSContext *p = h->priv_data;
@@ -191,6 +213,12 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     gnutls_transport_set_push_function(p->session, gnutls_url_push);
     gnutls_transport_set_ptr(p->session, p);
     gnutls_set_default_priority(p->session);
+    if (!c->listen && c->session_data) {
+        ret = gnutls_session_set_data(p->session, c->session_data, c->session_data_size);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Unable to use the TLS session to resume: %s\n",
+                   gnutls_strerror(ret));
+    }
     do {
         if (ff_check_interrupt(&h->interrupt_callback)) {
             ret = AVERROR_EXIT;
@@ -204,6 +232,14 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         }
     } while (ret);
     p->need_shutdown = 1;
+    if (!c->listen) {
+        if (gnutls_session_is_resumed(p->session))
+            av_log(h, AV_LOG_VERBOSE, "Resumed TLS session\n");
+        if (!session_ticket_pending(p)) {
+            store_session(p);
+            p->session_stored = 1;
+        }
+    }
     if (c->verify) {
         unsigned int status, cert_list_size;
         gnutls_x509_crt_t cert;
@@ -251,8 +287,14 @@ static int tls_read(URLContext *h, uint8_t *buf, int size)
     c->tls_shared.tcp->flags &= ~AVIO_FLAG_NONBLOCK;
     c->tls_shared.tcp->flags |= h->flags & AVIO_FLAG_NONBLOCK;
     ret = gnutls_record_recv(c->session, buf, size);
-    if (ret > 0)
+    if (ret > 0) {
+        if (!c->session_stored && !c->tls_shared.listen &&
+            !session_ticket_pending(c)) {
+            store_session(c);
+            c->session_stored = 1;
+        }
         return ret;
+    }
     if (ret == 0)
         return AVERROR_EOF;
     return print_tls_error(h, ret);
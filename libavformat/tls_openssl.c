@@ -23,6 +23,7 @@
 #include "os_support.h"
 #include "url.h"
 #include "tls.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 
 #include <openssl/bio.h>
@@ -236,6 +237,22 @@ static int url_bio_bputs(BIO *b, const char *str)
     return url_bio_bwrite(b, str, strlen(str));
 }
 
+static int new_session_cb(SSL *ssl, SSL_SESSION *sess)
+{
+    URLContext *h = SSL_get_app_data(ssl);
+    TLSContext *c = h->priv_data;
+    unsigned char *buf, *p;
+    int len = i2d_SSL_SESSION(sess, NULL);
+
+    if (len <= 0 || !(buf = p = av_malloc(len)))
+        return 0;
+    i2d_SSL_SESSION(sess, &p);
+    ff_tls_set_session_data(&c->tls_shared, buf, len);
+    av_free(buf);
+    /* the session is only kept serialized */
+    return 0;
+}
+
 #if OPENSSL_VERSION_NUMBER < 0x1010000fL
 static BIO_METHOD url_bio_method = {
     .type = BIO_TYPE_SOURCE_SINK,
@@ -296,12 +313,25 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
     // the requested hostname.
     if (c->verify)
         SSL_CTX_set_verify(p->ctx, SSL_VERIFY_PEER|SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+    if (!c->listen) {
+        SSL_CTX_set_session_cache_mode(p->ctx, SSL_SESS_CACHE_CLIENT |
+                                               SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(p->ctx, new_session_cb);
+    }
     p->ssl = SSL_new(p->ctx);
     if (!p->ssl) {
         av_log(h, AV_LOG_ERROR, "%s\n", ERR_error_string(ERR_get_error(), NULL));
         ret = AVERROR(EIO);
         goto fail;
     }
+    SSL_set_app_data(p->ssl, h);
+    if (!c->listen && c->session_data) {
+        const unsigned char *data = c->session_data;
+        SSL_SESSION *sess = d2i_SSL_SESSION(NULL, &data, c->session_data_size);
+        if (!sess || !SSL_set_session(p->ssl, sess))
+            av_log(h, AV_LOG_WARNING, "Unable to use the TLS session to resume\n");
+        SSL_SESSION_free(sess);
+    }
 #if OPENSSL_VERSION_NUMBER >= 0x1010000fL
     p->url_bio_method = BIO_meth_new(BIO_TYPE_SOURCE_SINK, "urlprotocol bio");
     BIO_meth_set_write(p->url_bio_method, url_bio_bwrite);
@@ -328,6 +358,8 @@ static int tls_open(URLContext *h, const char *uri, int flags, AVDictionary **op
         ret = print_tls_error(h, ret);
         goto fail;
     }
+    if (!c->listen && SSL_session_reused(p->ssl))
+        av_log(h, AV_LOG_VERBOSE, "Resumed TLS session\n");
 
     return 0;
 fail:
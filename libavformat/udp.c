@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() */
 
 #include "avformat.h"
 #include "libavutil/avassert.h"
@@ -36,6 +37,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
 #include "libavutil/time.h"
+#include "mpegts.h"
 #include "network.h"
 #include "os_support.h"
 #include "url.h"
@@ -68,6 +70,10 @@
 #include "libavutil/thread.h"
 #endif
 
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
+
 #ifndef IPV6_ADD_MEMBERSHIP
 #define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
@@ -77,6 +83,8 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_MAX_SEGMENTS 64 /* maximum number of segments of one UDP_SEGMENT send */
+#define UDP_MAX_GSO_SIZE (65535 - 40 - UDP_HEADER_SIZE)
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -100,6 +108,8 @@ typedef struct UDPContext {
     int circular_buffer_error;
     int64_t bitrate; /* number of bits to send per second */
     int64_t burst_bits;
+    int pcr_pacing;
+    int pacing_spin;
     int close_req;
 #if HAVE_PTHREAD_CANCEL
     pthread_t circular_buffer_thread;
@@ -108,6 +118,19 @@ typedef struct UDPContext {
     int thread_started;
 #endif
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
+    /* Batched I/O of the circular buffer thread */
+    int batch_size;
+    int gso;
+    int gro;
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+    struct sockaddr_storage *addrs;
+    uint8_t *cmsgs;
+    uint8_t *batch_buf;
+    int *msg_pkts;      ///< number of packets in each message of a send batch
+    int nb_batch;       ///< number of packets queued for sending
+#endif
     int remaining_in_dg;
     char *localaddr;
     int timeout;
@@ -124,6 +147,8 @@ static const AVOption options[] = {
     { "buffer_size",    "System data size (in bytes)",                     OFFSET(buffer_size),    AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "bitrate",        "Bits to send per second",                         OFFSET(bitrate),        AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
     { "burst_bits",     "Max length of bursts in bits (when using bitrate)", OFFSET(burst_bits),   AV_OPT_TYPE_INT64,  { .i64 = 0  },     0, INT64_MAX, .flags = E },
+    { "pcr_pacing",     "Send MPEG-TS packets at the time given by their PCR", OFFSET(pcr_pacing), AV_OPT_TYPE_BOOL,   { .i64 = 0  },     0, 1,       E },
+    { "pacing_spin",    "Busy-wait this long in microseconds before a paced packet instead of sleeping", OFFSET(pacing_spin), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1000000, E },
     { "localport",      "Local port",                                      OFFSET(local_port),     AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, D|E },
     { "local_port",     "Local port",                                      OFFSET(local_port),     AV_OPT_TYPE_INT,    { .i64 = -1 },    -1, INT_MAX, .flags = D|E },
     { "localaddr",      "Local address",                                   OFFSET(localaddr),      AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -139,6 +164,9 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch_size",     "Number of datagrams received or sent with one system call by the circular buffer thread", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = 32 }, 1, 1024, .flags = D|E },
+    { "gso",            "Use UDP segmentation offload to send batches",    OFFSET(gso),            AV_OPT_TYPE_BOOL,   { .i64 = 0  },     0, 1,       E },
+    { "gro",            "Use UDP generic receive offload",                 OFFSET(gro),            AV_OPT_TYPE_BOOL,   { .i64 = 0  },     0, 1,       D },
     { NULL }
 };
 
@@ -479,6 +507,169 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+#define UDP_CMSG_SIZE CMSG_SPACE(sizeof(int))
+
+static int udp_alloc_batch(UDPContext *s)
+{
+    const int n = s->batch_size;
+
+    s->msgs      = av_calloc(n, sizeof(*s->msgs));
+    s->iovs      = av_calloc(n, sizeof(*s->iovs));
+    s->addrs     = av_calloc(n, sizeof(*s->addrs));
+    s->cmsgs     = av_calloc(n, UDP_CMSG_SIZE);
+    s->msg_pkts  = av_calloc(n, sizeof(*s->msg_pkts));
+    s->batch_buf = av_malloc_array(n, UDP_MAX_PKT_SIZE);
+    if (!s->msgs || !s->iovs || !s->addrs || !s->cmsgs ||
+        !s->msg_pkts || !s->batch_buf)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < n; i++)
+        s->iovs[i].iov_base = s->batch_buf + (size_t)i * UDP_MAX_PKT_SIZE;
+    return 0;
+}
+#endif
+
+static void udp_free_batch(UDPContext *s)
+{
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    av_freep(&s->msgs);
+    av_freep(&s->iovs);
+    av_freep(&s->addrs);
+    av_freep(&s->cmsgs);
+    av_freep(&s->msg_pkts);
+    av_freep(&s->batch_buf);
+#endif
+}
+
+/**
+ * Enable the segmentation offloads requested with the gso and gro options.
+ * They are only used with batched I/O and disabled if the system lacks them.
+ */
+static void udp_set_offload(URLContext *h, int is_output)
+{
+    UDPContext *s = h->priv_data;
+    av_unused int has_batch = 0;
+
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+    has_batch = !!s->msgs;
+#endif
+    if (is_output) {
+        s->gro = 0;
+        if (s->gso) {
+            int ret = AVERROR(ENOSYS);
+#ifdef UDP_SEGMENT
+            int val = 0;
+            /* Only probes for kernel support, the segment size is set
+             * per message. */
+            if (has_batch)
+                ret = setsockopt(s->udp_fd, IPPROTO_UDP, UDP_SEGMENT, &val, sizeof(val)) < 0 ?
+                      ff_neterrno() : 0;
+#endif
+            if (ret < 0) {
+                av_log(h, AV_LOG_WARNING, "UDP segmentation offload is not available\n");
+                s->gso = 0;
+            }
+        }
+    } else {
+        s->gso = 0;
+        if (s->gro) {
+            int ret = AVERROR(ENOSYS);
+#ifdef UDP_GRO
+            int val = 1;
+            if (has_batch)
+                ret = setsockopt(s->udp_fd, IPPROTO_UDP, UDP_GRO, &val, sizeof(val)) < 0 ?
+                      ff_neterrno() : 0;
+#endif
+            if (ret < 0) {
+                av_log(h, AV_LOG_WARNING, "UDP generic receive offload is not available\n");
+                s->gro = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Queue a received datagram for udp_read(). A datagram coalesced by GRO is
+ * split back into its segments of seg_size bytes.
+ *
+ * @return 0 if the datagram was queued or dropped, AVERROR(EIO) on a fatal
+ *         circular buffer overrun
+ */
+static int udp_queue_datagram(URLContext *h, const uint8_t *buf, int len, int seg_size)
+{
+    UDPContext *s = h->priv_data;
+    uint8_t tmp[4];
+
+    if (seg_size <= 0)
+        seg_size = len;
+
+    do {
+        int size = FFMIN(len, seg_size);
+
+        if (av_fifo_can_write(s->fifo) < size + 4) {
+            /* No Space left */
+            if (s->overrun_nonfatal) {
+                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                        "Surviving due to overrun_nonfatal option\n");
+                return 0;
+            } else {
+                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                        "To avoid, increase fifo_size URL option. "
+                        "To survive in such case, use overrun_nonfatal option\n");
+                return AVERROR(EIO);
+            }
+        }
+        AV_WL32(tmp, size);
+        av_fifo_write(s->fifo, tmp, 4);
+        av_fifo_write(s->fifo, buf, size);
+        buf += size;
+        len -= size;
+    } while (len > 0);
+
+    return 0;
+}
+
+#if HAVE_RECVMMSG
+static int udp_gro_segment_size(struct msghdr *msg)
+{
+#ifdef UDP_GRO
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int size;
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size;
+        }
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Receive up to batch_size datagrams with one system call, blocking until
+ * at least one is available.
+ */
+static int udp_recv_batch(UDPContext *s)
+{
+    for (int i = 0; i < s->batch_size; i++) {
+        struct msghdr *msg = &s->msgs[i].msg_hdr;
+
+        s->iovs[i].iov_len  = UDP_MAX_PKT_SIZE;
+        msg->msg_name       = &s->addrs[i];
+        msg->msg_namelen    = sizeof(s->addrs[i]);
+        msg->msg_iov        = &s->iovs[i];
+        msg->msg_iovlen     = 1;
+        msg->msg_control    = s->gro ? s->cmsgs + i * UDP_CMSG_SIZE : NULL;
+        msg->msg_controllen = s->gro ? UDP_CMSG_SIZE : 0;
+        msg->msg_flags      = 0;
+    }
+
+    return recvmmsg(s->udp_fd, s->msgs, s->batch_size, MSG_WAITFORONE, NULL);
+}
+#endif
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -495,7 +686,7 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, ret;
         struct sockaddr_storage addr;
         socklen_t addr_len = sizeof(addr);
 
@@ -504,7 +695,12 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+#if HAVE_RECVMMSG
+        if (s->msgs)
+            len = udp_recv_batch(s);
+        else
+#endif
+        len = recvfrom(s->udp_fd, s->tmp, sizeof(s->tmp), 0, (struct sockaddr *)&addr, &addr_len);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
         if (len < 0) {
@@ -514,25 +710,30 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
-
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+#if HAVE_RECVMMSG
+        if (s->msgs) {
+            /* len is the number of datagrams received */
+            for (int i = 0; i < len; i++) {
+                if (ff_ip_check_source_lists(&s->addrs[i], &s->filters))
+                    continue;
+                ret = udp_queue_datagram(h, s->iovs[i].iov_base, s->msgs[i].msg_len,
+                                         udp_gro_segment_size(&s->msgs[i].msg_hdr));
+                if (ret < 0) {
+                    s->circular_buffer_error = ret;
+                    goto end;
+                }
+            }
+        } else
+#endif
+        {
+            if (ff_ip_check_source_lists(&addr, &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
+            ret = udp_queue_datagram(h, s->tmp, len, 0);
+            if (ret < 0) {
+                s->circular_buffer_error = ret;
                 goto end;
             }
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
         pthread_cond_signal(&s->cond);
     }
 
@@ -542,15 +743,241 @@ end:
     return NULL;
 }
 
+#if HAVE_SENDMMSG
+/**
+ * Fill s->msgs with the queued packets starting at first. With gso, runs of
+ * packets of the same size (the last one may be shorter) are merged into one
+ * message that the kernel segments again.
+ *
+ * @return the number of messages
+ */
+static int udp_build_send_msgs(UDPContext *s, int first)
+{
+    int nb_msgs = 0;
+
+    for (int i = first; i < s->nb_batch; nb_msgs++) {
+        struct msghdr *msg = &s->msgs[nb_msgs].msg_hdr;
+        size_t seg_size = s->iovs[i].iov_len;
+        size_t total    = seg_size;
+        int n = 1;
+
+        if (s->gso && seg_size) {
+            while (i + n < s->nb_batch && n < UDP_MAX_SEGMENTS &&
+                   s->iovs[i + n - 1].iov_len == seg_size &&
+                   s->iovs[i + n].iov_len <= seg_size &&
+                   total + s->iovs[i + n].iov_len <= UDP_MAX_GSO_SIZE)
+                total += s->iovs[i + n++].iov_len;
+        }
+
+        msg->msg_name       = s->is_connected ? NULL : &s->dest_addr;
+        msg->msg_namelen    = s->is_connected ? 0 : s->dest_addr_len;
+        msg->msg_iov        = &s->iovs[i];
+        msg->msg_iovlen     = n;
+        msg->msg_control    = NULL;
+        msg->msg_controllen = 0;
+        msg->msg_flags      = 0;
+#ifdef UDP_SEGMENT
+        if (n > 1) {
+            uint16_t gso_size = seg_size;
+            struct cmsghdr *cmsg;
+
+            msg->msg_control    = s->cmsgs + nb_msgs * UDP_CMSG_SIZE;
+            msg->msg_controllen = CMSG_SPACE(sizeof(gso_size));
+            cmsg = CMSG_FIRSTHDR(msg);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type  = UDP_SEGMENT;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(gso_size));
+            memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+        }
+#endif
+        s->msg_pkts[nb_msgs] = n;
+        i += n;
+    }
+
+    return nb_msgs;
+}
+
+/**
+ * Send all queued packets, with as few system calls as possible.
+ */
+static int udp_send_batch(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int first = 0;
+
+    while (first < s->nb_batch) {
+        int nb_msgs = udp_build_send_msgs(s, first);
+        int ret = sendmmsg(s->udp_fd, s->msgs, nb_msgs, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR(EINTR))
+                continue;
+            if (s->gso && (ret == AVERROR(EIO) || ret == AVERROR(EINVAL))) {
+                /* e.g. the device does not support checksum offload */
+                av_log(h, AV_LOG_WARNING, "UDP segmentation offload failed, disabling it\n");
+                s->gso = 0;
+                continue;
+            }
+            return ret;
+        }
+        for (int i = 0; i < ret; i++)
+            first += s->msg_pkts[i];
+    }
+    s->nb_batch = 0;
+
+    return 0;
+}
+#endif
+
+#define PCR_MAX_GAP    (27000000LL / 2) ///< larger PCR steps are discontinuities
+#define PCR_MAX_OFFSET 1000000          ///< resynchronize when this late or early, in us
+
+typedef struct UDPPacer {
+    /* bitrate pacing */
+    int64_t start;
+    int64_t sent_bits;
+    int64_t burst_interval;
+    int64_t max_delay;
+
+    /* PCR pacing */
+    int     pcr_pid;
+    int64_t pos;            ///< number of bytes sent
+    int64_t ref_pcr;
+    int64_t ref_time;       ///< time at which ref_pcr is sent
+    int64_t last_pcr;
+    int64_t last_pcr_pos;
+    int64_t pcr_ticks;      ///< length of the last PCR interval in 27 MHz ticks
+    int64_t pcr_bytes;      ///< and in bytes
+} UDPPacer;
+
+/**
+ * Token bucket of burst_bits filled at bitrate.
+ *
+ * @return the time at which the next packet of len bytes may be sent
+ */
+static int64_t pace_bitrate(UDPPacer *p, const UDPContext *s, int len, int64_t now)
+{
+    int64_t target = p->start + p->sent_bits * 1000000 / s->bitrate;
+
+    if (now < target) {
+        if (target - now > p->max_delay) {
+            target     = now + p->max_delay;
+            p->start   = target;
+            p->sent_bits = 0;
+        }
+    } else if (now - p->burst_interval > target) {
+        p->start     = now - p->burst_interval;
+        p->sent_bits = 0;
+    }
+    p->sent_bits += len * 8;
+
+    return target;
+}
+
+/**
+ * Find the first PCR of the locked PCR PID in a datagram of MPEG-TS packets,
+ * which may be preceded by a header such as the RTP one.
+ */
+static int find_pcr(UDPPacer *p, const uint8_t *buf, int len, int64_t *pcr)
+{
+    int off = len % TS_PACKET_SIZE;
+
+    if (len < TS_PACKET_SIZE)
+        return 0;
+    for (int i = off; i < len; i += TS_PACKET_SIZE)
+        if (buf[i] != 0x47)
+            return 0;
+
+    for (const uint8_t *pkt = buf + off; pkt < buf + len; pkt += TS_PACKET_SIZE) {
+        int pid = AV_RB16(pkt + 1) & 0x1fff;
+
+        if (!(pkt[3] & 0x20) || pkt[4] < 7 || !(pkt[5] & 0x10))
+            continue;
+        if (p->pcr_pid < 0)
+            p->pcr_pid = pid;
+        if (pid != p->pcr_pid)
+            continue;
+        *pcr = (AV_RB32(pkt + 6) * 2LL + (pkt[10] >> 7)) * 300 +
+               ((pkt[10] & 1) << 8 | pkt[11]);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Schedule MPEG-TS datagrams on the PCR timeline. Datagrams carrying a PCR
+ * are sent at the time of their PCR, the ones in between at the rate of the
+ * previous PCR interval.
+ *
+ * @return the time at which the datagram may be sent
+ */
+static int64_t pace_pcr(UDPPacer *p, const UDPContext *s,
+                        const uint8_t *buf, int len, int64_t now)
+{
+    int64_t pcr, target;
+
+    if (find_pcr(p, buf, len, &pcr)) {
+        int64_t delta = pcr - p->last_pcr;
+
+        if (p->last_pcr == AV_NOPTS_VALUE || delta < 0 || delta > PCR_MAX_GAP) {
+            p->ref_pcr   = pcr;
+            p->ref_time  = now;
+            p->pcr_bytes = 0;
+        } else {
+            p->pcr_ticks = delta;
+            p->pcr_bytes = p->pos - p->last_pcr_pos;
+        }
+        p->last_pcr     = pcr;
+        p->last_pcr_pos = p->pos;
+        target = p->ref_time + (pcr - p->ref_pcr) / 27;
+    } else if (p->pcr_bytes > 0) {
+        /* not later than the expected time of the next PCR */
+        int64_t ticks = FFMIN((p->pos - p->last_pcr_pos) * p->pcr_ticks / p->pcr_bytes,
+                              p->pcr_ticks);
+        target = p->ref_time + (p->last_pcr - p->ref_pcr + ticks) / 27;
+    } else {
+        /* no rate known yet */
+        target = s->bitrate ? pace_bitrate(p, s, len, now) : now;
+    }
+    p->pos += len;
+
+    if (p->last_pcr != AV_NOPTS_VALUE &&
+        FFABS(target - now) > PCR_MAX_OFFSET) {
+        /* The input is not in real time, restart from the current time
+         * instead of sending a burst or stalling. */
+        p->ref_time += now - target;
+        target       = now;
+    }
+
+    return target;
+}
+
+/**
+ * Sleep until target, busy-waiting for the last pacing_spin microseconds
+ * to avoid the wakeup latency of the scheduler.
+ */
+static void wait_until(const UDPContext *s, int64_t target)
+{
+    int64_t now = av_gettime_relative();
+
+    if (target - now > s->pacing_spin)
+        av_usleep(target - now - s->pacing_spin);
+    if (s->pacing_spin)
+        while (av_gettime_relative() < target);
+}
+
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
-    int64_t target_timestamp = av_gettime_relative();
-    int64_t start_timestamp = av_gettime_relative();
-    int64_t sent_bits = 0;
-    int64_t burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0;
-    int64_t max_delay = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0;
+    UDPPacer pacer = {
+        .start          = av_gettime_relative(),
+        .burst_interval = s->bitrate ? (s->burst_bits * 1000000 / s->bitrate) : 0,
+        .max_delay      = s->bitrate ?  ((int64_t)h->max_packet_size * 8 * 1000000 / s->bitrate + 1) : 0,
+        .pcr_pid        = -1,
+        .last_pcr       = AV_NOPTS_VALUE,
+    };
+    int ret;
 
     ff_thread_setname("udp-tx");
 
@@ -564,12 +991,24 @@ static void *circular_buffer_task_tx( void *_URLContext)
 
     for(;;) {
         int len;
-        const uint8_t *p;
+        uint8_t *p;
         uint8_t tmp[4];
-        int64_t timestamp;
+        int64_t timestamp, target;
 
         len = av_fifo_can_read(s->fifo);
 
+#if HAVE_SENDMMSG
+        if (len < 4 && s->nb_batch) {
+            /* Nothing else is pending, send the batch before waiting */
+            pthread_mutex_unlock(&s->mutex);
+            ret = udp_send_batch(h);
+            if (ret < 0)
+                goto fail;
+            pthread_mutex_lock(&s->mutex);
+            continue;
+        }
+#endif
+
         while (len<4) {
             if (s->close_req)
                 goto end;
@@ -583,33 +1022,47 @@ static void *circular_buffer_task_tx( void *_URLContext)
         av_assert0(len >= 0);
         av_assert0(len <= sizeof(s->tmp));
 
-        av_fifo_read(s->fifo, s->tmp, len);
+        p = s->tmp;
+#if HAVE_SENDMMSG
+        if (s->msgs)
+            p = s->iovs[s->nb_batch].iov_base;
+#endif
+        av_fifo_read(s->fifo, p, len);
 
         pthread_mutex_unlock(&s->mutex);
 
-        if (s->bitrate) {
+        if (s->bitrate || s->pcr_pacing) {
             timestamp = av_gettime_relative();
-            if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
-                if (delay > max_delay) {
-                    delay = max_delay;
-                    start_timestamp = timestamp + delay;
-                    sent_bits = 0;
-                }
-                av_usleep(delay);
-            } else {
-                if (timestamp - burst_interval > target_timestamp) {
-                    start_timestamp = timestamp - burst_interval;
-                    sent_bits = 0;
+            target = s->pcr_pacing ? pace_pcr(&pacer, s, p, len, timestamp) :
+                                     pace_bitrate(&pacer, s, len, timestamp);
+            if (timestamp < target) {
+#if HAVE_SENDMMSG
+                if (s->nb_batch) {
+                    /* Send the packets that are due before waiting */
+                    int slot = s->nb_batch;
+                    ret = udp_send_batch(h);
+                    if (ret < 0)
+                        goto fail;
+                    /* and move the packet just read to the start of the batch */
+                    FFSWAP(void *, s->iovs[0].iov_base, s->iovs[slot].iov_base);
                 }
+#endif
+                wait_until(s, target);
             }
-            sent_bits += len * 8;
-            target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
         }
 
-        p = s->tmp;
+#if HAVE_SENDMMSG
+        if (s->msgs) {
+            s->iovs[s->nb_batch++].iov_len = len;
+            if (s->nb_batch == s->batch_size) {
+                ret = udp_send_batch(h);
+                if (ret < 0)
+                    goto fail;
+            }
+            len = 0;
+        }
+#endif
         while (len) {
-            int ret;
             av_assert0(len > 0);
             if (!s->is_connected) {
                 ret = sendto (s->udp_fd, p, len, 0,
@@ -622,18 +1075,17 @@ static void *circular_buffer_task_tx( void *_URLContext)
                 p   += ret;
             } else {
                 ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
-                }
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    goto fail;
             }
         }
 
         pthread_mutex_lock(&s->mutex);
     }
 
+fail:
+    pthread_mutex_lock(&s->mutex);
+    s->circular_buffer_error = ret;
 end:
     pthread_mutex_unlock(&s->mutex);
     return NULL;
@@ -735,6 +1187,25 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "burst_bits", p)) {
             s->burst_bits = strtoll(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "pcr_pacing", p)) {
+            s->pcr_pacing = strtol(buf, NULL, 10);
+            if (!HAVE_PTHREAD_CANCEL)
+                av_log(h, AV_LOG_WARNING,
+                       "'pcr_pacing' option was set but it is not supported "
+                       "on this build (pthread support is required)\n");
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "pacing_spin", p)) {
+            s->pacing_spin = av_clip(strtol(buf, NULL, 10), 0, 1000000);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, 1024);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gso", p)) {
+            s->gso = strtol(buf, NULL, 10);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gro", p)) {
+            s->gro = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "localaddr", p)) {
             av_freep(&s->localaddr);
             s->localaddr = av_strdup(buf);
@@ -925,21 +1396,30 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     /*
       Create thread in case of:
       1. Input and circular_buffer_size is set
-      2. Output and bitrate and circular_buffer_size is set
+      2. Output and bitrate or pcr_pacing and circular_buffer_size is set
     */
 
-    if (is_output && s->bitrate && !s->circular_buffer_size) {
+    if (is_output && (s->bitrate || s->pcr_pacing) && !s->circular_buffer_size) {
         /* Warn user in case of 'circular_buffer_size' is not set */
-        av_log(h, AV_LOG_WARNING,"'bitrate' option was set but 'circular_buffer_size' is not, but required\n");
+        av_log(h, AV_LOG_WARNING,"'bitrate' or 'pcr_pacing' option was set but 'circular_buffer_size' is not, but required\n");
     }
 
-    if ((!is_output && s->circular_buffer_size) || (is_output && s->bitrate && s->circular_buffer_size)) {
+    if ((!is_output && s->circular_buffer_size) ||
+        (is_output && (s->bitrate || s->pcr_pacing) && s->circular_buffer_size)) {
         /* start the task going */
         s->fifo = av_fifo_alloc2(s->circular_buffer_size, 1, 0);
         if (!s->fifo) {
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        if (s->batch_size > 1 && (is_output ? HAVE_SENDMMSG : HAVE_RECVMMSG)) {
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+            ret = udp_alloc_batch(s);
+            if (ret < 0)
+                goto fail;
+#endif
+        }
+        udp_set_offload(h, is_output);
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -973,6 +1453,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    udp_free_batch(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -1142,6 +1625,9 @@ static int udp_close(URLContext *h)
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
+#if HAVE_PTHREAD_CANCEL
+    udp_free_batch(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return 0;
 }
@@ -26,6 +26,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -46,6 +47,7 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int readahead_size;         /**< size of the background read-ahead buffer, 0 if disabled */
 } URLContext;
 
 typedef struct URLProtocol {
@@ -83,6 +85,7 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    int (*url_get_mapped_buffer)(URLContext *h, AVBufferRef **buf);
     int (*url_shutdown)(URLContext *h, int flags);
     const AVClass *priv_data_class;
     int priv_data_size;
@@ -263,6 +266,15 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(void *urlcontext);
 
+/**
+ * Return a reference to the whole resource if it is mapped in memory.
+ * Offsets in the buffer correspond to positions in the resource. The buffer
+ * is followed by AV_INPUT_BUFFER_PADDING_SIZE readable zero bytes.
+ *
+ * @return 0 on success, AVERROR(ENOSYS) if the resource is not mapped
+ */
+int ffurl_get_mapped_buffer(URLContext *h, AVBufferRef **buf);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
@@ -85,6 +85,8 @@ static const AVOption options[]={
 {"phase_shift"          , "set swr resampling phase shift", OFFSET(phase_shift)  , AV_OPT_TYPE_INT  , {.i64=10                    }, 0      , 24        , PARAM },
 {"linear_interp"        , "enable linear interpolation" , OFFSET(linear_interp)  , AV_OPT_TYPE_BOOL , {.i64=1                     }, 0      , 1         , PARAM },
 {"exact_rational"       , "enable exact rational"       , OFFSET(exact_rational) , AV_OPT_TYPE_BOOL , {.i64=1                     }, 0      , 1         , PARAM },
+{"threads"              , "set the number of threads"   , OFFSET(threads)        , AV_OPT_TYPE_INT  , {.i64=1                     }, 0      , INT_MAX   , PARAM, .unit = "threads"},
+    {"auto"             , "use as many threads as CPUs" , 0                      , AV_OPT_TYPE_CONST, {.i64=0                     }, INT_MIN, INT_MAX   , PARAM, .unit = "threads"},
 {"cutoff"               , "set cutoff frequency ratio"  , OFFSET(cutoff)         , AV_OPT_TYPE_DOUBLE,{.dbl=0.                    }, 0      , 1         , PARAM },
 
 /* duplicate option in order to work with avconv */
@@ -177,13 +177,61 @@ static void resample_free(ResampleContext **cc){
     ResampleContext *c = *cc;
     if(!c)
         return;
+    avpriv_slicethread_free(&c->slicethread);
     av_freep(&c->filter_bank);
     av_freep(cc);
 }
 
+static void resample_worker(void *priv, int jobnr, int threadnr,
+                            int nb_jobs, int nb_threads)
+{
+    ResampleContext *c = priv;
+    AudioData *dst = c->job_dst;
+    const AudioData *src = c->job_src;
+    int ch_start = dst->ch_count *  jobnr      / nb_jobs;
+    int ch_end   = dst->ch_count * (jobnr + 1) / nb_jobs;
+
+    if (!c->job_linear && c->dsp.resample_common_multi && ch_end - ch_start > 1) {
+        c->dsp.resample_common_multi(c, dst->ch + ch_start, src->ch + ch_start,
+                                     ch_end - ch_start, c->job_n, 0);
+    } else {
+        for (int i = ch_start; i < ch_end; i++) {
+            if (c->job_linear)
+                c->dsp.resample_linear(c, dst->ch[i], src->ch[i], c->job_n, 0);
+            else
+                c->dsp.resample_common(c, dst->ch[i], src->ch[i], c->job_n, 0);
+        }
+    }
+}
+
+static int resample_init_threads(ResampleContext *c, int threads)
+{
+    int ret;
+
+    if (c->slicethread && c->threads == threads)
+        return 0;
+
+    avpriv_slicethread_free(&c->slicethread);
+    c->threads    = threads;
+    c->nb_threads = 1;
+    if (threads == 1)
+        return 0;
+
+    ret = avpriv_slicethread_create(&c->slicethread, c, resample_worker,
+                                    NULL, threads);
+    if (ret == AVERROR(ENOSYS))
+        return 0;
+    else if (ret < 0)
+        return ret;
+
+    c->nb_threads = ret;
+    return 0;
+}
+
 static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_rate, int filter_size, int phase_shift, int linear,
                                     double cutoff0, enum AVSampleFormat format, enum SwrFilterType filter_type, double kaiser_beta,
-                                    double precision, int cheby, int exact_rational)
+                                    double precision, int cheby, int exact_rational,
+                                    int nb_threads)
 {
     double cutoff = cutoff0? cutoff0 : 0.97;
     double factor= FFMIN(out_rate * cutoff / in_rate, 1.0);
@@ -270,8 +318,12 @@ static ResampleContext *resample_init(ResampleContext *c, int out_rate, int in_r
 
     swri_resample_dsp_init(c);
 
+    if (resample_init_threads(c, nb_threads) < 0)
+        goto error;
+
     return c;
 error:
+    avpriv_slicethread_free(&c->slicethread);
     av_freep(&c->filter_bank);
     av_free(c);
     return NULL;
@@ -388,8 +440,31 @@ static int multiple_resample(ResampleContext *c, AudioData *dst, int dst_size, A
              * when frac and dst_incr_mod are zero */
             resample_func = (c->linear && (c->frac || c->dst_incr_mod)) ?
                             c->dsp.resample_linear : c->dsp.resample_common;
-            for (i = 0; i < dst->ch_count; i++)
-                *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
+            if (c->nb_threads > 1 && dst->ch_count > 1) {
+                int64_t frac = c->frac + dst_size * (int64_t)c->dst_incr_mod;
+                int64_t index = c->index + dst_size * (int64_t)c->dst_incr_div +
+                                frac / c->src_incr;
+
+                c->job_dst    = dst;
+                c->job_src    = src;
+                c->job_n      = dst_size;
+                c->job_linear = resample_func == c->dsp.resample_linear;
+                avpriv_slicethread_execute(c->slicethread,
+                                           FFMIN(c->nb_threads, dst->ch_count), 0);
+
+                /* the jobs do not update the context, advance it here the
+                 * same way the resample functions do */
+                *consumed = index / c->phase_count;
+                c->index  = index % c->phase_count;
+                c->frac   = frac % c->src_incr;
+            } else if (resample_func == c->dsp.resample_common && c->dsp.resample_common_multi &&
+                       dst->ch_count > 1) {
+                *consumed = c->dsp.resample_common_multi(c, dst->ch, src->ch,
+                                                         dst->ch_count, dst_size, 1);
+            } else {
+                for (i = 0; i < dst->ch_count; i++)
+                    *consumed = resample_func(c, dst->ch[i], src->ch[i], dst_size, i+1 == dst->ch_count);
+            }
         }
     }
 
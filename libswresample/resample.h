@@ -24,6 +24,7 @@
 
 #include "libavutil/log.h"
 #include "libavutil/samplefmt.h"
+#include "libavutil/slicethread.h"
 
 #include "swresample_internal.h"
 
@@ -50,6 +51,15 @@ typedef struct ResampleContext {
     int filter_shift;
     int phase_count_compensation;      /* desired phase_count when compensation is enabled */
 
+    AVSliceThread *slicethread;
+    int threads;                       /* requested number of threads, 0 for auto */
+    int nb_threads;                    /* actual number of threads */
+    /* arguments of the jobs of a threaded multiple_resample() */
+    AudioData *job_dst;
+    const AudioData *job_src;
+    int job_n;
+    int job_linear;
+
     struct {
         void (*resample_one)(void *dst, const void *src,
                              int n, int64_t index, int64_t incr);
@@ -57,6 +67,14 @@ typedef struct ResampleContext {
                                const void *src, int n, int update_ctx);
         int (*resample_linear)(struct ResampleContext *c, void *dst,
                                const void *src, int n, int update_ctx);
+        /* resample_common() for ch_count planar channels, NULL if only
+         * resample_common() has an architecture specific version; there is
+         * no SIMD version, so with asm enabled this covers s32p everywhere
+         * and s16p/fltp/dblp only on architectures without resample_common
+         * kernels */
+        int (*resample_common_multi)(struct ResampleContext *c, uint8_t *const *dst,
+                                     uint8_t *const *src, int ch_count, int n,
+                                     int update_ctx);
     } dsp;
 } ResampleContext;
 
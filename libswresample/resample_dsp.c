@@ -27,6 +27,9 @@
 
 #include "resample.h"
 
+/** number of channels resampled together by resample_common_multi() */
+#define MULTI_CH 4
+
 #define TEMPLATE_RESAMPLE_S16
 #include "resample_template.c"
 #undef TEMPLATE_RESAMPLE_S16
@@ -45,29 +48,40 @@
 
 void swri_resample_dsp_init(ResampleContext *c)
 {
+    int (*common)(ResampleContext *c, void *dst, const void *src, int n, int update_ctx);
+    int (*common_multi)(ResampleContext *c, uint8_t *const *dst, uint8_t *const *src,
+                        int ch_count, int n, int update_ctx);
+
     switch(c->format){
     case AV_SAMPLE_FMT_S16P:
         c->dsp.resample_one = resample_one_int16;
         c->dsp.resample_common = resample_common_int16;
+        c->dsp.resample_common_multi = resample_common_multi_int16;
         c->dsp.resample_linear = resample_linear_int16;
         break;
     case AV_SAMPLE_FMT_S32P:
         c->dsp.resample_one = resample_one_int32;
         c->dsp.resample_common = resample_common_int32;
+        c->dsp.resample_common_multi = resample_common_multi_int32;
         c->dsp.resample_linear = resample_linear_int32;
         break;
     case AV_SAMPLE_FMT_FLTP:
         c->dsp.resample_one = resample_one_float;
         c->dsp.resample_common = resample_common_float;
+        c->dsp.resample_common_multi = resample_common_multi_float;
         c->dsp.resample_linear = resample_linear_float;
         break;
     case AV_SAMPLE_FMT_DBLP:
         c->dsp.resample_one = resample_one_double;
         c->dsp.resample_common = resample_common_double;
+        c->dsp.resample_common_multi = resample_common_multi_double;
         c->dsp.resample_linear = resample_linear_double;
         break;
     }
 
+    common       = c->dsp.resample_common;
+    common_multi = c->dsp.resample_common_multi;
+
 #if ARCH_X86
     swri_resample_dsp_x86_init(c);
 #elif ARCH_ARM
@@ -75,4 +89,10 @@ void swri_resample_dsp_init(ResampleContext *c)
 #elif ARCH_AARCH64
     swri_resample_dsp_aarch64_init(c);
 #endif
+
+    /* the C resample_common_multi() must not replace an architecture
+     * specific resample_common() */
+    if (c->dsp.resample_common != common &&
+        c->dsp.resample_common_multi == common_multi)
+        c->dsp.resample_common_multi = NULL;
 }
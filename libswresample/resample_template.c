@@ -140,6 +140,112 @@ static int RENAME(resample_common)(ResampleContext *c,
     return sample_index;
 }
 
+static av_always_inline int RENAME(resample_common_group)(ResampleContext *c,
+                                                         uint8_t *const *dest,
+                                                         uint8_t *const *source,
+                                                         const int nb_ch, int n,
+                                                         int *pindex, int *pfrac)
+{
+    DELEM *dst[MULTI_CH];
+    const DELEM *src[MULTI_CH];
+    int dst_index, ch;
+    int index= c->index;
+    int frac= c->frac;
+    int sample_index = 0;
+
+    for (ch = 0; ch < nb_ch; ch++) {
+        dst[ch] = (DELEM *)dest[ch];
+        src[ch] = (const DELEM *)source[ch];
+    }
+
+    while (index >= c->phase_count) {
+        sample_index++;
+        index -= c->phase_count;
+    }
+
+    for (dst_index = 0; dst_index < n; dst_index++) {
+        FELEM *filter = ((FELEM *) c->filter_bank) + c->filter_alloc * index;
+        FELEM2 val[MULTI_CH], val2[MULTI_CH];
+        int i;
+
+        for (ch = 0; ch < nb_ch; ch++) {
+            val[ch]  = FOFFSET;
+            val2[ch] = 0;
+        }
+        for (i = 0; i + 1 < c->filter_length; i+=2) {
+            const FELEM2 f0 = filter[i], f1 = filter[i + 1];
+            for (ch = 0; ch < nb_ch; ch++) {
+                val[ch]  += src[ch][sample_index + i    ] * f0;
+                val2[ch] += src[ch][sample_index + i + 1] * f1;
+            }
+        }
+        if (i < c->filter_length)
+            for (ch = 0; ch < nb_ch; ch++)
+                val[ch] += src[ch][sample_index + i] * (FELEM2)filter[i];
+        for (ch = 0; ch < nb_ch; ch++) {
+#ifdef FELEML
+            OUT(dst[ch][dst_index], val[ch] + (FELEML)val2[ch]);
+#else
+            OUT(dst[ch][dst_index], val[ch] + val2[ch]);
+#endif
+        }
+
+        frac  += c->dst_incr_mod;
+        index += c->dst_incr_div;
+        if (frac >= c->src_incr) {
+            frac -= c->src_incr;
+            index++;
+        }
+
+        while (index >= c->phase_count) {
+            sample_index++;
+            index -= c->phase_count;
+        }
+    }
+
+    *pindex = index;
+    *pfrac  = frac;
+    return sample_index;
+}
+
+/**
+ * Same as resample_common() for all channels at once. Groups of channels
+ * share each load of the filter coefficients and the phase computation.
+ * C only; it is not used where resample_common() has a SIMD version.
+ */
+static int RENAME(resample_common_multi)(ResampleContext *c,
+                                         uint8_t *const *dest,
+                                         uint8_t *const *source,
+                                         int ch_count, int n, int update_ctx)
+{
+    int index, frac, sample_index = 0, ch;
+
+    for (ch = 0; ch + MULTI_CH <= ch_count; ch += MULTI_CH)
+        sample_index = RENAME(resample_common_group)(c, dest + ch, source + ch,
+                                                     MULTI_CH, n, &index, &frac);
+    switch (ch_count - ch) {
+    case 3:
+        sample_index = RENAME(resample_common_group)(c, dest + ch, source + ch,
+                                                     3, n, &index, &frac);
+        break;
+    case 2:
+        sample_index = RENAME(resample_common_group)(c, dest + ch, source + ch,
+                                                     2, n, &index, &frac);
+        break;
+    case 1:
+        sample_index = RENAME(resample_common_group)(c, dest + ch, source + ch,
+                                                     1, n, &index, &frac);
+        break;
+    }
+
+    if(update_ctx){
+        c->frac= frac;
+        c->index= index;
+    }
+
+    return sample_index;
+}
+
 static int RENAME(resample_linear)(ResampleContext *c,
                                    void *dest, const void *source,
                                    int n, int update_ctx)
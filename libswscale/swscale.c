@@ -1239,6 +1239,136 @@ int sws_scale_frame(SwsContext *sws, AVFrame *dst, const AVFrame *src)
     return ret;
 }
 
+#define MULTI_BAND_HEIGHT 16
+
+typedef struct MultiOutput {
+    int parent;     ///< index of the destination used as source, -1 for src
+    int in_fed;     ///< source lines passed to the scaler so far
+    int out_done;   ///< destination lines written so far
+    int align;      ///< vertical alignment of the source slices
+} MultiOutput;
+
+static int multi_band_ok(SwsContext *sws)
+{
+    SwsInternal *c = sws_internal(sws);
+    const AVPixFmtDescriptor *desc;
+
+    /* a sliced call would run on the first slice context only */
+    if (c->nb_slice_ctx > 1)
+        return 0;
+    if (c->nb_slice_ctx)
+        c = sws_internal(c->slice_ctx[0]);
+    desc = av_pix_fmt_desc_get(c->srcFormat);
+
+    return !c->cascaded_context[0] && !c->gamma_flag && !usePal(c->srcFormat) &&
+           !(desc->flags & (AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL));
+}
+
+static void multi_band_ptrs(const AVFrame *f, int y, const uint8_t *data[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(f->format);
+
+    for (int i = 0; i < 4; i++) {
+        const int shift = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+        data[i] = f->data[i] ? f->data[i] + (y >> shift) * (ptrdiff_t)f->linesize[i]
+                             : NULL;
+    }
+}
+
+int sws_scale_frames(SwsContext *const ctx[], AVFrame *const dst[], int nb_dst,
+                     const AVFrame *src)
+{
+    MultiOutput *out;
+    int banded = 1, ret = 0;
+
+    if (nb_dst <= 0)
+        return AVERROR(EINVAL);
+
+    out = av_calloc(nb_dst, sizeof(*out));
+    if (!out)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < nb_dst; i++) {
+        SwsInternal *c = sws_internal(ctx[i]);
+        const AVFrame *in = src;
+
+        out[i].parent = -1;
+        if (c->srcW != src->width || c->srcH != src->height ||
+            c->srcFormat != src->format) {
+            for (int j = i - 1; j >= 0; j--) {
+                if (c->srcW == dst[j]->width && c->srcH == dst[j]->height &&
+                    c->srcFormat == dst[j]->format) {
+                    out[i].parent = j;
+                    in = dst[j];
+                    break;
+                }
+            }
+            if (out[i].parent < 0) {
+                av_log(c, AV_LOG_ERROR, "Context %d matches neither the source "
+                       "nor a previous destination\n", i);
+                ret = AVERROR(EINVAL);
+                goto end;
+            }
+        }
+        out[i].align = 1 << av_pix_fmt_desc_get(in->format)->log2_chroma_h;
+
+        if (!dst[i]->buf[0]) {
+            dst[i]->width  = c->dstW;
+            dst[i]->height = c->dstH;
+            dst[i]->format = c->dstFormat;
+
+            ret = av_frame_get_buffer(dst[i], 0);
+            if (ret < 0)
+                goto end;
+        }
+
+        banded &= multi_band_ok(ctx[i]);
+    }
+
+    if (!banded) {
+        for (int i = 0; i < nb_dst; i++) {
+            ret = sws_scale_frame(ctx[i], dst[i],
+                                  out[i].parent < 0 ? src : dst[out[i].parent]);
+            if (ret < 0)
+                goto end;
+        }
+        goto end;
+    }
+
+    /* Pass the source through all scalers band by band, so that each band
+     * is read from memory only once. A destination scaled from another one
+     * gets the lines of its parent as soon as they are written. */
+    for (int y = 0; y < src->height; y += MULTI_BAND_HEIGHT) {
+        const int end = FFMIN(y + MULTI_BAND_HEIGHT, src->height);
+
+        for (int i = 0; i < nb_dst; i++) {
+            const int p = out[i].parent;
+            const AVFrame *in = p < 0 ? src : dst[p];
+            int avail = p < 0 ? end : out[p].out_done;
+            const uint8_t *data[4];
+
+            if (avail < in->height)
+                avail &= ~(out[i].align - 1);
+            if (avail <= out[i].in_fed)
+                continue;
+
+            multi_band_ptrs(in, out[i].in_fed, data);
+            ret = sws_scale(ctx[i], data, in->linesize, out[i].in_fed,
+                            avail - out[i].in_fed, dst[i]->data, dst[i]->linesize);
+            if (ret < 0)
+                goto end;
+
+            out[i].in_fed    = avail;
+            out[i].out_done += ret;
+        }
+    }
+    ret = 0;
+
+end:
+    av_free(out);
+    return ret;
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
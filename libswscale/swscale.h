@@ -343,6 +343,34 @@ int sws_scale(SwsContext *c, const uint8_t *const srcSlice[],
  */
 int sws_scale_frame(SwsContext *c, AVFrame *dst, const AVFrame *src);
 
+/**
+ * Scale one source frame to several destination frames.
+ *
+ * The source is passed to all scalers in bands of a few lines, so that it is
+ * read from memory only once instead of once per destination. A context may
+ * also be set up to scale from the size and format of an earlier destination
+ * instead of the source, e.g. for a 1080p source scaled to 720p and 360p the
+ * 360p output can be scaled from the 720p one. Its input is then fed with the
+ * lines of that destination as soon as they are written, and the result
+ * differs from scaling the source directly.
+ *
+ * Contexts that use several threads, or whose conversion cannot take sliced
+ * input, make the function scale each destination with sws_scale_frame()
+ * instead. The output is the same in both cases.
+ *
+ * @param ctx    nb_dst initialized scaling contexts. The source of ctx[i] is
+ *               src if its size and format match, otherwise the last
+ *               destination dst[j], j < i, that matches.
+ * @param dst    nb_dst destination frames. Frames without data buffers are
+ *               allocated as in sws_frame_start().
+ * @param nb_dst number of destinations
+ * @param src    the source frame
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int sws_scale_frames(SwsContext *const ctx[], AVFrame *const dst[], int nb_dst,
+                     const AVFrame *src);
+
 /**
  * Initialize the scaling process for a given pair of source/destination frames.
  * Must be called before any calls to sws_send_slice() and sws_receive_slice().
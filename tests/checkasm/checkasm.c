@@ -294,6 +294,9 @@ static const struct {
     { "sw_yuv2rgb", checkasm_check_sw_yuv2rgb },
     { "sw_yuv2yuv", checkasm_check_sw_yuv2yuv },
 #endif
+#if CONFIG_SWRESAMPLE
+    { "sw_resample", checkasm_check_sw_resample },
+#endif
 #if CONFIG_AVUTIL
         { "fixed_dsp", checkasm_check_fixed_dsp },
         { "float_dsp", checkasm_check_float_dsp },
@@ -0,0 +1,191 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/mem_internal.h"
+
+#include "libswresample/resample.h"
+#include "libswresample/swresample_internal.h"
+
+#include "checkasm.h"
+
+#define SRC_LEN  2048
+#define DST_LEN  1024
+
+static void randomize_buffer(uint8_t *buf, enum AVSampleFormat format)
+{
+    for (int i = 0; i < SRC_LEN; i++) {
+        switch (format) {
+        case AV_SAMPLE_FMT_S16P:
+            ((int16_t *)buf)[i] = (int16_t)rnd();
+            break;
+        case AV_SAMPLE_FMT_S32P:
+            ((int32_t *)buf)[i] = (int32_t)rnd();
+            break;
+        case AV_SAMPLE_FMT_FLTP:
+            ((float *)buf)[i] = (float)rnd() / UINT_MAX * 2.0f - 1.0f;
+            break;
+        case AV_SAMPLE_FMT_DBLP:
+            ((double *)buf)[i] = (double)rnd() / UINT_MAX * 2.0 - 1.0;
+            break;
+        }
+    }
+}
+
+static int compare(const uint8_t *a, const uint8_t *b, int n,
+                   enum AVSampleFormat format)
+{
+    switch (format) {
+    case AV_SAMPLE_FMT_FLTP:
+        return !float_near_abs_eps_array((const float *)a, (const float *)b, 1e-5f, n);
+    case AV_SAMPLE_FMT_DBLP:
+        return !double_near_abs_eps_array((const double *)a, (const double *)b, 1e-12, n);
+    case AV_SAMPLE_FMT_S16P:
+        for (int i = 0; i < n; i++)
+            if (abs(((const int16_t *)a)[i] - ((const int16_t *)b)[i]) > 1)
+                return 1;
+        return 0;
+    default:
+        return memcmp(a, b, n * av_get_bytes_per_sample(format));
+    }
+}
+
+static void check_resample(enum AVSampleFormat format, const char *name, int linear)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [SRC_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_LEN * 8]);
+    /* 48000 -> 44100, the default filter parameters of swr */
+    ResampleContext *c = swri_resampler.init(NULL, 44100, 48000, 32, 10, linear,
+                                             0.97, format, SWR_FILTER_TYPE_KAISER,
+                                             9, 1.0 / (1 << 20), 0, 1, 1);
+    const int n = DST_LEN - 17;
+    const int bps = av_get_bytes_per_sample(format);
+
+    declare_func(int, ResampleContext *c, void *dst, const void *src,
+                 int n, int update_ctx);
+
+    if (!c) {
+        fail();
+        return;
+    }
+
+    randomize_buffer(src, format);
+
+    if (check_func(linear ? c->dsp.resample_linear : c->dsp.resample_common,
+                   "resample_%s_%s", linear ? "linear" : "common", name)) {
+        int ret0, ret1;
+
+        /* a fractional position, so that resample_linear interpolates */
+        c->index = 3;
+        c->frac  = c->src_incr / 3;
+
+        memset(dst0, 0, DST_LEN * bps);
+        memset(dst1, 0, DST_LEN * bps);
+        ret0 = call_ref(c, dst0, src, n, 0);
+        ret1 = call_new(c, dst1, src, n, 0);
+        if (ret0 != ret1 || compare(dst0, dst1, DST_LEN, format))
+            fail();
+        bench_new(c, dst1, src, n, 0);
+    }
+
+    swri_resampler.free(&c);
+}
+
+#define MULTI_CH 7
+
+static void check_resample_multi(enum AVSampleFormat format, const char *name)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [MULTI_CH], [SRC_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [MULTI_CH], [DST_LEN * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [MULTI_CH], [DST_LEN * 8]);
+    ResampleContext *c = swri_resampler.init(NULL, 44100, 48000, 32, 10, 0,
+                                             0.97, format, SWR_FILTER_TYPE_KAISER,
+                                             9, 1.0 / (1 << 20), 0, 1, 1);
+    const int n = DST_LEN - 17;
+    const int bps = av_get_bytes_per_sample(format);
+
+    declare_func(int, ResampleContext *c, uint8_t *const *dst,
+                 uint8_t *const *src, int ch_count, int n, int update_ctx);
+
+    if (!c) {
+        fail();
+        return;
+    }
+
+    for (int ch = 0; ch < MULTI_CH; ch++)
+        randomize_buffer(src[ch], format);
+
+    if (check_func(c->dsp.resample_common_multi, "resample_common_multi_%s", name)) {
+        uint8_t *srcp[MULTI_CH], *dstp0[MULTI_CH], *dstp1[MULTI_CH];
+
+        for (int ch = 0; ch < MULTI_CH; ch++) {
+            srcp[ch]  = src[ch];
+            dstp0[ch] = dst0[ch];
+            dstp1[ch] = dst1[ch];
+        }
+
+        /* a group of four channels, then one of four and one of three */
+        for (int ch_count = MULTI_CH - 3; ch_count <= MULTI_CH; ch_count += 3) {
+            int ret0, ret1;
+
+            c->index = 3;
+            c->frac  = c->src_incr / 3;
+
+            for (int ch = 0; ch < ch_count; ch++) {
+                memset(dst0[ch], 0, DST_LEN * bps);
+                memset(dst1[ch], 0, DST_LEN * bps);
+            }
+            ret0 = call_ref(c, dstp0, srcp, ch_count, n, 0);
+            ret1 = call_new(c, dstp1, srcp, ch_count, n, 0);
+            if (ret0 != ret1)
+                fail();
+            for (int ch = 0; ch < ch_count; ch++)
+                if (compare(dst0[ch], dst1[ch], DST_LEN, format))
+                    fail();
+        }
+        bench_new(c, dstp1, srcp, MULTI_CH, n, 0);
+    }
+
+    swri_resampler.free(&c);
+}
+
+void checkasm_check_sw_resample(void)
+{
+    static const struct {
+        enum AVSampleFormat format;
+        const char *name;
+    } formats[] = {
+        { AV_SAMPLE_FMT_S16P, "int16"  },
+        { AV_SAMPLE_FMT_S32P, "int32"  },
+        { AV_SAMPLE_FMT_FLTP, "float"  },
+        { AV_SAMPLE_FMT_DBLP, "double" },
+    };
+
+    for (int linear = 0; linear <= 1; linear++) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+            check_resample(formats[i].format, formats[i].name, linear);
+        report(linear ? "resample_linear" : "resample_common");
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(formats); i++)
+        check_resample_multi(formats[i].format, formats[i].name);
+    report("resample_common_multi");
+}
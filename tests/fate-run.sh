@@ -144,6 +144,13 @@ ffmpeg(){
     run ffmpeg${PROGSUF}${EXECSUF} ${ffmpeg_args}
 }
 
+# $1 = AMF_STUB_* settings, the rest are ffmpeg arguments
+amf_stub(){
+    stub_env=$1
+    shift
+    (export LD_LIBRARY_PATH=$(target_path tools) $stub_env; ffmpeg "$@")
+}
+
 ffprobe_demux(){
     filename=$1
     shift
@@ -180,6 +187,25 @@ md5(){
     do_md5sum $encfile | awk '{print $1}'
 }
 
+# Encode with 1 and with nb_threads threads, the outputs must be identical.
+threads_bitexact(){
+    nb_threads=$1
+    shift
+    file1="${outdir}/${test}-1.out"
+    filen="${outdir}/${test}-${nb_threads}.out"
+    cleanfiles="$cleanfiles $file1 $filen"
+    ffmpeg -y "$@" -threads 1 $(target_path $file1) || return
+    ffmpeg -y "$@" -threads $nb_threads $(target_path $filen) || return
+    md5_1=$(do_md5sum $file1 | awk '{print $1}')
+    md5_n=$(do_md5sum $filen | awk '{print $1}')
+    if [ "$md5_1" = "$md5_n" ]; then
+        echo "1 and $nb_threads threads: identical"
+    else
+        echo "1 thread: $md5_1"
+        echo "$nb_threads threads: $md5_n"
+    fi
+}
+
 pcm(){
     ffmpeg -auto_conversion_filters "$@" -vn -f s16le -
 }
@@ -273,6 +299,42 @@ transcode(){
         run ffprobe${PROGSUF}${EXECSUF} -bitexact $ffprobe_opts $tencfile || return
 }
 
+mov_index_cache_probe(){
+    echo "$1"
+    run ffprobe${PROGSUF}${EXECSUF} -bitexact -loglevel debug -index_cache $tcache \
+        -of compact -show_entries packet=pts,dts,duration,size,pos,flags $tfile \
+        > $pktfile 2> $logfile || return
+    do_md5sum $pktfile | awk '{print $1}'
+    grep -q 'File unchanged since the index cache' $logfile &&
+        echo "stsz/stco skipped" || echo "stsz/stco read"
+    echo "restored streams: $(grep -c 'restored from cache' $logfile)"
+}
+
+mov_index_cache(){
+    srcfile=$1
+    src_opts=$2
+    enc_opts=$3
+    stsz_entry=$4
+    file="${outdir}/${test}.mp4"
+    cache="${outdir}/${test}.index"
+    pktfile="${outdir}/${test}.pkts"
+    logfile="${outdir}/${test}.log"
+    test $keep -ge 1 || cleanfiles="$cleanfiles $file $cache $pktfile $logfile"
+    tfile=$(target_path $file)
+    tcache=$(target_path $cache)
+    rm -f $cache
+    ffmpeg $DEC_OPTS $src_opts -i $(target_path $srcfile) $ENC_OPTS $enc_opts \
+        -f mp4 -y $tfile || return
+    mov_index_cache_probe build   || return
+    mov_index_cache_probe restore || return
+    # change a sample size in the middle of the stsz table, keeping the size
+    # of the file, the cached index must not be used anymore
+    printf '\000\000\001\000' | dd of=$file bs=1 seek=$stsz_entry \
+        conv=notrunc 2>/dev/null || return
+    mov_index_cache_probe modified || return
+    mov_index_cache_probe restore  || return
+}
+
 stream_demux(){
     src_fmt=$1
     srcfile=$2
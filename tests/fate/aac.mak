@@ -240,6 +240,11 @@ fate-aac-pred-encode: CMP_TARGET = 662
 fate-aac-pred-encode: FUZZ = 12
 fate-aac-pred-encode: SIZE_TOLERANCE = 3560
 
+# the quantizers of the 5.1 channels are searched in parallel
+FATE_AAC_ENCODE_THREADS += fate-aac-encode-threads
+fate-aac-encode-threads: tests/data/asynth-44100-6.wav
+fate-aac-encode-threads: CMD = threads_bitexact 4 -auto_conversion_filters -i $(TARGET_PATH)/tests/data/asynth-44100-6.wav -c:a aac -b:a 384k -fflags +bitexact -flags +bitexact -f adts
+
 FATE_AAC_LATM += fate-aac-latm_000000001180bc60
 fate-aac-latm_000000001180bc60: CMD = pcm -i $(TARGET_SAMPLES)/aac/latm_000000001180bc60.mpg
 fate-aac-latm_000000001180bc60: REF = $(SAMPLES)/aac/latm_000000001180bc60.s16
@@ -262,10 +267,12 @@ $(FATE_AAC_ALL): CMP  = oneoff
 $(FATE_AAC_ALL): FUZZ = 2
 
 FATE_AAC_ENCODE-$(call ENCMUX, AAC, ADTS, ARESAMPLE_FILTER) += $(FATE_AAC_ENCODE)
+FATE_AAC_ENCODE_THREADS-$(call ENCMUX, AAC, ADTS, ARESAMPLE_FILTER WAV_DEMUXER PCM_S16LE_DECODER) += $(FATE_AAC_ENCODE_THREADS)
 
 FATE_AAC_BSF-$(call ALLYES, AAC_DEMUXER AAC_ADTSTOASC_BSF MATROSKA_MUXER) += fate-aac-autobsf-adtstoasc
 
 FATE_SAMPLES_FFMPEG += $(FATE_AAC_ALL) $(FATE_AAC_ENCODE-yes) $(FATE_AAC_BSF-yes)
+FATE_FFMPEG += $(FATE_AAC_ENCODE_THREADS-yes)
 
-fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_BSF-yes)
+fate-aac: $(FATE_AAC_ALL) $(FATE_AAC_ENCODE) $(FATE_AAC_ENCODE_THREADS-yes) $(FATE_AAC_BSF-yes)
 fate-aac-latm: $(FATE_AAC_LATM-yes)
@@ -91,11 +91,20 @@ fate-ac3-fixed-encode: CMD = md5 -i $(SRC) -c ac3_fixed -ab 128k -f ac3 -flags +
 fate-ac3-fixed-encode: CMP = oneline
 fate-ac3-fixed-encode: REF = e9d78bca187b4bbafc4512bcea8efd3e
 
+# Only needs generated input, so it also runs without SAMPLES.
+FATE_AC3_FFMPEG-$(call ENCMUX, AC3_FIXED, AC3, ARESAMPLE_FILTER WAV_DEMUXER PCM_S16LE_DECODER) += fate-ac3-fixed-encode-threads
+fate-ac3-fixed-encode-threads: tests/data/asynth-44100-2.wav
+fate-ac3-fixed-encode-threads: SRC = $(TARGET_PATH)/tests/data/asynth-44100-2.wav
+fate-ac3-fixed-encode-threads: CMD = md5 -i $(SRC) -c ac3_fixed -ab 128k -threads 4 -f ac3 -flags +bitexact -af aresample
+fate-ac3-fixed-encode-threads: CMP = oneline
+fate-ac3-fixed-encode-threads: REF = e9d78bca187b4bbafc4512bcea8efd3e
+
 FATE_EAC3-$(call ALLYES, EAC3_DEMUXER EAC3_MUXER EAC3_CORE_BSF) += fate-eac3-core-bsf
 fate-eac3-core-bsf: CMD = md5pipe -i $(TARGET_SAMPLES)/eac3/the_great_wall_7.1.eac3 -c:a copy -bsf:a eac3_core -fflags +bitexact -f eac3
 fate-eac3-core-bsf: CMP = oneline
 fate-eac3-core-bsf: REF = b704bf851e99b7442e9bed368b60e6ca
 
 FATE_SAMPLES_AVCONV += $(FATE_AC3-yes) $(FATE_EAC3-yes)
+FATE_FFMPEG += $(FATE_AC3_FFMPEG-yes)
 
-fate-ac3: $(FATE_AC3-yes) $(FATE_EAC3-yes)
+fate-ac3: $(FATE_AC3-yes) $(FATE_EAC3-yes) $(FATE_AC3_FFMPEG-yes)
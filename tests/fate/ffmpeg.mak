@@ -249,6 +249,17 @@ fate-ffmpeg-filter-in-eof: CMD = framecrc
     -filter_complex "[0][1]concat" -c:v rawvideo
 FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, CONCAT_FILTER) += fate-ffmpeg-filter-in-eof
 
+# Test the shared task thread budget: with a single slot every component of
+# the pipeline must still get to run, and the output must not depend on the
+# number of slots.
+FATE_FFMPEG_TASK_THREADS = fate-ffmpeg-task-threads-1 fate-ffmpeg-task-threads-3
+$(FATE_FFMPEG_TASK_THREADS): tests/data/vsynth1.yuv
+$(FATE_FFMPEG_TASK_THREADS): REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-task-threads
+fate-ffmpeg-task-threads-%: CMD = framecrc -task_threads $(@:fate-ffmpeg-task-threads-%=%) \
+    -f rawvideo -s 352x288 -pix_fmt yuv420p -t 1 -i $(TARGET_PATH)/tests/data/vsynth1.yuv   \
+    -filter_complex "[0:v]split[a][b];[a]hflip[c];[b][c]hstack" -c:v rawvideo
+FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, SPLIT_FILTER HFLIP_FILTER HSTACK_FILTER) += $(FATE_FFMPEG_TASK_THREADS)
+
 # Test termination on streamcopy with -t as an output option.
 fate-ffmpeg-streamcopy-t: tests/data/vsynth1.yuv
 fate-ffmpeg-streamcopy-t: CMP = null
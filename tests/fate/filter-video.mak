@@ -192,6 +192,11 @@ fate-filter-gradfun: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf gradfun
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_HQDN3D_FILTER) += fate-filter-hqdn3d
 fate-filter-hqdn3d: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf hqdn3d
 
+# The frame threaded output must not depend on the number of threads.
+FATE_FILTER_VSYNTH_PGMYUV-$(call ALLYES, PERMS_FILTER OWDENOISE_FILTER RAWVIDEO_ENCODER NUT_MUXER) += fate-filter-owdenoise-threads
+fate-filter-owdenoise-threads: CMD = threads_bitexact 4 -c:v pgmyuv -i $(SRC) -frames:v 30 \
+    -vf "perms=random,owdenoise=10:20:20:enable=not(between(t\,0.2\,1.2))" -c:v rawvideo -fflags +bitexact -f nut
+
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_INTERLACE_FILTER) += fate-filter-interlace
 fate-filter-interlace: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf interlace
 
@@ -467,6 +472,18 @@ FATE_FILTER_VSYNTH-$(call ALLYES, TESTSRC_FILTER SCALE2REF_FILTER NULLSINK_FILTE
 fate-filter-scale2ref_keep_aspect: tests/data/filtergraphs/scale2ref_keep_aspect
 fate-filter-scale2ref_keep_aspect: CMD = framemd5 -frames:v 5 -/filter_complex $(TARGET_PATH)/tests/data/filtergraphs/scale2ref_keep_aspect -map "[main]"
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT SCALE_MULTI) += fate-filter-scale_multi fate-filter-scale_multi-threads fate-filter-scale_multi-pyramid
+fate-filter-scale_multi: CMD = framecrc -filter_complex "testsrc2=s=352x288:r=5:d=2,format=yuv420p,scale_multi=sizes=200x160|176x144|88x72:flags=bicubic+accurate_rnd+bitexact:pyramid=0[a][b][c]" -map "[a]" -map "[b]" -map "[c]"
+fate-filter-scale_multi-threads: CMD = framecrc -filter_complex_threads 4 -filter_complex "testsrc2=s=352x288:r=5:d=2,format=yuv420p,scale_multi=sizes=200x160|176x144|88x72:flags=bicubic+accurate_rnd+bitexact:pyramid=0:threads=4[a][b][c]" -map "[a]" -map "[b]" -map "[c]"
+fate-filter-scale_multi-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-scale_multi
+fate-filter-scale_multi-pyramid: CMD = framecrc -filter_complex "testsrc2=s=352x288:r=5:d=2,format=yuv420p,scale_multi=sizes=200x160|176x144|88x72:flags=bicubic+accurate_rnd+bitexact[a][b][c]" -map "[a]" -map "[b]" -map "[c]"
+
+FILTER_BRANCHES = "testsrc2=s=352x288:r=5:d=2,format=yuv420p,split=4[a][b][c][d];[a]hflip[oa];[b]vflip[ob];[c]negate[oc];[d]transpose[od]" -map "[oa]" -map "[ob]" -map "[oc]" -map "[od]"
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT SPLIT HFLIP VFLIP NEGATE TRANSPOSE) += fate-filter-graph-branches fate-filter-graph-branches-threads
+fate-filter-graph-branches: CMD = framecrc -filter_complex $(FILTER_BRANCHES)
+fate-filter-graph-branches-threads: CMD = framecrc -filter_thread_type slice+graph -filter_complex_threads 4 -filter_complex $(FILTER_BRANCHES)
+fate-filter-graph-branches-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-graph-branches
+
 FATE_FILTER_VSYNTH-$(call FILTERDEMDEC, SCALE, RAWVIDEO, RAWVIDEO) += fate-filter-scalechroma
 fate-filter-scalechroma: tests/data/vsynth1.yuv
 fate-filter-scalechroma: CMD = framecrc -flags bitexact -s 352x288 -pix_fmt yuv444p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -pix_fmt yuv420p -sws_flags +bitexact -vf scale=out_chroma_loc=bottomleft
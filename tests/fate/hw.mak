@@ -4,3 +4,24 @@ fate-hwdevice: CMD = run libavutil/tests/hwdevice$(EXESUF)
 fate-hwdevice: CMP = null
 
 FATE_HW-$(CONFIG_AVUTIL) += $(FATE_HWCONTEXT)
+
+# Run the AMF encoder against the stub runtime from tools/amf_stub.c
+AMF_STUB_ENC = -f lavfi -i testsrc2=s=320x240:r=25:d=2,format=yuv420p -c:v h264_amf -f null -
+
+# A queue of 2 frames keeps the encoder full, so QueryOutput() has to wait
+FATE_AMF_STUB += fate-amf-stub-wait
+fate-amf-stub-wait: CMD = amf_stub "AMF_STUB_QUEUE_SIZE=2 AMF_STUB_LATENCY_US=5000" $(AMF_STUB_ENC)
+fate-amf-stub-wait: REF = frame= *50 fps
+
+FATE_AMF_STUB += fate-amf-stub-poll
+fate-amf-stub-poll: CMD = amf_stub "AMF_STUB_QUEUE_SIZE=2 AMF_STUB_NO_TIMEOUT=1" $(AMF_STUB_ENC)
+fate-amf-stub-poll: REF = frame= *50 fps
+
+FATE_AMF_STUB += fate-amf-stub-timeout-fail
+fate-amf-stub-timeout-fail: CMD = amf_stub "AMF_STUB_QUEUE_SIZE=2 AMF_STUB_TIMEOUT_FAIL=1" $(AMF_STUB_ENC)
+fate-amf-stub-timeout-fail: REF = falling back to polling
+
+$(FATE_AMF_STUB): tools/libamfrt64.so.1
+$(FATE_AMF_STUB): CMP = grep
+
+FATE_HW-$(call ALLYES, H264_AMF_ENCODER LAVFI_INDEV TESTSRC2_FILTER FORMAT_FILTER NULL_MUXER) += $(FATE_AMF_STUB)
@@ -1,6 +1,21 @@
-#FATE_LIBAVFORMAT-$(HAVE_PTHREADS) += fate-async
-#fate-async: libavformat/tests/async$(EXESUF)
-#fate-async: CMD = run libavformat/tests/async
+FATE_LIBAVFORMAT-$(call ALLYES, ASYNC_PROTOCOL CRYPTO_PROTOCOL FILE_PROTOCOL) += fate-async
+fate-async: libavformat/tests/async$(EXESUF)
+fate-async: CMD = run libavformat/tests/async$(EXESUF)
+
+FATE_FILE-$(HAVE_MMAP) += fate-file-mmap
+fate-file-mmap: libavformat/tests/file$(EXESUF)
+fate-file-mmap: CMD = run libavformat/tests/file$(EXESUF)
+FATE_LIBAVFORMAT-$(CONFIG_FILE_PROTOCOL) += $(FATE_FILE-yes)
+
+FATE_HTTP-$(HAVE_THREADS) += fate-http-parallel
+fate-http-parallel: libavformat/tests/http_parallel$(EXESUF)
+fate-http-parallel: CMD = run libavformat/tests/http_parallel$(EXESUF)
+FATE_HTTP_POOL-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER) += fate-http-pool-hls
+FATE_HTTP_POOL-$(call ALLYES, DASH_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER) += fate-http-pool-dash
+$(FATE_HTTP_POOL-yes): libavformat/tests/http_pool$(EXESUF)
+$(FATE_HTTP_POOL-yes): CMD = run libavformat/tests/http_pool$(EXESUF) $(@:fate-http-pool-%=%)
+FATE_HTTP-$(HAVE_THREADS) += $(FATE_HTTP_POOL-yes)
+FATE_LIBAVFORMAT-$(CONFIG_HTTP_PROTOCOL) += $(FATE_HTTP-yes)
 
 FATE_LIBAVFORMAT-$(CONFIG_NETWORK) += fate-noproxy
 fate-noproxy: libavformat/tests/noproxy$(EXESUF)
@@ -14,6 +29,11 @@ FATE_LIBAVFORMAT-$(CONFIG_SRTP) += fate-srtp
 fate-srtp: libavformat/tests/srtp$(EXESUF)
 fate-srtp: CMD = run libavformat/tests/srtp$(EXESUF)
 
+FATE_UDP-$(HAVE_PTHREAD_CANCEL) += fate-udp
+fate-udp: libavformat/tests/udp$(EXESUF)
+fate-udp: CMD = run libavformat/tests/udp$(EXESUF)
+FATE_LIBAVFORMAT-$(CONFIG_UDP_PROTOCOL) += $(FATE_UDP-yes)
+
 FATE_LIBAVFORMAT-yes += fate-url
 fate-url: libavformat/tests/url$(EXESUF)
 fate-url: CMD = run libavformat/tests/url$(EXESUF)
@@ -1085,6 +1085,16 @@ $(call CROSS_TEST,$(SAMPLERATES_LITE),ARESAMPLE_EXACT_LIN_ASYNC,dblp,f64le,s16)
 FATE_SWR_RESAMPLE-$(call FILTERDEMDEC, ARESAMPLE ASETPTS ATRIM SINE, , PCM_S16LE, LAVFI_INDEV) += fate-swr-async-firstpts
 fate-swr-async-firstpts: CMD = framecrc -auto_conversion_filters -copyts -f lavfi -i "sine=r=1000:samples_per_frame=100,asetpts=PTS+S+S*floor(ld(1)/4)+st(1\,ld(1)+1)*0,atrim=end=2" -filter:a aresample=async=300:first_pts=0
 
+# between 3 and 4 s, each channel of the input is a different sweep
+FATE_SWR_RESAMPLE-$(call FILTERDEMDECENCMUX, ARESAMPLE ATRIM, WAV, PCM_S16LE, PCM_S16LE, PCM_S16LE) += fate-swr-resample-multichannel
+fate-swr-resample-multichannel: tests/data/asynth-44100-7.wav
+fate-swr-resample-multichannel: CMD = md5 -i $(TARGET_PATH)/tests/data/asynth-44100-7.wav -af "atrim=start_sample=132300:end_sample=176400,aresample=48000:internal_sample_fmt=s32p" -f s16le
+
+FATE_SWR_RESAMPLE-$(call FILTERDEMDECENCMUX, ARESAMPLE ATRIM, WAV, PCM_S16LE, PCM_S16LE, PCM_S16LE) += fate-swr-resample-multichannel-threads
+fate-swr-resample-multichannel-threads: tests/data/asynth-44100-7.wav
+fate-swr-resample-multichannel-threads: REF = $(SRC_PATH)/tests/ref/fate/swr-resample-multichannel
+fate-swr-resample-multichannel-threads: CMD = md5 -i $(TARGET_PATH)/tests/data/asynth-44100-7.wav -af "atrim=start_sample=132300:end_sample=176400,aresample=48000:internal_sample_fmt=s32p:threads=4" -f s16le
+
 FATE_SWR_RESAMPLE-$(call FILTERDEMDECENCMUX, ARESAMPLE, WAV, PCM_S16LE, PCM_S16LE, WAV) += $(FATE_SWR_RESAMPLE)
 fate-swr-resample: $(FATE_SWR_RESAMPLE-yes)
 FATE_SWR += $(FATE_SWR_RESAMPLE-yes)
@@ -270,6 +270,12 @@ fate-matroska-side-data-pref-packet: CMD = run ffprobe$(PROGSSUF)$(EXESUF) $(TAR
     -select_streams v:0 -show_streams -show_frames -show_entries stream=stream_side_data:frame=frame_side_data_list -side_data_prefer_packet mastering_display_metadata,content_light_level
 FATE_MATROSKA_FFPROBE-$(call ALLYES, MATROSKA_DEMUXER HEVC_DECODER) += fate-matroska-side-data-pref-codec fate-matroska-side-data-pref-packet
 
+# Packets of the remuxed file reference the mapping of the input file
+FATE_MATROSKA_FFMPEG-$(call TRANSCODE, MPEG4, MATROSKA, RAWVIDEO_DEMUXER) += fate-matroska-mmap
+fate-matroska-mmap: tests/data/vsynth1.yuv
+fate-matroska-mmap: CMD = transcode rawvideo tests/data/vsynth1.yuv matroska "-c:v mpeg4 -qscale 10 -frames:v 10" "-c copy" "" "" "-mmap 1" "-s 352x288 -pix_fmt yuv420p"
+
+FATE_FFMPEG += $(FATE_MATROSKA_FFMPEG-yes)
 FATE_SAMPLES_AVCONV += $(FATE_MATROSKA-yes)
 FATE_SAMPLES_FFPROBE += $(FATE_MATROSKA_FFPROBE-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_MATROSKA_FFMPEG_FFPROBE-yes)
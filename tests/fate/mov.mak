@@ -284,6 +284,25 @@ fate-mov-mp4-iamf-ambisonic_1: CMD = transcode wav $(SRC) mp4 "-auto_conversion_
   -streamid 0:0 -streamid 1:1 -streamid 2:2 -streamid 3:3 -map [MONO0] -map [MONO1] -map [MONO2] -map [MONO3] -c:a flac -t 1" "-c:a copy -map 0" \
   "-show_entries stream_group=index,id,nb_streams,type:stream_group_components:stream_group_disposition:stream_group_tags:stream_group_stream=index,id:stream_group_stream_disposition"
 
+# Build an index cache, restore the index from it, then check that the cache is
+# not used after a sample size in the middle of the stsz box was changed. The
+# last argument is the offset of the 2500th entry of the stsz box of the file.
+FATE_MOV_FFMPEG_FFPROBE-$(call TRANSCODE, MPEG4, MOV, RAWVIDEO_DEMUXER) \
+                          += fate-mov-index-cache
+fate-mov-index-cache: tests/data/vsynth1.yuv
+fate-mov-index-cache: CMD = mov_index_cache tests/data/vsynth1.yuv "-f rawvideo -s 16x16 -pix_fmt yuv420p" "-c:v mpeg4 -qscale 10 -frames:v 5000" 602553
+
+# Packets of the remuxed file reference the mapping of the input file
+FATE_MOV_FFMPEG-$(call TRANSCODE, MPEG4, MOV, RAWVIDEO_DEMUXER) += fate-mov-mmap
+fate-mov-mmap: tests/data/vsynth1.yuv
+fate-mov-mmap: CMD = transcode rawvideo tests/data/vsynth1.yuv mp4 "-c:v mpeg4 -qscale 10 -frames:v 10" "-c copy" "" "" "-mmap 1" "-s 352x288 -pix_fmt yuv420p"
+
+# read the input, write the mp4 file and read it back with io_uring, in small
+# requests; the file protocol falls back to plain I/O without io_uring support
+FATE_MOV_FFMPEG-$(call TRANSCODE, MPEG4, MOV, RAWVIDEO_DEMUXER) += fate-mov-io-uring
+fate-mov-io-uring: tests/data/vsynth1.yuv
+fate-mov-io-uring: CMD = transcode rawvideo tests/data/vsynth1.yuv mp4 "-c:v mpeg4 -qscale 10 -frames:v 10 -io_uring 1 -io_uring_depth 4 -io_uring_block_size 4096" "-c copy" "" "" "-io_uring 1 -io_uring_depth 4 -io_uring_block_size 4096" "-s 352x288 -pix_fmt yuv420p -io_uring 1 -io_uring_depth 4 -io_uring_block_size 4096"
+
 FATE_FFMPEG += $(FATE_MOV_FFMPEG-yes)
 FATE_FFMPEG_FFPROBE += $(FATE_MOV_FFMPEG_FFPROBE-yes)
 
@@ -38,7 +38,25 @@ fate-opus-tron.6ch.tinypkts: CMP_SHIFT = 1440
 fate-opus-tron.6ch.tinypkts: CMP_TARGET = 0
 
 FATE_SAMPLES_FFMPEG += $(FATE_OPUS)
+
+# The stereo trials run in order with one thread and independently with more,
+# so the streams differ while the quality has to stay the same.
+FATE_OPUS_ENCODE += fate-opus-encode
+fate-opus-encode: CMD = enc_dec_pcm ogg wav s16le $(TARGET_PATH)/tests/data/asynth-48000-2.wav -c:a opus -strict -2 -b:a 64k -threads 1 -fflags +bitexact -flags +bitexact
+
+FATE_OPUS_ENCODE += fate-opus-encode-threads
+fate-opus-encode-threads: CMD = enc_dec_pcm ogg wav s16le $(TARGET_PATH)/tests/data/asynth-48000-2.wav -c:a opus -strict -2 -b:a 64k -threads 4 -fflags +bitexact -flags +bitexact
+
+$(FATE_OPUS_ENCODE): tests/data/asynth-48000-2.wav
+$(FATE_OPUS_ENCODE): CMP = stddev
+$(FATE_OPUS_ENCODE): REF = ./tests/data/asynth-48000-2.wav
+$(FATE_OPUS_ENCODE): CMP_TARGET = 5016
+$(FATE_OPUS_ENCODE): SIZE_TOLERANCE = 44
+$(FATE_OPUS_ENCODE): FUZZ = 16
+
+FATE_OPUS_ENCODE-$(call ENCDEC2, OPUS, PCM_S16LE, OGG WAV) += $(FATE_OPUS_ENCODE)
+FATE_FFMPEG += $(FATE_OPUS_ENCODE-yes)
 fate-opus-celt: $(FATE_OPUS_CELT-yes)
 fate-opus-hybrid: $(FATE_OPUS_HYBRID-yes)
 fate-opus-silk: $(FATE_OPUS_SILK-yes)
-fate-opus: $(FATE_OPUS)
+fate-opus: $(FATE_OPUS) $(FATE_OPUS_ENCODE-yes)
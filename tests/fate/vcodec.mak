@@ -349,6 +349,15 @@ fate-vsynth%-msrle:              CODEC   = msrle
 FATE_VCODEC_SCALE-$(call ENCDEC, PNG, AVI) += mpng
 fate-vsynth%-mpng:               CODEC   = png
 
+# The images are compressed in bands on slice threads. The input is read as
+# rgb24, so that no conversion is needed and the images are large enough for
+# two bands. The decoded images must match the input.
+FATE_PNG_SLICE-$(call ENCDEC, PNG, AVI, RAWVIDEO_DEMUXER RAWVIDEO_ENCODER RAWVIDEO_MUXER) += fate-png-enc-slice
+fate-png-enc-slice: tests/data/vsynth1.yuv
+fate-png-enc-slice: CMD = enc_dec "rawvideo -s 352x288 -pix_fmt rgb24" $(TARGET_PATH)/tests/data/vsynth1.yuv \
+    avi "-c png -pred mixed -threads 2 -thread_type slice" rawvideo "-pix_fmt rgb24"
+FATE_FFMPEG += $(FATE_PNG_SLICE-yes)
+
 FATE_VCODEC_SCALE-$(call ENCDEC, MSVIDEO1, AVI) += msvideo1
 
 FATE_VCODEC_SCALE-$(call ENCDEC, PRORES, MOV) += prores prores_int prores_444 prores_444_int prores_ks
@@ -431,6 +440,12 @@ FATE_VCODEC-$(call ENCDEC, SNOW, AVI) += snow-ll
 fate-vsynth%-snow-ll:            ENCOPTS = -qscale .001 -pred 1 \
                                            -flags +mv4+qpel
 
+# the OBMC prediction of P frames runs on slice threads
+FATE_SNOW_THREADS-$(call ENCMUX, SNOW, NUT, RAWVIDEO_DEMUXER) += fate-snow-encode-threads
+fate-snow-encode-threads: tests/data/vsynth1.yuv
+fate-snow-encode-threads: CMD = threads_bitexact 4 -f rawvideo -s 352x288 -pix_fmt yuv420p -i $(TARGET_PATH)/tests/data/vsynth1.yuv -frames:v 10 -c:v snow -qscale 2 -motion_est iter -flags +qpel+bitexact -fflags +bitexact -f nut
+FATE_FFMPEG += $(FATE_SNOW_THREADS-yes)
+
 FATE_VCODEC-$(call ENCDEC, SPEEDHQ, AVI)      += speedhq-420p
 FATE_VCODEC_SCALE-$(call ENCDEC, SPEEDHQ, AVI) += speedhq-422p speedhq-444p
 fate-vsynth%-speedhq-420p:       ENCOPTS = -pix_fmt yuv420p -b 600k
@@ -0,0 +1,1112 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Stub AMF runtime, for exercising the AMF encoder wrappers without a GPU.
+ *
+ * It implements the subset of the AMF C API used by libavcodec/amfenc*.c on
+ * top of host memory and a worker thread that "encodes" each submitted
+ * surface into a dummy packet after a configurable delay. The produced
+ * bitstream is garbage, so only use it with outputs that do not parse it,
+ * e.g. -f null or -f framecrc.
+ *
+ * Build with "make tools/libamfrt64.so.1" in an AMF-enabled build tree and
+ * run ffmpeg with LD_LIBRARY_PATH pointing to the tools directory.
+ *
+ * The following environment variables control the simulation:
+ *   AMF_STUB_LATENCY_US   encoding time of one frame, default 2000
+ *   AMF_STUB_QUEUE_SIZE   frames in flight before AMF_INPUT_FULL, default 16
+ *   AMF_STUB_PACKET_SIZE  size of the produced packets, default 1024
+ *   AMF_STUB_GOP          distance between key frames, default 250
+ *   AMF_STUB_NO_TIMEOUT   if set, pretend that QUERY_TIMEOUT is unsupported
+ *   AMF_STUB_TIMEOUT_FAIL if set, fail changes of QUERY_TIMEOUT after Init()
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+
+#include <AMF/core/Factory.h>
+#include <AMF/core/Version.h>
+#include <AMF/components/VideoEncoderVCE.h>
+#include <AMF/components/VideoEncoderHEVC.h>
+#include <AMF/components/VideoEncoderAV1.h>
+
+#define STUB_EXPORT __attribute__((visibility("default")))
+
+#define STUB_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static int env_int(const char *name, int def)
+{
+    const char *val = getenv(name);
+    return val ? atoi(val) : def;
+}
+
+/* common object: reference counting, properties and supported interfaces */
+
+typedef struct StubProperty {
+    wchar_t         *name;
+    AMFVariantStruct value;
+} StubProperty;
+
+typedef struct StubObject StubObject;
+
+struct StubObject {
+    const void     *vtbl;
+    atomic_long     refcount;
+    void          (*destroy)(StubObject *obj);
+    const AMFGuid *(*iids)(int *nb_iids);
+
+    StubProperty   *props;
+    int             nb_props;
+
+    StubObject     *next;  ///< queue link, owned by whoever queued the object
+    amf_pts         pts;
+    amf_pts         duration;
+};
+
+static void obj_init(StubObject *obj, const void *vtbl,
+                     void (*destroy)(StubObject *obj),
+                     const AMFGuid *(*iids)(int *nb_iids))
+{
+    memset(obj, 0, sizeof(*obj));
+    obj->vtbl    = vtbl;
+    obj->destroy = destroy;
+    obj->iids    = iids;
+    atomic_init(&obj->refcount, 1);
+}
+
+static void obj_clear_props(StubObject *obj)
+{
+    for (int i = 0; i < obj->nb_props; i++) {
+        free(obj->props[i].name);
+        AMFVariantClear(&obj->props[i].value);
+    }
+    free(obj->props);
+    obj->props    = NULL;
+    obj->nb_props = 0;
+}
+
+static amf_long obj_acquire(StubObject *obj)
+{
+    return atomic_fetch_add(&obj->refcount, 1) + 1;
+}
+
+static amf_long obj_release(StubObject *obj)
+{
+    amf_long ref = atomic_fetch_sub(&obj->refcount, 1) - 1;
+    if (!ref) {
+        obj_clear_props(obj);
+        obj->destroy(obj);
+    }
+    return ref;
+}
+
+static AMF_RESULT obj_query_interface(StubObject *obj, const AMFGuid *iid, void **out)
+{
+    int nb_iids;
+    const AMFGuid *iids = obj->iids(&nb_iids);
+
+    for (int i = 0; i < nb_iids; i++) {
+        if (!memcmp(iid, &iids[i], sizeof(*iid))) {
+            obj_acquire(obj);
+            *out = obj;
+            return AMF_OK;
+        }
+    }
+    *out = NULL;
+    return AMF_NO_INTERFACE;
+}
+
+static StubProperty *obj_find_prop(StubObject *obj, const wchar_t *name)
+{
+    for (int i = 0; i < obj->nb_props; i++)
+        if (!wcscmp(obj->props[i].name, name))
+            return &obj->props[i];
+    return NULL;
+}
+
+static AMF_RESULT obj_set_property(StubObject *obj, const wchar_t *name,
+                                   const AMFVariantStruct *value)
+{
+    StubProperty *prop = obj_find_prop(obj, name);
+
+    if (!prop) {
+        StubProperty *props = realloc(obj->props, (obj->nb_props + 1) * sizeof(*props));
+        if (!props)
+            return AMF_OUT_OF_MEMORY;
+        obj->props = props;
+        prop = &props[obj->nb_props];
+        prop->name = wcsdup(name);
+        if (!prop->name)
+            return AMF_OUT_OF_MEMORY;
+        AMFVariantInit(&prop->value);
+        obj->nb_props++;
+    }
+    return AMFVariantCopy(&prop->value, (AMFVariantStruct *)value);
+}
+
+static AMF_RESULT obj_get_property(StubObject *obj, const wchar_t *name,
+                                   AMFVariantStruct *value)
+{
+    StubProperty *prop = obj_find_prop(obj, name);
+
+    if (!prop)
+        return AMF_NOT_FOUND;
+    /* callers do not always initialize the variant, do not clear it */
+    AMFVariantInit(value);
+    return AMFVariantCopy(value, &prop->value);
+}
+
+static AMF_RESULT obj_copy_props(StubObject *dst, StubObject *src)
+{
+    for (int i = 0; i < src->nb_props; i++) {
+        AMF_RESULT res = obj_set_property(dst, src->props[i].name, &src->props[i].value);
+        if (res != AMF_OK)
+            return res;
+    }
+    return AMF_OK;
+}
+
+static int64_t obj_get_int(StubObject *obj, const wchar_t *name, int64_t def)
+{
+    StubProperty *prop = obj_find_prop(obj, name);
+    return prop && prop->value.type == AMF_VARIANT_INT64 ? prop->value.int64Value : def;
+}
+
+/* Typed wrappers around the common implementation for every interface. */
+#define STUB_INTERFACE_FUNCS(type)                                                          \
+static amf_long AMF_STD_CALL type##_Acquire(type *p)                                        \
+{                                                                                           \
+    return obj_acquire((StubObject *)p);                                                    \
+}                                                                                           \
+static amf_long AMF_STD_CALL type##_Release(type *p)                                        \
+{                                                                                           \
+    return obj_release((StubObject *)p);                                                    \
+}                                                                                           \
+static AMF_RESULT AMF_STD_CALL type##_QueryInterface(type *p, const AMFGuid *iid, void **o) \
+{                                                                                           \
+    return obj_query_interface((StubObject *)p, iid, o);                                    \
+}
+
+#define STUB_PROPERTY_FUNCS(type)                                                           \
+static AMF_RESULT AMF_STD_CALL type##_SetProperty(type *p, const wchar_t *name,             \
+                                                  AMFVariantStruct value)                   \
+{                                                                                           \
+    return obj_set_property((StubObject *)p, name, &value);                                 \
+}                                                                                           \
+static AMF_RESULT AMF_STD_CALL type##_GetProperty(type *p, const wchar_t *name,             \
+                                                  AMFVariantStruct *value)                  \
+{                                                                                           \
+    return obj_get_property((StubObject *)p, name, value);                                  \
+}                                                                                           \
+static amf_bool AMF_STD_CALL type##_HasProperty(type *p, const wchar_t *name)               \
+{                                                                                           \
+    return obj_find_prop((StubObject *)p, name) != NULL;                                    \
+}
+
+#define STUB_DATA_FUNCS(type, data_type)                                                    \
+static AMF_MEMORY_TYPE AMF_STD_CALL type##_GetMemoryType(type *p)                           \
+{                                                                                           \
+    return AMF_MEMORY_HOST;                                                                 \
+}                                                                                           \
+static AMF_DATA_TYPE AMF_STD_CALL type##_GetDataType(type *p)                               \
+{                                                                                           \
+    return data_type;                                                                       \
+}                                                                                           \
+static amf_bool AMF_STD_CALL type##_IsReusable(type *p)                                     \
+{                                                                                           \
+    return 0;                                                                               \
+}                                                                                           \
+static void AMF_STD_CALL type##_SetPts(type *p, amf_pts pts)                                \
+{                                                                                           \
+    ((StubObject *)p)->pts = pts;                                                           \
+}                                                                                           \
+static amf_pts AMF_STD_CALL type##_GetPts(type *p)                                          \
+{                                                                                           \
+    return ((StubObject *)p)->pts;                                                          \
+}                                                                                           \
+static void AMF_STD_CALL type##_SetDuration(type *p, amf_pts duration)                      \
+{                                                                                           \
+    ((StubObject *)p)->duration = duration;                                                 \
+}                                                                                           \
+static amf_pts AMF_STD_CALL type##_GetDuration(type *p)                                     \
+{                                                                                           \
+    return ((StubObject *)p)->duration;                                                     \
+}
+
+#define STUB_INTERFACE_VTBL(type)           \
+    .Acquire        = type##_Acquire,       \
+    .Release        = type##_Release,       \
+    .QueryInterface = type##_QueryInterface
+
+#define STUB_PROPERTY_VTBL(type)            \
+    .SetProperty    = type##_SetProperty,   \
+    .GetProperty    = type##_GetProperty,   \
+    .HasProperty    = type##_HasProperty
+
+#define STUB_DATA_VTBL(type)                \
+    .GetMemoryType  = type##_GetMemoryType, \
+    .GetDataType    = type##_GetDataType,   \
+    .IsReusable     = type##_IsReusable,    \
+    .SetPts         = type##_SetPts,        \
+    .GetPts         = type##_GetPts,        \
+    .SetDuration    = type##_SetDuration,   \
+    .GetDuration    = type##_GetDuration
+
+/* AMFBuffer */
+
+typedef struct StubBuffer {
+    StubObject obj;
+    uint8_t   *data;
+    amf_size   size;
+} StubBuffer;
+
+static const AMFGuid *buffer_iids(int *nb)
+{
+    static AMFGuid iids[4];
+    iids[0] = IID_AMFInterface();
+    iids[1] = IID_AMFPropertyStorage();
+    iids[2] = IID_AMFData();
+    iids[3] = IID_AMFBuffer();
+    *nb = 4;
+    return iids;
+}
+
+static void buffer_destroy(StubObject *obj)
+{
+    StubBuffer *buf = (StubBuffer *)obj;
+    free(buf->data);
+    free(buf);
+}
+
+STUB_INTERFACE_FUNCS(AMFBuffer)
+STUB_PROPERTY_FUNCS(AMFBuffer)
+STUB_DATA_FUNCS(AMFBuffer, AMF_DATA_BUFFER)
+
+static AMF_RESULT AMF_STD_CALL AMFBuffer_SetSize(AMFBuffer *p, amf_size size)
+{
+    StubBuffer *buf = (StubBuffer *)p;
+    return size <= buf->size ? (buf->size = size, AMF_OK) : AMF_INVALID_ARG;
+}
+
+static amf_size AMF_STD_CALL AMFBuffer_GetSize(AMFBuffer *p)
+{
+    return ((StubBuffer *)p)->size;
+}
+
+static void *AMF_STD_CALL AMFBuffer_GetNative(AMFBuffer *p)
+{
+    return ((StubBuffer *)p)->data;
+}
+
+static const AMFBufferVtbl buffer_vtbl = {
+    STUB_INTERFACE_VTBL(AMFBuffer),
+    STUB_PROPERTY_VTBL(AMFBuffer),
+    STUB_DATA_VTBL(AMFBuffer),
+    .SetSize   = AMFBuffer_SetSize,
+    .GetSize   = AMFBuffer_GetSize,
+    .GetNative = AMFBuffer_GetNative,
+};
+
+static StubBuffer *buffer_alloc(amf_size size)
+{
+    StubBuffer *buf = malloc(sizeof(*buf));
+    if (!buf)
+        return NULL;
+    obj_init(&buf->obj, &buffer_vtbl, buffer_destroy, buffer_iids);
+    buf->size = size;
+    buf->data = calloc(1, size ? size : 1);
+    if (!buf->data) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+/* AMFSurface and AMFPlane */
+
+typedef struct StubSurface StubSurface;
+
+typedef struct StubPlane {
+    const AMFPlaneVtbl *vtbl;
+    StubSurface        *surface;
+    AMF_PLANE_TYPE      type;
+    uint8_t            *data;
+    int                 pixel_size;
+    int                 width, height, pitch;
+} StubPlane;
+
+struct StubSurface {
+    StubObject         obj;
+    AMF_SURFACE_FORMAT format;
+    AMF_FRAME_TYPE     frame_type;
+    StubPlane          planes[3];
+    int                nb_planes;
+};
+
+static const AMFGuid *surface_iids(int *nb)
+{
+    static AMFGuid iids[4];
+    iids[0] = IID_AMFInterface();
+    iids[1] = IID_AMFPropertyStorage();
+    iids[2] = IID_AMFData();
+    iids[3] = IID_AMFSurface();
+    *nb = 4;
+    return iids;
+}
+
+static void surface_destroy(StubObject *obj)
+{
+    StubSurface *surf = (StubSurface *)obj;
+    for (int i = 0; i < surf->nb_planes; i++)
+        free(surf->planes[i].data);
+    free(surf);
+}
+
+/* planes live inside their surface and share its reference count */
+static amf_long AMF_STD_CALL AMFPlane_Acquire(AMFPlane *p)
+{
+    return obj_acquire(&((StubPlane *)p)->surface->obj);
+}
+
+static amf_long AMF_STD_CALL AMFPlane_Release(AMFPlane *p)
+{
+    return obj_release(&((StubPlane *)p)->surface->obj);
+}
+
+static AMF_RESULT AMF_STD_CALL AMFPlane_QueryInterface(AMFPlane *p, const AMFGuid *iid, void **o)
+{
+    AMFGuid plane = IID_AMFPlane(), iface = IID_AMFInterface();
+
+    if (memcmp(iid, &plane, sizeof(*iid)) && memcmp(iid, &iface, sizeof(*iid))) {
+        *o = NULL;
+        return AMF_NO_INTERFACE;
+    }
+    AMFPlane_Acquire(p);
+    *o = p;
+    return AMF_OK;
+}
+
+static AMF_PLANE_TYPE AMF_STD_CALL AMFPlane_GetType(AMFPlane *p)      { return ((StubPlane *)p)->type;       }
+static void *AMF_STD_CALL AMFPlane_GetNative(AMFPlane *p)             { return ((StubPlane *)p)->data;       }
+static amf_int32 AMF_STD_CALL AMFPlane_GetPixelSizeInBytes(AMFPlane *p) { return ((StubPlane *)p)->pixel_size; }
+static amf_int32 AMF_STD_CALL AMFPlane_GetOffsetX(AMFPlane *p)        { return 0;                            }
+static amf_int32 AMF_STD_CALL AMFPlane_GetOffsetY(AMFPlane *p)        { return 0;                            }
+static amf_int32 AMF_STD_CALL AMFPlane_GetWidth(AMFPlane *p)          { return ((StubPlane *)p)->width;      }
+static amf_int32 AMF_STD_CALL AMFPlane_GetHeight(AMFPlane *p)         { return ((StubPlane *)p)->height;     }
+static amf_int32 AMF_STD_CALL AMFPlane_GetHPitch(AMFPlane *p)         { return ((StubPlane *)p)->pitch;      }
+static amf_int32 AMF_STD_CALL AMFPlane_GetVPitch(AMFPlane *p)         { return ((StubPlane *)p)->height;     }
+static amf_bool AMF_STD_CALL AMFPlane_IsTiled(AMFPlane *p)            { return 0;                            }
+
+static const AMFPlaneVtbl plane_vtbl = {
+    STUB_INTERFACE_VTBL(AMFPlane),
+    .GetType             = AMFPlane_GetType,
+    .GetNative           = AMFPlane_GetNative,
+    .GetPixelSizeInBytes = AMFPlane_GetPixelSizeInBytes,
+    .GetOffsetX          = AMFPlane_GetOffsetX,
+    .GetOffsetY          = AMFPlane_GetOffsetY,
+    .GetWidth            = AMFPlane_GetWidth,
+    .GetHeight           = AMFPlane_GetHeight,
+    .GetHPitch           = AMFPlane_GetHPitch,
+    .GetVPitch           = AMFPlane_GetVPitch,
+    .IsTiled             = AMFPlane_IsTiled,
+};
+
+STUB_INTERFACE_FUNCS(AMFSurface)
+STUB_PROPERTY_FUNCS(AMFSurface)
+STUB_DATA_FUNCS(AMFSurface, AMF_DATA_SURFACE)
+
+static AMF_SURFACE_FORMAT AMF_STD_CALL AMFSurface_GetFormat(AMFSurface *p)
+{
+    return ((StubSurface *)p)->format;
+}
+
+static amf_size AMF_STD_CALL AMFSurface_GetPlanesCount(AMFSurface *p)
+{
+    return ((StubSurface *)p)->nb_planes;
+}
+
+static AMFPlane *AMF_STD_CALL AMFSurface_GetPlaneAt(AMFSurface *p, amf_size index)
+{
+    StubSurface *surf = (StubSurface *)p;
+    return index < surf->nb_planes ? (AMFPlane *)&surf->planes[index] : NULL;
+}
+
+static AMFPlane *AMF_STD_CALL AMFSurface_GetPlane(AMFSurface *p, AMF_PLANE_TYPE type)
+{
+    StubSurface *surf = (StubSurface *)p;
+    for (int i = 0; i < surf->nb_planes; i++)
+        if (surf->planes[i].type == type)
+            return (AMFPlane *)&surf->planes[i];
+    return NULL;
+}
+
+static AMF_FRAME_TYPE AMF_STD_CALL AMFSurface_GetFrameType(AMFSurface *p)
+{
+    return ((StubSurface *)p)->frame_type;
+}
+
+static void AMF_STD_CALL AMFSurface_SetFrameType(AMFSurface *p, AMF_FRAME_TYPE type)
+{
+    ((StubSurface *)p)->frame_type = type;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFSurface_SetCrop(AMFSurface *p, amf_int32 x, amf_int32 y,
+                                                  amf_int32 width, amf_int32 height)
+{
+    return AMF_OK;
+}
+
+static const AMFSurfaceVtbl surface_vtbl = {
+    STUB_INTERFACE_VTBL(AMFSurface),
+    STUB_PROPERTY_VTBL(AMFSurface),
+    STUB_DATA_VTBL(AMFSurface),
+    .GetFormat      = AMFSurface_GetFormat,
+    .GetPlanesCount = AMFSurface_GetPlanesCount,
+    .GetPlaneAt     = AMFSurface_GetPlaneAt,
+    .GetPlane       = AMFSurface_GetPlane,
+    .GetFrameType   = AMFSurface_GetFrameType,
+    .SetFrameType   = AMFSurface_SetFrameType,
+    .SetCrop        = AMFSurface_SetCrop,
+};
+
+static int surface_add_plane(StubSurface *surf, AMF_PLANE_TYPE type,
+                             int width, int height, int pixel_size)
+{
+    StubPlane *plane = &surf->planes[surf->nb_planes];
+
+    plane->vtbl       = &plane_vtbl;
+    plane->surface    = surf;
+    plane->type       = type;
+    plane->pixel_size = pixel_size;
+    plane->width      = width;
+    plane->height     = height;
+    plane->pitch      = (width * pixel_size + 255) & ~255;
+    plane->data       = calloc(plane->pitch, height);
+    if (!plane->data)
+        return -1;
+    surf->nb_planes++;
+    return 0;
+}
+
+static StubSurface *surface_alloc(AMF_SURFACE_FORMAT format, int width, int height)
+{
+    StubSurface *surf = calloc(1, sizeof(*surf));
+    int cw = (width + 1) >> 1, ch = (height + 1) >> 1, ret;
+
+    if (!surf)
+        return NULL;
+    obj_init(&surf->obj, &surface_vtbl, surface_destroy, surface_iids);
+    surf->format     = format;
+    surf->frame_type = AMF_FRAME_PROGRESSIVE;
+
+    switch (format) {
+    case AMF_SURFACE_NV12:
+        ret = surface_add_plane(surf, AMF_PLANE_Y,  width, height, 1) ||
+              surface_add_plane(surf, AMF_PLANE_UV, cw,    ch,     2);
+        break;
+    case AMF_SURFACE_P010:
+        ret = surface_add_plane(surf, AMF_PLANE_Y,  width, height, 2) ||
+              surface_add_plane(surf, AMF_PLANE_UV, cw,    ch,     4);
+        break;
+    case AMF_SURFACE_YUV420P:
+        ret = surface_add_plane(surf, AMF_PLANE_Y, width, height, 1) ||
+              surface_add_plane(surf, AMF_PLANE_U, cw,    ch,     1) ||
+              surface_add_plane(surf, AMF_PLANE_V, cw,    ch,     1);
+        break;
+    case AMF_SURFACE_BGRA:
+    case AMF_SURFACE_RGBA:
+        ret = surface_add_plane(surf, AMF_PLANE_PACKED, width, height, 4);
+        break;
+    default:
+        ret = -1;
+        break;
+    }
+    if (ret) {
+        surface_destroy(&surf->obj);
+        return NULL;
+    }
+    return surf;
+}
+
+/* AMFComponent: the encoder */
+
+enum StubCodec {
+    STUB_CODEC_H264,
+    STUB_CODEC_HEVC,
+    STUB_CODEC_AV1,
+};
+
+typedef struct StubEncoder {
+    StubObject      obj;
+    enum StubCodec  codec;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       worker;
+    int             worker_running;
+
+    /* protected by lock */
+    StubObject     *in_head, *in_tail;
+    StubObject     *out_head, *out_tail;
+    int             in_flight;   ///< submitted but not yet returned by QueryOutput()
+    int             busy;        ///< the worker is encoding a frame
+    int             draining;
+    int             terminate;
+
+    int             latency_us;
+    int             queue_size;
+    int             packet_size;
+    int             gop;
+    int             no_timeout;
+    int             timeout_fail;
+    int64_t         nb_encoded;
+} StubEncoder;
+
+static const wchar_t *const query_timeout_prop[] = {
+    [STUB_CODEC_H264] = AMF_VIDEO_ENCODER_QUERY_TIMEOUT,
+    [STUB_CODEC_HEVC] = AMF_VIDEO_ENCODER_HEVC_QUERY_TIMEOUT,
+    [STUB_CODEC_AV1]  = AMF_VIDEO_ENCODER_AV1_QUERY_TIMEOUT,
+};
+
+static const wchar_t *const extradata_prop[] = {
+    [STUB_CODEC_H264] = AMF_VIDEO_ENCODER_EXTRADATA,
+    [STUB_CODEC_HEVC] = AMF_VIDEO_ENCODER_HEVC_EXTRADATA,
+    [STUB_CODEC_AV1]  = AMF_VIDEO_ENCODER_AV1_EXTRADATA,
+};
+
+static void queue_push(StubObject **head, StubObject **tail, StubObject *obj)
+{
+    obj->next = NULL;
+    if (*tail)
+        (*tail)->next = obj;
+    else
+        *head = obj;
+    *tail = obj;
+}
+
+static StubObject *queue_pop(StubObject **head, StubObject **tail)
+{
+    StubObject *obj = *head;
+    if (obj) {
+        *head = obj->next;
+        if (!*head)
+            *tail = NULL;
+        obj->next = NULL;
+    }
+    return obj;
+}
+
+static int encoder_drained(const StubEncoder *enc)
+{
+    return enc->draining && !enc->in_head && !enc->busy && !enc->out_head;
+}
+
+static void set_output_type(StubEncoder *enc, StubBuffer *buf, int key)
+{
+    AMFVariantStruct var;
+
+    AMFVariantInit(&var);
+    switch (enc->codec) {
+    case STUB_CODEC_H264:
+        AMFVariantAssignInt64(&var, key ? AMF_VIDEO_ENCODER_OUTPUT_DATA_TYPE_IDR :
+                                          AMF_VIDEO_ENCODER_OUTPUT_DATA_TYPE_P);
+        obj_set_property(&buf->obj, AMF_VIDEO_ENCODER_OUTPUT_DATA_TYPE, &var);
+        break;
+    case STUB_CODEC_HEVC:
+        AMFVariantAssignInt64(&var, key ? AMF_VIDEO_ENCODER_HEVC_OUTPUT_DATA_TYPE_IDR :
+                                          AMF_VIDEO_ENCODER_HEVC_OUTPUT_DATA_TYPE_P);
+        obj_set_property(&buf->obj, AMF_VIDEO_ENCODER_HEVC_OUTPUT_DATA_TYPE, &var);
+        break;
+    case STUB_CODEC_AV1:
+        AMFVariantAssignInt64(&var, key ? AMF_VIDEO_ENCODER_AV1_OUTPUT_FRAME_TYPE_KEY :
+                                          AMF_VIDEO_ENCODER_AV1_OUTPUT_FRAME_TYPE_INTER);
+        obj_set_property(&buf->obj, AMF_VIDEO_ENCODER_AV1_OUTPUT_FRAME_TYPE, &var);
+        break;
+    }
+}
+
+static void *encoder_worker(void *arg)
+{
+    StubEncoder *enc = arg;
+
+    pthread_mutex_lock(&enc->lock);
+    while (1) {
+        StubObject *in;
+        StubBuffer *out;
+        int key;
+
+        while (!enc->terminate && !enc->in_head)
+            pthread_cond_wait(&enc->cond, &enc->lock);
+        if (enc->terminate)
+            break;
+
+        in = queue_pop(&enc->in_head, &enc->in_tail);
+        enc->busy = 1;
+        key = enc->gop <= 0 || !(enc->nb_encoded % enc->gop);
+        enc->nb_encoded++;
+        pthread_mutex_unlock(&enc->lock);
+
+        if (enc->latency_us > 0)
+            usleep(enc->latency_us);
+
+        out = buffer_alloc(enc->packet_size);
+        if (out) {
+            memset(out->data, key ? 0xAA : 0x55, out->size);
+            obj_copy_props(&out->obj, in);
+            out->obj.pts      = in->pts;
+            out->obj.duration = in->duration;
+            set_output_type(enc, out, key);
+        }
+        obj_release(in);
+
+        pthread_mutex_lock(&enc->lock);
+        enc->busy = 0;
+        if (out)
+            queue_push(&enc->out_head, &enc->out_tail, &out->obj);
+        else
+            enc->in_flight--;
+        pthread_cond_broadcast(&enc->cond);
+    }
+    pthread_mutex_unlock(&enc->lock);
+    return NULL;
+}
+
+static void encoder_stop(StubEncoder *enc)
+{
+    StubObject *obj;
+
+    if (enc->worker_running) {
+        pthread_mutex_lock(&enc->lock);
+        enc->terminate = 1;
+        pthread_cond_broadcast(&enc->cond);
+        pthread_mutex_unlock(&enc->lock);
+        pthread_join(enc->worker, NULL);
+        enc->worker_running = 0;
+    }
+    while ((obj = queue_pop(&enc->in_head, &enc->in_tail)))
+        obj_release(obj);
+    while ((obj = queue_pop(&enc->out_head, &enc->out_tail)))
+        obj_release(obj);
+    enc->in_flight = 0;
+    enc->draining  = 0;
+    enc->terminate = 0;
+}
+
+static const AMFGuid *encoder_iids(int *nb)
+{
+    static AMFGuid iids[4];
+    iids[0] = IID_AMFInterface();
+    iids[1] = IID_AMFPropertyStorage();
+    iids[2] = IID_AMFPropertyStorageEx();
+    iids[3] = IID_AMFComponent();
+    *nb = 4;
+    return iids;
+}
+
+static void encoder_destroy(StubObject *obj)
+{
+    StubEncoder *enc = (StubEncoder *)obj;
+    encoder_stop(enc);
+    pthread_cond_destroy(&enc->cond);
+    pthread_mutex_destroy(&enc->lock);
+    free(enc);
+}
+
+STUB_INTERFACE_FUNCS(AMFComponent)
+STUB_PROPERTY_FUNCS(AMFComponent)
+
+static AMF_RESULT AMF_STD_CALL encoder_set_property(AMFComponent *p, const wchar_t *name,
+                                                    AMFVariantStruct value)
+{
+    StubEncoder *enc = (StubEncoder *)p;
+
+    if (enc->timeout_fail && enc->worker_running &&
+        !wcscmp(name, query_timeout_prop[enc->codec]))
+        return AMF_FAIL;
+    return AMFComponent_SetProperty(p, name, value);
+}
+
+static AMF_RESULT AMF_STD_CALL encoder_get_property(AMFComponent *p, const wchar_t *name,
+                                                    AMFVariantStruct *value)
+{
+    StubEncoder *enc = (StubEncoder *)p;
+
+    if (enc->no_timeout && !wcscmp(name, query_timeout_prop[enc->codec]))
+        return AMF_NOT_FOUND;
+    return AMFComponent_GetProperty(p, name, value);
+}
+
+static AMF_RESULT AMF_STD_CALL AMFComponent_Init(AMFComponent *p, AMF_SURFACE_FORMAT format,
+                                                 amf_int32 width, amf_int32 height)
+{
+    StubEncoder *enc = (StubEncoder *)p;
+    AMFVariantStruct var;
+    StubBuffer *extradata;
+    AMF_RESULT res;
+
+    if (enc->worker_running)
+        return AMF_ALREADY_INITIALIZED;
+
+    extradata = buffer_alloc(16);
+    if (!extradata)
+        return AMF_OUT_OF_MEMORY;
+    AMFVariantInit(&var);
+    AMFVariantAssignInterface(&var, (AMFInterface *)extradata);
+    res = obj_set_property(&enc->obj, extradata_prop[enc->codec], &var);
+    AMFVariantClear(&var);
+    obj_release(&extradata->obj);
+    if (res != AMF_OK)
+        return res;
+
+    if (pthread_create(&enc->worker, NULL, encoder_worker, enc))
+        return AMF_FAIL;
+    enc->worker_running = 1;
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFComponent_Terminate(AMFComponent *p)
+{
+    encoder_stop((StubEncoder *)p);
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFComponent_Drain(AMFComponent *p)
+{
+    StubEncoder *enc = (StubEncoder *)p;
+
+    pthread_mutex_lock(&enc->lock);
+    enc->draining = 1;
+    pthread_cond_broadcast(&enc->cond);
+    pthread_mutex_unlock(&enc->lock);
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFComponent_Flush(AMFComponent *p)
+{
+    StubEncoder *enc = (StubEncoder *)p;
+    StubObject *obj;
+
+    pthread_mutex_lock(&enc->lock);
+    while ((obj = queue_pop(&enc->in_head, &enc->in_tail))) {
+        obj_release(obj);
+        enc->in_flight--;
+    }
+    while ((obj = queue_pop(&enc->out_head, &enc->out_tail))) {
+        obj_release(obj);
+        enc->in_flight--;
+    }
+    enc->draining = 0;
+    pthread_mutex_unlock(&enc->lock);
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFComponent_SubmitInput(AMFComponent *p, AMFData *data)
+{
+    StubEncoder *enc = (StubEncoder *)p;
+    AMF_RESULT res = AMF_OK;
+
+    if (!enc->worker_running)
+        return AMF_NOT_INITIALIZED;
+
+    pthread_mutex_lock(&enc->lock);
+    if (enc->draining) {
+        res = AMF_EOF;
+    } else if (enc->in_flight >= enc->queue_size) {
+        res = AMF_INPUT_FULL;
+    } else {
+        obj_acquire((StubObject *)data);
+        queue_push(&enc->in_head, &enc->in_tail, (StubObject *)data);
+        enc->in_flight++;
+        pthread_cond_broadcast(&enc->cond);
+    }
+    pthread_mutex_unlock(&enc->lock);
+    return res;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFComponent_QueryOutput(AMFComponent *p, AMFData **data)
+{
+    StubEncoder *enc = (StubEncoder *)p;
+    int64_t timeout = enc->no_timeout ? 0 :
+                      obj_get_int(&enc->obj, query_timeout_prop[enc->codec], 0);
+    struct timespec deadline;
+    StubObject *out;
+    AMF_RESULT res;
+
+    *data = NULL;
+    if (!enc->worker_running)
+        return AMF_NOT_INITIALIZED;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec  += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&enc->lock);
+    while (timeout > 0 && !enc->out_head && !encoder_drained(enc) &&
+           (enc->in_head || enc->busy)) {
+        if (pthread_cond_timedwait(&enc->cond, &enc->lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    out = queue_pop(&enc->out_head, &enc->out_tail);
+    if (out) {
+        enc->in_flight--;
+        *data = (AMFData *)out;
+        res   = AMF_OK;
+    } else {
+        res = encoder_drained(enc) ? AMF_EOF : AMF_REPEAT;
+    }
+    pthread_mutex_unlock(&enc->lock);
+    return res;
+}
+
+static const AMFComponentVtbl component_vtbl = {
+    STUB_INTERFACE_VTBL(AMFComponent),
+    .SetProperty = encoder_set_property,
+    .GetProperty = encoder_get_property,
+    .HasProperty = AMFComponent_HasProperty,
+    .Init        = AMFComponent_Init,
+    .Terminate   = AMFComponent_Terminate,
+    .Drain       = AMFComponent_Drain,
+    .Flush       = AMFComponent_Flush,
+    .SubmitInput = AMFComponent_SubmitInput,
+    .QueryOutput = AMFComponent_QueryOutput,
+};
+
+static StubEncoder *encoder_alloc(enum StubCodec codec)
+{
+    StubEncoder *enc = calloc(1, sizeof(*enc));
+
+    if (!enc)
+        return NULL;
+    obj_init(&enc->obj, &component_vtbl, encoder_destroy, encoder_iids);
+    enc->codec        = codec;
+    enc->latency_us   = env_int("AMF_STUB_LATENCY_US", 2000);
+    enc->queue_size   = STUB_MAX(env_int("AMF_STUB_QUEUE_SIZE", 16), 1);
+    enc->packet_size  = STUB_MAX(env_int("AMF_STUB_PACKET_SIZE", 1024), 1);
+    enc->gop          = env_int("AMF_STUB_GOP", 250);
+    enc->no_timeout   = !!getenv("AMF_STUB_NO_TIMEOUT");
+    enc->timeout_fail = !!getenv("AMF_STUB_TIMEOUT_FAIL");
+    pthread_mutex_init(&enc->lock, NULL);
+    pthread_cond_init(&enc->cond, NULL);
+    return enc;
+}
+
+/* AMFContext */
+
+typedef struct StubContext {
+    StubObject obj;
+} StubContext;
+
+static const AMFGuid *context_iids(int *nb)
+{
+    static AMFGuid iids[4];
+    iids[0] = IID_AMFInterface();
+    iids[1] = IID_AMFPropertyStorage();
+    iids[2] = IID_AMFContext();
+    iids[3] = IID_AMFContext1();
+    *nb = 4;
+    return iids;
+}
+
+static void context_destroy(StubObject *obj)
+{
+    free(obj);
+}
+
+/* AMFContext1Vtbl starts with all of AMFContextVtbl, so one table serves both */
+STUB_INTERFACE_FUNCS(AMFContext1)
+STUB_PROPERTY_FUNCS(AMFContext1)
+
+static AMF_RESULT AMF_STD_CALL AMFContext1_Terminate(AMFContext1 *p)
+{
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFContext1_InitDX9(AMFContext1 *p, void *device)
+{
+    return AMF_NOT_SUPPORTED;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFContext1_InitDX11(AMFContext1 *p, void *device,
+                                                    AMF_DX_VERSION version)
+{
+    return AMF_NOT_SUPPORTED;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFContext1_InitVulkan(AMFContext1 *p, void *device)
+{
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFContext1_AllocBuffer(AMFContext1 *p, AMF_MEMORY_TYPE type,
+                                                       amf_size size, AMFBuffer **buffer)
+{
+    StubBuffer *buf;
+
+    if (type != AMF_MEMORY_HOST)
+        return AMF_NOT_SUPPORTED;
+    buf = buffer_alloc(size);
+    *buffer = (AMFBuffer *)buf;
+    return buf ? AMF_OK : AMF_OUT_OF_MEMORY;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFContext1_AllocSurface(AMFContext1 *p, AMF_MEMORY_TYPE type,
+                                                        AMF_SURFACE_FORMAT format,
+                                                        amf_int32 width, amf_int32 height,
+                                                        AMFSurface **surface)
+{
+    StubSurface *surf;
+
+    if (type != AMF_MEMORY_HOST)
+        return AMF_NOT_SUPPORTED;
+    surf = surface_alloc(format, width, height);
+    *surface = (AMFSurface *)surf;
+    return surf ? AMF_OK : AMF_OUT_OF_MEMORY;
+}
+
+static const AMFContext1Vtbl context_vtbl = {
+    STUB_INTERFACE_VTBL(AMFContext1),
+    STUB_PROPERTY_VTBL(AMFContext1),
+    .Terminate    = AMFContext1_Terminate,
+    .InitDX9      = AMFContext1_InitDX9,
+    .InitDX11     = AMFContext1_InitDX11,
+    .AllocBuffer  = AMFContext1_AllocBuffer,
+    .AllocSurface = AMFContext1_AllocSurface,
+    .InitVulkan   = AMFContext1_InitVulkan,
+};
+
+/* AMFTrace and AMFDebug, logging is discarded */
+
+static amf_int32 AMF_STD_CALL AMFTrace_SetGlobalLevel(AMFTrace *p, amf_int32 level)
+{
+    return AMF_TRACE_WARNING;
+}
+
+static amf_bool AMF_STD_CALL AMFTrace_EnableWriter(AMFTrace *p, const wchar_t *id, amf_bool enable)
+{
+    return 0;
+}
+
+static amf_int32 AMF_STD_CALL AMFTrace_SetWriterLevel(AMFTrace *p, const wchar_t *id, amf_int32 level)
+{
+    return AMF_TRACE_WARNING;
+}
+
+static void AMF_STD_CALL AMFTrace_RegisterWriter(AMFTrace *p, const wchar_t *id,
+                                                 AMFTraceWriter *writer, amf_bool enable)
+{
+}
+
+static void AMF_STD_CALL AMFTrace_UnregisterWriter(AMFTrace *p, const wchar_t *id)
+{
+}
+
+static const AMFTraceVtbl trace_vtbl = {
+    .SetGlobalLevel   = AMFTrace_SetGlobalLevel,
+    .EnableWriter     = AMFTrace_EnableWriter,
+    .SetWriterLevel   = AMFTrace_SetWriterLevel,
+    .RegisterWriter   = AMFTrace_RegisterWriter,
+    .UnregisterWriter = AMFTrace_UnregisterWriter,
+};
+
+static AMFTrace stub_trace = { .pVtbl = &trace_vtbl };
+
+static const AMFDebugVtbl debug_vtbl = { 0 };
+
+static AMFDebug stub_debug = { .pVtbl = &debug_vtbl };
+
+/* AMFFactory */
+
+static AMF_RESULT AMF_STD_CALL AMFFactory_CreateContext(AMFFactory *p, AMFContext **context)
+{
+    StubContext *ctx = malloc(sizeof(*ctx));
+
+    *context = NULL;
+    if (!ctx)
+        return AMF_OUT_OF_MEMORY;
+    obj_init(&ctx->obj, &context_vtbl, context_destroy, context_iids);
+    *context = (AMFContext *)ctx;
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFFactory_CreateComponent(AMFFactory *p, AMFContext *context,
+                                                          const wchar_t *id, AMFComponent **component)
+{
+    StubEncoder *enc;
+    enum StubCodec codec;
+
+    *component = NULL;
+    if (!wcscmp(id, AMFVideoEncoderVCE_AVC))
+        codec = STUB_CODEC_H264;
+    else if (!wcscmp(id, AMFVideoEncoder_HEVC))
+        codec = STUB_CODEC_HEVC;
+    else if (!wcscmp(id, AMFVideoEncoder_AV1))
+        codec = STUB_CODEC_AV1;
+    else
+        return AMF_NOT_SUPPORTED;
+
+    enc = encoder_alloc(codec);
+    if (!enc)
+        return AMF_OUT_OF_MEMORY;
+    *component = (AMFComponent *)enc;
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFFactory_GetDebug(AMFFactory *p, AMFDebug **debug)
+{
+    *debug = &stub_debug;
+    return AMF_OK;
+}
+
+static AMF_RESULT AMF_STD_CALL AMFFactory_GetTrace(AMFFactory *p, AMFTrace **trace)
+{
+    *trace = &stub_trace;
+    return AMF_OK;
+}
+
+static const AMFFactoryVtbl factory_vtbl = {
+    .CreateContext   = AMFFactory_CreateContext,
+    .CreateComponent = AMFFactory_CreateComponent,
+    .GetDebug        = AMFFactory_GetDebug,
+    .GetTrace        = AMFFactory_GetTrace,
+};
+
+static AMFFactory stub_factory = { .pVtbl = &factory_vtbl };
+
+STUB_EXPORT AMF_RESULT AMF_CDECL_CALL AMFQueryVersion(amf_uint64 *version)
+{
+    *version = AMF_FULL_VERSION;
+    return AMF_OK;
+}
+
+STUB_EXPORT AMF_RESULT AMF_CDECL_CALL AMFInit(amf_uint64 version, AMFFactory **factory)
+{
+    *factory = &stub_factory;
+    return AMF_OK;
+}